@@ -1,12 +1,14 @@
 #!/usr/bin/env pwsh
 # UWB Tag Firmware - Build Script
-# Usage: .\build.ps1 [board_name] [clean]
+# Usage: .\build.ps1 [board_name] [clean] [-Overlay conf,...]
 #   Example: .\build.ps1 nrf52833dongle_nrf52833
 #   Example: .\build.ps1 nrf52833dk_nrf52833 clean
+#   Example: .\build.ps1 -Overlay overlay-prod.conf,overlay-memreport.conf
 
 param(
     [string]$Board = "nrf52833dongle_nrf52833",
-    [switch]$Clean
+    [switch]$Clean,
+    [string[]]$Overlay = @()
 )
 
 $ErrorActionPreference = "Stop"
@@ -15,6 +17,9 @@ Write-Host "=======================================" -ForegroundColor Cyan
 Write-Host "UWB Tag Firmware - Build Script" -ForegroundColor Cyan
 Write-Host "=======================================" -ForegroundColor Cyan
 Write-Host "Board: $Board" -ForegroundColor Yellow
+if ($Overlay.Count -gt 0) {
+    Write-Host "Overlays: $($Overlay -join ', ')" -ForegroundColor Yellow
+}
 Write-Host ""
 
 # Check if west is available
@@ -42,7 +47,11 @@ Write-Host "Building firmware for $Board..." -ForegroundColor Yellow
 Write-Host ""
 
 try {
-    west build -b $Board -d build -- -DCMAKE_EXPORT_COMPILE_COMMANDS=ON
+    $cmakeArgs = @("-DCMAKE_EXPORT_COMPILE_COMMANDS=ON")
+    if ($Overlay.Count -gt 0) {
+        $cmakeArgs += "-DEXTRA_CONF_FILE=$($Overlay -join ';')"
+    }
+    west build -b $Board -d build -- @cmakeArgs
     
     Write-Host ""
     Write-Host "=======================================" -ForegroundColor Green
@@ -0,0 +1,161 @@
+#ifndef AGG_H
+#define AGG_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "uwb_stream_proto.h"
+
+/* Multi-anchor range aggregation daemon (aggd): input framing, lock-free
+ * epoch buckets and the multilateration solver. See host/README.md.
+ *
+ * Inputs are COBS streams in the uwb_stream_proto.h framing, with two frame
+ * types:
+ *   UWB_STREAM_TYPE_RANGES (0x52)  a tag's own stream (CONFIG_UWB_STREAM); the
+ *                                  tag id comes from the input, the epoch is
+ *                                  t_ms / epoch_ms
+ *   AGG_TYPE_TAG_RANGES (0x54)     anchor/gateway reports for many tags: each
+ *                                  record is tag(2) epoch(4) + a 16-byte
+ *                                  uwb_stream record. The epoch is the tag's
+ *                                  cycle counter as seen by all anchors (the
+ *                                  REPORT's POLL sequence number, unwrapped).
+ * Same header (type, n, seq, dropped) and CRC as the tag stream.
+ */
+
+#define AGG_TYPE_TAG_RANGES     0x54
+#define AGG_TAG_REC_LEN         (6 + UWB_STREAM_REC_LEN)
+#define AGG_TAG_MAX_RECORDS     ((254 - UWB_STREAM_HDR_LEN - UWB_STREAM_CRC_LEN) / AGG_TAG_REC_LEN)
+#define AGG_TAG_FRAME_LEN(n)    (UWB_STREAM_HDR_LEN + (n) * AGG_TAG_REC_LEN + UWB_STREAM_CRC_LEN)
+
+#define AGG_MAX_RANGES          16      // ranges kept per (tag, epoch)
+#define AGG_EPOCH_RING          4       // open epochs per tag; must exceed lag + 1
+#define AGG_MAX_ANCHORS         64
+
+struct agg_range {
+    uint64_t key;           // (tag, epoch) the writer meant; foreign entries are ignored
+    uint16_t anchor;
+    uint8_t quality;
+    uint32_t dist_mm;
+};
+
+/* One (tag, epoch) bucket. key: 0 free, AGG_KEY_CLAIMING while being reset,
+ * else (tag + 1) << 32 | epoch. n carries AGG_SEALED once the bucket is closed;
+ * a writer whose fetch_add returns a sealed count drops its range. */
+struct agg_bucket {
+    _Atomic uint64_t key;
+    _Atomic uint32_t n;
+    _Atomic uint32_t committed;
+    _Atomic int64_t first_ns;
+    struct agg_range r[AGG_MAX_RANGES];
+};
+
+#define AGG_KEY_CLAIMING        UINT64_MAX
+#define AGG_SEALED              0x80000000u
+
+/* Bounded MPMC queue of sealed buckets (Vyukov). Capacity >= bucket count,
+ * so a push never fails: each bucket is queued at most once. */
+struct agg_qcell {
+    _Atomic uint32_t seq;
+    uint32_t bucket;
+    uint32_t count;
+};
+
+struct agg_queue {
+    struct agg_qcell *cells;
+    uint32_t mask;
+    _Atomic uint32_t head;
+    _Atomic uint32_t tail;
+};
+
+struct agg_stats {
+    _Atomic uint64_t ranges;
+    _Atomic uint64_t late;          // epoch already sealed
+    _Atomic uint64_t stalled;       // reader waited for a worker to free a ring slot
+    _Atomic uint64_t overflow;      // more than AGG_MAX_RANGES in one epoch
+    _Atomic uint64_t no_tag_slot;   // more tags than --max-tags
+    _Atomic uint64_t sealed;
+    _Atomic uint64_t swept;         // sealed by age rather than by a newer epoch
+};
+
+struct agg_table {
+    struct agg_bucket *buckets;     // max_tags * AGG_EPOCH_RING
+    uint32_t max_tags;
+    _Atomic uint32_t tag_count;
+    _Atomic uint32_t *tag_idx;      // tag id -> index + 1 (0 = not seen)
+    _Atomic uint64_t *tag_max;      // per tag index: highest epoch + 1 seen
+    uint32_t lag;                   // epochs kept open behind the newest one
+    struct agg_queue q;
+    struct agg_stats st;
+};
+
+/* A sealed epoch, copied out for a worker */
+struct agg_epoch {
+    uint16_t tag;
+    uint32_t epoch;
+    int64_t first_ns;
+    uint8_t n;
+    struct agg_range r[AGG_MAX_RANGES];
+};
+
+int agg_table_init(struct agg_table *t, uint32_t max_tags, uint32_t lag);
+void agg_table_free(struct agg_table *t);
+
+/* Reader threads: add one range. Seals the tag's epochs that fell `lag` behind;
+ * waits while the epoch's ring slot still holds an older epoch not yet taken
+ * by a worker. */
+void agg_insert(struct agg_table *t, uint16_t tag, uint32_t epoch, uint16_t anchor,
+                uint32_t dist_mm, uint8_t quality, int64_t now_ns);
+
+/* Seal every open bucket whose first range arrived before `before_ns`
+ * (INT64_MAX: all). Returns the number sealed. */
+uint32_t agg_sweep(struct agg_table *t, int64_t before_ns);
+
+/* Workers: take one sealed epoch and free its bucket. Returns false if none. */
+bool agg_take(struct agg_table *t, struct agg_epoch *out);
+
+// ================= Solver =================
+struct agg_anchor {
+    uint16_t id;
+    double x, y, z;         // m
+};
+
+struct agg_anchors {
+    struct agg_anchor a[AGG_MAX_ANCHORS];
+    int n;
+    int16_t idx[65536];     // anchor id -> index in a[], -1 if unknown
+};
+
+struct agg_solution {
+    double x, y, z;
+    double rms_m;           // range residual RMS
+    int used;               // anchors used
+};
+
+void agg_anchors_init(struct agg_anchors *an);
+int agg_anchors_add(struct agg_anchors *an, uint16_t id, double x, double y, double z);
+int agg_anchors_load(struct agg_anchors *an, const char *path);
+
+/* Multilateration on the ranges of one epoch (several ranges to one anchor are
+ * averaged). dims = 2 solves x/y at height tag_z, dims = 3 solves x/y/z.
+ * Linear least squares, then Gauss-Newton. Returns 0, or -1 with too few
+ * anchors or a degenerate geometry. */
+int agg_solve(const struct agg_anchors *an, const struct agg_epoch *ep, int dims, double tag_z,
+              struct agg_solution *out);
+
+// ================= Tagged frames =================
+struct agg_tag_rec {
+    uint16_t tag;
+    uint32_t epoch;
+    struct uwb_stream_rec rec;
+};
+
+/* Build a 0x54 frame from n records and COBS-encode it with delimiter into
+ * out (UWB_STREAM_COBS_LEN(AGG_TAG_FRAME_LEN(n)) bytes). Returns the length. */
+size_t agg_tag_frame_encode(uint8_t *out, const struct agg_tag_rec *recs, uint8_t n,
+                            uint16_t seq);
+
+/* Parse a decoded 0x54 frame. Returns the record count or -1. */
+int agg_tag_frame_parse(const uint8_t *frame, size_t len, struct agg_tag_rec *recs, int max);
+
+#endif /* AGG_H */
@@ -0,0 +1,46 @@
+#include <string.h>
+#include "uwb_frame.h"
+#include "agg.h"
+
+size_t agg_tag_frame_encode(uint8_t *out, const struct agg_tag_rec *recs, uint8_t n,
+                            uint16_t seq) {
+    uint8_t frame[AGG_TAG_FRAME_LEN(AGG_TAG_MAX_RECORDS)];
+    size_t pos = UWB_STREAM_HDR_LEN;
+
+    if (n > AGG_TAG_MAX_RECORDS) {
+        n = AGG_TAG_MAX_RECORDS;
+    }
+    frame[0] = AGG_TYPE_TAG_RANGES;
+    frame[1] = n;
+    uwb_put_u16(&frame[2], seq);
+    uwb_put_u16(&frame[4], 0);
+    for (uint8_t i = 0; i < n; i++, pos += AGG_TAG_REC_LEN) {
+        uwb_put_u16(&frame[pos], recs[i].tag);
+        uwb_put_u32(&frame[pos + 2], recs[i].epoch);
+        uwb_stream_rec_pack(&frame[pos + 6], &recs[i].rec);
+    }
+    uwb_put_u16(&frame[pos], uwb_stream_crc16(frame, pos));
+    return uwb_cobs_encode(frame, pos + UWB_STREAM_CRC_LEN, out);
+}
+
+int agg_tag_frame_parse(const uint8_t *frame, size_t len, struct agg_tag_rec *recs, int max) {
+    if (len < AGG_TAG_FRAME_LEN(0) || frame[0] != AGG_TYPE_TAG_RANGES ||
+        frame[1] > AGG_TAG_MAX_RECORDS || len != (size_t)AGG_TAG_FRAME_LEN(frame[1])) {
+        return -1;
+    }
+    const size_t body = len - UWB_STREAM_CRC_LEN;
+
+    if (uwb_get_u16(&frame[body]) != uwb_stream_crc16(frame, body)) {
+        return -1;
+    }
+    const int n = frame[1] < max ? frame[1] : max;
+
+    for (int i = 0; i < n; i++) {
+        const uint8_t *p = &frame[UWB_STREAM_HDR_LEN + i * AGG_TAG_REC_LEN];
+
+        recs[i].tag = uwb_get_u16(p);
+        recs[i].epoch = uwb_get_u32(p + 2);
+        uwb_stream_rec_unpack(p + 6, &recs[i].rec);
+    }
+    return n;
+}
@@ -0,0 +1,232 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "agg.h"
+
+#define GN_ITERATIONS   8
+#define GN_STOP_M       1e-4
+
+void agg_anchors_init(struct agg_anchors *an) {
+    an->n = 0;
+    memset(an->idx, 0xFF, sizeof(an->idx));
+}
+
+int agg_anchors_add(struct agg_anchors *an, uint16_t id, double x, double y, double z) {
+    if (an->n >= AGG_MAX_ANCHORS || an->idx[id] >= 0) {
+        return -1;
+    }
+    an->a[an->n] = (struct agg_anchor){ .id = id, .x = x, .y = y, .z = z };
+    an->idx[id] = (int16_t)an->n++;
+    return 0;
+}
+
+/* One anchor per line: "<id> <x> <y> <z>" in metres, id decimal or 0x hex;
+ * '#' starts a comment. */
+int agg_anchors_load(struct agg_anchors *an, const char *path) {
+    FILE *f = fopen(path, "r");
+    char line[256];
+    int lineno = 0;
+
+    if (!f) {
+        return -1;
+    }
+    agg_anchors_init(an);
+    while (fgets(line, sizeof(line), f)) {
+        unsigned id;
+        double x, y, z;
+
+        lineno++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        if (line[strspn(line, " \t")] == '\0') {
+            continue;
+        }
+        if (sscanf(line, "%i %lf %lf %lf", (int *)&id, &x, &y, &z) != 4 || id > 0xFFFF ||
+            agg_anchors_add(an, (uint16_t)id, x, y, z) != 0) {
+            fprintf(stderr, "%s:%d: bad anchor line\n", path, lineno);
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    return an->n;
+}
+
+/* Solve the dims x dims system A p = b (Gaussian elimination, partial pivot). */
+static int solve_small(double A[3][3], double b[3], int dims, double p[3]) {
+    for (int c = 0; c < dims; c++) {
+        int piv = c;
+
+        for (int r = c + 1; r < dims; r++) {
+            if (fabs(A[r][c]) > fabs(A[piv][c])) {
+                piv = r;
+            }
+        }
+        if (fabs(A[piv][c]) < 1e-9) {
+            return -1;
+        }
+        if (piv != c) {
+            for (int k = 0; k < dims; k++) {
+                const double tmp = A[c][k];
+                A[c][k] = A[piv][k];
+                A[piv][k] = tmp;
+            }
+            const double tmp = b[c];
+            b[c] = b[piv];
+            b[piv] = tmp;
+        }
+        for (int r = c + 1; r < dims; r++) {
+            const double f = A[r][c] / A[c][c];
+
+            for (int k = c; k < dims; k++) {
+                A[r][k] -= f * A[c][k];
+            }
+            b[r] -= f * b[c];
+        }
+    }
+    for (int r = dims - 1; r >= 0; r--) {
+        double s = b[r];
+
+        for (int k = r + 1; k < dims; k++) {
+            s -= A[r][k] * p[k];
+        }
+        p[r] = s / A[r][r];
+    }
+    return 0;
+}
+
+int agg_solve(const struct agg_anchors *an, const struct agg_epoch *ep, int dims, double tag_z,
+              struct agg_solution *out) {
+    double pos[AGG_MAX_RANGES][3];
+    double range[AGG_MAX_RANGES];
+    double weight[AGG_MAX_RANGES];
+    int cnt[AGG_MAX_RANGES];
+    int m = 0;
+
+    // Average repeated ranges per anchor, weight by quality
+    for (int i = 0; i < ep->n; i++) {
+        const int ai = an->idx[ep->r[i].anchor];
+        int k;
+
+        if (ai < 0 || ep->r[i].dist_mm == 0) {
+            continue;
+        }
+        for (k = 0; k < m; k++) {
+            if (pos[k][0] == an->a[ai].x && pos[k][1] == an->a[ai].y && pos[k][2] == an->a[ai].z) {
+                break;
+            }
+        }
+        if (k == m) {
+            pos[m][0] = an->a[ai].x;
+            pos[m][1] = an->a[ai].y;
+            pos[m][2] = an->a[ai].z;
+            range[m] = 0;
+            weight[m] = 0;
+            cnt[m] = 0;
+            m++;
+        }
+        range[k] += ep->r[i].dist_mm / 1000.0;
+        weight[k] += ep->r[i].quality ? ep->r[i].quality / 100.0 : 0.01;
+        cnt[k]++;
+    }
+    if (m < dims + 1) {
+        return -1;
+    }
+    for (int k = 0; k < m; k++) {
+        range[k] /= cnt[k];
+        weight[k] /= cnt[k];
+        if (dims == 2) {
+            // Horizontal range at the known tag height
+            const double dz = pos[k][2] - tag_z;
+            const double h2 = range[k] * range[k] - dz * dz;
+
+            range[k] = h2 > 0 ? sqrt(h2) : 0;
+        }
+    }
+
+    // Linear least squares: subtract the first sphere from the others
+    double A[3][3] = { { 0 } };
+    double b[3] = { 0 };
+    double p[3] = { 0, 0, tag_z };
+    const double k0 = pos[0][0] * pos[0][0] + pos[0][1] * pos[0][1] +
+                      (dims == 3 ? pos[0][2] * pos[0][2] : 0);
+
+    for (int k = 1; k < m; k++) {
+        double row[3];
+        const double kk = pos[k][0] * pos[k][0] + pos[k][1] * pos[k][1] +
+                          (dims == 3 ? pos[k][2] * pos[k][2] : 0);
+        const double rhs = range[0] * range[0] - range[k] * range[k] + kk - k0;
+
+        for (int d = 0; d < dims; d++) {
+            row[d] = 2 * (pos[k][d] - pos[0][d]);
+        }
+        for (int r = 0; r < dims; r++) {
+            for (int c = 0; c < dims; c++) {
+                A[r][c] += weight[k] * row[r] * row[c];
+            }
+            b[r] += weight[k] * row[r] * rhs;
+        }
+    }
+    if (solve_small(A, b, dims, p) != 0) {
+        return -1;
+    }
+
+    // Gauss-Newton on sum w (|p - a| - r)^2
+    for (int it = 0; it < GN_ITERATIONS; it++) {
+        double JtJ[3][3] = { { 0 } };
+        double Jtr[3] = { 0 };
+        double step[3] = { 0 };
+
+        for (int k = 0; k < m; k++) {
+            double diff[3];
+            double dist = 0;
+
+            for (int d = 0; d < dims; d++) {
+                diff[d] = p[d] - pos[k][d];
+                dist += diff[d] * diff[d];
+            }
+            dist = sqrt(dist);
+            if (dist < 1e-6) {
+                continue;
+            }
+            const double res = dist - range[k];
+
+            for (int r = 0; r < dims; r++) {
+                const double jr = diff[r] / dist;
+
+                for (int c = 0; c < dims; c++) {
+                    JtJ[r][c] += weight[k] * jr * diff[c] / dist;
+                }
+                Jtr[r] += weight[k] * jr * res;
+            }
+        }
+        if (solve_small(JtJ, Jtr, dims, step) != 0) {
+            break;
+        }
+        double norm = 0;
+
+        for (int d = 0; d < dims; d++) {
+            p[d] -= step[d];
+            norm += step[d] * step[d];
+        }
+        if (norm < GN_STOP_M * GN_STOP_M) {
+            break;
+        }
+    }
+
+    double ss = 0;
+
+    for (int k = 0; k < m; k++) {
+        double dist = 0;
+
+        for (int d = 0; d < dims; d++) {
+            dist += (p[d] - pos[k][d]) * (p[d] - pos[k][d]);
+        }
+        ss += (sqrt(dist) - range[k]) * (sqrt(dist) - range[k]);
+    }
+    out->x = p[0];
+    out->y = p[1];
+    out->z = dims == 3 ? p[2] : tag_z;
+    out->rms_m = sqrt(ss / m);
+    out->used = m;
+    return isfinite(p[0]) && isfinite(p[1]) ? 0 : -1;
+}
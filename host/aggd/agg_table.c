@@ -0,0 +1,293 @@
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include "agg.h"
+
+/* Lock-free (tag, epoch) bucketing. Every tag owns AGG_EPOCH_RING buckets,
+ * epoch e maps to slot e % AGG_EPOCH_RING, so a (tag, epoch) has exactly one
+ * possible bucket and concurrent readers cannot create duplicates. */
+
+static uint64_t make_key(uint16_t tag, uint32_t epoch) {
+    return ((uint64_t)tag + 1) << 32 | epoch;
+}
+
+// ================= MPMC queue =================
+static int queue_init(struct agg_queue *q, uint32_t min_cap) {
+    uint32_t cap = 1;
+
+    while (cap < min_cap) {
+        cap <<= 1;
+    }
+    q->cells = calloc(cap, sizeof(*q->cells));
+    if (!q->cells) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < cap; i++) {
+        atomic_init(&q->cells[i].seq, i);
+    }
+    q->mask = cap - 1;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return 0;
+}
+
+static void queue_push(struct agg_queue *q, uint32_t bucket, uint32_t count) {
+    uint32_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    while (1) {
+        struct agg_qcell *c = &q->cells[pos & q->mask];
+        const uint32_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        const int32_t dif = (int32_t)(seq - pos);
+
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                c->bucket = bucket;
+                c->count = count;
+                atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+                return;
+            }
+        } else if (dif < 0) {
+            sched_yield();      // cannot happen with capacity >= buckets; be safe
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+}
+
+static bool queue_pop(struct agg_queue *q, uint32_t *bucket, uint32_t *count) {
+    uint32_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+    while (1) {
+        struct agg_qcell *c = &q->cells[pos & q->mask];
+        const uint32_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        const int32_t dif = (int32_t)(seq - (pos + 1));
+
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *bucket = c->bucket;
+                *count = c->count;
+                atomic_store_explicit(&c->seq, pos + q->mask + 1, memory_order_release);
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+}
+
+// ================= Buckets =================
+int agg_table_init(struct agg_table *t, uint32_t max_tags, uint32_t lag) {
+    const uint32_t nb = max_tags * AGG_EPOCH_RING;
+
+    memset(t, 0, sizeof(*t));
+    if (lag + 1 >= AGG_EPOCH_RING) {
+        return -1;
+    }
+    t->max_tags = max_tags;
+    t->lag = lag;
+    t->buckets = calloc(nb, sizeof(*t->buckets));
+    t->tag_idx = calloc(65536, sizeof(*t->tag_idx));
+    t->tag_max = calloc(max_tags, sizeof(*t->tag_max));
+    if (!t->buckets || !t->tag_idx || !t->tag_max || queue_init(&t->q, nb) != 0) {
+        agg_table_free(t);
+        return -1;
+    }
+    // Free buckets stay sealed, so a writer racing a reuse never counts as live
+    for (uint32_t i = 0; i < nb; i++) {
+        atomic_init(&t->buckets[i].n, AGG_SEALED);
+    }
+    return 0;
+}
+
+void agg_table_free(struct agg_table *t) {
+    free(t->buckets);
+    free((void *)t->tag_idx);
+    free((void *)t->tag_max);
+    free(t->q.cells);
+    t->buckets = NULL;
+    t->tag_idx = NULL;
+    t->tag_max = NULL;
+    t->q.cells = NULL;
+}
+
+static int tag_index(struct agg_table *t, uint16_t tag) {
+    uint32_t idx = atomic_load_explicit(&t->tag_idx[tag], memory_order_acquire);
+
+    if (idx) {
+        return (int)idx - 1;
+    }
+    const uint32_t mine = atomic_fetch_add(&t->tag_count, 1);
+
+    if (mine >= t->max_tags) {
+        return -1;
+    }
+    // Lost race: another reader registered the tag first, `mine` stays unused
+    if (!atomic_compare_exchange_strong(&t->tag_idx[tag], &idx, mine + 1)) {
+        return (int)idx - 1;
+    }
+    return (int)mine;
+}
+
+static void seal_bucket(struct agg_table *t, uint32_t b, bool swept) {
+    const uint32_t prev = atomic_fetch_or(&t->buckets[b].n, AGG_SEALED);
+
+    if (prev & AGG_SEALED) {
+        return;     // somebody else sealed it
+    }
+    atomic_fetch_add_explicit(&t->st.sealed, 1, memory_order_relaxed);
+    if (swept) {
+        atomic_fetch_add_explicit(&t->st.swept, 1, memory_order_relaxed);
+    }
+    queue_push(&t->q, b, prev);
+}
+
+static void seal_epoch(struct agg_table *t, int ti, uint16_t tag, uint32_t epoch) {
+    const uint32_t b = (uint32_t)ti * AGG_EPOCH_RING + epoch % AGG_EPOCH_RING;
+
+    if (atomic_load_explicit(&t->buckets[b].key, memory_order_acquire) == make_key(tag, epoch)) {
+        seal_bucket(t, b, false);
+    }
+}
+
+void agg_insert(struct agg_table *t, uint16_t tag, uint32_t epoch, uint16_t anchor,
+                uint32_t dist_mm, uint8_t quality, int64_t now_ns) {
+    const int ti = tag_index(t, tag);
+
+    atomic_fetch_add_explicit(&t->st.ranges, 1, memory_order_relaxed);
+    if (ti < 0) {
+        atomic_fetch_add_explicit(&t->st.no_tag_slot, 1, memory_order_relaxed);
+        return;
+    }
+
+    // Advance the tag's newest epoch; the winner seals what fell behind
+    _Atomic uint64_t *max = &t->tag_max[ti];
+    uint64_t old = atomic_load_explicit(max, memory_order_relaxed);
+
+    while ((uint64_t)epoch + 1 > old) {
+        if (atomic_compare_exchange_weak(max, &old, (uint64_t)epoch + 1)) {
+            // Epochs x with x + lag + 1 <= epoch become closed (at most one ring's worth)
+            const int64_t hi = (int64_t)epoch - t->lag - 1;
+            int64_t lo = old ? (int64_t)old - 1 - t->lag : 0;
+
+            if (lo < hi - AGG_EPOCH_RING + 1) {
+                lo = hi - AGG_EPOCH_RING + 1;
+            }
+            for (int64_t x = lo < 0 ? 0 : lo; x <= hi; x++) {
+                seal_epoch(t, ti, tag, (uint32_t)x);
+            }
+            break;
+        }
+    }
+    if ((uint64_t)epoch + 1 + t->lag < atomic_load_explicit(max, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&t->st.late, 1, memory_order_relaxed);
+        return;
+    }
+
+    struct agg_bucket *bk = &t->buckets[(uint32_t)ti * AGG_EPOCH_RING + epoch % AGG_EPOCH_RING];
+    const uint64_t key = make_key(tag, epoch);
+    uint64_t cur = atomic_load_explicit(&bk->key, memory_order_acquire);
+    bool stalled = false;
+
+    while (cur != key) {
+        if (cur == AGG_KEY_CLAIMING) {
+            cur = atomic_load_explicit(&bk->key, memory_order_acquire);
+            continue;   // another reader is resetting it for (probably) this key
+        }
+        if (cur != 0) {
+            const uint32_t held = (uint32_t)cur;
+
+            if (held > epoch) {
+                atomic_fetch_add_explicit(&t->st.late, 1, memory_order_relaxed);
+                return;
+            }
+            // An older epoch waits for a worker: make sure it is queued and wait,
+            // so a slow worker pool throttles the readers instead of losing ranges
+            if (!stalled) {
+                atomic_fetch_add_explicit(&t->st.stalled, 1, memory_order_relaxed);
+                stalled = true;
+            }
+            seal_epoch(t, ti, tag, held);
+            sched_yield();
+            cur = atomic_load_explicit(&bk->key, memory_order_acquire);
+            continue;
+        }
+        if (atomic_compare_exchange_strong(&bk->key, &cur, AGG_KEY_CLAIMING)) {
+            atomic_store_explicit(&bk->committed, 0, memory_order_relaxed);
+            atomic_store_explicit(&bk->first_ns, now_ns, memory_order_relaxed);
+            atomic_store_explicit(&bk->n, 0, memory_order_release);
+            atomic_store_explicit(&bk->key, key, memory_order_release);
+            cur = key;
+        }
+    }
+
+    const uint32_t i = atomic_fetch_add_explicit(&bk->n, 1, memory_order_acq_rel);
+
+    if (i & AGG_SEALED) {
+        atomic_fetch_add_explicit(&t->st.late, 1, memory_order_relaxed);
+        return;
+    }
+    if (i < AGG_MAX_RANGES) {
+        bk->r[i] = (struct agg_range){ .key = key, .anchor = anchor, .quality = quality,
+                                       .dist_mm = dist_mm };
+    } else {
+        atomic_fetch_add_explicit(&t->st.overflow, 1, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&bk->committed, 1, memory_order_release);
+}
+
+uint32_t agg_sweep(struct agg_table *t, int64_t before_ns) {
+    const uint32_t nb = atomic_load(&t->tag_count) < t->max_tags
+                            ? atomic_load(&t->tag_count) * AGG_EPOCH_RING
+                            : t->max_tags * AGG_EPOCH_RING;
+    uint32_t sealed = 0;
+
+    for (uint32_t b = 0; b < nb; b++) {
+        struct agg_bucket *bk = &t->buckets[b];
+        const uint64_t key = atomic_load_explicit(&bk->key, memory_order_acquire);
+
+        if (key == 0 || key == AGG_KEY_CLAIMING ||
+            (atomic_load_explicit(&bk->n, memory_order_relaxed) & AGG_SEALED) ||
+            atomic_load_explicit(&bk->first_ns, memory_order_relaxed) >= before_ns) {
+            continue;
+        }
+        seal_bucket(t, b, true);
+        sealed++;
+    }
+    return sealed;
+}
+
+bool agg_take(struct agg_table *t, struct agg_epoch *out) {
+    uint32_t b;
+    uint32_t count;
+
+    if (!queue_pop(&t->q, &b, &count)) {
+        return false;
+    }
+    struct agg_bucket *bk = &t->buckets[b];
+    const uint64_t key = atomic_load_explicit(&bk->key, memory_order_acquire);
+
+    // Writers that got an index before the seal are a few stores from committing
+    while (atomic_load_explicit(&bk->committed, memory_order_acquire) < count) {
+        sched_yield();
+    }
+
+    out->tag = (uint16_t)((key >> 32) - 1);
+    out->epoch = (uint32_t)key;
+    out->first_ns = atomic_load_explicit(&bk->first_ns, memory_order_relaxed);
+    out->n = 0;
+    for (uint32_t i = 0; i < count && i < AGG_MAX_RANGES; i++) {
+        if (bk->r[i].key == key) {
+            out->r[out->n++] = bk->r[i];
+        }
+    }
+    // n keeps AGG_SEALED: late writers that still hold the old key drop out
+    atomic_store_explicit(&bk->key, 0, memory_order_release);
+    return true;
+}
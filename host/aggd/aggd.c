@@ -0,0 +1,667 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "agg.h"
+
+/* Multi-anchor aggregation daemon: one reader thread per input, lock-free
+ * (tag, epoch) buckets, a sweeper that closes stale epochs and a worker pool
+ * solving positions.
+ *
+ *   aggd --anchors FILE --in PATH[@tag] [--in ...] [options]
+ *   aggd --synthetic [tags=N,anchors=N,epochs=N,workers=N]
+ */
+
+#define MAX_INPUTS      64
+#define MAX_WORKERS     64
+#define READ_CHUNK      4096
+
+static volatile sig_atomic_t stop_requested;
+
+static struct {
+    uint32_t epoch_ms;
+    uint32_t max_age_ms;
+    uint32_t lag;
+    uint32_t max_tags;
+    int workers;
+    int dims;
+    double tag_z;
+    FILE *out;
+} cfg = {
+    .epoch_ms = 100,
+    .max_age_ms = 500,
+    .lag = 1,
+    .max_tags = 8192,
+    .workers = 4,
+    .dims = 2,
+    .tag_z = 1.0,
+};
+
+static struct agg_table table;
+static struct agg_anchors anchors;
+static _Atomic int readers_done;
+static _Atomic int all_sealed;
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void on_sigint(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// ================= Synthetic site =================
+static struct {
+    int enabled;
+    uint32_t tags;
+    uint32_t epochs;
+    int anchors;
+    double noise_m;
+    uint8_t **stream;       // per input (= per anchor)
+    size_t *len;
+    _Atomic uint32_t *progress;
+} syn = {
+    .tags = 2000,
+    .epochs = 100,
+    .anchors = 8,
+    .noise_m = 0.05,
+};
+
+#define SYN_SIZE_M      40.0
+#define SYN_ANCHOR_Z    2.5
+
+// Tag position at an epoch: a slow circle around a per-tag centre
+static void syn_truth(uint32_t tag, uint32_t epoch, double p[3]) {
+    const double cx = 5 + (tag * 7919u % 3000) / 100.0;
+    const double cy = 5 + (tag * 104729u % 3000) / 100.0;
+    const double a = (tag % 360) * M_PI / 180 + epoch * 0.02;
+
+    p[0] = cx + 2 * cos(a);
+    p[1] = cy + 2 * sin(a);
+    p[2] = cfg.tag_z;
+}
+
+static double syn_gauss(unsigned *seed) {
+    const double u1 = (rand_r(seed) + 1.0) / ((double)RAND_MAX + 2.0);
+    const double u2 = (rand_r(seed) + 1.0) / ((double)RAND_MAX + 2.0);
+
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// Perimeter layout, alternating high and low so 3D stays well conditioned
+static void syn_anchors(void) {
+    agg_anchors_init(&anchors);
+    for (int i = 0; i < syn.anchors; i++) {
+        const double s = 4.0 * SYN_SIZE_M * i / syn.anchors;
+        double x, y;
+
+        if (s < SYN_SIZE_M) {
+            x = s, y = 0;
+        } else if (s < 2 * SYN_SIZE_M) {
+            x = SYN_SIZE_M, y = s - SYN_SIZE_M;
+        } else if (s < 3 * SYN_SIZE_M) {
+            x = 3 * SYN_SIZE_M - s, y = SYN_SIZE_M;
+        } else {
+            x = 0, y = 4 * SYN_SIZE_M - s;
+        }
+        agg_anchors_add(&anchors, (uint16_t)(0x0100 + i), x, y,
+                        (i & 1) ? SYN_ANCHOR_Z : SYN_ANCHOR_Z - 2.0);
+    }
+}
+
+/* Encode one anchor's report stream: every tag in every epoch, epoch-major,
+ * as a gateway would forward it. */
+static int syn_encode(int ai) {
+    const uint64_t recs = (uint64_t)syn.tags * syn.epochs;
+    const size_t cap = (size_t)(recs / AGG_TAG_MAX_RECORDS + 1) *
+                       UWB_STREAM_COBS_LEN(AGG_TAG_FRAME_LEN(AGG_TAG_MAX_RECORDS));
+    const struct agg_anchor *a = &anchors.a[ai];
+    struct agg_tag_rec batch[AGG_TAG_MAX_RECORDS];
+    unsigned seed = 1 + ai;
+    uint16_t seq = 0;
+    uint8_t n = 0;
+    size_t len = 0;
+
+    syn.stream[ai] = malloc(cap);
+    if (!syn.stream[ai]) {
+        return -1;
+    }
+    for (uint32_t e = 0; e < syn.epochs; e++) {
+        for (uint32_t tag = 0; tag < syn.tags; tag++) {
+            double p[3];
+
+            syn_truth(tag, e, p);
+            const double d = sqrt((p[0] - a->x) * (p[0] - a->x) + (p[1] - a->y) * (p[1] - a->y) +
+                                  (p[2] - a->z) * (p[2] - a->z)) +
+                             syn.noise_m * syn_gauss(&seed);
+
+            batch[n++] = (struct agg_tag_rec){
+                .tag = (uint16_t)tag,
+                .epoch = e,
+                .rec = { .t_ms = e * cfg.epoch_ms, .anchor = a->id, .quality = 80,
+                         .dist_mm = d > 0 ? (uint32_t)(d * 1000) : 0 },
+            };
+            if (n == AGG_TAG_MAX_RECORDS || (e + 1 == syn.epochs && tag + 1 == syn.tags)) {
+                len += agg_tag_frame_encode(&syn.stream[ai][len], batch, n, seq);
+                seq += n;
+                n = 0;
+            }
+        }
+    }
+    syn.len[ai] = len;
+    return 0;
+}
+
+// ================= Readers =================
+struct input {
+    const char *path;
+    int tag;                // tag id for 0x52 tag streams, -1 if not given
+    int fd;
+    int index;
+    pthread_t thread;
+    uint8_t buf[UWB_STREAM_COBS_LEN(AGG_TAG_FRAME_LEN(AGG_TAG_MAX_RECORDS))];
+    size_t n;
+    int overflow;
+    int synced;
+    uint32_t cur_epoch;     // synthetic pacing
+    uint64_t bytes;
+    uint64_t frames;
+    uint64_t bad_frames;
+    uint64_t records;
+    uint64_t skipped;       // failed ranges, or a 0x52 stream without @tag
+};
+
+static struct input inputs[MAX_INPUTS];
+static int input_count;
+
+static void syn_pace(struct input *in, uint32_t epoch);
+
+static void input_range(struct input *in, uint16_t tag, uint32_t epoch,
+                        const struct uwb_stream_rec *r) {
+    if (r->status || r->dist_mm == 0) {
+        in->skipped++;
+        return;
+    }
+    if (syn.enabled && epoch != in->cur_epoch) {
+        syn_pace(in, epoch);
+    }
+    in->records++;
+    agg_insert(&table, tag, epoch, r->anchor, r->dist_mm, r->quality, now_ns());
+}
+
+static void input_frame(struct input *in) {
+    uint8_t frame[sizeof(in->buf)];
+    const size_t len = uwb_cobs_decode(in->buf, in->n, frame);
+
+    if (len == 0) {
+        in->bad_frames++;
+        return;
+    }
+    if (frame[0] == AGG_TYPE_TAG_RANGES) {
+        struct agg_tag_rec recs[AGG_TAG_MAX_RECORDS];
+        const int n = agg_tag_frame_parse(frame, len, recs, AGG_TAG_MAX_RECORDS);
+
+        if (n < 0) {
+            in->bad_frames++;
+            return;
+        }
+        in->frames++;
+        for (int i = 0; i < n; i++) {
+            input_range(in, recs[i].tag, recs[i].epoch, &recs[i].rec);
+        }
+    } else {
+        struct uwb_stream_rec recs[UWB_STREAM_MAX_RECORDS];
+        uint16_t seq;
+        uint16_t dropped;
+        const int n = uwb_stream_frame_parse(frame, len, &seq, &dropped, recs,
+                                             UWB_STREAM_MAX_RECORDS);
+
+        if (n < 0) {
+            in->bad_frames++;
+            return;
+        }
+        in->frames++;
+        for (int i = 0; i < n; i++) {
+            if (in->tag < 0) {
+                in->skipped++;
+                continue;
+            }
+            input_range(in, (uint16_t)in->tag, recs[i].t_ms / cfg.epoch_ms, &recs[i]);
+        }
+    }
+}
+
+static void input_feed(struct input *in, const uint8_t *data, size_t len) {
+    in->bytes += len;
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == 0x00) {
+            if (in->synced && !in->overflow && in->n) {
+                input_frame(in);
+            } else if (in->synced && in->overflow) {
+                in->bad_frames++;
+            }
+            in->synced = 1;
+            in->overflow = 0;
+            in->n = 0;
+        } else if (in->n < sizeof(in->buf)) {
+            in->buf[in->n++] = data[i];
+        } else {
+            in->overflow = 1;
+        }
+    }
+}
+
+/* Anchors report in real time, so no input runs more than one epoch ahead of
+ * another. Replaying memory at full speed needs the same bound, or the fastest
+ * reader would seal epochs the others have not delivered yet. */
+static void syn_pace(struct input *in, uint32_t epoch) {
+    atomic_store_explicit(&syn.progress[in->index], epoch, memory_order_release);
+    in->cur_epoch = epoch;
+    for (int i = 0; i < input_count; i++) {
+        while (atomic_load_explicit(&syn.progress[i], memory_order_acquire) + 1 < epoch) {
+            sched_yield();
+        }
+    }
+}
+
+static void *reader_thread(void *arg) {
+    struct input *in = arg;
+
+    if (syn.enabled) {
+        const uint8_t *s = syn.stream[in->index];
+        unsigned seed = 100 + in->index;
+
+        in->synced = 1;
+        for (size_t pos = 0; pos < syn.len[in->index] && !stop_requested;) {
+            size_t chunk = 1 + (size_t)(rand_r(&seed) % READ_CHUNK);
+
+            if (chunk > syn.len[in->index] - pos) {
+                chunk = syn.len[in->index] - pos;
+            }
+            input_feed(in, &s[pos], chunk);
+            pos += chunk;
+        }
+        // Let the other readers past the end
+        atomic_store_explicit(&syn.progress[in->index], UINT32_MAX - 1, memory_order_release);
+        return NULL;
+    }
+
+    struct pollfd pfd = { .fd = in->fd, .events = POLLIN };
+    uint8_t buf[READ_CHUNK];
+
+    while (!stop_requested) {
+        // Poll with a timeout so Ctrl-C is seen on a quiet port
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        const ssize_t n = read(in->fd, buf, sizeof(buf));
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;      // end of file or port gone
+        }
+        input_feed(in, buf, (size_t)n);
+    }
+    return NULL;
+}
+
+static int input_open(struct input *in) {
+    struct termios tio;
+
+    in->fd = open(in->path, O_RDONLY | O_NOCTTY);
+    if (in->fd < 0) {
+        fprintf(stderr, "%s: %s\n", in->path, strerror(errno));
+        return -1;
+    }
+    // Raw mode for a port (it may start mid-frame); a recording starts on a boundary
+    if (isatty(in->fd) && tcgetattr(in->fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(in->fd, TCSANOW, &tio);
+    } else {
+        in->synced = 1;
+    }
+    return 0;
+}
+
+// ================= Sweeper and workers =================
+static void *sweeper_thread(void *arg) {
+    const struct timespec period = { .tv_nsec = 10 * 1000000 };
+
+    (void)arg;
+    while (!atomic_load(&readers_done)) {
+        agg_sweep(&table, now_ns() - (int64_t)cfg.max_age_ms * 1000000);
+        nanosleep(&period, NULL);
+    }
+    agg_sweep(&table, INT64_MAX);
+    atomic_store(&all_sealed, 1);
+    return NULL;
+}
+
+struct worker {
+    pthread_t thread;
+    uint64_t solved;
+    uint64_t failed;
+    uint64_t latency_ns_sum;
+    int64_t latency_ns_max;
+    double err2_sum;        // synthetic: squared horizontal error vs. truth
+    double err_max;
+};
+
+static struct worker workers[MAX_WORKERS];
+
+static void *worker_thread(void *arg) {
+    struct worker *w = arg;
+    const struct timespec idle = { .tv_nsec = 200 * 1000 };
+    struct agg_epoch ep;
+    struct agg_solution s;
+
+    while (1) {
+        if (!agg_take(&table, &ep)) {
+            // all_sealed follows the final sweep: empty after that means done
+            const int last = atomic_load(&all_sealed);
+
+            if (!agg_take(&table, &ep)) {
+                if (last) {
+                    break;
+                }
+                nanosleep(&idle, NULL);
+                continue;
+            }
+        }
+        if (agg_solve(&anchors, &ep, cfg.dims, cfg.tag_z, &s) != 0) {
+            w->failed++;
+            continue;
+        }
+        const int64_t lat = now_ns() - ep.first_ns;
+
+        w->solved++;
+        w->latency_ns_sum += (uint64_t)lat;
+        if (lat > w->latency_ns_max) {
+            w->latency_ns_max = lat;
+        }
+        if (syn.enabled) {
+            double p[3];
+
+            syn_truth(ep.tag, ep.epoch, p);
+            const double e2 = (s.x - p[0]) * (s.x - p[0]) + (s.y - p[1]) * (s.y - p[1]);
+
+            w->err2_sum += e2;
+            if (sqrt(e2) > w->err_max) {
+                w->err_max = sqrt(e2);
+            }
+        }
+        if (cfg.out) {
+            pthread_mutex_lock(&out_lock);
+            fprintf(cfg.out, "%u,%u,%.3f,%.3f,%.3f,%.3f,%d\n", ep.tag, ep.epoch, s.x, s.y, s.z,
+                    s.rms_m, s.used);
+            pthread_mutex_unlock(&out_lock);
+        }
+    }
+    return NULL;
+}
+
+// ================= Main =================
+static int run(void) {
+    pthread_t sweeper;
+
+    if (agg_table_init(&table, cfg.max_tags, cfg.lag) != 0) {
+        fprintf(stderr, "table init failed (lag must be below %d)\n", AGG_EPOCH_RING - 1);
+        return 1;
+    }
+    if (cfg.out) {
+        fprintf(cfg.out, "tag,epoch,x,y,z,rms_m,anchors\n");
+    }
+    signal(SIGINT, on_sigint);
+
+    const int64_t t0 = now_ns();
+
+    pthread_create(&sweeper, NULL, sweeper_thread, NULL);
+    for (int i = 0; i < cfg.workers; i++) {
+        pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i]);
+    }
+    for (int i = 0; i < input_count; i++) {
+        pthread_create(&inputs[i].thread, NULL, reader_thread, &inputs[i]);
+    }
+    for (int i = 0; i < input_count; i++) {
+        pthread_join(inputs[i].thread, NULL);
+    }
+    atomic_store(&readers_done, 1);
+    pthread_join(sweeper, NULL);
+    for (int i = 0; i < cfg.workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    const double secs = (now_ns() - t0) / 1e9;
+    uint64_t records = 0;
+    uint64_t bad = 0;
+    uint64_t skipped = 0;
+    struct worker sum = { 0 };
+
+    for (int i = 0; i < input_count; i++) {
+        records += inputs[i].records;
+        bad += inputs[i].bad_frames;
+        skipped += inputs[i].skipped;
+    }
+    for (int i = 0; i < cfg.workers; i++) {
+        sum.solved += workers[i].solved;
+        sum.failed += workers[i].failed;
+        sum.latency_ns_sum += workers[i].latency_ns_sum;
+        sum.err2_sum += workers[i].err2_sum;
+        if (workers[i].latency_ns_max > sum.latency_ns_max) {
+            sum.latency_ns_max = workers[i].latency_ns_max;
+        }
+        if (workers[i].err_max > sum.err_max) {
+            sum.err_max = workers[i].err_max;
+        }
+    }
+
+    const struct agg_stats *st = &table.st;
+
+    fprintf(stderr, "%d inputs, %d workers: %llu ranges (%llu bad frames, %llu skipped) in %.2f s\n",
+            input_count, cfg.workers, (unsigned long long)records, (unsigned long long)bad,
+            (unsigned long long)skipped, secs);
+    fprintf(stderr, "epochs sealed %llu (by age %llu), late %llu, reader stalls %llu, overflow %llu, "
+            "no tag slot %llu\n",
+            (unsigned long long)st->sealed, (unsigned long long)st->swept,
+            (unsigned long long)st->late, (unsigned long long)st->stalled,
+            (unsigned long long)st->overflow, (unsigned long long)st->no_tag_slot);
+    fprintf(stderr, "positions %llu (%llu failed), %.0f positions/s, latency mean %.2f ms max %.2f ms\n",
+            (unsigned long long)sum.solved, (unsigned long long)sum.failed, sum.solved / secs,
+            sum.solved ? sum.latency_ns_sum / 1e6 / sum.solved : 0.0,
+            sum.latency_ns_max / 1e6);
+    agg_table_free(&table);
+
+    if (!syn.enabled) {
+        return 0;
+    }
+    const uint64_t expect = (uint64_t)syn.tags * syn.epochs;
+    const double rms = sum.solved ? sqrt(sum.err2_sum / sum.solved) : INFINITY;
+    const int pass = sum.solved == expect && st->late == 0 && st->overflow == 0 &&
+                     rms < 3 * syn.noise_m;
+
+    fprintf(stderr, "expected %llu positions, horizontal error RMS %.3f m max %.3f m\n",
+            (unsigned long long)expect, rms, sum.err_max);
+    fprintf(stderr, "%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+static int synthetic_setup(const char *spec) {
+    char buf[256];
+
+    snprintf(buf, sizeof(buf), "%s", spec ? spec : "");
+    for (char *kv = strtok(buf, ","); kv; kv = strtok(NULL, ",")) {
+        unsigned v;
+
+        if (sscanf(kv, "tags=%u", &v) == 1) {
+            syn.tags = v;
+        } else if (sscanf(kv, "epochs=%u", &v) == 1) {
+            syn.epochs = v;
+        } else if (sscanf(kv, "anchors=%u", &v) == 1) {
+            syn.anchors = (int)v;
+        } else if (sscanf(kv, "workers=%u", &v) == 1) {
+            cfg.workers = (int)v;
+        } else {
+            fprintf(stderr, "unknown synthetic option '%s'\n", kv);
+            return -1;
+        }
+    }
+    if (syn.tags == 0 || syn.tags > 65535 || syn.epochs == 0 || syn.anchors < cfg.dims + 1 ||
+        syn.anchors > AGG_MAX_ANCHORS || syn.anchors > MAX_INPUTS || syn.anchors > AGG_MAX_RANGES) {
+        fprintf(stderr, "synthetic: bad tags/epochs/anchors\n");
+        return -1;
+    }
+    syn.enabled = 1;
+    cfg.max_tags = syn.tags;
+    syn_anchors();
+    syn.stream = calloc(syn.anchors, sizeof(*syn.stream));
+    syn.len = calloc(syn.anchors, sizeof(*syn.len));
+    syn.progress = calloc(syn.anchors, sizeof(*syn.progress));
+    if (!syn.stream || !syn.len || !syn.progress) {
+        return -1;
+    }
+
+    const int64_t t0 = now_ns();
+    size_t total = 0;
+
+    for (int i = 0; i < syn.anchors; i++) {
+        if (syn_encode(i) != 0) {
+            fprintf(stderr, "synthetic: out of memory\n");
+            return -1;
+        }
+        total += syn.len[i];
+        inputs[i] = (struct input){ .path = "synthetic", .tag = -1, .index = i };
+    }
+    input_count = syn.anchors;
+    fprintf(stderr, "synthetic: %u tags x %u epochs x %d anchors, %.1f MB encoded in %.2f s\n",
+            syn.tags, syn.epochs, syn.anchors, total / 1e6, (now_ns() - t0) / 1e9);
+    return 0;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: aggd --anchors FILE --in PATH[@tag] [--in ...] [options]\n"
+            "       aggd --synthetic [tags=N,anchors=N,epochs=N,workers=N] [options]\n"
+            "  --in PATH[@tag]   port or recording; @tag (hex or decimal) for a tag's own stream\n"
+            "  --anchors FILE    one anchor per line: id x y z (m)\n"
+            "  --workers N       solver threads (4)\n"
+            "  --dims 2|3        solve x/y at --tag-z (2) or x/y/z\n"
+            "  --tag-z M         tag height for 2D (1.0)\n"
+            "  --epoch-ms N      epoch length for tag streams (100)\n"
+            "  --lag N           epochs kept open behind the newest per tag (1)\n"
+            "  --max-age-ms N    close an epoch this long after its first range (500)\n"
+            "  --max-tags N      tag table size (8192)\n"
+            "  --out FILE        positions as CSV (- = stdout)\n");
+}
+
+int main(int argc, char **argv) {
+    const char *anchors_path = NULL;
+    const char *synthetic = NULL;
+    int want_synthetic = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!strcmp(a, "--synthetic")) {
+            want_synthetic = 1;
+            if (v && v[0] != '-') {
+                synthetic = v;
+                i++;
+            }
+            continue;
+        }
+        if (!v) {
+            usage();
+            return 2;
+        }
+        i++;
+        if (!strcmp(a, "--in")) {
+            if (input_count == MAX_INPUTS) {
+                fprintf(stderr, "too many inputs\n");
+                return 2;
+            }
+            struct input *in = &inputs[input_count];
+            char *at = strrchr(argv[i], '@');
+
+            *in = (struct input){ .path = argv[i], .tag = -1, .index = input_count++ };
+            if (at) {
+                *at = '\0';
+                in->tag = (int)strtol(at + 1, NULL, 0) & 0xFFFF;
+            }
+        } else if (!strcmp(a, "--anchors")) {
+            anchors_path = v;
+        } else if (!strcmp(a, "--workers")) {
+            cfg.workers = atoi(v);
+        } else if (!strcmp(a, "--dims")) {
+            cfg.dims = atoi(v);
+        } else if (!strcmp(a, "--tag-z")) {
+            cfg.tag_z = atof(v);
+        } else if (!strcmp(a, "--epoch-ms")) {
+            cfg.epoch_ms = (uint32_t)atoi(v);
+        } else if (!strcmp(a, "--lag")) {
+            cfg.lag = (uint32_t)atoi(v);
+        } else if (!strcmp(a, "--max-age-ms")) {
+            cfg.max_age_ms = (uint32_t)atoi(v);
+        } else if (!strcmp(a, "--max-tags")) {
+            cfg.max_tags = (uint32_t)atoi(v);
+        } else if (!strcmp(a, "--out")) {
+            cfg.out = strcmp(v, "-") ? fopen(v, "w") : stdout;
+            if (!cfg.out) {
+                fprintf(stderr, "%s: %s\n", v, strerror(errno));
+                return 1;
+            }
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (cfg.workers < 1 || cfg.workers > MAX_WORKERS || (cfg.dims != 2 && cfg.dims != 3) ||
+        cfg.epoch_ms == 0 || cfg.max_tags == 0 || cfg.max_tags > 65536) {
+        usage();
+        return 2;
+    }
+
+    if (want_synthetic) {
+        if (synthetic_setup(synthetic) != 0) {
+            return 1;
+        }
+    } else {
+        if (!anchors_path || input_count == 0) {
+            usage();
+            return 2;
+        }
+        if (agg_anchors_load(&anchors, anchors_path) < cfg.dims + 1) {
+            fprintf(stderr, "%s: need at least %d anchors\n", anchors_path, cfg.dims + 1);
+            return 1;
+        }
+        for (int i = 0; i < input_count; i++) {
+            if (input_open(&inputs[i]) != 0) {
+                return 1;
+            }
+        }
+    }
+
+    const int ret = run();
+
+    if (cfg.out && cfg.out != stdout) {
+        fclose(cfg.out);
+    }
+    return ret;
+}
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uwb_anchor_table.h"
+
+/* Scripted checks of the anchor table and best-N selection
+ * (CONFIG_UWB_ANCHOR_SELECT, src/uwb_anchor_table.c): ranking by score and
+ * range, skipping and re-admitting anchors that keep missing, discovery
+ * slots, expiry and a full table. The last part drives the table cycle by
+ * cycle, as the radio thread does, against anchors that answer with fixed
+ * probabilities. Prints one line per check, then PASS/FAIL. */
+
+#define BCAST           0xFFFF
+#define PERIOD_MS       100
+
+static int failures;
+
+static void check(int ok, const char *what) {
+    printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+    failures += !ok;
+}
+
+static void setup(struct uwb_anchor_table *t, uint8_t best_n, uint16_t discover_epochs) {
+    const struct uwb_anchor_cfg cfg = {
+        .best_n = best_n,
+        .max_misses = 3,
+        .discover_epochs = discover_epochs,
+        .timeout_ms = 10000,
+    };
+
+    uwb_anchor_table_init(t, &cfg);
+}
+
+/* `n` completed exchanges with `addr` (answering broadcast POLLs) */
+static void train(struct uwb_anchor_table *t, uint16_t addr, int n, uint8_t quality,
+                  uint32_t dist_mm, uint32_t now_ms) {
+    for (int i = 0; i < n; i++) {
+        uwb_anchor_result(t, BCAST, addr, now_ms, quality, dist_mm);
+    }
+}
+
+/* The targets of one whole epoch */
+static int epoch(struct uwb_anchor_table *t, uint16_t *out, uint32_t now_ms) {
+    const int n = t->cfg.best_n;
+
+    for (int i = 0; i < n; i++) {
+        out[i] = uwb_anchor_next(t, now_ms);
+    }
+    return n;
+}
+
+static int contains(const uint16_t *v, int n, uint16_t addr) {
+    for (int i = 0; i < n; i++) {
+        if (v[i] == addr) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void check_empty(void) {
+    struct uwb_anchor_table t;
+    uint16_t sel[UWB_ANCHOR_TABLE_SIZE];
+
+    setup(&t, 3, 0);
+    epoch(&t, sel, 0);
+    check(sel[0] == BCAST && sel[1] == BCAST && sel[2] == BCAST,
+          "empty table: every slot is a broadcast POLL");
+    check(t.stats.discovery == 3 && t.stats.unicast == 0, "empty table: counted as discovery");
+}
+
+static void check_ranking(void) {
+    struct uwb_anchor_table t;
+    uint16_t sel[UWB_ANCHOR_TABLE_SIZE];
+
+    setup(&t, 3, 0);
+    train(&t, 0x0A01, 8, 90, 5000, 0);
+    train(&t, 0x0A02, 8, 60, 1000, 0);
+    train(&t, 0x0A03, 8, 80, 3000, 0);
+    train(&t, 0x0A04, 8, 95, 2000, 0);
+    // 0x0A04 answers but never completes
+    for (int i = 0; i < 8; i++) {
+        uwb_anchor_result(&t, BCAST, 0x0A04, 0, 0, 0);
+    }
+    uwb_anchor_heard(&t, 0x0A05, 0);
+
+    epoch(&t, sel, 0);
+    check(uwb_anchor_count(&t) == 5, "five anchors in the table");
+    check(sel[0] == 0x0A01 && sel[1] == 0x0A03 && sel[2] == 0x0A02,
+          "best 3 by score: quality 90 > 80 > 60");
+    check(!contains(sel, 3, 0x0A05), "heard-only anchor ranks below proven ones");
+    check(uwb_anchor_score(uwb_anchor_find(&t, 0x0A04)) <
+              uwb_anchor_score(uwb_anchor_find(&t, 0x0A05)),
+          "anchor whose exchanges fail ranks below an unknown one");
+
+    // Equal scores: the nearer anchor first, no range yet counts as farthest
+    setup(&t, 3, 0);
+    train(&t, 0x0B01, 6, 70, 9000, 0);
+    train(&t, 0x0B02, 6, 70, 2500, 0);
+    train(&t, 0x0B03, 6, 70, 6000, 0);
+    epoch(&t, sel, 0);
+    check(sel[0] == 0x0B02 && sel[1] == 0x0B03 && sel[2] == 0x0B01,
+          "equal scores: nearest first");
+}
+
+static void check_misses(void) {
+    struct uwb_anchor_table t;
+    uint16_t sel[UWB_ANCHOR_TABLE_SIZE];
+    uint32_t now = 0;
+
+    // As many anchors as slots, so only the miss limit can leave one out
+    setup(&t, 3, 0);
+    train(&t, 0x0C01, 8, 90, 2000, now);
+    train(&t, 0x0C02, 8, 80, 2000, now);
+    train(&t, 0x0C03, 8, 50, 2000, now);
+
+    // 0x0C01 stops answering: it stays selected until max_misses, then drops out
+    int picked = 0;
+
+    for (int e = 0; e < 6; e++) {
+        epoch(&t, sel, now);
+        for (int i = 0; i < 3; i++) {
+            if (sel[i] == 0x0C01) {
+                picked++;
+                uwb_anchor_result(&t, sel[i], 0, now, 0, 0);
+            } else if (sel[i] != BCAST) {
+                uwb_anchor_result(&t, sel[i], sel[i], now, 80, 2000);
+            } else {
+                uwb_anchor_result(&t, sel[i], 0, now, 0, 0);
+            }
+        }
+        now += 3 * PERIOD_MS;
+    }
+    check(picked == 3, "silent anchor POLLed exactly max_misses times");
+    check(uwb_anchor_find(&t, 0x0C01)->misses == 3, "miss count kept");
+    epoch(&t, sel, now);
+    check(!contains(sel, 3, 0x0C01) && contains(sel, 3, 0x0C02) && contains(sel, 3, 0x0C03) &&
+              sel[2] == BCAST,
+          "skipped anchor's slot goes to discovery");
+
+    // Hearing it is not enough; a completed exchange brings it back
+    uwb_anchor_heard(&t, 0x0C01, now);
+    epoch(&t, sel, now);
+    check(!contains(sel, 3, 0x0C01), "overheard frame does not re-admit a skipped anchor");
+    train(&t, 0x0C01, 6, 95, 2000, now);
+    check(uwb_anchor_find(&t, 0x0C01)->misses == 0, "completed exchange clears the misses");
+    epoch(&t, sel, now);
+    check(contains(sel, 3, 0x0C01), "re-admitted after answering a broadcast POLL");
+
+    // A different anchor answering a unicast POLL counts as a miss for the target
+    setup(&t, 1, 0);
+    train(&t, 0x0D01, 4, 90, 2000, 0);
+    epoch(&t, sel, 0);
+    uwb_anchor_result(&t, sel[0], 0x0D02, 0, 90, 2500);
+    check(uwb_anchor_find(&t, 0x0D01)->misses == 1 && uwb_anchor_find(&t, 0x0D02) != NULL,
+          "answer from another anchor: target missed, answering anchor added");
+}
+
+static void check_discovery(void) {
+    struct uwb_anchor_table t;
+    uint16_t sel[UWB_ANCHOR_TABLE_SIZE];
+    int bcast = 0;
+    int kept = 1;
+
+    setup(&t, 3, 4);
+    train(&t, 0x0E01, 6, 90, 1000, 0);
+    train(&t, 0x0E02, 6, 90, 2000, 0);
+    train(&t, 0x0E03, 6, 90, 3000, 0);
+    train(&t, 0x0E04, 6, 90, 4000, 0);
+    for (int e = 0; e < 8; e++) {
+        epoch(&t, sel, 0);
+        bcast += (sel[2] == BCAST);
+        kept &= (sel[0] == 0x0E01 && sel[1] == 0x0E02);
+    }
+    check(kept, "discovery slot only replaces the last pick");
+    check(bcast == 2, "one discovery slot every 4 epochs");
+
+    // Fewer anchors than best_n: the rest of the epoch is discovery
+    setup(&t, 3, 0);
+    train(&t, 0x0E01, 2, 90, 1000, 0);
+    epoch(&t, sel, 0);
+    check(sel[0] == 0x0E01 && sel[1] == BCAST && sel[2] == BCAST, "unfilled slots broadcast");
+}
+
+static void check_expiry(void) {
+    struct uwb_anchor_table t;
+    uint16_t sel[UWB_ANCHOR_TABLE_SIZE];
+
+    setup(&t, 2, 0);
+    train(&t, 0x0F01, 4, 90, 1000, 0);
+    train(&t, 0x0F02, 4, 90, 2000, 6000);
+    epoch(&t, sel, 10500);
+    check(uwb_anchor_find(&t, 0x0F01) == NULL && t.stats.expired == 1,
+          "anchor not heard for timeout_ms dropped");
+    check(sel[0] == 0x0F02 && sel[1] == BCAST, "its slot goes to discovery");
+
+    // Full table: a new anchor waits until the oldest is quiet for half the timeout
+    setup(&t, 2, 0);
+    for (int i = 0; i < UWB_ANCHOR_TABLE_SIZE; i++) {
+        uwb_anchor_heard(&t, (uint16_t)(0x1000 + i), (uint32_t)(i * 10));
+    }
+    uwb_anchor_heard(&t, 0x2000, 1000);
+    check(uwb_anchor_find(&t, 0x2000) == NULL && t.stats.table_full == 1,
+          "full table: newcomer refused while every entry is fresh");
+    uwb_anchor_heard(&t, 0x2000, 5000);
+    check(uwb_anchor_find(&t, 0x2000) != NULL && uwb_anchor_find(&t, 0x1000) == NULL,
+          "full table: longest-silent entry replaced after timeout/2");
+}
+
+static double uniform(unsigned *seed) {
+    return (rand_r(seed) + 0.5) / ((double)RAND_MAX + 1.0);
+}
+
+/* Cycle-by-cycle run against anchors with fixed answer rates and quality */
+static void check_sim(void) {
+    static const struct {
+        uint16_t addr;
+        double p;           // probability a POLL to it completes
+        uint8_t quality;
+        uint32_t dist_mm;
+    } anchors[] = {
+        { 0x3001, 0.98, 90, 4000 },
+        { 0x3002, 0.95, 85, 7000 },
+        { 0x3003, 0.90, 70, 3000 },
+        { 0x3004, 0.97, 40, 2000 },
+        { 0x3005, 0.00, 95, 1000 },     // powered off after discovery
+        { 0x3006, 0.30, 90, 5000 },     // mostly blocked
+    };
+    const int n_anchors = (int)(sizeof(anchors) / sizeof(anchors[0]));
+    struct uwb_anchor_table t;
+    unsigned seed = 1;
+    uint32_t now = 0;
+    int polled[6] = { 0 };
+    int late_polled[6] = { 0 };
+
+    setup(&t, 3, 10);
+    // Discovery: every anchor answers one broadcast POLL
+    for (int i = 0; i < n_anchors; i++) {
+        uwb_anchor_result(&t, BCAST, anchors[i].addr, now, anchors[i].quality, anchors[i].dist_mm);
+    }
+
+    for (int c = 0; c < 3000; c++, now += PERIOD_MS) {
+        const uint16_t target = uwb_anchor_next(&t, now);
+        int k = -1;
+
+        if (target == BCAST) {
+            // Every anchor answers a broadcast; the tag takes one of those that get through
+            const int i = rand_r(&seed) % n_anchors;
+
+            if (uniform(&seed) < anchors[i].p) {
+                k = i;
+            }
+        }
+        for (int i = 0; i < n_anchors; i++) {
+            if (anchors[i].addr == target && uniform(&seed) < anchors[i].p) {
+                k = i;
+            }
+        }
+        if (target != BCAST) {
+            for (int i = 0; i < n_anchors; i++) {
+                if (anchors[i].addr == target) {
+                    polled[i]++;
+                    late_polled[i] += (c >= 1500);
+                }
+            }
+        }
+        if (k >= 0) {
+            uwb_anchor_result(&t, target, anchors[k].addr, now, anchors[k].quality,
+                              anchors[k].dist_mm);
+        } else {
+            uwb_anchor_result(&t, target, 0, now, 0, 0);
+        }
+    }
+
+    printf("     unicast POLLs:");
+    for (int i = 0; i < n_anchors; i++) {
+        printf(" %04X=%d", anchors[i].addr, polled[i]);
+    }
+    printf(" (discovery %u)\n", t.stats.discovery);
+    check(polled[4] <= 3 && late_polled[4] == 0, "dead anchor: at most max_misses POLLs, then skipped");
+    check(late_polled[0] > 400 && late_polled[1] > 400 && late_polled[2] > 400,
+          "steady state: the three reliable high-quality anchors are ranged");
+    check(late_polled[3] < late_polled[2] / 4, "low-quality anchor mostly left out");
+    check(late_polled[5] < late_polled[2] / 4, "mostly blocked anchor mostly left out");
+}
+
+int main(void) {
+    check_empty();
+    check_ranking();
+    check_misses();
+    check_discovery();
+    check_expiry();
+    check_sim();
+
+    printf("%s (%d failed)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
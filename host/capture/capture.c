@@ -0,0 +1,302 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include "uwb_frame.h"
+#include "uwb_rtt_bin_proto.h"
+#include "uwb_stream_proto.h"
+#include "capture.h"
+
+static const uint8_t cap_magic[6] = { 'U', 'W', 'B', 'C', 'A', 'P' };
+static const uint8_t index_sync[8] = { 0xFF, 'C', 'A', 'P', 'I', 'D', 'X', 0x5A };
+
+#define SCAN_CHUNK      65536
+#define SCAN_LIMIT      (4u << 20)      // give up looking for an index block after this
+
+static uint64_t get_u64(const uint8_t *p) {
+    return (uint64_t)uwb_get_u32(p) | ((uint64_t)uwb_get_u32(p + 4) << 32);
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    uwb_put_u32(p, (uint32_t)v);
+    uwb_put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+bool cap_record_time(uint8_t type, const uint8_t *p, uint16_t len, uint32_t *t_ms) {
+    switch (type) {
+    case UWB_RTT_REC_CYCLE:
+    case UWB_RTT_REC_TWR:
+        if (len >= 8) {
+            *t_ms = uwb_get_u32(&p[4]);
+            return true;
+        }
+        break;
+    case UWB_RTT_REC_CONFIG:
+    case UWB_RTT_REC_DIAG:
+        if (len >= 4) {
+            *t_ms = uwb_get_u32(&p[0]);
+            return true;
+        }
+        break;
+    }
+    return false;
+}
+
+// ================= Writer =================
+int cap_writer_open(struct cap_writer *w, const char *path) {
+    memset(w, 0, sizeof(*w));
+    w->f = fopen(path, "ab");
+    if (!w->f || fseek(w->f, 0, SEEK_END) != 0) {
+        return -errno;
+    }
+    const long size = ftell(w->f);
+
+    if (size < 0) {
+        return -errno;
+    }
+    w->off = (uint64_t)size;
+    if (w->off == 0) {
+        uint8_t hdr[CAP_HDR_LEN] = { 0 };
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        memcpy(hdr, cap_magic, sizeof(cap_magic));
+        hdr[6] = CAP_VERSION;
+        put_u64(&hdr[8], (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000);
+        if (fwrite(hdr, sizeof(hdr), 1, w->f) != 1) {
+            return -EIO;
+        }
+        w->off = sizeof(hdr);
+    }
+    return 0;
+}
+
+static int put(struct cap_writer *w, uint8_t type, const uint8_t *p, uint16_t len) {
+    uint8_t hdr[CAP_REC_HDR_LEN] = { type };
+
+    uwb_put_u16(&hdr[1], len);
+    if (fwrite(hdr, sizeof(hdr), 1, w->f) != 1 || (len && fwrite(p, len, 1, w->f) != 1)) {
+        return -EIO;
+    }
+    w->off += sizeof(hdr) + len;
+    return 0;
+}
+
+static int write_index(struct cap_writer *w) {
+    uint8_t p[CAP_INDEX_LEN(CAP_INDEX_ENTRIES)];
+    const int n = w->n_entries;
+
+    if (n == 0) {
+        return 0;
+    }
+    memcpy(p, index_sync, sizeof(index_sync));
+    uwb_put_u16(&p[8], (uint16_t)n);
+    for (int i = 0; i < n; i++) {
+        uint8_t *e = &p[10 + i * CAP_INDEX_ENTRY_LEN];
+
+        uwb_put_u32(e, w->entry_t[i]);
+        put_u64(e + 4, w->entry_off[i]);
+    }
+    const uint16_t len = (uint16_t)CAP_INDEX_LEN(n);
+
+    uwb_put_u16(&p[len - 2], uwb_stream_crc16(p, len - 2u));
+    w->n_entries = 0;
+    w->since_index = 0;
+    w->index_blocks++;
+    return put(w, CAP_REC_INDEX, p, len);
+}
+
+int cap_write(struct cap_writer *w, uint8_t type, const uint8_t *p, uint16_t len) {
+    uint32_t t;
+
+    if (cap_record_time(type, p, len, &t)) {
+        w->t_ms = t;
+        w->have_t = true;
+    }
+    // Index entries need a time: records before the first timed one are found from the start
+    if (w->since_index % CAP_INDEX_STRIDE == 0 && w->have_t && w->n_entries < CAP_INDEX_ENTRIES) {
+        w->entry_t[w->n_entries] = w->t_ms;
+        w->entry_off[w->n_entries] = w->off;
+        w->n_entries++;
+    }
+    const int ret = put(w, type, p, len);
+
+    if (ret) {
+        return ret;
+    }
+    w->records++;
+    if (++w->since_index >= CAP_INDEX_EVERY) {
+        return write_index(w);
+    }
+    return 0;
+}
+
+int cap_write_gap(struct cap_writer *w, uint32_t lost) {
+    uint8_t p[4];
+
+    uwb_put_u32(p, lost);
+    return cap_write(w, CAP_REC_GAP, p, sizeof(p));
+}
+
+int cap_writer_close(struct cap_writer *w) {
+    int ret = 0;
+
+    if (!w->f) {
+        return 0;
+    }
+    ret = write_index(w);
+    if (fclose(w->f) != 0 && ret == 0) {
+        ret = -errno;
+    }
+    w->f = NULL;
+    return ret;
+}
+
+// ================= Reader =================
+int cap_reader_open(struct cap_reader *r, const char *path) {
+    uint8_t hdr[CAP_HDR_LEN];
+
+    memset(r, 0, sizeof(*r));
+    r->f = fopen(path, "rb");
+    if (!r->f) {
+        return -errno;
+    }
+    if (fseek(r->f, 0, SEEK_END) != 0) {
+        return -errno;
+    }
+    r->size = (uint64_t)ftell(r->f);
+    rewind(r->f);
+    if (fread(hdr, sizeof(hdr), 1, r->f) != 1 || memcmp(hdr, cap_magic, sizeof(cap_magic)) ||
+        hdr[6] != CAP_VERSION) {
+        fclose(r->f);
+        r->f = NULL;
+        return -EPROTO;
+    }
+    r->off = CAP_HDR_LEN;
+    return 0;
+}
+
+void cap_reader_close(struct cap_reader *r) {
+    if (r->f) {
+        fclose(r->f);
+        r->f = NULL;
+    }
+}
+
+int cap_next(struct cap_reader *r, uint8_t *type, const uint8_t **payload, uint16_t *len) {
+    uint8_t hdr[CAP_REC_HDR_LEN];
+
+    for (;;) {
+        if (r->off + CAP_REC_HDR_LEN > r->size) {
+            r->truncated = r->size - r->off;
+            return 0;
+        }
+        if (fseeko(r->f, (off_t)r->off, SEEK_SET) != 0 || fread(hdr, sizeof(hdr), 1, r->f) != 1) {
+            return -EIO;
+        }
+        const uint16_t n = uwb_get_u16(&hdr[1]);
+
+        if (r->off + CAP_REC_HDR_LEN + n > r->size) {
+            r->truncated = r->size - r->off;
+            return 0;
+        }
+        r->off += CAP_REC_HDR_LEN + n;
+        if (hdr[0] == CAP_REC_INDEX) {
+            r->index_blocks++;
+            continue;
+        }
+        if (n && fread(r->buf, n, 1, r->f) != 1) {
+            return -EIO;
+        }
+        *type = hdr[0];
+        *payload = r->buf;
+        *len = n;
+        return 1;
+    }
+}
+
+struct index_block {
+    uint64_t pos;               // of the record header
+    int n;
+    uint32_t t[CAP_INDEX_ENTRIES];
+    uint64_t off[CAP_INDEX_ENTRIES];
+};
+
+/* Parse the index record whose sync pattern starts at file offset `sync`. */
+static bool read_index(struct cap_reader *r, uint64_t sync, struct index_block *b) {
+    uint8_t p[CAP_INDEX_LEN(CAP_INDEX_ENTRIES)];
+    uint8_t hdr[CAP_REC_HDR_LEN];
+
+    if (sync < CAP_HDR_LEN + CAP_REC_HDR_LEN || fseeko(r->f, (off_t)(sync - CAP_REC_HDR_LEN), SEEK_SET) ||
+        fread(hdr, sizeof(hdr), 1, r->f) != 1 || hdr[0] != CAP_REC_INDEX) {
+        return false;
+    }
+    const uint16_t len = uwb_get_u16(&hdr[1]);
+
+    if (len < CAP_INDEX_LEN(1) || len > sizeof(p) || fread(p, len, 1, r->f) != 1) {
+        return false;
+    }
+    const int n = uwb_get_u16(&p[8]);
+
+    if (len != CAP_INDEX_LEN(n) || uwb_get_u16(&p[len - 2]) != uwb_stream_crc16(p, len - 2u)) {
+        return false;
+    }
+    b->pos = sync - CAP_REC_HDR_LEN;
+    b->n = n;
+    for (int i = 0; i < n; i++) {
+        b->t[i] = uwb_get_u32(&p[10 + i * CAP_INDEX_ENTRY_LEN]);
+        b->off[i] = get_u64(&p[10 + i * CAP_INDEX_ENTRY_LEN + 4]);
+    }
+    return true;
+}
+
+/* First valid index block starting in [from, to) */
+static bool find_index(struct cap_reader *r, uint64_t from, uint64_t to, struct index_block *b) {
+    static uint8_t chunk[SCAN_CHUNK + sizeof(index_sync)];
+    const uint64_t limit = from + SCAN_LIMIT < to ? from + SCAN_LIMIT : to;
+
+    for (uint64_t pos = from; pos < limit; pos += SCAN_CHUNK) {
+        if (fseeko(r->f, (off_t)pos, SEEK_SET) != 0) {
+            return false;
+        }
+        const size_t got = fread(chunk, 1, sizeof(chunk), r->f);
+
+        for (size_t i = 0; i + sizeof(index_sync) <= got && i < SCAN_CHUNK; i++) {
+            if (chunk[i] == index_sync[0] && memcmp(&chunk[i], index_sync, sizeof(index_sync)) == 0 &&
+                pos + i < to && read_index(r, pos + i, b)) {
+                return true;
+            }
+        }
+        if (got < sizeof(chunk)) {
+            break;
+        }
+    }
+    return false;
+}
+
+int cap_seek_ms(struct cap_reader *r, uint32_t t_ms) {
+    struct index_block b;
+    struct index_block best = { .n = 0 };
+    uint64_t lo = CAP_HDR_LEN;
+    uint64_t hi = r->size;
+    int reads = 0;
+
+    // Last index block whose first entry is at or before t_ms
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+
+        reads++;
+        if (!find_index(r, mid, hi, &b)) {
+            hi = mid;
+        } else if (b.t[0] <= t_ms) {
+            best = b;
+            lo = b.pos + CAP_REC_HDR_LEN + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    r->off = CAP_HDR_LEN;
+    for (int i = 0; i < best.n && best.t[i] <= t_ms; i++) {
+        r->off = best.off[i];
+    }
+    return reads;
+}
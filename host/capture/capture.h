@@ -0,0 +1,95 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Capture file: an append-only log of the tag's binary diagnostics records,
+ * for replay on the host (uwb_replay). Little endian:
+ *
+ *   header (16):  "UWBCAP" version(1) reserved(1) created, unix ms(8)
+ *   records:      type(1) len(2) payload(len)
+ *
+ * Types below 0x80 are the RTT diagnostics records (uwb_rtt_bin_proto.h) with
+ * their payload unchanged; the 8-byte RTT header is replaced by the 3 above.
+ * The writer adds:
+ *   CAP_REC_GAP    count(4): records lost on the target or the link
+ *   CAP_REC_INDEX  sync(8) n(2) n x { t_ms(4) offset(8) } crc(2)
+ *
+ * Every CAP_INDEX_EVERY records the writer appends an index block listing
+ * every CAP_INDEX_STRIDE-th record since the previous block, with the tag
+ * uptime at that record. A reader seeks by bisecting the file on index
+ * blocks (found by the sync pattern, checked by the CRC-16 of the stream
+ * format), reading a few kB whatever the file size. Times must increase
+ * through the file for that, i.e. one capture per tag boot. Appending to an
+ * existing file just continues it; a record cut short at the end (power loss
+ * while capturing) is ignored.
+ */
+
+#define CAP_VERSION             1
+#define CAP_HDR_LEN             16
+#define CAP_REC_HDR_LEN         3
+
+#define CAP_REC_GAP             0x80
+#define CAP_REC_INDEX           0xFF
+
+#define CAP_INDEX_EVERY         256
+#define CAP_INDEX_STRIDE        16
+#define CAP_INDEX_ENTRIES       (CAP_INDEX_EVERY / CAP_INDEX_STRIDE)
+#define CAP_INDEX_ENTRY_LEN     12
+#define CAP_INDEX_LEN(n)        (8 + 2 + (n) * CAP_INDEX_ENTRY_LEN + 2)
+#define CAP_MAX_PAYLOAD         65535
+
+struct cap_writer {
+    FILE *f;
+    uint64_t off;               // file size = offset of the next record
+    uint32_t since_index;       // records since the last index block
+    uint32_t t_ms;              // latest tag uptime seen
+    bool have_t;
+    int n_entries;
+    uint32_t entry_t[CAP_INDEX_ENTRIES];
+    uint64_t entry_off[CAP_INDEX_ENTRIES];
+    // counters
+    uint64_t records;
+    uint64_t index_blocks;
+};
+
+/* Open for appending; writes the header if the file is new or empty.
+ * Returns 0 or -errno. */
+int cap_writer_open(struct cap_writer *w, const char *path);
+
+/* Append one record. Returns 0 or -errno. */
+int cap_write(struct cap_writer *w, uint8_t type, const uint8_t *payload, uint16_t len);
+int cap_write_gap(struct cap_writer *w, uint32_t lost);
+
+/* Write the pending index block and close. Returns 0 or -errno. */
+int cap_writer_close(struct cap_writer *w);
+
+struct cap_reader {
+    FILE *f;
+    uint64_t size;
+    uint64_t off;               // next record
+    uint8_t buf[CAP_MAX_PAYLOAD];
+    // counters
+    uint64_t index_blocks;
+    uint64_t truncated;         // bytes of a record cut short at the end
+};
+
+/* Returns 0, or -errno (-EPROTO: not a capture file) */
+int cap_reader_open(struct cap_reader *r, const char *path);
+void cap_reader_close(struct cap_reader *r);
+
+/* Next data record (index blocks are skipped). *payload points into the
+ * reader and is valid until the next call. Returns 1, 0 at the end, or -EIO. */
+int cap_next(struct cap_reader *r, uint8_t *type, const uint8_t **payload, uint16_t *len);
+
+/* Position the reader at an indexed record at or before tag time t_ms (at the
+ * start if there is none); the caller skips forward from there. Returns the
+ * number of index blocks read. */
+int cap_seek_ms(struct cap_reader *r, uint32_t t_ms);
+
+/* Tag uptime carried by a record, if any */
+bool cap_record_time(uint8_t type, const uint8_t *payload, uint16_t len, uint32_t *t_ms);
+
+#endif /* CAPTURE_H */
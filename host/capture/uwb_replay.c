@@ -0,0 +1,469 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "uwb_frame.h"
+#include "uwb_ranging.h"
+#include "uwb_rtt_bin_proto.h"
+#include "uwb_stream_proto.h"
+#include "uwb_twr_est.h"
+#include "capture.h"
+
+/* Replays a capture through the tag's estimator (src/uwb_twr_est.c, built for
+ * the host): SS-TWR distance from the raw timestamps, quality score and the
+ * per-anchor alpha-beta filter, i.e. what the tag puts in its range stream.
+ *
+ *   uwb_replay <file.cap> [--from-ms T] [--to-ms T] [--csv]
+ *              [--alpha Q8] [--beta Q8] [--gap-ms MS]
+ *   uwb_replay --synthetic [cycles]         writer/reader/estimator check
+ *
+ * The recomputed distance is compared with the one the tag computed; with an
+ * unchanged estimator they match exactly, so any difference is the effect of
+ * the change under test. Per-anchor statistics and settings changes go to
+ * stderr, range records (--csv) to stdout.
+ */
+
+#define MAX_ANCHORS     16
+
+struct anchor_stats {
+    uint16_t anchor;
+    uint32_t n;
+    double sum;
+    double sum_sq;
+    double filt_dev_sq;         // (filtered - raw)^2, how much the filter smooths
+};
+
+struct replay {
+    struct uwb_range_filter filter;
+    int csv;
+    uint32_t from_ms;
+    uint32_t to_ms;
+    // results
+    uint64_t records;
+    uint64_t twr;
+    uint64_t valid;
+    uint64_t mismatched;        // recomputed distance differs from the tag's
+    uint32_t max_diff_mm;
+    uint64_t cycles;
+    uint64_t failed_cycles;
+    uint64_t lost;              // CAP_REC_GAP
+    uint64_t configs;
+    uint64_t diags;
+    int16_t temp_min, temp_max;
+    uint16_t vbat_min;
+    uint32_t first_ms, last_ms;
+    bool have_ms;
+    struct anchor_stats anchors[MAX_ANCHORS];
+    int n_anchors;
+};
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct anchor_stats *anchor_get(struct replay *rp, uint16_t anchor) {
+    for (int i = 0; i < rp->n_anchors; i++) {
+        if (rp->anchors[i].anchor == anchor) {
+            return &rp->anchors[i];
+        }
+    }
+    if (rp->n_anchors == MAX_ANCHORS) {
+        return NULL;
+    }
+    struct anchor_stats *a = &rp->anchors[rp->n_anchors++];
+
+    memset(a, 0, sizeof(*a));
+    a->anchor = anchor;
+    return a;
+}
+
+static void on_twr(struct replay *rp, const uint8_t *p) {
+    const uint32_t t_ms = uwb_get_u32(&p[4]);
+    const uint16_t anchor = uwb_get_u16(&p[8]);
+    const int8_t status = (int8_t)p[11];
+    const uint8_t flags = p[12];
+    const struct uwb_twr_ts ts = {
+        .poll_tx = uwb_get_ts40(&p[13]),
+        .resp_rx = uwb_get_ts40(&p[18]),
+        .poll_rx = uwb_get_ts40(&p[23]),
+        .resp_tx = uwb_get_ts40(&p[28]),
+        .final_tx = uwb_get_ts40(&p[33]),
+    };
+    const uint32_t tag_mm = uwb_get_u32(&p[38]);
+    const uint32_t report_mm = uwb_get_u32(&p[42]);
+    // The tag only computes a distance for a completed exchange
+    const uint32_t dist_mm = status == 0 ? uwb_twr_ss_dist_mm(&ts) : 0;
+    const bool toa = (flags & UWB_RANGE_FLAG_TOA) != 0;
+    uint32_t filt_mm = 0;
+    int16_t vel_cm_s = 0;
+
+    rp->twr++;
+    if (dist_mm != tag_mm) {
+        const uint32_t d = dist_mm > tag_mm ? dist_mm - tag_mm : tag_mm - dist_mm;
+
+        rp->mismatched++;
+        rp->max_diff_mm = d > rp->max_diff_mm ? d : rp->max_diff_mm;
+    }
+    const bool reset = uwb_range_filter_update(&rp->filter, anchor, t_ms,
+                                               status == 0 && dist_mm > 0, dist_mm,
+                                               &filt_mm, &vel_cm_s);
+    const uint8_t quality = uwb_est_quality(status, dist_mm, report_mm, toa);
+
+    if (status == 0 && dist_mm > 0) {
+        struct anchor_stats *a = anchor_get(rp, anchor);
+
+        rp->valid++;
+        if (a) {
+            const double dev = (double)filt_mm - dist_mm;
+
+            a->n++;
+            a->sum += dist_mm;
+            a->sum_sq += (double)dist_mm * dist_mm;
+            a->filt_dev_sq += dev * dev;
+        }
+    }
+    if (rp->csv) {
+        printf("%u,%u,0x%04x,%d,%u,%u,%u,%d,%u,%u,%d\n", uwb_get_u32(&p[0]), t_ms, anchor, status,
+               tag_mm, dist_mm, filt_mm, vel_cm_s, quality, report_mm, reset);
+    }
+}
+
+static void on_config(const uint8_t *p) {
+    fprintf(stderr, "config at %u ms: period %u ms, antenna delay %u, channel %u, code %u, "
+                    "STS mode %u, features 0x%02x\n",
+            uwb_get_u32(&p[0]), uwb_get_u32(&p[4]), uwb_get_u16(&p[8]), p[10], p[11], p[12],
+            p[13]);
+}
+
+static void on_diag(struct replay *rp, const uint8_t *p) {
+    const int16_t temp = (int16_t)uwb_get_u16(&p[4]);
+    const uint16_t vbat = uwb_get_u16(&p[6]);
+
+    if (rp->diags++ == 0) {
+        rp->temp_min = rp->temp_max = temp;
+        rp->vbat_min = vbat;
+    }
+    rp->temp_min = temp < rp->temp_min ? temp : rp->temp_min;
+    rp->temp_max = temp > rp->temp_max ? temp : rp->temp_max;
+    rp->vbat_min = vbat < rp->vbat_min ? vbat : rp->vbat_min;
+}
+
+/* Replays [from_ms, to_ms]. Returns 0, or -errno on a read error. */
+static int replay_file(struct replay *rp, const char *path, double *elapsed_s, int *seeks) {
+    static struct cap_reader r;
+    uint8_t type;
+    const uint8_t *p;
+    uint16_t len;
+    int ret = cap_reader_open(&r, path);
+
+    if (ret) {
+        return ret;
+    }
+    const double t0 = now_s();
+
+    *seeks = rp->from_ms ? cap_seek_ms(&r, rp->from_ms) : 0;
+    while ((ret = cap_next(&r, &type, &p, &len)) > 0) {
+        uint32_t t_ms;
+        const bool timed = cap_record_time(type, p, len, &t_ms);
+
+        if (timed && t_ms < rp->from_ms) {
+            continue;
+        }
+        if (timed && t_ms > rp->to_ms) {
+            break;
+        }
+        if (timed) {
+            if (!rp->have_ms) {
+                rp->first_ms = t_ms;
+                rp->have_ms = true;
+            }
+            rp->last_ms = t_ms;
+        }
+        rp->records++;
+        if (type == UWB_RTT_REC_TWR && len == UWB_RTT_TWR_LEN) {
+            on_twr(rp, p);
+        } else if (type == UWB_RTT_REC_CYCLE && len == UWB_RTT_CYCLE_LEN) {
+            rp->cycles++;
+            rp->failed_cycles += p[19] != 0;
+        } else if (type == UWB_RTT_REC_CONFIG && len == UWB_RTT_CONFIG_LEN) {
+            rp->configs++;
+            on_config(p);
+        } else if (type == UWB_RTT_REC_DIAG && len == UWB_RTT_DIAG_LEN) {
+            on_diag(rp, p);
+        } else if (type == CAP_REC_GAP && len == 4) {
+            rp->lost += uwb_get_u32(p);
+        }
+    }
+    *elapsed_s = now_s() - t0;
+    if (r.truncated) {
+        fprintf(stderr, "ignored %llu bytes of a truncated record at the end\n",
+                (unsigned long long)r.truncated);
+    }
+    cap_reader_close(&r);
+    return ret < 0 ? ret : 0;
+}
+
+static void print_summary(const struct replay *rp, double elapsed_s) {
+    const double span_s = rp->have_ms ? (rp->last_ms - rp->first_ms) / 1000.0 : 0;
+
+    fprintf(stderr, "%llu records over %.1f s of capture: %llu cycles (%llu failed), %llu exchanges "
+                    "(%llu valid), %llu lost on the target\n",
+            (unsigned long long)rp->records, span_s, (unsigned long long)rp->cycles,
+            (unsigned long long)rp->failed_cycles, (unsigned long long)rp->twr,
+            (unsigned long long)rp->valid, (unsigned long long)rp->lost);
+    fprintf(stderr, "estimator vs tag: %llu distances differ (max %u mm)\n",
+            (unsigned long long)rp->mismatched, rp->max_diff_mm);
+    for (int i = 0; i < rp->n_anchors; i++) {
+        const struct anchor_stats *a = &rp->anchors[i];
+        const double mean = a->sum / a->n;
+        const double var = a->sum_sq / a->n - mean * mean;
+
+        fprintf(stderr, "  anchor 0x%04x: %u ranges, mean %.0f mm, std %.0f mm, filter vs raw %.0f mm RMS\n",
+                a->anchor, a->n, mean, sqrt(var > 0 ? var : 0), sqrt(a->filt_dev_sq / a->n));
+    }
+    if (rp->diags) {
+        fprintf(stderr, "  DW3000 temp %.2f..%.2f C, VBAT min %u mV\n", rp->temp_min / 100.0,
+                rp->temp_max / 100.0, rp->vbat_min);
+    }
+    fprintf(stderr, "replay: %.0f records/s, %.0fx real time\n",
+            elapsed_s > 0 ? rp->records / elapsed_s : 0.0,
+            elapsed_s > 0 ? span_s / elapsed_s : 0.0);
+}
+
+static void replay_init(struct replay *rp) {
+    memset(rp, 0, sizeof(*rp));
+    uwb_range_filter_init(&rp->filter);
+    rp->to_ms = UINT32_MAX;
+}
+
+// ================= Synthetic check =================
+struct sim_anchor {
+    uint16_t addr;
+    uint64_t clock;             // anchor DTU at tag DTU 0
+    double skew;                // anchor clock rate - 1
+    double d0_m, amp_m;         // distance swings around d0_m
+};
+
+static uint64_t ts40(double dtu) {
+    return (uint64_t)llround(dtu) & UWB_TS_MASK;
+}
+
+/* Writes `cycles` TWR cycles at 10 Hz against 3 anchors, with settings,
+ * housekeeping, lost records and a torn last record. */
+static int synthetic_write(const char *path, uint32_t cycles, uint32_t *twr_written,
+                           uint32_t *mid_ms) {
+    static struct cap_writer w;
+    struct sim_anchor an[3] = {
+        { 0x0002, 0x12345678ull, 12e-6, 4.0, 2.5 },
+        { 0x0003, 0xFFFFF00000ull, -8e-6, 9.0, 6.0 },
+        { 0x0004, 0x00ABCDEF01ull, 3e-6, 15.0, 0.0 },
+    };
+    const double dtu_per_s = 1.0 / UWB_TWR_DTU_S;
+    uint64_t tag = 0xFFF0000000ull;         // wraps within the first minute
+    int ret = cap_writer_open(&w, path);
+
+    if (ret) {
+        return ret;
+    }
+    srand(7);
+    *twr_written = 0;
+    for (uint32_t c = 1; c <= cycles && ret == 0; c++) {
+        const uint32_t t_ms = 1000 + c * 100;
+        struct sim_anchor *a = &an[c % 3];
+        uint8_t p[UWB_RTT_TWR_LEN];
+        uint8_t cyc[UWB_RTT_CYCLE_LEN] = { 0 };
+        const int8_t status = (c % 50 == 0) ? UWB_RANGE_ERR_RESP : (c % 23 == 0) ? UWB_RANGE_ERR_FINAL : 0;
+
+        if (c == 1 || c == cycles / 2) {
+            uint8_t cfg[UWB_RTT_CONFIG_LEN] = { 0 };
+
+            uwb_put_u32(&cfg[0], t_ms);
+            uwb_put_u32(&cfg[4], 100);
+            uwb_put_u16(&cfg[8], c == 1 ? 16210 : 16200);
+            cfg[10] = 5;
+            cfg[11] = 9;
+            ret = cap_write(&w, UWB_RTT_REC_CONFIG, cfg, sizeof(cfg));
+        }
+        if (c == cycles / 2) {
+            *mid_ms = t_ms;
+        }
+
+        // Exchange: POLL at tag time, RESP after the anchor's fixed reply delay
+        const double t_s = t_ms / 1000.0;
+        const double d_m = a->d0_m + a->amp_m * sin(t_s / 60.0) + 0.02 * ((double)rand() / RAND_MAX - 0.5);
+        const double tof = d_m / UWB_TWR_C_M_S * dtu_per_s;
+        const double poll_tx = (double)tag;
+        const double poll_rx = (double)a->clock + (poll_tx + tof) * (1 + a->skew);
+        const double reply = 650e-6 * dtu_per_s;
+        const double resp_tx = poll_rx + reply;
+        const double resp_rx = poll_tx + 2 * tof + reply / (1 + a->skew);
+        const struct uwb_twr_ts ts = {
+            .poll_tx = ts40(poll_tx), .resp_rx = ts40(resp_rx), .poll_rx = ts40(poll_rx),
+            .resp_tx = ts40(resp_tx), .final_tx = status ? 0 : ts40(resp_rx + 400e-6 * dtu_per_s),
+        };
+        const uint32_t dist = status == 0 ? uwb_twr_ss_dist_mm(&ts) : 0;
+
+        uwb_put_u32(&cyc[0], c);
+        uwb_put_u32(&cyc[4], t_ms);
+        uwb_put_u16(&cyc[16], status == UWB_RANGE_ERR_RESP ? 0 : a->addr);
+        cyc[19] = (uint8_t)status;
+        uwb_put_u32(&cyc[20], dist);
+        if (ret == 0) {
+            ret = cap_write(&w, UWB_RTT_REC_CYCLE, cyc, sizeof(cyc));
+        }
+        if (status != UWB_RANGE_ERR_RESP && ret == 0) {
+            uwb_put_u32(&p[0], c);
+            uwb_put_u32(&p[4], t_ms);
+            uwb_put_u16(&p[8], a->addr);
+            p[10] = (uint8_t)c;
+            p[11] = (uint8_t)status;
+            p[12] = 0;
+            uwb_put_ts40(&p[13], ts.poll_tx);
+            uwb_put_ts40(&p[18], ts.resp_rx);
+            uwb_put_ts40(&p[23], ts.poll_rx);
+            uwb_put_ts40(&p[28], ts.resp_tx);
+            uwb_put_ts40(&p[33], ts.final_tx);
+            uwb_put_u32(&p[38], dist);
+            uwb_put_u32(&p[42], status == 0 ? (uint32_t)llround(d_m * 1000) : 0);
+            ret = cap_write(&w, UWB_RTT_REC_TWR, p, sizeof(p));
+            (*twr_written)++;
+        }
+        if (c % 30 == 0 && ret == 0) {
+            uint8_t d[UWB_RTT_DIAG_LEN];
+
+            uwb_put_u32(&d[0], t_ms);
+            uwb_put_u16(&d[4], (uint16_t)(2800 + c % 200));
+            uwb_put_u16(&d[6], 3300);
+            ret = cap_write(&w, UWB_RTT_REC_DIAG, d, sizeof(d));
+        }
+        if (c % 997 == 0 && ret == 0) {
+            ret = cap_write_gap(&w, 2);
+        }
+        tag += (uint64_t)(0.1 * dtu_per_s);
+    }
+    if (ret == 0) {
+        ret = cap_writer_close(&w);
+    }
+    if (ret == 0) {
+        // A record cut short, as after a power loss while capturing
+        FILE *f = fopen(path, "ab");
+        const uint8_t torn[5] = { UWB_RTT_REC_TWR, UWB_RTT_TWR_LEN, 0, 1, 2 };
+
+        if (!f || fwrite(torn, sizeof(torn), 1, f) != 1 || fclose(f) != 0) {
+            ret = -EIO;
+        }
+    }
+    return ret;
+}
+
+static int synthetic(uint32_t cycles) {
+    static struct replay rp, part;
+    char path[] = "/tmp/uwb_replay_XXXXXX";
+    const int fd = mkstemp(path);
+    uint32_t twr_written = 0;
+    uint32_t mid_ms = 0;
+    double elapsed_s, part_s;
+    int seeks = 0;
+
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    unlink(path);   // the writer creates it and writes the header
+
+    int ret = synthetic_write(path, cycles, &twr_written, &mid_ms);
+
+    replay_init(&rp);
+    if (ret == 0) {
+        ret = replay_file(&rp, path, &elapsed_s, &seeks);
+    }
+    // Seek into the middle: the indexed start must be close to it
+    replay_init(&part);
+    part.from_ms = mid_ms;
+    if (ret == 0) {
+        ret = replay_file(&part, path, &part_s, &seeks);
+    }
+    if (ret) {
+        fprintf(stderr, "%s: %s\n", path, strerror(-ret));
+        unlink(path);
+        return 1;
+    }
+    print_summary(&rp, elapsed_s);
+    fprintf(stderr, "seek to %u ms: %d index probes, first record at %u ms\n", mid_ms, seeks,
+            part.first_ms);
+    unlink(path);
+
+    const int ok = rp.twr == twr_written && rp.mismatched == 0 && rp.n_anchors == 3 &&
+                   rp.lost == 2 * (cycles / 997) && rp.configs == 2 && rp.diags == cycles / 30 &&
+                   part.first_ms == mid_ms && part.twr > 0 && part.twr < rp.twr &&
+                   seeks < 40;
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: uwb_replay <file.cap> [--from-ms T] [--to-ms T] [--csv]\n"
+                    "                  [--alpha Q8] [--beta Q8] [--gap-ms MS]\n"
+                    "       uwb_replay --synthetic [cycles]\n");
+}
+
+int main(int argc, char **argv) {
+    static struct replay rp;
+    double elapsed_s;
+    int seeks;
+
+    if (argc >= 2 && strcmp(argv[1], "--synthetic") == 0) {
+        const uint32_t cycles = argc >= 3 ? (uint32_t)strtoul(argv[2], NULL, 0) : 100000;
+
+        if (cycles < 1000) {
+            fprintf(stderr, "--synthetic needs at least 1000 cycles\n");
+            return 2;
+        }
+        return synthetic(cycles);
+    }
+    if (argc < 2 || argv[1][0] == '-') {
+        usage();
+        return 2;
+    }
+    replay_init(&rp);
+    for (int i = 2; i < argc; i++) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--csv") == 0) {
+            rp.csv = 1;
+        } else if (v && strcmp(argv[i], "--from-ms") == 0) {
+            rp.from_ms = (uint32_t)strtoul(v, NULL, 0), i++;
+        } else if (v && strcmp(argv[i], "--to-ms") == 0) {
+            rp.to_ms = (uint32_t)strtoul(v, NULL, 0), i++;
+        } else if (v && strcmp(argv[i], "--alpha") == 0) {
+            rp.filter.alpha_q8 = atoi(v), i++;
+        } else if (v && strcmp(argv[i], "--beta") == 0) {
+            rp.filter.beta_q8 = atoi(v), i++;
+        } else if (v && strcmp(argv[i], "--gap-ms") == 0) {
+            rp.filter.gap_ms = atoi(v), i++;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (rp.csv) {
+        printf("cycle,t_ms,anchor,status,tag_mm,dist_mm,filt_mm,vel_cm_s,quality,report_mm,filt_reset\n");
+    }
+
+    const int ret = replay_file(&rp, argv[1], &elapsed_s, &seeks);
+
+    if (ret) {
+        fprintf(stderr, "%s: %s\n", argv[1], ret == -EPROTO ? "not a capture file" : strerror(-ret));
+        return 1;
+    }
+    print_summary(&rp, elapsed_s);
+    return 0;
+}
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uwb_downlink.h"
+#include "uwb_frame.h"
+
+/* Scripted checks of the downlink command channel (CONFIG_UWB_DOWNLINK,
+ * src/uwb_downlink.c): command and ack encoding, value checks, replacement
+ * of a pending command, and idempotent repeats. The last part runs an anchor
+ * that resends each command until it sees the ack, over a link that loses
+ * frames, and checks that every command is applied exactly once. Prints one
+ * line per check, then PASS/FAIL. */
+
+#define ANCHOR          0x0002
+
+static int failures;
+
+static void check(int ok, const char *what) {
+    printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+    failures += !ok;
+}
+
+static struct uwb_dl_cmd cmd(uint8_t seq, uint8_t op, uint8_t len, const uint8_t *val) {
+    struct uwb_dl_cmd c = { .seq = seq, .op = op, .len = len };
+
+    memcpy(c.val, val, len);
+    return c;
+}
+
+static struct uwb_dl_cmd period(uint8_t seq, uint16_t ms) {
+    uint8_t v[2];
+
+    uwb_put_u16(v, ms);
+    return cmd(seq, UWB_DL_OP_PERIOD, 2, v);
+}
+
+static struct uwb_dl_cmd tx_power(uint8_t seq, uint32_t power) {
+    uint8_t v[4];
+
+    uwb_put_u32(v, power);
+    return cmd(seq, UWB_DL_OP_TX_POWER, 4, v);
+}
+
+static struct uwb_dl_cmd phy(uint8_t seq, uint8_t chan, uint8_t code) {
+    const uint8_t v[2] = { chan, code };
+
+    return cmd(seq, UWB_DL_OP_PHY, 2, v);
+}
+
+/* Anchor encodes, tag receives it after a frame's payload */
+static int send(struct uwb_dl_state *st, const struct uwb_dl_cmd *c) {
+    uint8_t buf[UWB_DL_CMD_MAX];
+    const uint16_t len = uwb_dl_cmd_put(buf, c);
+
+    return uwb_dl_rx(st, buf, len, ANCHOR);
+}
+
+/* Cycle boundary on the tag: apply what is pending, return the POLL tail */
+static uint16_t boundary(struct uwb_dl_state *st, uint8_t *poll_tail, int *applied) {
+    struct uwb_dl_cmd c;
+
+    if (uwb_dl_take(st, &c)) {
+        uwb_dl_done(st, uwb_dl_check(&c));
+        if (applied) {
+            (*applied)++;
+        }
+    }
+    return uwb_dl_ack_put(st, poll_tail);
+}
+
+static void check_encoding(void) {
+    struct uwb_dl_state st;
+    struct uwb_dl_cmd got;
+    const struct uwb_dl_cmd c = tx_power(7, 0x0C0C0C0C);
+    uint8_t buf[UWB_DL_CMD_MAX + 4];
+    uint8_t tail[UWB_DL_ACK_LEN];
+    uint8_t seq, status;
+
+    check(uwb_dl_cmd_put(buf, &c) == 8 && buf[0] == UWB_DL_CMD_TAG && buf[1] == 7 &&
+              buf[2] == UWB_DL_OP_TX_POWER && buf[3] == 4 && buf[4] == 0x0C,
+          "command encoding: tag seq op len value");
+
+    uwb_dl_init(&st);
+    check(send(&st, &c) == 0 && uwb_dl_take(&st, &got) && got.seq == 7 &&
+              got.op == UWB_DL_OP_TX_POWER && got.len == 4 && uwb_get_u32(got.val) == 0x0C0C0C0C,
+          "received command taken at the cycle boundary");
+    check(!uwb_dl_take(&st, &got), "taken once");
+    check(uwb_dl_ack_put(&st, tail) == 0, "no ack before the outcome is known");
+    uwb_dl_done(&st, UWB_DL_OK);
+    check(uwb_dl_ack_put(&st, tail) == UWB_DL_ACK_LEN && tail[0] == UWB_DL_ACK_TAG &&
+              uwb_dl_ack_get(tail, sizeof(tail), &seq, &status) == 0 && seq == 7 &&
+              status == UWB_DL_OK,
+          "ack in the next POLL: 0xDA seq status");
+    check(uwb_dl_ack_put(&st, tail) == 0, "ack sent once");
+
+    // Frames without a command, and broken ones
+    uwb_dl_init(&st);
+    buf[0] = 0x00;
+    check(uwb_dl_rx(&st, buf, 8, ANCHOR) != 0 && st.stats.rx == 0, "other bytes: no command");
+    check(uwb_dl_rx(&st, buf, 0, ANCHOR) != 0 && st.stats.rx == 0, "no tail: no command");
+    uwb_dl_cmd_put(buf, &c);
+    check(uwb_dl_rx(&st, buf, 6, ANCHOR) != 0 && st.stats.malformed == 1 && !st.pending,
+          "truncated value dropped");
+    buf[3] = UWB_DL_VAL_MAX + 1;
+    check(uwb_dl_rx(&st, buf, sizeof(buf), ANCHOR) != 0 && st.stats.malformed == 2,
+          "oversized length dropped");
+    check(uwb_dl_ack_get(buf, 2, &seq, &status) != 0, "short ack rejected");
+}
+
+static void check_values(void) {
+    const uint8_t none[1] = { 0 };
+    struct uwb_dl_cmd c;
+
+    c = period(1, UWB_DL_PERIOD_MIN_MS - 1);
+    check(uwb_dl_check(&c) == UWB_DL_BAD_VALUE, "period below 20 ms refused");
+    c = period(1, UWB_DL_PERIOD_MIN_MS);
+    check(uwb_dl_check(&c) == UWB_DL_OK, "period 20 ms accepted");
+    c = period(1, UWB_DL_PERIOD_MAX_MS);
+    check(uwb_dl_check(&c) == UWB_DL_OK, "period 60000 ms accepted");
+    c = period(1, UWB_DL_PERIOD_MAX_MS + 1);
+    check(uwb_dl_check(&c) == UWB_DL_BAD_VALUE, "period above 60000 ms refused");
+    c = cmd(1, UWB_DL_OP_PERIOD, 1, none);
+    check(uwb_dl_check(&c) == UWB_DL_BAD_VALUE, "period with the wrong length refused");
+
+    c = tx_power(1, 0x10101010);
+    check(uwb_dl_check(&c) == UWB_DL_OK, "TX power at the cap accepted");
+    c = tx_power(1, 0x00000000);
+    check(uwb_dl_check(&c) == UWB_DL_OK, "TX power 0 (lowest) accepted");
+    int each = 1;
+
+    for (int i = 0; i < 4; i++) {
+        c = tx_power(1, 0x10101010 + (1U << (8 * i)));
+        each &= (uwb_dl_check(&c) == UWB_DL_BAD_VALUE);
+    }
+    check(each, "TX power refused if any segment byte is above the cap");
+    c = tx_power(1, 0xFFFFFFFF);
+    check(uwb_dl_check(&c) == UWB_DL_BAD_VALUE, "TX power 0xFFFFFFFF refused");
+    c = tx_power(1, 0x10101010);
+    c.len = 3;
+    check(uwb_dl_check(&c) == UWB_DL_BAD_VALUE, "TX power with the wrong length refused");
+
+    int ok = 1;
+
+    for (uint8_t code = 0; code < 32; code++) {
+        const int valid = (code >= 3 && code <= 4) || (code >= 9 && code <= 12);
+
+        c = phy(1, 5, code);
+        ok &= (uwb_dl_check(&c) == (valid ? UWB_DL_OK : UWB_DL_BAD_VALUE));
+        c = phy(1, 9, code);
+        ok &= (uwb_dl_check(&c) == (valid ? UWB_DL_OK : UWB_DL_BAD_VALUE));
+    }
+    check(ok, "PHY: codes 3-4 and 9-12 only, on channel 5 and 9");
+    c = phy(1, 7, 9);
+    check(uwb_dl_check(&c) == UWB_DL_BAD_VALUE, "PHY on channel 7 refused");
+    c = cmd(1, UWB_DL_OP_PHY, 1, none);
+    check(uwb_dl_check(&c) == UWB_DL_BAD_VALUE, "PHY with the wrong length refused");
+
+    c = cmd(1, 0x7F, 1, none);
+    check(uwb_dl_check(&c) == UWB_DL_UNKNOWN, "unknown op");
+}
+
+static void check_repeats(void) {
+    struct uwb_dl_state st;
+    struct uwb_dl_cmd c;
+    uint8_t tail[UWB_DL_ACK_LEN];
+    int applied = 0;
+
+    uwb_dl_init(&st);
+    c = period(10, 500);
+    send(&st, &c);
+    boundary(&st, tail, &applied);
+
+    // The anchor missed the ack and resends: acked again, not applied again
+    send(&st, &c);
+    check(!st.pending && st.stats.repeats == 1, "repeat of the applied command not queued");
+    check(boundary(&st, tail, &applied) == UWB_DL_ACK_LEN && tail[1] == 10 &&
+              tail[2] == UWB_DL_OK && applied == 1,
+          "repeat acked again with the stored status, applied once");
+
+    // A refused command's repeat gets the same refusal
+    c = phy(11, 7, 9);
+    send(&st, &c);
+    boundary(&st, tail, &applied);
+    check(tail[1] == 11 && tail[2] == UWB_DL_BAD_VALUE && st.stats.rejected == 1,
+          "refused command acked with its status");
+    send(&st, &c);
+    boundary(&st, tail, &applied);
+    check(tail[2] == UWB_DL_BAD_VALUE && applied == 2, "its repeat gets the same status");
+
+    // Two commands within one cycle: the newer one wins
+    c = period(12, 200);
+    send(&st, &c);
+    c = period(13, 300);
+    send(&st, &c);
+    check(st.stats.replaced == 1, "newer command replaces a pending one");
+    boundary(&st, tail, &applied);
+    check(tail[1] == 13 && applied == 3, "only the newer command applied and acked");
+
+    // Sequence numbers wrap: 255 then 0 is a new command
+    uwb_dl_init(&st);
+    c = period(255, 100);
+    send(&st, &c);
+    boundary(&st, tail, &applied);
+    c = period(0, 150);
+    send(&st, &c);
+    check(st.pending, "seq 0 after 255 is a new command");
+}
+
+/* An anchor that resends each command until it sees the ack, over a link that
+ * loses `loss` of the frames either way */
+static void check_lossy_link(void) {
+    struct uwb_dl_state st;
+    unsigned seed = 1;
+    const double loss = 0.3;
+    int applied = 0;
+    int cmds = 0;
+    int sends = 0;
+    int acked_ok = 1;
+
+    uwb_dl_init(&st);
+    for (int k = 0; k < 500; k++) {
+        const uint8_t seq = (uint8_t)k;
+        const struct uwb_dl_cmd c = period(seq, (uint16_t)(100 + k));
+        int acked = 0;
+
+        cmds++;
+        for (int tries = 0; !acked && tries < 100; tries++) {
+            uint8_t tail[UWB_DL_ACK_LEN];
+            uint8_t aseq, astatus;
+
+            sends++;
+            if ((double)rand_r(&seed) / RAND_MAX >= loss) {
+                send(&st, &c);
+            }
+            const uint16_t n = boundary(&st, tail, &applied);
+
+            if (n && (double)rand_r(&seed) / RAND_MAX >= loss &&
+                uwb_dl_ack_get(tail, n, &aseq, &astatus) == 0 && aseq == seq) {
+                acked = 1;
+                acked_ok &= (astatus == UWB_DL_OK);
+            }
+        }
+        if (!acked) {
+            acked_ok = 0;
+        }
+    }
+    printf("     30%% loss each way: %d commands, %d sends, %u repeats, %d applied\n", cmds,
+           sends, st.stats.repeats, applied);
+    check(acked_ok, "every command acked OK");
+    check(applied == cmds && st.stats.applied == (uint32_t)cmds,
+          "every command applied exactly once");
+}
+
+int main(void) {
+    check_encoding();
+    check_values();
+    check_repeats();
+    check_lossy_link();
+
+    printf("%s (%d failed)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
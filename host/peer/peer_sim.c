@@ -0,0 +1,513 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uwb_peer_proto.h"
+
+/* Multi-tag simulation of peer mode (CONFIG_UWB_PEER): runs the firmware's
+ * schedule and neighbor code (src/uwb_peer_proto.c) for every tag against a
+ * simple shared channel, and reports discovery, window alignment, ranging
+ * rate, lost receptions and radio-on time.
+ *
+ * Tags start at random times with random window phases and +-20 ppm clocks.
+ * A transmission reaches every tag within --range-m that is listening (inside
+ * its window or scan and not transmitting) for its whole duration. Two
+ * overlapping transmissions that a receiver can both hear are both lost
+ * there. An exchange (POLL/RESP/FINAL/REPORT) succeeds if neither end loses
+ * any of it. Window moves, handover beacons and the period trim go through
+ * the same calls as in the firmware's radio thread.
+ */
+
+#define MAX_TAGS        256
+#define MAX_TX          4096
+
+static struct {
+    int tags;
+    double area_m;
+    double range_m;
+    double seconds;
+    int period_ms;
+    int slots;
+    int beacon_slots;
+    int slot_us;
+    int guard_us;
+    int beacon_periods;
+    int scan_periods;
+    int range_periods;
+    int timeout_ms;
+    unsigned seed;
+} opt = {
+    .tags = 40,
+    .area_m = 30,
+    .range_m = 60,
+    .seconds = 600,
+    .period_ms = 1000,
+    .slots = 8,
+    .beacon_slots = 8,
+    .slot_us = 6000,
+    .guard_us = 1000,
+    .beacon_periods = 10,
+    .scan_periods = 60,
+    .range_periods = 10,
+    .timeout_ms = 30000,
+    .seed = 1,
+};
+
+// On-air durations (us): beacon, and the four frames of an exchange with
+// 1.5 ms reply delays
+#define BEACON_US       250
+#define EXCHANGE_US     4500
+#define START_SPREAD_S  30.0
+#define FRESH_US        300e6
+
+struct tag {
+    struct uwb_peer_state st;
+    double x, y;
+    double ppm;
+    double start_us;        // power-on
+    double next_us;         // next window start (global time)
+    double win_start, win_end;  // current window (incl. scan)
+    double on_us;           // radio on
+    bool started;
+};
+
+struct tx {
+    int src;
+    int dst;                // -1 = beacon
+    double t0, t1;
+    uint16_t root;          // beacon
+    uint8_t hops;
+    double win_start;       // window the beacon's offset refers to
+    bool resolved;
+};
+
+static struct tag tags[MAX_TAGS];
+static struct tx txs[MAX_TX];
+static int n_tx;
+static double pair_ranged[MAX_TAGS][MAX_TAGS];  // last completed exchange (global us)
+
+static double uniform(void) {
+    return (rand_r(&opt.seed) + 0.5) / ((double)RAND_MAX + 1.0);
+}
+
+static bool in_range(int a, int b) {
+    return hypot(tags[a].x - tags[b].x, tags[a].y - tags[b].y) <= opt.range_m;
+}
+
+static uint32_t local_ms(const struct tag *t, double g_us) {
+    return (uint32_t)((g_us - t->start_us) * (1.0 + t->ppm * 1e-6) / 1000.0);
+}
+
+static double window_us(void) {
+    const struct uwb_peer_cfg cfg = {
+        .slots = (uint8_t)opt.slots,
+        .beacon_slots = (uint8_t)opt.beacon_slots,
+        .slot_us = (uint16_t)opt.slot_us,
+        .guard_us = (uint16_t)opt.guard_us,
+    };
+
+    return uwb_peer_window_us(&cfg);
+}
+
+// One period of the tag's (trimmed) timer in global time
+static double period_us(const struct tag *t) {
+    return uwb_peer_period_us(&t->st, (uint32_t)opt.period_ms * 1000U) / (1.0 + t->ppm * 1e-6);
+}
+
+/* Tag r listens for all of x: inside its window and not sending itself */
+static bool listening(int r, const struct tx *x) {
+    const double t0 = x->t0, t1 = x->t1;
+    const struct tag *t = &tags[r];
+
+    if (!t->started || t0 < t->win_start || t1 > t->win_end) {
+        return false;
+    }
+    for (int i = 0; i < n_tx; i++) {
+        const struct tx *o = &txs[i];
+
+        if (o != x && o->t0 < t1 && o->t1 > t0 && (o->src == r || o->dst == r)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Another transmission overlapping `x` that r can hear */
+static bool collided(int r, const struct tx *x) {
+    for (int i = 0; i < n_tx; i++) {
+        const struct tx *o = &txs[i];
+
+        if (o == x || o->t0 >= x->t1 || o->t1 <= x->t0) {
+            continue;
+        }
+        if (o->src != r && in_range(o->src, r)) {
+            return true;
+        }
+        // The other end of an exchange transmits too
+        if (o->dst >= 0 && o->dst != r && in_range(o->dst, r)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void add_tx(int src, int dst, double t0, double len_us, double win_start) {
+    struct tx *x;
+
+    if (n_tx >= MAX_TX) {
+        return;
+    }
+    x = &txs[n_tx++];
+    memset(x, 0, sizeof(*x));
+    x->src = src;
+    x->dst = dst;
+    x->t0 = t0;
+    x->t1 = t0 + len_us;
+    x->root = tags[src].st.root;
+    x->hops = tags[src].st.hops;
+    x->win_start = win_start;
+}
+
+/* Move tag i's next window by `shift` from where the current one puts it
+ * (a later follow in the same window replaces an earlier one). After a real
+ * move, its pending handover beacon goes out in the old window first. */
+static void handover(int i, int32_t shift) {
+    struct tag *t = &tags[i];
+    struct uwb_peer_plan plan;
+    const double old_us = t->win_start + period_us(t);
+
+    t->next_us = old_us + shift;
+    uwb_peer_shifted(&t->st, local_ms(t, t->win_start), shift);
+    if (!uwb_peer_handover(&t->st, &plan) || abs(shift) <= opt.guard_us) {
+        return;
+    }
+    if (shift < 0) {
+        t->next_us += period_us(t);     // the old window comes first
+    }
+    // Offset into the new window
+    add_tx(i, -1, old_us + plan.beacon_at_us, BEACON_US, t->next_us);
+}
+
+static struct {
+    uint64_t exchanges, exchanges_ok, beacons, beacons_heard, lost_rx;
+} sim;
+
+static void resolve(struct tx *x) {
+    struct tag *s = &tags[x->src];
+
+    x->resolved = true;
+    if (x->dst < 0) {
+        sim.beacons++;
+        for (int r = 0; r < opt.tags; r++) {
+            if (r == x->src || !in_range(r, x->src)) {
+                continue;
+            }
+            // Beacon from before the receiver's window: skip quietly
+            if (!tags[r].started || x->t0 < tags[r].win_start || x->t1 > tags[r].win_end) {
+                continue;
+            }
+            if (collided(r, x) || !listening(r, x)) {
+                sim.lost_rx++;
+                continue;
+            }
+            struct tag *t = &tags[r];
+
+            sim.beacons_heard++;
+            if (uwb_peer_heard(&t->st, local_ms(t, x->t1), s->st.cfg.self, x->root, x->hops)) {
+                // As in the firmware: the sender's window start vs ours
+                const int32_t shift = uwb_peer_phase_shift(
+                    (int64_t)(x->win_start - t->win_start), (uint32_t)period_us(t));
+
+                handover(r, shift);
+            }
+        }
+        return;
+    }
+
+    // Third parties overhear the exchange: refreshes both ends as neighbors
+    for (int r = 0; r < opt.tags; r++) {
+        if (r == x->src || r == x->dst || !listening(r, x) || collided(r, x)) {
+            continue;
+        }
+        const uint32_t now_ms = local_ms(&tags[r], x->t1);
+
+        if (in_range(r, x->src)) {
+            uwb_peer_heard(&tags[r].st, now_ms, s->st.cfg.self, 0, 0);
+        }
+        if (in_range(r, x->dst)) {
+            uwb_peer_heard(&tags[r].st, now_ms, tags[x->dst].st.cfg.self, 0, 0);
+        }
+    }
+
+    struct tag *d = &tags[x->dst];
+    const bool ok = in_range(x->src, x->dst) && listening(x->dst, x) &&
+                    !collided(x->dst, x) && !collided(x->src, x);
+    sim.exchanges++;
+    if (!ok) {
+        sim.lost_rx += in_range(x->src, x->dst) && d->started;
+        uwb_peer_ranged(&s->st, d->st.cfg.self, true, 0);
+        return;
+    }
+    sim.exchanges_ok++;
+    pair_ranged[x->src][x->dst] = pair_ranged[x->dst][x->src] = x->t1;
+
+    const uint32_t mm = (uint32_t)(1000.0 * hypot(s->x - d->x, s->y - d->y)) + 1;
+
+    uwb_peer_heard(&d->st, local_ms(d, x->t1), s->st.cfg.self, 0, 0);
+    uwb_peer_heard(&s->st, local_ms(s, x->t1), d->st.cfg.self, 0, 0);
+    uwb_peer_ranged(&d->st, s->st.cfg.self, false, mm);
+    uwb_peer_ranged(&s->st, d->st.cfg.self, true, mm);
+}
+
+static void compact(double now) {
+    int w = 0;
+
+    for (int i = 0; i < n_tx; i++) {
+        // Kept while it can still overlap a transmission not resolved yet
+        if (!txs[i].resolved || txs[i].t1 > now - 2.0 * opt.period_ms * 1000.0) {
+            txs[w++] = txs[i];
+        }
+    }
+    n_tx = w;
+}
+
+static void start_window(int i, double now) {
+    struct tag *t = &tags[i];
+    struct uwb_peer_plan plan;
+
+    uwb_peer_plan(&t->st, local_ms(t, now), &plan);
+    t->win_start = now;
+    t->win_end = now + (plan.scan ? period_us(t) - opt.guard_us : window_us());
+    t->on_us += t->win_end - t->win_start;
+    t->next_us = now + period_us(t);
+
+    if (plan.beacon) {
+        add_tx(i, -1, now + plan.beacon_at_us, BEACON_US, now);
+    }
+    if (plan.poll) {
+        for (int j = 0; j < opt.tags; j++) {
+            if (tags[j].st.cfg.self == plan.peer) {
+                add_tx(i, j, now + plan.poll_at_us, EXCHANGE_US, now);
+            }
+        }
+    }
+}
+
+struct report {
+    int roots;              // distinct roots
+    double nbr_avg;
+    double pairs_fresh;     // in-range pairs ranged within FRESH_US
+    double spread_us;       // worst window offset from the lowest address tag's
+};
+
+static int count_roots(void) {
+    uint16_t roots[MAX_TAGS];
+    int n = 0;
+
+    for (int i = 0; i < opt.tags; i++) {
+        bool seen = false;
+
+        for (int k = 0; k < n; k++) {
+            seen |= roots[k] == tags[i].st.root;
+        }
+        if (!seen) {
+            roots[n++] = tags[i].st.root;
+        }
+    }
+    return n;
+}
+
+static void snapshot(struct report *r, double now) {
+    int nbr_sum = 0;
+    int pairs = 0, fresh = 0;
+    int low = 0;
+
+    for (int i = 0; i < opt.tags; i++) {
+        nbr_sum += uwb_peer_count(&tags[i].st);
+        low = (tags[i].st.cfg.self < tags[low].st.cfg.self) ? i : low;
+        for (int j = i + 1; j < opt.tags; j++) {
+            if (in_range(i, j)) {
+                pairs++;
+                fresh += pair_ranged[i][j] > 0 && now - pair_ranged[i][j] <= FRESH_US;
+            }
+        }
+    }
+    r->roots = count_roots();
+    r->nbr_avg = (double)nbr_sum / opt.tags;
+    r->pairs_fresh = pairs ? (double)fresh / pairs : 1.0;
+    r->spread_us = 0;
+    for (int i = 0; i < opt.tags; i++) {
+        const double p = opt.period_ms * 1000.0;
+        const double d = fabs(fmod(tags[i].next_us - tags[low].next_us + 100.5 * p, p) - 0.5 * p);
+
+        if (tags[i].st.root == tags[low].st.root && d > r->spread_us) {
+            r->spread_us = d;
+        }
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: peer_sim [--tags N] [--area-m M] [--range-m M] [--seconds S]\n"
+            "                [--period-ms MS] [--slots N] [--beacon-slots N] [--slot-us US]\n"
+            "                [--range-periods N] [--beacon-periods N] [--scan-periods N]\n"
+            "                [--seed N]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        const char *v = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (!v) {
+            usage();
+        }
+        if (!strcmp(a, "--tags")) opt.tags = atoi(v);
+        else if (!strcmp(a, "--area-m")) opt.area_m = atof(v);
+        else if (!strcmp(a, "--range-m")) opt.range_m = atof(v);
+        else if (!strcmp(a, "--seconds")) opt.seconds = atof(v);
+        else if (!strcmp(a, "--period-ms")) opt.period_ms = atoi(v);
+        else if (!strcmp(a, "--slots")) opt.slots = atoi(v);
+        else if (!strcmp(a, "--beacon-slots")) opt.beacon_slots = atoi(v);
+        else if (!strcmp(a, "--slot-us")) opt.slot_us = atoi(v);
+        else if (!strcmp(a, "--range-periods")) opt.range_periods = atoi(v);
+        else if (!strcmp(a, "--beacon-periods")) opt.beacon_periods = atoi(v);
+        else if (!strcmp(a, "--scan-periods")) opt.scan_periods = atoi(v);
+        else if (!strcmp(a, "--seed")) opt.seed = (unsigned)atoi(v);
+        else usage();
+        i++;
+    }
+    if (opt.tags < 2 || opt.tags > MAX_TAGS || opt.slots < 1 || opt.slots > 255 ||
+        opt.beacon_slots < 1 || opt.beacon_slots > 255 ||
+        window_us() >= opt.period_ms * 1000.0 * 0.9) {
+        usage();
+    }
+
+    for (int i = 0; i < opt.tags; i++) {
+        struct tag *t = &tags[i];
+        const struct uwb_peer_cfg cfg = {
+            .self = (uint16_t)(0x8000 | (rand_r(&opt.seed) & 0x7FFF)),
+            .slots = (uint8_t)opt.slots,
+            .beacon_slots = (uint8_t)opt.beacon_slots,
+            .slot_us = (uint16_t)opt.slot_us,
+            .guard_us = (uint16_t)opt.guard_us,
+            .beacon_periods = (uint16_t)opt.beacon_periods,
+            .scan_periods = (uint16_t)opt.scan_periods,
+            .range_periods = (uint16_t)opt.range_periods,
+            .timeout_ms = (uint32_t)opt.timeout_ms,
+        };
+
+        uwb_peer_init(&t->st, &cfg, (uint32_t)rand_r(&opt.seed));
+        t->x = uniform() * opt.area_m;
+        t->y = uniform() * opt.area_m;
+        t->ppm = (uniform() * 2.0 - 1.0) * 20.0;
+        t->start_us = uniform() * START_SPREAD_S * 1e6;
+        t->next_us = t->start_us;
+        t->win_start = t->win_end = -1.0;
+    }
+    // Unique addresses
+    for (int i = 0; i < opt.tags; i++) {
+        for (int j = 0; j < i; j++) {
+            if (tags[j].st.cfg.self == tags[i].st.cfg.self) {
+                tags[i].st.cfg.self++;
+                tags[i].st.root = tags[i].st.cfg.self;
+                j = -1;
+            }
+        }
+    }
+
+    printf("%d tags in %.0f x %.0f m, range %.0f m, period %d ms, window %.1f ms "
+           "(%d slots of %d us), start within %.0f s\n",
+           opt.tags, opt.area_m, opt.area_m, opt.range_m, opt.period_ms, window_us() / 1000.0,
+           opt.slots, opt.slot_us, START_SPREAD_S);
+    printf("%8s %6s %8s %10s %10s %10s %12s\n", "time_s", "roots", "nbr_avg", "spread_us",
+           "pairs_5min", "xchg/s", "lost_rx");
+
+    const double end_us = opt.seconds * 1e6;
+    double next_report = 60e6;
+    uint64_t last_ok = 0;
+    double split_us = 0;    // last time more than one root was seen
+    struct report rep = { 0 };
+
+    while (1) {
+        // Next event: a window start, or the end of a pending transmission
+        int who = -1;
+        double t_win = end_us;
+        for (int i = 0; i < opt.tags; i++) {
+            if (tags[i].next_us < t_win) {
+                t_win = tags[i].next_us;
+                who = i;
+            }
+        }
+        struct tx *due = NULL;
+        for (int i = 0; i < n_tx; i++) {
+            if (!txs[i].resolved && txs[i].t1 <= t_win && (!due || txs[i].t1 < due->t1)) {
+                due = &txs[i];
+            }
+        }
+        const double now = due ? due->t1 : t_win;
+
+        while (now >= next_report && next_report <= end_us) {
+            snapshot(&rep, next_report);
+            printf("%8.0f %6d %8.1f %10.0f %9.1f%% %10.1f %12llu\n", next_report / 1e6, rep.roots,
+                   rep.nbr_avg, rep.spread_us, 100.0 * rep.pairs_fresh,
+                   (sim.exchanges_ok - last_ok) / 60.0, (unsigned long long)sim.lost_rx);
+            last_ok = sim.exchanges_ok;
+            next_report += 60e6;
+        }
+        if (now >= end_us) {
+            break;
+        }
+        if (due) {
+            resolve(due);
+            continue;
+        }
+        tags[who].started = true;
+        start_window(who, now);
+        compact(now);
+        if (count_roots() > 1) {
+            split_us = now;
+        }
+    }
+
+    double on = 0, life = 0;
+    struct uwb_peer_stats tot = { 0 };
+    for (int i = 0; i < opt.tags; i++) {
+        const struct uwb_peer_stats *s = &tags[i].st.stats;
+
+        on += tags[i].on_us;
+        life += end_us - tags[i].start_us;
+        tot.scans += s->scans;
+        tot.root_changes += s->root_changes;
+        tot.table_full += s->table_full;
+    }
+    snapshot(&rep, end_us);
+
+    const double done = sim.exchanges ? (double)sim.exchanges_ok / sim.exchanges : 0.0;
+
+    printf("exchanges: %llu started, %llu completed (%.0f%%), %.2f per tag per second\n",
+           (unsigned long long)sim.exchanges, (unsigned long long)sim.exchanges_ok,
+           100.0 * done, sim.exchanges_ok * 2.0 / (life / 1e6));
+    printf("beacons: %llu sent, %llu receptions; root changes %u, "
+           "senders ignored (table full) %u\n",
+           (unsigned long long)sim.beacons, (unsigned long long)sim.beacons_heard,
+           tot.root_changes, tot.table_full);
+    printf("radio on: %.2f%% of the time (window %.2f%%, scans %u)\n", 100.0 * on / life,
+           100.0 * window_us() / (opt.period_ms * 1000.0), tot.scans);
+    if (rep.roots == 1) {
+        printf("windows on one root since %.0f s, within %.0f us\n", split_us / 1e6,
+               rep.spread_us);
+    } else {
+        printf("windows on %d roots at the end\n", rep.roots);
+    }
+
+    // Everybody in range of everybody: expect one root well before the end,
+    // windows within the guard time and exchanges completing near the
+    // slotted-ALOHA rate
+    const bool dense = opt.range_m >= opt.area_m * 1.5;
+    const bool pass = !dense || (rep.roots == 1 && split_us < end_us / 2 &&
+                                 rep.spread_us < opt.guard_us && done >= 0.2);
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <string.h>
+#include "uwb_phy_scan.h"
+
+/* Scripted checks of the channel / preamble code discovery scan
+ * (CONFIG_UWB_PHY_SCAN, src/uwb_phy_scan.c): probe order, early lock,
+ * probes per cycle, exponential backoff of empty sweeps and rescanning after
+ * a lost lock. Cycles are driven the way the radio thread drives them: up to
+ * per_cycle probes while unlocked, uwb_phy_scan_cycle() while locked. Prints
+ * one line per check, then PASS/FAIL. */
+
+#define CH5_CH9         ((1U << 5) | (1U << 9))
+#define CODES_9_12      ((1UL << 9) | (1UL << 10) | (1UL << 11) | (1UL << 12))
+
+static int failures;
+
+static void check(int ok, const char *what) {
+    printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+    failures += !ok;
+}
+
+static void setup(struct uwb_phy_scan *st, uint8_t per_cycle, uint8_t chan, uint8_t code) {
+    const struct uwb_phy_scan_cfg cfg = {
+        .chan_mask = CH5_CH9,
+        .code_mask = CODES_9_12,
+        .per_cycle = per_cycle,
+        .lost_cycles = 20,
+        .backoff = 2,
+        .backoff_max = 60,
+    };
+    const struct uwb_phy home = { chan, code };
+
+    uwb_phy_scan_init(st, &cfg, &home);
+}
+
+static int same(const struct uwb_phy *a, uint8_t chan, uint8_t code) {
+    return a->chan == chan && a->code == code;
+}
+
+/* One unlocked cycle with the network on `net` (chan 0 = nowhere). Returns
+ * the probes sent; `log` collects them. */
+static int cycle(struct uwb_phy_scan *st, const struct uwb_phy *net, struct uwb_phy *log, int *n_log) {
+    struct uwb_phy phy;
+    int probes = 0;
+
+    for (int i = 0; i < st->cfg.per_cycle && uwb_phy_scan_next(st, &phy); i++) {
+        probes++;
+        if (log) {
+            log[(*n_log)++] = phy;
+        }
+        if (net->chan && same(&phy, net->chan, net->code)) {
+            uwb_phy_scan_found(st, &phy);
+            break;
+        }
+    }
+    return probes;
+}
+
+static void check_order(void) {
+    static const struct uwb_phy want[] = {
+        { 5, 9 }, { 5, 10 }, { 5, 11 }, { 5, 12 }, { 9, 9 }, { 9, 10 }, { 9, 11 }, { 9, 12 },
+    };
+    static const struct uwb_phy want_c9[] = {
+        { 9, 11 }, { 9, 9 }, { 9, 10 }, { 9, 12 }, { 5, 9 }, { 5, 10 }, { 5, 11 }, { 5, 12 },
+    };
+    const struct uwb_phy none = { 0, 0 };
+    struct uwb_phy seen[32];
+    struct uwb_phy_scan st;
+    int n = 0;
+
+    setup(&st, 16, 5, 9);
+    cycle(&st, &none, seen, &n);
+    check(n == 8 && memcmp(seen, want, sizeof(want)) == 0,
+          "order: home, its channel's other codes, then the other channel");
+
+    setup(&st, 16, 9, 11);
+    n = 0;
+    cycle(&st, &none, seen, &n);
+    check(n == 8 && memcmp(seen, want_c9, sizeof(want_c9)) == 0,
+          "order follows the home PHY (channel 9, code 11)");
+
+    // A home PHY outside the masks is still probed first, and only once
+    setup(&st, 16, 5, 3);
+    n = 0;
+    cycle(&st, &none, seen, &n);
+    check(n == 9 && same(&seen[0], 5, 3) && same(&seen[1], 5, 9),
+          "home outside the masks probed first");
+}
+
+static void check_lock(void) {
+    struct uwb_phy_scan st;
+    struct uwb_phy net = { 5, 9 };
+
+    setup(&st, 8, 5, 9);
+    check(cycle(&st, &net, NULL, NULL) == 1 && st.locked && same(&st.home, 5, 9) &&
+              st.stats.lock_probes == 1,
+          "known site: locked on the first probe");
+
+    net = (struct uwb_phy){ 9, 11 };
+    setup(&st, 8, 5, 9);
+    check(cycle(&st, &net, NULL, NULL) == 7 && st.locked && same(&st.home, 9, 11),
+          "network on channel 9 code 11: locked in the first cycle, probe 7");
+
+    // Fewer probes per cycle: the sweep carries on where it stopped
+    net = (struct uwb_phy){ 9, 12 };
+    setup(&st, 3, 5, 9);
+    const int p1 = cycle(&st, &net, NULL, NULL);
+    const int p2 = cycle(&st, &net, NULL, NULL);
+    const int p3 = cycle(&st, &net, NULL, NULL);
+
+    check(p1 == 3 && p2 == 3 && p3 == 2 && st.locked && st.stats.lock_probes == 8,
+          "3 probes per cycle: locked on probe 8 in the third cycle");
+    check(cycle(&st, &net, NULL, NULL) == 0, "no probes once locked");
+}
+
+static void check_backoff(void) {
+    struct uwb_phy_scan st;
+    const struct uwb_phy none = { 0, 0 };
+    int want = 2;
+    int doubling = 1;
+
+    setup(&st, 8, 5, 9);
+    // One sweep per loop: a cycle of 8 probes, a cycle that finds the sweep
+    // empty and starts the backoff, then the idle cycles
+    for (int sweep = 0; sweep < 10; sweep++) {
+        doubling &= (cycle(&st, &none, NULL, NULL) == 8);
+        doubling &= (cycle(&st, &none, NULL, NULL) == 0 && st.stats.sweeps == (uint32_t)sweep + 1);
+
+        const uint32_t idle_before = st.stats.idle;
+
+        while (st.idle > 0) {
+            cycle(&st, &none, NULL, NULL);
+        }
+        doubling &= ((int)(st.stats.idle - idle_before) == want);
+        want = (want * 2 > 60) ? 60 : want * 2;
+    }
+    check(doubling, "empty sweeps back off 2, 4, 8 .. up to 60 idle cycles");
+    check(st.stats.sweeps == 10 && st.stats.probes == 80, "every sweep probes all 8 PHYs");
+
+    // One hour out of coverage at 1 s: about one sweep a minute once backed off
+    setup(&st, 8, 5, 9);
+    for (int c = 0; c < 3600; c++) {
+        cycle(&st, &none, NULL, NULL);
+    }
+    printf("     1 h out of coverage: %u sweeps, %u probes, %u idle cycles\n", st.stats.sweeps,
+           st.stats.probes, st.stats.idle);
+    check(st.stats.sweeps >= 55 && st.stats.sweeps <= 65, "out of coverage: ~1 sweep a minute");
+
+    // A lock ends the backoff, and the next loss starts it from the beginning
+    const struct uwb_phy net = { 9, 10 };
+    int c = 0;
+
+    while (!st.locked && c++ < 200) {
+        cycle(&st, &net, NULL, NULL);
+    }
+    check(st.locked && same(&st.home, 9, 10), "network appears: locked within a backoff period");
+    for (int i = 0; i < 20; i++) {
+        uwb_phy_scan_cycle(&st, false);
+    }
+    check(!st.locked && st.backoff == 2 && st.idle == 0, "backoff reset after a lost lock");
+}
+
+static void check_lost(void) {
+    struct uwb_phy_scan st;
+    struct uwb_phy seen[32];
+    struct uwb_phy net = { 9, 11 };
+    int n = 0;
+    int lost_at = -1;
+
+    setup(&st, 8, 5, 9);
+    cycle(&st, &net, NULL, NULL);
+
+    for (int i = 0; i < 19; i++) {
+        uwb_phy_scan_cycle(&st, false);
+    }
+    uwb_phy_scan_cycle(&st, true);
+    for (int i = 0; i < 19; i++) {
+        uwb_phy_scan_cycle(&st, false);
+    }
+    check(st.locked, "an answer resets the miss count");
+    for (int i = 0; i < 20 && lost_at < 0; i++) {
+        if (uwb_phy_scan_cycle(&st, false)) {
+            lost_at = i;
+        }
+    }
+    check(lost_at == 0 && !st.locked && st.stats.losses == 1,
+          "lock lost after lost_cycles cycles in a row without an anchor");
+
+    // The network moved to channel 5 code 12: the rescan starts from the PHY just lost
+    net = (struct uwb_phy){ 5, 12 };
+    cycle(&st, &net, seen, &n);
+    check(n == 8 && same(&seen[0], 9, 11) && same(&seen[1], 9, 9) && same(&seen[4], 5, 9) &&
+              st.locked && same(&st.home, 5, 12),
+          "rescan from the lost PHY finds the network on its new PHY");
+
+    // A PHY set from outside (downlink command) becomes the new home
+    const struct uwb_phy dl = { 9, 9 };
+
+    uwb_phy_scan_found(&st, &dl);
+    for (int i = 0; i < 20; i++) {
+        uwb_phy_scan_cycle(&st, false);
+    }
+    n = 0;
+    net = (struct uwb_phy){ 5, 12 };
+    cycle(&st, &net, seen, &n);
+    check(same(&seen[0], 9, 9) && st.locked && same(&st.home, 5, 12),
+          "after a downlink PHY change with no anchor, the rescan finds the old network");
+}
+
+int main(void) {
+    check_order();
+    check_lock();
+    check_backoff();
+    check_lost();
+
+    printf("%s (%d failed)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,272 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "uwb_frame.h"
+#include "uwb_rangelog_proto.h"
+#include "uwb_twr_est.h"
+
+/* Decoder and benchmark for the tag's flash range log (CONFIG_UWB_RANGELOG).
+ *
+ *   rangelog_dump <file.log> [--csv]         file from "uci_tool <port> log-read"
+ *   rangelog_dump --bench [rate_hz] [log_kB] [block_bytes]
+ *
+ * The file is len(2) + block per stored block, oldest first. Records go to
+ * stdout with the alpha-beta filter of the range stream re-run over them
+ * (uwb_twr_est.c); a block starting at a lower uptime than the previous one
+ * ended is a reboot and restarts the filter.
+ *
+ * --bench encodes a simulated day of walking-speed ranging with the
+ * firmware's coder and checks that it decodes back. It reports bytes per
+ * record and the resulting flash budget on the nRF52833: how long the log
+ * holds, sector erases per day against the 10k-cycle endurance, and how long
+ * the CPU is stalled by flash writes and erases (NVMC timings from the
+ * datasheet), which also bounds the sustained logging rate.
+ */
+
+// nRF52833 NVMC, datasheet maxima
+#define NVMC_WORD_US            41.0
+#define NVMC_ERASE_US           85000.0
+#define NVMC_ENDURANCE          10000.0
+#define SECTOR_BYTES            4096
+// FCB: sector header, then per entry a 1-2 byte length and a CRC-8, each
+// entry padded to the 4-byte write alignment
+#define FCB_SECTOR_HDR          12
+#define FCB_ENTRY_OVERHEAD      8
+
+static int dump(const char *path, int csv) {
+    static uint8_t blk[UINT16_MAX];
+    static struct uwb_stream_rec recs[UINT16_MAX];
+    struct uwb_range_filter filter;
+    FILE *f = fopen(path, "rb");
+    uint8_t len[2];
+    uint32_t blocks = 0, records = 0, lost = 0, bad = 0, boots = 1, bytes = 0;
+    uint32_t t_end = 0;
+
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    uwb_range_filter_init(&filter);
+    if (csv) {
+        printf("boot,t_ms,anchor,status,dist_mm,filt_mm,vel_cm_s,quality,flags\n");
+    }
+    while (fread(len, 2, 1, f) == 1) {
+        const uint16_t n = uwb_get_u16(len);
+        uint32_t t0;
+        uint16_t blk_lost;
+
+        if (fread(blk, n, 1, f) != 1) {
+            bad++;
+            break;
+        }
+        const int nr = uwb_rangelog_block_parse(blk, n, &t0, &blk_lost, recs, UINT16_MAX);
+
+        bytes += n;
+        if (nr < 0) {
+            bad++;
+            continue;
+        }
+        if (blocks && t0 < t_end) {
+            boots++;
+            uwb_range_filter_init(&filter);
+        }
+        blocks++;
+        lost += blk_lost;
+        for (int i = 0; i < nr; i++) {
+            const struct uwb_stream_rec *r = &recs[i];
+            uint32_t filt = 0;
+            int16_t vel = 0;
+
+            (void)uwb_range_filter_update(&filter, r->anchor, r->t_ms, r->status == 0 && r->dist_mm > 0,
+                                          r->dist_mm, &filt, &vel);
+            if (csv) {
+                printf("%u,%u,0x%04x,%d,%u,%u,%d,%u,%u\n", boots, r->t_ms, r->anchor, r->status,
+                       r->dist_mm, filt, vel, r->quality, r->flags);
+            } else {
+                printf("boot %u %10u ms anchor 0x%04x st %2d %7u mm filt %7u mm %5d cm/s q %3u\n",
+                       boots, r->t_ms, r->anchor, r->status, r->dist_mm, filt, vel, r->quality);
+            }
+            t_end = r->t_ms;
+        }
+        records += (uint32_t)nr;
+    }
+    fclose(f);
+    fprintf(stderr, "%u records in %u blocks (%.1f B/record), %u boots, %u not logged on the tag, "
+                    "%u bad blocks\n",
+            records, blocks, records ? (double)bytes / records : 0.0, boots, lost, bad);
+    return bad ? 1 : 0;
+}
+
+// ================= Benchmark =================
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double gauss(void) {
+    const double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+    const double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/* A day at rate_hz: the tag walks around a 30 x 20 m site with 6 anchors and
+ * ranges to the nearest 4 in turn; 3 cm noise, 4% failed exchanges. */
+static uint32_t simulate(struct uwb_stream_rec *out, uint32_t n, double rate_hz) {
+    static const double ax[6] = { 0, 15, 30, 30, 15, 0 };
+    static const double ay[6] = { 0, 0, 0, 20, 20, 20 };
+    double x = 10, y = 10, hx = 1, hy = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        const double t_s = i / rate_hz;
+        int near[6] = { 0, 1, 2, 3, 4, 5 };
+        double d[6];
+
+        // Walk at 1.2 m/s, turning slowly, bouncing off the walls
+        const double turn = 0.3 * gauss() / rate_hz;
+        const double c = cos(turn), s = sin(turn);
+        const double nhx = hx * c - hy * s;
+
+        hy = hx * s + hy * c;
+        hx = nhx;
+        x += 1.2 * hx / rate_hz;
+        y += 1.2 * hy / rate_hz;
+        if (x < 1 || x > 29) {
+            hx = -hx;
+        }
+        if (y < 1 || y > 19) {
+            hy = -hy;
+        }
+        for (int a = 0; a < 6; a++) {
+            d[a] = hypot(x - ax[a], y - ay[a]);
+        }
+        for (int a = 1; a < 6; a++) {
+            for (int b = a; b > 0 && d[near[b]] < d[near[b - 1]]; b--) {
+                const int tmp = near[b];
+
+                near[b] = near[b - 1];
+                near[b - 1] = tmp;
+            }
+        }
+        const int a = near[i % 4];
+        const int fail = rand() % 100 < 4;
+        const int no_resp = fail && rand() % 2;
+        const double mm = d[a] * 1000 + 30 * gauss();
+
+        // UWB_RANGE_ERR_RESP (nobody answered) or UWB_RANGE_ERR_FINAL
+        out[i] = (struct uwb_stream_rec){
+            .t_ms = 1000 + (uint32_t)llround(t_s * 1000),
+            .anchor = no_resp ? 0 : (uint16_t)(0x0010 + a),
+            .status = fail ? (no_resp ? -2 : -3) : 0,
+            .quality = fail ? 0 : (rand() % 10 ? 100 : 70),
+            .flags = fail ? 0 : UWB_STREAM_FLAG_REPORT,
+            .dist_mm = fail ? 0 : (uint32_t)(mm > 0 ? mm : 0),
+        };
+    }
+    return n;
+}
+
+static int bench(double rate_hz, uint32_t log_kb, uint16_t block_size) {
+    const uint32_t n = (uint32_t)(rate_hz * 86400);
+    struct uwb_stream_rec *recs = malloc(n * sizeof(*recs));
+    struct uwb_stream_rec *back = malloc(n * sizeof(*recs));
+    uint8_t *blocks = malloc((size_t)n * 6 + 65536);
+    uint32_t *block_off = malloc((n / 8 + 16) * sizeof(uint32_t));
+    struct uwb_rangelog_enc enc;
+    uint32_t nblocks = 0;
+    size_t total = 0;
+
+    if (!recs || !back || !blocks || !block_off || block_size < UWB_RANGELOG_HDR_LEN + UWB_RANGELOG_REC_MAX) {
+        fprintf(stderr, "bad parameters or out of memory\n");
+        return 2;
+    }
+    srand(3);
+    simulate(recs, n, rate_hz);
+
+    // Encode, as uwb_rangelog_report() does, one block after the other
+    const double t0 = now_s();
+
+    block_off[0] = 0;
+    uwb_rangelog_enc_start(&enc, blocks, block_size, recs[0].t_ms, 0);
+    for (uint32_t i = 0; i < n; i++) {
+        if (!uwb_rangelog_enc_add(&enc, &recs[i])) {
+            total += uwb_rangelog_enc_finish(&enc);
+            block_off[++nblocks] = (uint32_t)total;
+            uwb_rangelog_enc_start(&enc, &blocks[total], block_size, recs[i].t_ms, 0);
+            uwb_rangelog_enc_add(&enc, &recs[i]);
+        }
+    }
+    total += uwb_rangelog_enc_finish(&enc);
+    block_off[++nblocks] = (uint32_t)total;
+    const double enc_s = now_s() - t0;
+
+    // Decode and compare
+    const double t1 = now_s();
+    uint32_t got = 0;
+    int ok = 1;
+
+    for (uint32_t b = 0; b < nblocks && ok; b++) {
+        uint32_t bt0;
+        uint16_t lost;
+        const int nr = uwb_rangelog_block_parse(&blocks[block_off[b]], block_off[b + 1] - block_off[b],
+                                                &bt0, &lost, &back[got], (int)(n - got));
+
+        ok = nr > 0;
+        got += nr > 0 ? (uint32_t)nr : 0;
+    }
+    const double dec_s = now_s() - t1;
+
+    for (uint32_t i = 0; i < n && ok; i++) {
+        ok = got == n && back[i].t_ms == recs[i].t_ms && back[i].anchor == recs[i].anchor &&
+             back[i].status == recs[i].status && back[i].dist_mm == recs[i].dist_mm &&
+             back[i].quality == recs[i].quality && back[i].flags == recs[i].flags;
+    }
+
+    // Flash budget per day
+    const double per_rec = (double)total / n;
+    const double flash_day = total + (double)nblocks * FCB_ENTRY_OVERHEAD;
+    const uint32_t sectors = log_kb * 1024 / SECTOR_BYTES;
+    const double sector_use = SECTOR_BYTES - FCB_SECTOR_HDR;
+    const double erases_day = flash_day / sector_use;
+    const double cycles_day = sectors ? erases_day / sectors : 0;
+    const double hold_h = sectors > 1 ? (sectors - 1) * sector_use / flash_day * 24 : 0;
+    const double stall_s = (flash_day / 4 * NVMC_WORD_US + erases_day * NVMC_ERASE_US) / 1e6;
+    const double stall_rec_us = stall_s * 1e6 / n;
+
+    printf("%u records/day at %.1f Hz, %u-byte blocks: %.2f B/record (stream record %d B, %.1fx)\n",
+           n, rate_hz, block_size, per_rec, UWB_STREAM_REC_LEN, UWB_STREAM_REC_LEN / per_rec);
+    printf("  %.0f kB/day in %u blocks; %u kB log = %u sectors holds %.1f h\n", flash_day / 1024,
+           nblocks, log_kb, sectors, hold_h);
+    printf("  wear: %.1f sector erases/day, %.2f cycles/sector/day -> %.1f years to %.0fk cycles "
+           "(5 years need a %.0f kB log)\n",
+           erases_day, cycles_day, cycles_day > 0 ? NVMC_ENDURANCE / cycles_day / 365 : INFINITY,
+           NVMC_ENDURANCE / 1000, ceil(erases_day * 365 * 5 / NVMC_ENDURANCE) * SECTOR_BYTES / 1024);
+    printf("  CPU stalled by flash: %.1f s/day (%.4f%%), %.0f us per record -> flash-bound "
+           "logging limit %.0f records/s\n",
+           stall_s, stall_s / 864, stall_rec_us, 1e6 / stall_rec_us);
+    printf("  host coder: encode %.1fM records/s, decode %.1fM records/s\n", n / enc_s / 1e6,
+           n / dec_s / 1e6);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    free(recs);
+    free(back);
+    free(blocks);
+    free(block_off);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+        return bench(argc > 2 ? atof(argv[2]) : 10.0, argc > 3 ? (uint32_t)atoi(argv[3]) : 32,
+                     argc > 4 ? (uint16_t)atoi(argv[4]) : 1024);
+    }
+    if (argc < 2 || argv[1][0] == '-') {
+        fprintf(stderr, "usage: rangelog_dump <file.log> [--csv]\n"
+                        "       rangelog_dump --bench [rate_hz] [log_kB] [block_bytes]\n");
+        return 2;
+    }
+    return dump(argv[1], argc > 2 && strcmp(argv[2], "--csv") == 0);
+}
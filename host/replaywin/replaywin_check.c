@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <string.h>
+#include "uwb_replay_window.h"
+#include "uwb_peer_proto.h"
+
+/* Scripted checks of the per-sender replay window (src/uwb_replay_window.h) that
+ * the tag applies to RESP sequence numbers. Covers duplicates, out-of-order
+ * numbers inside the window, and senders whose numbers jump by more than the
+ * window between two frames we accept. Prints one line per check, then
+ * PASS/FAIL. */
+
+#define MAX_AGE_MS      1000
+#define TABLE           4
+
+static int failures;
+
+static void check(int ok, const char *what) {
+    printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+    failures += !ok;
+}
+
+static struct uwb_replay_entry tab[UWB_PEER_NEIGHBORS];
+
+static struct uwb_replay table(uint16_t n) {
+    struct uwb_replay r = { tab, n, MAX_AGE_MS };
+
+    uwb_replay_reset(&r);
+    return r;
+}
+
+/* The driver's order: reject a replay, otherwise accept */
+static int take(struct uwb_replay *r, uint16_t addr, uint8_t seq, uint32_t now_ms) {
+    if (uwb_replay_seen(r, addr, seq, now_ms)) {
+        return 0;
+    }
+    uwb_replay_accept(r, addr, seq, now_ms);
+    return 1;
+}
+
+static void check_window(void) {
+    struct uwb_replay r = table(TABLE);
+
+    check(take(&r, 0x0002, 10, 0) && !take(&r, 0x0002, 10, 1), "duplicate rejected");
+    check(take(&r, 0x0002, 12, 2) && take(&r, 0x0002, 11, 3) && !take(&r, 0x0002, 11, 4),
+          "late number inside the window accepted once");
+    check(take(&r, 0x0003, 10, 5), "senders are separate");
+    check(take(&r, 0x0002, 30, 6) && !take(&r, 0x0002, 30, 7) && !take(&r, 0x0002, 12, 7),
+          "step ahead keeps the numbers still in the window");
+    check(take(&r, 0x0002, 250, 8) && take(&r, 0x0002, 4, 9) && !take(&r, 0x0002, 250, 10) &&
+          !take(&r, 0x0002, 4, 11), "wrap 255 -> 0: both sides still remembered");
+    check(take(&r, 0x0002, 60, 20) && take(&r, 0x0002, 20, 21) && !take(&r, 0x0002, 20, 22),
+          "number further back than the window is a jump, not a replay");
+    check(take(&r, 0x0002, 77, 20 + MAX_AGE_MS + 1) && take(&r, 0x0002, 77 - 5, 20 + MAX_AGE_MS + 2),
+          "entry idle for max_age_ms forgotten");
+}
+
+/* The tag's 8-bit counter advances by `step` per cycle (POLL, FINAL, ...).
+ * An anchor answers, misses `gap` cycles, then answers again: its fresh RESP
+ * must be taken whatever the gap. */
+static int gaps_ok(int step, uint32_t period_ms, int *bad_gap) {
+    for (int gap = 1; gap < 300; gap++) {
+        struct uwb_replay r = table(TABLE);
+        uint32_t now = 0;
+        uint8_t seq = 0;
+
+        for (int c = 0; c < 20; c++, seq += step, now += period_ms) {
+            take(&r, 0x0002, seq, now);
+        }
+        seq += (uint8_t)(step * gap);
+        now += period_ms * gap;
+        if (!take(&r, 0x0002, seq, now)) {
+            *bad_gap = gap;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void check_gaps(void) {
+    int bad = 0;
+
+    check(gaps_ok(2, 100, &bad), "anchor back after missing 1..299 cycles (100 ms, 2 numbers/cycle)");
+    check(gaps_ok(1, 20, &bad), "anchor back after missing 1..299 cycles (20 ms, 1 number/cycle)");
+
+    // Without the time to age out: any jump past the window, ahead or back
+    int ok = 1;
+
+    for (int jump = UWB_REPLAY_WINDOW; jump <= 256 - UWB_REPLAY_WINDOW; jump++) {
+        struct uwb_replay r = table(TABLE);
+
+        for (int i = 0; i < 40; i++) {
+            take(&r, 0x0002, (uint8_t)i, (uint32_t)i);
+        }
+        ok &= take(&r, 0x0002, (uint8_t)(39 + jump), 41);
+    }
+    check(ok, "jumps of 32..224 numbers within max_age_ms accepted");
+}
+
+/* Responder side: an initiator's POLLs to us, after its counter moved on by
+ * `jump` (frames to other responders, or a restart), must all be taken. */
+static int initiator_ok(int from, int to) {
+    for (int jump = from; jump <= to; jump++) {
+        struct uwb_replay r = table(TABLE);
+        uint8_t seq = 200;
+
+        for (int i = 0; i < 10; i++, seq++) {
+            take(&r, 0x1001, seq, (uint32_t)i * 50);
+        }
+        seq = (uint8_t)(seq - 1 + jump);
+        for (int i = 0; i < 10; i++, seq++) {
+            if (!take(&r, 0x1001, seq, 500 + (uint32_t)i * 50)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static void check_initiator(void) {
+    check(initiator_ok(256 - 127, 256 - 33), "initiator counter 33..127 back: POLLs accepted");
+    check(initiator_ok(128, 224), "initiator counter 128..224 ahead: POLLs accepted");
+
+    struct uwb_replay r = table(TABLE);
+
+    take(&r, 0x1001, 7, 0);
+    take(&r, 0x1001, 8, 50);
+    check(!take(&r, 0x1001, 8, 52) && !take(&r, 0x1001, 7, 53), "POLL received twice rejected");
+}
+
+/* Peer mode: every neighbor POLLs us in turn, with the table sized as the
+ * driver sizes it. No entry may be evicted, so each neighbor's last POLL is
+ * still caught when it comes again. */
+static void check_peers(void) {
+    struct uwb_replay r = table(UWB_PEER_NEIGHBORS);
+    int taken = 1, caught = 1;
+    uint32_t now = 0;
+
+    for (int round = 0; round < 3; round++) {
+        for (int p = 0; p < UWB_PEER_NEIGHBORS; p++, now += 2) {
+            taken &= take(&r, (uint16_t)(0x2000 + p), (uint8_t)(p * 7 + round * 40), now);
+        }
+    }
+    for (int p = 0; p < UWB_PEER_NEIGHBORS; p++, now += 2) {
+        caught &= !take(&r, (uint16_t)(0x2000 + p), (uint8_t)(p * 7 + 80), now);
+    }
+    check(taken, "POLLs from a full neighbor table accepted");
+    check(caught, "repeat from every neighbor rejected (no entry evicted)");
+}
+
+int main(void) {
+    check_window();
+    check_gaps();
+    check_initiator();
+    check_peers();
+
+    printf("%s (%d failed)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
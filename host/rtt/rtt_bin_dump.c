@@ -0,0 +1,377 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "uwb_frame.h"
+#include "uwb_rtt_bin_proto.h"
+#include "capture.h"
+
+/* Reader for the tag's binary diagnostics RTT channel (overlay-rttbin.conf).
+ *
+ *   rtt_bin_dump <source> [--csv] [--cir cir.csv] [--capture out.cap]
+ *
+ * <source> is a raw channel capture or FIFO (JLinkRTTLogger -RTTChannel 1),
+ * "-" for stdin, or tcp:HOST:PORT for an RTT server that exposes the channel
+ * (OpenOCD: "rtt server start 9091 1"). Cycle records go to stdout (text or
+ * CSV), CIR windows to the --cir file as cycle,sample,re,im rows; counters
+ * go to stderr at the end. --capture appends every record, and the count of
+ * records dropped on the target, to a capture file for uwb_replay
+ * (host/capture).
+ *
+ *   rtt_bin_dump --synthetic                decoder check with gaps and garbage
+ */
+
+#define MAX_PAYLOAD     (UWB_RTT_CIR_HDR_LEN + 256 * UWB_RTT_CIR_SAMPLE_LEN)
+
+static volatile sig_atomic_t stop_requested;
+
+struct reader {
+    uint8_t buf[UWB_RTT_BIN_HDR_LEN + MAX_PAYLOAD];
+    size_t n;
+    int have_seq;
+    uint32_t next_seq;
+    int csv;
+    FILE *cir;
+    struct cap_writer *cap;
+    int quiet;
+    // counters
+    uint64_t bytes;
+    uint64_t skipped;           // bytes discarded while resynchronising
+    uint64_t dropped;           // sequence gaps (records dropped on the target)
+    uint32_t cycles;
+    uint32_t cirs;
+    uint32_t twrs;
+    uint32_t others;            // settings and housekeeping records
+    uint32_t unknown;
+};
+
+static int32_t s18(const uint8_t *p) {
+    const int32_t v = (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)(p[2] & 0x03) << 16));
+
+    return (v & 0x20000) ? v - 0x40000 : v;
+}
+
+static void on_cycle(struct reader *r, const uint8_t *p) {
+    const uint32_t cycle = uwb_get_u32(&p[0]);
+    const uint32_t t_ms = uwb_get_u32(&p[4]);
+    const uint32_t late_us = uwb_get_u32(&p[8]);
+    const uint32_t cycle_us = uwb_get_u32(&p[12]);
+    const uint16_t anchor = uwb_get_u16(&p[16]);
+    const int8_t status = (int8_t)p[19];
+    const uint32_t dist = uwb_get_u32(&p[20]);
+    const uint32_t report = uwb_get_u32(&p[24]);
+    const int32_t toa = (int32_t)uwb_get_u32(&p[28]);
+
+    r->cycles++;
+    if (r->quiet) {
+        return;
+    }
+    if (r->csv) {
+        printf("%u,%u,%u,%u,0x%04x,%u,%d,%u,%u,%d\n", cycle, t_ms, late_us, cycle_us, anchor,
+               p[18], status, dist, report, toa);
+    } else {
+        printf("#%-7u %10u ms late %5u us busy %5u us anchor 0x%04x st %2d %7u mm report %7u mm "
+               "toa %d\n", cycle, t_ms, late_us, cycle_us, anchor, status, dist, report, toa);
+    }
+}
+
+static void on_cir(struct reader *r, const uint8_t *p, uint16_t len) {
+    const uint32_t cycle = uwb_get_u32(&p[0]);
+    const uint16_t fp = uwb_get_u16(&p[6]);
+    const uint16_t first = uwb_get_u16(&p[8]);
+    const uint16_t n = uwb_get_u16(&p[10]);
+
+    if (len != UWB_RTT_CIR_HDR_LEN + n * UWB_RTT_CIR_SAMPLE_LEN) {
+        r->unknown++;
+        return;
+    }
+    r->cirs++;
+    if (!r->cir) {
+        return;
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        const uint8_t *s = &p[UWB_RTT_CIR_HDR_LEN + i * UWB_RTT_CIR_SAMPLE_LEN];
+
+        fprintf(r->cir, "%u,%u,%d,%d,%u.%02u\n", cycle, first + i, s18(s), s18(s + 3),
+                fp >> 6, (fp & 0x3F) * 100 / 64);
+    }
+}
+
+/* Returns the record length if buf[0..n) starts with a complete, plausible
+ * record, 0 if more bytes are needed, -1 if buf[0] cannot start a record. */
+static int record_len(const uint8_t *b, size_t n) {
+    if (b[0] != UWB_RTT_BIN_MAGIC) {
+        return -1;
+    }
+    if (n < UWB_RTT_BIN_HDR_LEN) {
+        return 0;
+    }
+    const uint16_t len = uwb_get_u16(&b[2]);
+
+    if ((b[1] == UWB_RTT_REC_CYCLE && len != UWB_RTT_CYCLE_LEN) ||
+        (b[1] == UWB_RTT_REC_CIR && len < UWB_RTT_CIR_HDR_LEN) ||
+        (b[1] == UWB_RTT_REC_TWR && len != UWB_RTT_TWR_LEN) ||
+        (b[1] == UWB_RTT_REC_CONFIG && len != UWB_RTT_CONFIG_LEN) ||
+        (b[1] == UWB_RTT_REC_DIAG && len != UWB_RTT_DIAG_LEN) || len > MAX_PAYLOAD) {
+        return -1;
+    }
+    return n < (size_t)UWB_RTT_BIN_HDR_LEN + len ? 0 : UWB_RTT_BIN_HDR_LEN + len;
+}
+
+static void feed(struct reader *r, const uint8_t *data, size_t len) {
+    r->bytes += len;
+    while (len) {
+        const size_t take = (sizeof(r->buf) - r->n < len) ? sizeof(r->buf) - r->n : len;
+
+        memcpy(&r->buf[r->n], data, take);
+        r->n += take;
+        data += take;
+        len -= take;
+
+        while (r->n) {
+            const int rl = record_len(r->buf, r->n);
+
+            if (rl == 0) {
+                break;
+            }
+            if (rl < 0) {
+                // Resynchronise on the next magic byte
+                const uint8_t *m = memchr(&r->buf[1], UWB_RTT_BIN_MAGIC, r->n - 1);
+                const size_t skip = m ? (size_t)(m - r->buf) : r->n;
+
+                r->skipped += skip;
+                memmove(r->buf, &r->buf[skip], r->n - skip);
+                r->n -= skip;
+                continue;
+            }
+            const uint32_t seq = uwb_get_u32(&r->buf[4]);
+            const uint8_t *p = &r->buf[UWB_RTT_BIN_HDR_LEN];
+            const uint16_t plen = (uint16_t)(rl - UWB_RTT_BIN_HDR_LEN);
+
+            if (r->have_seq && seq != r->next_seq) {
+                r->dropped += (uint32_t)(seq - r->next_seq);
+                if (r->cap && cap_write_gap(r->cap, seq - r->next_seq)) {
+                    r->cap = NULL;
+                    fprintf(stderr, "capture: write failed, stopped\n");
+                }
+            }
+            r->have_seq = 1;
+            r->next_seq = seq + 1;
+            if (r->buf[1] == UWB_RTT_REC_CYCLE) {
+                on_cycle(r, p);
+            } else if (r->buf[1] == UWB_RTT_REC_CIR) {
+                on_cir(r, p, plen);
+            } else if (r->buf[1] == UWB_RTT_REC_TWR) {
+                r->twrs++;
+            } else if (r->buf[1] == UWB_RTT_REC_CONFIG || r->buf[1] == UWB_RTT_REC_DIAG) {
+                r->others++;
+            } else {
+                r->unknown++;
+            }
+            if (r->cap && cap_write(r->cap, r->buf[1], p, plen)) {
+                r->cap = NULL;
+                fprintf(stderr, "capture: write failed, stopped\n");
+            }
+            memmove(r->buf, &r->buf[rl], r->n - (size_t)rl);
+            r->n -= (size_t)rl;
+        }
+    }
+}
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_counters(const struct reader *r, double secs) {
+    fprintf(stderr, "%llu bytes (%.1f kB/s), %u cycle + %u CIR + %u TWR + %u other records, "
+                    "%u unknown, dropped on target %llu, skipped %llu bytes\n",
+            (unsigned long long)r->bytes, secs > 0 ? r->bytes / secs / 1000 : 0.0, r->cycles,
+            r->cirs, r->twrs, r->others, r->unknown, (unsigned long long)r->dropped,
+            (unsigned long long)r->skipped);
+}
+
+static int open_source(const char *src) {
+    if (strcmp(src, "-") == 0) {
+        return STDIN_FILENO;
+    }
+    if (strncmp(src, "tcp:", 4) != 0) {
+        return open(src, O_RDONLY);
+    }
+
+    char host[256];
+    const char *port = strrchr(src + 4, ':');
+    struct addrinfo hints = { .ai_socktype = SOCK_STREAM };
+    struct addrinfo *ai;
+
+    if (!port || (size_t)(port - src - 4) >= sizeof(host)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(host, src + 4, (size_t)(port - src - 4));
+    host[port - src - 4] = '\0';
+    if (getaddrinfo(host, port + 1, &hints, &ai) != 0) {
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+    const int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+    if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+        close(fd);
+        freeaddrinfo(ai);
+        return -1;
+    }
+    freeaddrinfo(ai);
+    return fd;
+}
+
+static void on_sigint(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int dump(const char *src, int csv, const char *cir_path, const char *cap_path) {
+    static struct reader r;
+    static struct cap_writer cap;
+    uint8_t buf[16384];
+    const int fd = open_source(src);
+
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", src, strerror(errno));
+        return 1;
+    }
+    r.csv = csv;
+    if (cir_path && !(r.cir = fopen(cir_path, "w"))) {
+        fprintf(stderr, "%s: %s\n", cir_path, strerror(errno));
+        return 1;
+    }
+    if (r.cir) {
+        fprintf(r.cir, "cycle,sample,re,im,fp_index\n");
+    }
+    if (cap_path) {
+        const int ret = cap_writer_open(&cap, cap_path);
+
+        if (ret) {
+            fprintf(stderr, "%s: %s\n", cap_path, strerror(-ret));
+            return 1;
+        }
+        r.cap = &cap;
+    }
+    if (csv) {
+        printf("cycle,t_ms,wake_late_us,cycle_us,anchor,seq,status,dist_mm,report_mm,toa_diff_dtu\n");
+    }
+
+    signal(SIGINT, on_sigint);
+    const double t0 = now_s();
+    while (!stop_requested) {
+        const ssize_t n = read(fd, buf, sizeof(buf));
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        feed(&r, buf, (size_t)n);
+    }
+    if (r.cir) {
+        fclose(r.cir);
+    }
+    if (cap_path && cap_writer_close(&cap)) {
+        fprintf(stderr, "%s: write failed\n", cap_path);
+    }
+    print_counters(&r, now_s() - t0);
+    return 0;
+}
+
+// ================= Synthetic check =================
+static size_t put_record(uint8_t *out, uint8_t type, uint32_t seq, const uint8_t *p, uint16_t len) {
+    out[0] = UWB_RTT_BIN_MAGIC;
+    out[1] = type;
+    uwb_put_u16(&out[2], len);
+    uwb_put_u32(&out[4], seq);
+    memcpy(&out[UWB_RTT_BIN_HDR_LEN], p, len);
+    return UWB_RTT_BIN_HDR_LEN + len;
+}
+
+static int synthetic(void) {
+    static struct reader r = { .quiet = 1 };
+    static uint8_t stream[1 << 20];
+    uint8_t p[UWB_RTT_CIR_HDR_LEN + 64 * UWB_RTT_CIR_SAMPLE_LEN] = { 0 };
+    size_t len = 0;
+    uint32_t seq = 0;
+    uint32_t gaps = 0;
+    uint32_t cycles = 0;
+    uint32_t cirs = 0;
+
+    srand(1);
+    for (uint32_t i = 0; i < 1000; i++) {
+        uwb_put_u32(&p[0], i);
+        p[19] = 0;
+        len += put_record(&stream[len], UWB_RTT_REC_CYCLE, seq++, p, UWB_RTT_CYCLE_LEN);
+        cycles++;
+        if (i % 2 == 0) {
+            uwb_put_u16(&p[10], 64);
+            len += put_record(&stream[len], UWB_RTT_REC_CIR, seq++, p, sizeof(p));
+            cirs++;
+        }
+        if (i % 97 == 0) {
+            seq += 3;   // records the target dropped
+            gaps += 3;
+        }
+    }
+
+    // Start mid-record, as when attaching to a running target
+    const size_t start = 5;
+
+    for (size_t pos = start; pos < len;) {
+        size_t chunk = 1 + (size_t)(rand() % 3000);
+
+        if (chunk > len - pos) {
+            chunk = len - pos;
+        }
+        feed(&r, &stream[pos], chunk);
+        pos += chunk;
+    }
+    print_counters(&r, 0);
+
+    const int ok = r.cycles == cycles - 1 && r.cirs == cirs && r.dropped == gaps &&
+                   r.unknown == 0 && r.skipped == UWB_RTT_BIN_HDR_LEN + UWB_RTT_CYCLE_LEN - start;
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    const char *cir = NULL;
+    const char *cap = NULL;
+    int csv = 0;
+
+    if (argc >= 2 && strcmp(argv[1], "--synthetic") == 0) {
+        return synthetic();
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: rtt_bin_dump <file|fifo|-|tcp:HOST:PORT> [--csv] [--cir cir.csv]\n"
+                        "                    [--capture out.cap]\n"
+                        "       rtt_bin_dump --synthetic\n");
+        return 2;
+    }
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            csv = 1;
+        } else if (strcmp(argv[i], "--cir") == 0 && i + 1 < argc) {
+            cir = argv[++i];
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            cap = argv[++i];
+        }
+    }
+    return dump(argv[1], csv, cir, cap);
+}
@@ -0,0 +1,70 @@
+#include <string.h>
+#include "stream_decode.h"
+
+void stream_decoder_init(struct stream_decoder *d,
+                         void (*on_record)(const struct uwb_stream_rec *, uint16_t, void *),
+                         void *ctx) {
+    memset(d, 0, sizeof(*d));
+    d->on_record = on_record;
+    d->ctx = ctx;
+}
+
+static void frame_done(struct stream_decoder *d) {
+    uint8_t frame[UWB_STREAM_FRAME_MAX];
+    struct uwb_stream_rec recs[UWB_STREAM_MAX_RECORDS];
+    uint16_t seq;
+    uint16_t dropped;
+
+    if (d->n > sizeof(frame) + 1) {
+        d->stats.bad_frames++;
+        return;
+    }
+    const size_t len = uwb_cobs_decode(d->buf, d->n, frame);
+    const int n = len ? uwb_stream_frame_parse(frame, len, &seq, &dropped, recs,
+                                               UWB_STREAM_MAX_RECORDS) : -1;
+
+    if (n < 0) {
+        d->stats.bad_frames++;
+        return;
+    }
+    d->stats.frames++;
+    d->stats.dropped_device += dropped;
+    if (d->have_seq) {
+        const uint16_t gap = (uint16_t)(seq - d->next_seq);
+
+        // The tag counts dropped records in seq too; the rest went missing on the link
+        if (gap > dropped) {
+            d->stats.lost_link += gap - dropped;
+        }
+    }
+    d->have_seq = 1;
+    d->next_seq = (uint16_t)(seq + n);
+    for (int i = 0; i < n; i++) {
+        d->stats.records++;
+        if (d->on_record) {
+            d->on_record(&recs[i], (uint16_t)(seq + i), d->ctx);
+        }
+    }
+}
+
+void stream_decoder_feed(struct stream_decoder *d, const uint8_t *data, size_t len) {
+    d->stats.bytes += len;
+    for (size_t i = 0; i < len; i++) {
+        const uint8_t b = data[i];
+
+        if (b == 0x00) {
+            if (d->synced && !d->overflow && d->n) {
+                frame_done(d);
+            } else if (d->synced && d->overflow) {
+                d->stats.bad_frames++;
+            }
+            d->synced = 1;
+            d->overflow = 0;
+            d->n = 0;
+        } else if (d->n < sizeof(d->buf)) {
+            d->buf[d->n++] = b;
+        } else {
+            d->overflow = 1;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef STREAM_DECODE_H
+#define STREAM_DECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "uwb_stream_proto.h"
+
+/* Incremental decoder for the tag's binary range stream (CONFIG_UWB_STREAM).
+ * Feed it raw port bytes in any chunking; complete, CRC-checked records are
+ * passed to the callback in order. */
+
+struct stream_stats {
+    uint64_t bytes;
+    uint32_t frames;
+    uint32_t bad_frames;        // COBS, length or CRC error
+    uint64_t records;
+    uint64_t dropped_device;    // dropped on the tag (reported in frame headers)
+    uint64_t lost_link;         // seq gaps not explained by dropped_device
+};
+
+struct stream_decoder {
+    uint8_t buf[UWB_STREAM_COBS_LEN(UWB_STREAM_FRAME_MAX)];
+    size_t n;
+    int overflow;               // discarding until the next delimiter
+    int synced;                 // first delimiter seen (a mid-frame start is not an error)
+    int have_seq;
+    uint16_t next_seq;
+    struct stream_stats stats;
+    void (*on_record)(const struct uwb_stream_rec *rec, uint16_t seq, void *ctx);
+    void *ctx;
+};
+
+void stream_decoder_init(struct stream_decoder *d,
+                         void (*on_record)(const struct uwb_stream_rec *, uint16_t, void *),
+                         void *ctx);
+
+void stream_decoder_feed(struct stream_decoder *d, const uint8_t *data, size_t len);
+
+#endif /* STREAM_DECODE_H */
@@ -0,0 +1,232 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "stream_decode.h"
+
+/* Decoder for the tag's binary range stream (overlay-stream.conf).
+ *
+ *   stream_dump <port|file> [--csv]     decode a CDC ACM port or a raw capture
+ *   stream_dump --synthetic [records]   encoder/decoder round trip with a
+ *                                       corrupted, randomly chunked stream
+ */
+
+static volatile sig_atomic_t stop_requested;
+
+struct dump_ctx {
+    int csv;
+};
+
+static void print_record(const struct uwb_stream_rec *r, uint16_t seq, void *ctx) {
+    const struct dump_ctx *c = ctx;
+
+    if (c->csv) {
+        printf("%u,%u,0x%04x,%d,%u,%u,%u,%d,%u\n", seq, r->t_ms, r->anchor, r->status,
+               r->dist_mm, r->filt_mm, r->quality, r->vel_cm_s, r->flags);
+    } else if (r->status) {
+        printf("%5u %10u ms anchor 0x%04x failed (%d)\n", seq, r->t_ms, r->anchor, r->status);
+    } else {
+        printf("%5u %10u ms anchor 0x%04x %7u mm filt %7u mm %+6d cm/s q %3u%s%s\n", seq,
+               r->t_ms, r->anchor, r->dist_mm, r->filt_mm, r->vel_cm_s, r->quality,
+               (r->flags & UWB_STREAM_FLAG_TOA) ? " NLOS" : "",
+               (r->flags & UWB_STREAM_FLAG_FILT_RESET) ? " reset" : "");
+    }
+}
+
+static void print_stats(const struct stream_stats *s) {
+    fprintf(stderr,
+            "%llu bytes, %u frames (%u bad), %llu records, "
+            "dropped on tag %llu, lost on link %llu\n",
+            (unsigned long long)s->bytes, s->frames, s->bad_frames,
+            (unsigned long long)s->records,
+            (unsigned long long)s->dropped_device, (unsigned long long)s->lost_link);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void on_sigint(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int dump(const char *path, int csv) {
+    struct dump_ctx ctx = { .csv = csv };
+    struct stream_decoder d;
+    struct termios tio;
+    uint8_t buf[4096];
+    const int fd = open(path, O_RDONLY | O_NOCTTY);
+
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    const int is_port = isatty(fd);
+
+    stream_decoder_init(&d, print_record, &ctx);
+    // Raw mode for a port; opening it raises DTR, which starts the stream.
+    // A capture starts on a frame boundary, a port may start mid-frame.
+    if (is_port && tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tcsetattr(fd, TCSANOW, &tio);
+    } else {
+        d.synced = 1;
+    }
+    if (csv) {
+        printf("seq,t_ms,anchor,status,dist_mm,filt_mm,quality,vel_cm_s,flags\n");
+    }
+
+    signal(SIGINT, on_sigint);
+    const double t0 = now_s();
+    while (!stop_requested) {
+        const ssize_t n = read(fd, buf, sizeof(buf));
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;      // end of capture or port gone
+        }
+        stream_decoder_feed(&d, buf, (size_t)n);
+    }
+    close(fd);
+    print_stats(&d.stats);
+    if (is_port) {
+        fprintf(stderr, "%.1f records/s\n", d.stats.records / (now_s() - t0));
+    }
+    return 0;
+}
+
+// ================= Synthetic round trip =================
+struct synth_ctx {
+    uint32_t expect_seq;
+    uint32_t mismatches;
+    uint32_t received;
+};
+
+static void make_record(uint32_t i, struct uwb_stream_rec *r) {
+    *r = (struct uwb_stream_rec){
+        .t_ms = 1000 + i * 5,
+        .anchor = 0x0002 + (i % 3),
+        .status = (i % 17 == 0) ? -2 : 0,
+        .quality = (uint8_t)(i % 101),
+        .flags = (uint8_t)(i & 0x7),
+        .dist_mm = (i * 7919u) & UWB_STREAM_MM_MAX,     // includes zero bytes
+        .filt_mm = (i * 104729u) & UWB_STREAM_MM_MAX,
+        .vel_cm_s = (int16_t)(i * 31 - 20000),
+    };
+}
+
+static void check_record(const struct uwb_stream_rec *r, uint16_t seq, void *ctx) {
+    struct synth_ctx *c = ctx;
+    struct uwb_stream_rec want;
+    uint32_t i = c->expect_seq;
+
+    // Corrupted frames are skipped: move on to the seq actually received
+    while ((uint16_t)i != seq) {
+        i++;
+    }
+    make_record(i, &want);
+    c->expect_seq = i + 1;
+    c->received++;
+    if (r->t_ms != want.t_ms || r->anchor != want.anchor || r->status != want.status ||
+        r->quality != want.quality || r->flags != want.flags || r->dist_mm != want.dist_mm ||
+        r->filt_mm != want.filt_mm || r->vel_cm_s != want.vel_cm_s) {
+        c->mismatches++;
+    }
+}
+
+static int synthetic(uint32_t records) {
+    const uint32_t batch = 3;
+    const size_t cap = (size_t)(records / batch + 1) * UWB_STREAM_COBS_LEN(UWB_STREAM_FRAME_MAX);
+    uint8_t *stream = malloc(cap);
+    uint8_t frame[UWB_STREAM_FRAME_MAX];
+    size_t len = 0;
+    uint32_t frames = 0;
+    uint32_t corrupted = 0;
+    uint32_t corrupted_records = 0;
+
+    if (!stream) {
+        return 1;
+    }
+    srand(1);
+
+    // Encode exactly as uwb_stream.c does, then damage one frame in 50
+    const double te = now_s();
+    for (uint32_t i = 0; i < records; i += batch) {
+        const uint8_t n = (uint8_t)((records - i < batch) ? records - i : batch);
+
+        for (uint8_t k = 0; k < n; k++) {
+            struct uwb_stream_rec r;
+
+            make_record(i + k, &r);
+            uwb_stream_rec_pack(&frame[UWB_STREAM_HDR_LEN + k * UWB_STREAM_REC_LEN], &r);
+        }
+        const size_t flen = uwb_stream_frame_finish(frame, n, (uint16_t)i, 0);
+        const size_t start = len;
+
+        len += uwb_cobs_encode(frame, flen, &stream[len]);
+        // Flip one bit without creating a delimiter; the last frame stays intact
+        if (++frames % 50 == 0 && i + batch < records) {
+            uint8_t *b = &stream[start + 5 + rand() % (int)(len - start - 6)];
+
+            *b ^= (*b == 0x40) ? 0x41 : 0x40;
+            corrupted++;
+            corrupted_records += n;
+        }
+    }
+    const double enc_s = now_s() - te;
+
+    struct synth_ctx ctx = { 0 };
+    struct stream_decoder d;
+
+    stream_decoder_init(&d, check_record, &ctx);
+    d.synced = 1;       // the synthetic stream starts on a frame boundary
+
+    const double td = now_s();
+    for (size_t pos = 0; pos < len;) {
+        size_t chunk = 1 + (size_t)(rand() % 200);
+
+        if (chunk > len - pos) {
+            chunk = len - pos;
+        }
+        stream_decoder_feed(&d, &stream[pos], chunk);
+        pos += chunk;
+    }
+    const double dec_s = now_s() - td;
+
+    print_stats(&d.stats);
+    printf("encode %.0f records/s, decode %.0f records/s (%zu bytes, %.2f bytes/record)\n",
+           records / enc_s, records / dec_s, len, (double)len / records);
+
+    const int ok = ctx.mismatches == 0 && d.stats.bad_frames == corrupted &&
+                   ctx.received == records - corrupted_records &&
+                   d.stats.lost_link == corrupted_records;
+
+    printf("%s: %u frames, %u corrupted, %u records decoded, %u mismatches\n",
+           ok ? "PASS" : "FAIL", frames, corrupted, ctx.received, ctx.mismatches);
+    free(stream);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "--synthetic") == 0) {
+        return synthetic(argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 100000);
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: stream_dump <port|capture> [--csv]\n"
+                        "       stream_dump --synthetic [records]\n");
+        return 2;
+    }
+    return dump(argv[1], argc > 2 && strcmp(argv[2], "--csv") == 0);
+}
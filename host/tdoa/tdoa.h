@@ -0,0 +1,138 @@
+#ifndef TDOA_H
+#define TDOA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* TDoA position solver for blink deployments: anchors timestamp a tag's blink
+ * with their own DW3000 clocks, positions are solved centrally.
+ *
+ *   1. tdoa_unwrap() extends each anchor's 40-bit RX timestamps to 64 bits.
+ *   2. A reference anchor transmits sync frames. Every other anchor feeds its
+ *      RX timestamp of them, with the reference's TX timestamp, to its clock
+ *      model (tdoa_clock_sync(): Kalman filter on offset and skew).
+ *   3. tdoa_batch_add() maps a blink's timestamps onto the reference clock.
+ *   4. tdoa_solve_batch() solves a whole batch: Chan's closed form (first
+ *      stage plus the constrained second stage) for a starting point, then
+ *      damped Gauss-Newton.
+ *
+ * Batches are structure-of-arrays: one array per anchor and per unknown, with
+ * the blink index innermost, so every solver loop runs over contiguous doubles
+ * and compiles to SIMD (see host/README.md for the flags).
+ */
+
+#define TDOA_MAX_ANCHORS        16
+#define TDOA_C_M_S              299702547.0             // in air, as in the firmware
+#define TDOA_TICK_S             (1.0 / (499.2e6 * 128.0))
+#define TDOA_TS_BITS            40
+#define TDOA_TS_MASK            ((UINT64_C(1) << TDOA_TS_BITS) - 1)
+
+// ================= Timestamps and clocks =================
+struct tdoa_unwrap {
+    uint64_t last_raw;
+    int64_t last;
+    bool valid;
+};
+
+/* Extend a 40-bit timestamp. Calls must be less than half a wrap (8.6 s) apart;
+ * a timestamp slightly older than the last one is returned without moving it. */
+int64_t tdoa_unwrap(struct tdoa_unwrap *u, uint64_t raw);
+
+/* Anchor clock against the reference anchor: local - ref = base + off + skew * (t - last),
+ * all in ticks, t in local ticks */
+struct tdoa_clock {
+    int64_t base;
+    int64_t last;           // local time of the estimate
+    double off;
+    double skew;
+    double P[2][2];
+    uint32_t syncs;
+    uint32_t rejected;      // innovation outside TDOA_CLOCK_GATE sigma
+    uint8_t reject_run;
+    bool valid;
+};
+
+#define TDOA_CLOCK_MEAS_TICKS   8.0     // sync timestamp noise (1 sigma, ~125 ps)
+#define TDOA_CLOCK_GATE         6.0
+#define TDOA_CLOCK_WARMUP       4       // syncs before gating starts
+
+void tdoa_clock_init(struct tdoa_clock *c);
+
+/* One sync frame: local RX time and the reference's TX time (both unwrapped)
+ * plus the time of flight between the two anchors. Returns 0, or -1 if the
+ * sync was rejected as an outlier. */
+int tdoa_clock_sync(struct tdoa_clock *c, int64_t local_rx, int64_t ref_tx, double tof_ticks);
+
+/* Local time -> reference time, in ticks relative to `epoch` (a reference time
+ * close to the result, keeps the double exact). */
+double tdoa_clock_to_ref(const struct tdoa_clock *c, int64_t local, int64_t epoch);
+
+// ================= Site =================
+struct tdoa_anchors {
+    int m;
+    double x[TDOA_MAX_ANCHORS];
+    double y[TDOA_MAX_ANCHORS];
+    double z[TDOA_MAX_ANCHORS];
+};
+
+struct tdoa_site {
+    struct tdoa_anchors an;
+    int ref;                                    // anchor sending the sync frames
+    struct tdoa_unwrap ts[TDOA_MAX_ANCHORS];
+    struct tdoa_clock clk[TDOA_MAX_ANCHORS];
+};
+
+void tdoa_site_init(struct tdoa_site *s, const struct tdoa_anchors *an, int ref);
+
+/* Sync frame from the reference: its TX timestamp and anchor a's RX timestamp
+ * (raw 40-bit). Returns tdoa_clock_sync()'s result. */
+int tdoa_site_sync(struct tdoa_site *s, uint64_t ref_tx_raw, int a, uint64_t rx_raw);
+
+// ================= Batches =================
+struct tdoa_batch {
+    int n;
+    int cap;
+    int m;                              // anchors (columns)
+    uint32_t *id;                       // caller's blink id
+    double *t[TDOA_MAX_ANCHORS];        // arrival, reference clock, s after the first arrival
+    double *w[TDOA_MAX_ANCHORS];        // weight, 0 = not received
+    // results
+    double *x, *y, *z;
+    double *rms_m;                      // range-difference residual RMS
+    uint8_t *ok;
+    // solver scratch
+    double *s[40];
+};
+
+struct tdoa_solve_cfg {
+    int dims;               // 2: x/y at tag_z, 3: x/y/z
+    double tag_z;           // 3D: height of the 2D starting point
+    double box_min[3];      // x/y/z: solutions outside are penalised (axis off if max <= min)
+    double box_max[3];
+    int iterations;         // Gauss-Newton iterations (fixed, for the whole batch)
+};
+
+int tdoa_batch_init(struct tdoa_batch *b, int m, int cap);
+void tdoa_batch_free(struct tdoa_batch *b);
+
+static inline void tdoa_batch_clear(struct tdoa_batch *b) {
+    b->n = 0;
+}
+
+/* Add one blink from raw 40-bit RX timestamps; rx_mask bit a = anchor a heard
+ * it. Anchors without a synced clock are left out. Returns the row, or -1 if
+ * the batch is full. */
+int tdoa_batch_add(struct tdoa_batch *b, struct tdoa_site *s, uint32_t id,
+                   const uint64_t *rx_raw, uint32_t rx_mask);
+
+/* Add one blink from arrival times already on a common clock (s). */
+int tdoa_batch_add_times(struct tdoa_batch *b, uint32_t id, const double *t_s,
+                         uint32_t rx_mask);
+
+/* Solve every row. A row needs dims + 2 receiving anchors. Returns the number
+ * solved (ok[i] set). */
+int tdoa_solve_batch(struct tdoa_batch *b, const struct tdoa_anchors *an,
+                     const struct tdoa_solve_cfg *cfg);
+
+#endif /* TDOA_H */
@@ -0,0 +1,134 @@
+#include <math.h>
+#include <string.h>
+#include "tdoa.h"
+
+/* Skew random walk (ticks^2 / tick^3): ~1 ppb/s of crystal wander, so over a
+ * 100 ms sync interval the offset prediction loses a few ticks. */
+#define CLOCK_Q             1e-28
+#define CLOCK_SKEW0         50e-6       // initial skew uncertainty (crystal tolerance)
+#define CLOCK_RESET_RUN     3           // consecutive rejects that restart the model
+
+int64_t tdoa_unwrap(struct tdoa_unwrap *u, uint64_t raw) {
+    raw &= TDOA_TS_MASK;
+    if (!u->valid) {
+        u->valid = true;
+        u->last_raw = raw;
+        u->last = (int64_t)raw;
+        return u->last;
+    }
+    // Signed 40-bit difference
+    int64_t d = (int64_t)((raw - u->last_raw) & TDOA_TS_MASK);
+
+    if (d >= (int64_t)1 << (TDOA_TS_BITS - 1)) {
+        d -= (int64_t)1 << TDOA_TS_BITS;
+    }
+    if (d < 0) {
+        return u->last + d;
+    }
+    u->last_raw = raw;
+    u->last += d;
+    return u->last;
+}
+
+void tdoa_clock_init(struct tdoa_clock *c) {
+    memset(c, 0, sizeof(*c));
+}
+
+static void clock_start(struct tdoa_clock *c, int64_t local, int64_t ref, double tof) {
+    const double r = TDOA_CLOCK_MEAS_TICKS * TDOA_CLOCK_MEAS_TICKS;
+
+    c->base = local - ref;
+    c->last = local;
+    c->off = -tof;
+    c->skew = 0;
+    c->P[0][0] = r;
+    c->P[0][1] = c->P[1][0] = 0;
+    c->P[1][1] = CLOCK_SKEW0 * CLOCK_SKEW0;
+    c->syncs = 1;
+    c->reject_run = 0;
+    c->valid = true;
+}
+
+int tdoa_clock_sync(struct tdoa_clock *c, int64_t local_rx, int64_t ref_tx, double tof_ticks) {
+    const double r = TDOA_CLOCK_MEAS_TICKS * TDOA_CLOCK_MEAS_TICKS;
+
+    if (!c->valid) {
+        clock_start(c, local_rx, ref_tx, tof_ticks);
+        return 0;
+    }
+
+    // Predict: off += skew * dt, P = F P F' + Q
+    const double dt = (double)(local_rx - c->last);
+    const double q = CLOCK_Q;
+    const double p00 = c->P[0][0] + dt * (c->P[1][0] + c->P[0][1]) + dt * dt * c->P[1][1] +
+                       q * dt * dt * dt / 3;
+    const double p01 = c->P[0][1] + dt * c->P[1][1] + q * dt * dt / 2;
+    const double p11 = c->P[1][1] + q * dt;
+
+    c->off += c->skew * dt;
+    c->last = local_rx;
+    c->P[0][0] = p00;
+    c->P[0][1] = c->P[1][0] = p01;
+    c->P[1][1] = p11;
+
+    // Measured offset at local_rx: the sync left the reference at ref_tx, arrived tof later
+    const double y = (double)(local_rx - ref_tx - c->base) - tof_ticks - c->off;
+    const double s = p00 + r;
+
+    if (c->syncs >= TDOA_CLOCK_WARMUP && y * y > TDOA_CLOCK_GATE * TDOA_CLOCK_GATE * s) {
+        c->rejected++;
+        if (++c->reject_run >= CLOCK_RESET_RUN) {
+            // The clock really jumped (anchor reset): start over from this sync
+            clock_start(c, local_rx, ref_tx, tof_ticks);
+        }
+        return -1;
+    }
+    c->reject_run = 0;
+
+    const double k0 = p00 / s;
+    const double k1 = p01 / s;
+
+    c->off += k0 * y;
+    c->skew += k1 * y;
+    c->P[0][0] = (1 - k0) * p00;
+    c->P[0][1] = c->P[1][0] = (1 - k0) * p01;
+    c->P[1][1] = p11 - k1 * p01;
+
+    // Keep the fractional part small so the double stays exact
+    const int64_t whole = (int64_t)c->off;
+
+    c->base += whole;
+    c->off -= (double)whole;
+    c->syncs++;
+    return 0;
+}
+
+double tdoa_clock_to_ref(const struct tdoa_clock *c, int64_t local, int64_t epoch) {
+    return (double)(local - c->base - epoch) - c->off - c->skew * (double)(local - c->last);
+}
+
+void tdoa_site_init(struct tdoa_site *s, const struct tdoa_anchors *an, int ref) {
+    memset(s, 0, sizeof(*s));
+    s->an = *an;
+    s->ref = ref;
+    for (int a = 0; a < an->m; a++) {
+        tdoa_clock_init(&s->clk[a]);
+    }
+    // The reference defines the time base
+    s->clk[ref].valid = true;
+    s->clk[ref].syncs = 1;
+}
+
+int tdoa_site_sync(struct tdoa_site *s, uint64_t ref_tx_raw, int a, uint64_t rx_raw) {
+    if (a == s->ref || a < 0 || a >= s->an.m) {
+        return -1;
+    }
+    const double dx = s->an.x[a] - s->an.x[s->ref];
+    const double dy = s->an.y[a] - s->an.y[s->ref];
+    const double dz = s->an.z[a] - s->an.z[s->ref];
+    const double tof = sqrt(dx * dx + dy * dy + dz * dz) / TDOA_C_M_S / TDOA_TICK_S;
+    const int64_t ref_tx = tdoa_unwrap(&s->ts[s->ref], ref_tx_raw);
+    const int64_t rx = tdoa_unwrap(&s->ts[a], rx_raw);
+
+    return tdoa_clock_sync(&s->clk[a], rx, ref_tx, tof);
+}
@@ -0,0 +1,429 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tdoa.h"
+#include "uwb_clock_sync.h"
+
+/* Simulated TDoA site: validates the clock models and the batch solver
+ * against known tag positions and measures solver throughput.
+ *
+ * Every anchor has its own 40-bit clock (random offset, skew within +-20 ppm
+ * with a slow random walk), the reference anchor sends a sync frame at the
+ * start of every interval, and every tag blinks once per interval at a random
+ * moment. RX timestamps get Gaussian noise; each anchor misses a blink with
+ * probability 1 - rx_prob. Runs long enough to cross the 40-bit wrap.
+ *
+ * --anchor-sync moves the clock models onto the anchors: every other anchor
+ * runs the firmware's src/uwb_clock_sync.c on its sync receptions and reports
+ * blinks already converted to the reference's 40-bit timebase, which are only
+ * differenced here (tdoa_batch_add_times()).
+ */
+
+#define SITE_M          30.0
+#define MAX_TAGS        100000
+
+static struct {
+    int tags;
+    double seconds;
+    double sync_ms;
+    double noise_ps;
+    double rx_prob;
+    int dims;
+    int batch;
+    int iterations;
+    int anchors;
+    int csv;
+    int anchor_sync;
+} opt = {
+    .tags = 1000,
+    .seconds = 30,
+    .sync_ms = 100,
+    .noise_ps = 100,
+    .rx_prob = 0.95,
+    .dims = 2,
+    .batch = 1024,
+    .iterations = 4,
+    .anchors = 8,
+};
+
+struct sim_clock {
+    uint64_t offset;        // raw counter value at t = 0
+    double phase;           // ticks elapsed since t = 0 at the start of the interval
+    double skew;
+};
+
+struct sim_tag {
+    double x, y, z;
+};
+
+#define SIM_MASTER_ADDR 0x0100     // --anchor-sync: anchor a is SIM_MASTER_ADDR + a
+
+static struct sim_clock clocks[TDOA_MAX_ANCHORS];
+static struct uwb_cs_state anchor_cs[TDOA_MAX_ANCHORS];
+static struct sim_tag *tags;
+static struct tdoa_anchors site_anchors;
+static unsigned seed = 1;
+
+static double uniform(void) {
+    return (rand_r(&seed) + 0.5) / ((double)RAND_MAX + 1.0);
+}
+
+static double gauss(void) {
+    return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Raw 40-bit timestamp of anchor a, dt seconds into the current interval
+static uint64_t sim_raw(int a, double dt, double noise_s) {
+    const struct sim_clock *c = &clocks[a];
+    const double ticks = c->phase + (1 + c->skew) * (dt + noise_s) / TDOA_TICK_S;
+
+    return (c->offset + (uint64_t)llround(ticks)) & TDOA_TS_MASK;
+}
+
+static double dist(const struct tdoa_anchors *an, int a, double x, double y, double z) {
+    const double dx = an->x[a] - x, dy = an->y[a] - y, dz = an->z[a] - z;
+
+    return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+// Signed difference of two 40-bit timestamps, s
+static double ts_diff_s(uint64_t a, uint64_t b) {
+    int64_t d = (int64_t)((a - b) & TDOA_TS_MASK);
+
+    if (d >= (int64_t)1 << (TDOA_TS_BITS - 1)) {
+        d -= (int64_t)1 << TDOA_TS_BITS;
+    }
+    return d * TDOA_TICK_S;
+}
+
+// --anchor-sync: blink timestamps as the anchors would report them, converted
+// to the reference's timebase (anchor 0 is the master and reports its own)
+static int add_anchor_synced(struct tdoa_batch *b, uint32_t id, const uint64_t *rx,
+                             uint32_t rx_mask, uint32_t now_ms) {
+    double t[TDOA_MAX_ANCHORS];
+    uint64_t master_ts[TDOA_MAX_ANCHORS];
+    uint32_t mask = 0;
+    int first = -1;
+
+    for (int a = 0; a < opt.anchors; a++) {
+        uint16_t master;
+
+        if (!(rx_mask >> a & 1)) {
+            continue;
+        }
+        if (a == 0) {
+            master_ts[a] = rx[a];
+        } else if (uwb_cs_convert(&anchor_cs[a], rx[a], now_ms, &master_ts[a], &master,
+                                  NULL) != 0) {
+            continue;
+        }
+        if (first < 0) {
+            first = a;
+        }
+        t[a] = ts_diff_s(master_ts[a], master_ts[first]);
+        mask |= 1u << a;
+    }
+    return tdoa_batch_add_times(b, id, t, mask);
+}
+
+static void sim_site(void) {
+    site_anchors.m = opt.anchors;
+    for (int a = 0; a < opt.anchors; a++) {
+        const double s = 4.0 * SITE_M * a / opt.anchors;
+
+        if (s < SITE_M) {
+            site_anchors.x[a] = s, site_anchors.y[a] = 0;
+        } else if (s < 2 * SITE_M) {
+            site_anchors.x[a] = SITE_M, site_anchors.y[a] = s - SITE_M;
+        } else if (s < 3 * SITE_M) {
+            site_anchors.x[a] = 3 * SITE_M - s, site_anchors.y[a] = SITE_M;
+        } else {
+            site_anchors.x[a] = 0, site_anchors.y[a] = 4 * SITE_M - s;
+        }
+        // 3D needs vertical spread (floor and ceiling mounts), 2D only height variety
+        site_anchors.z[a] = (a & 1) ? (opt.dims == 3 ? 6.0 : 2.5) : 0.5;
+        clocks[a] = (struct sim_clock){
+            .offset = ((uint64_t)rand_r(&seed) << 20 ^ (uint64_t)rand_r(&seed)) & TDOA_TS_MASK,
+            .skew = (uniform() * 2 - 1) * 20e-6,
+        };
+    }
+    for (int t = 0; t < opt.tags; t++) {
+        tags[t] = (struct sim_tag){
+            .x = 1 + uniform() * (SITE_M - 2),
+            .y = 1 + uniform() * (SITE_M - 2),
+            .z = opt.dims == 3 ? 0.5 + uniform() * 1.5 : 1.0,
+        };
+    }
+}
+
+struct score {
+    uint64_t blinks;
+    uint64_t solvable;      // heard by dims + 2 anchors
+    uint64_t solved;
+    double err2;
+    double err_max;
+    double solve_s;
+};
+
+static void solve_and_score(struct tdoa_batch *b, const struct tdoa_solve_cfg *cfg,
+                            struct score *sc) {
+    const double t0 = now_s();
+
+    tdoa_solve_batch(b, &site_anchors, cfg);
+    sc->solve_s += now_s() - t0;
+
+    for (int k = 0; k < b->n; k++) {
+        const struct sim_tag *tg = &tags[b->id[k]];
+        int heard = 0;
+
+        for (int a = 0; a < b->m; a++) {
+            heard += b->w[a][k] > 0;
+        }
+        sc->solvable += heard >= opt.dims + 2;
+        if (!b->ok[k]) {
+            continue;
+        }
+        const double ex = b->x[k] - tg->x, ey = b->y[k] - tg->y;
+        const double ez = opt.dims == 3 ? b->z[k] - tg->z : 0;
+        const double e2 = ex * ex + ey * ey + ez * ez;
+
+        sc->solved++;
+        sc->err2 += e2;
+        if (sqrt(e2) > sc->err_max) {
+            sc->err_max = sqrt(e2);
+        }
+        if (opt.csv) {
+            printf("%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f\n", b->id[k], b->x[k], b->y[k],
+                   b->z[k], tg->x, tg->y, tg->z, b->rms_m[k]);
+        }
+    }
+    tdoa_batch_clear(b);
+}
+
+// Clock model error: map "now" on every anchor to the reference, compare
+static double clock_error_ps(struct tdoa_site *site, double dt, uint32_t now_ms) {
+    double sum = 0;
+    int n = 0;
+
+    if (opt.anchor_sync) {
+        const uint64_t ref = sim_raw(0, dt, 0);
+
+        for (int a = 1; a < opt.anchors; a++) {
+            uint64_t ts;
+            uint16_t master;
+
+            if (uwb_cs_convert(&anchor_cs[a], sim_raw(a, dt, 0), now_ms, &ts, &master, NULL) != 0) {
+                return INFINITY;
+            }
+            const double e = ts_diff_s(ts, ref) * 1e12;
+
+            sum += e * e;
+            n++;
+        }
+        return sqrt(sum / n);
+    }
+
+    const int64_t ref = tdoa_unwrap(&site->ts[site->ref], sim_raw(site->ref, dt, 0));
+
+    for (int a = 0; a < site->an.m; a++) {
+        if (a == site->ref) {
+            continue;
+        }
+        const int64_t local = tdoa_unwrap(&site->ts[a], sim_raw(a, dt, 0));
+        const double e = tdoa_clock_to_ref(&site->clk[a], local, ref) * TDOA_TICK_S * 1e12;
+
+        sum += e * e;
+        n++;
+    }
+    return sqrt(sum / n);
+}
+
+static int run(void) {
+    struct tdoa_site site;
+    struct tdoa_batch b;
+    struct score sc = { 0 };
+    const struct tdoa_solve_cfg cfg = {
+        .dims = opt.dims,
+        .tag_z = 1.0,
+        .box_min = { -5, -5, 0 },
+        .box_max = { SITE_M + 5, SITE_M + 5, 3 },
+        .iterations = opt.iterations,
+    };
+    const double interval = opt.sync_ms / 1000;
+    const int intervals = (int)(opt.seconds / interval);
+    const double noise_s = opt.noise_ps * 1e-12;
+    uint32_t rejected = 0;
+
+    tags = calloc((size_t)opt.tags, sizeof(*tags));
+    if (!tags || tdoa_batch_init(&b, opt.anchors, opt.batch) != 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    sim_site();
+    tdoa_site_init(&site, &site_anchors, 0);
+    for (int a = 1; opt.anchor_sync && a < opt.anchors; a++) {
+        // Surveyed positions: the sync frame's flight is known
+        const struct uwb_cs_cfg cs_cfg = {
+            .timeout_ms = (uint32_t)fmax(1000, 3 * opt.sync_ms),
+            .tof_dtu = dist(&site_anchors, a, site_anchors.x[0], site_anchors.y[0],
+                            site_anchors.z[0]) / TDOA_C_M_S / TDOA_TICK_S,
+        };
+
+        uwb_cs_init(&anchor_cs[a], &cs_cfg);
+    }
+    if (opt.csv) {
+        printf("tag,x,y,z,true_x,true_y,true_z,rms_m\n");
+    }
+
+    const double t_start = now_s();
+
+    for (int i = 0; i < intervals; i++) {
+        // Sync frame from the reference at the start of the interval
+        const uint64_t tx = sim_raw(0, 0, 0);
+        const double start_ms = i * opt.sync_ms;
+
+        for (int a = 1; a < opt.anchors; a++) {
+            const double tof = dist(&site_anchors, a, site_anchors.x[0], site_anchors.y[0],
+                                    site_anchors.z[0]) / TDOA_C_M_S;
+            const uint64_t rx = sim_raw(a, tof, noise_s * gauss());
+            const int ret = opt.anchor_sync
+                                ? uwb_cs_sync(&anchor_cs[a], SIM_MASTER_ADDR, (uint8_t)i, tx, rx,
+                                              (uint32_t)start_ms)
+                                : tdoa_site_sync(&site, tx, a, rx);
+
+            if (ret != 0) {
+                rejected++;
+            }
+        }
+
+        // Blinks; the first interval only trains the clocks
+        for (int t = 0; i > 0 && t < opt.tags; t++) {
+            const struct sim_tag *tg = &tags[t];
+            const double when = (0.01 + 0.98 * uniform()) * interval;
+            uint64_t rx[TDOA_MAX_ANCHORS];
+            uint32_t mask = 0;
+
+            for (int a = 0; a < opt.anchors; a++) {
+                if (uniform() > opt.rx_prob) {
+                    continue;
+                }
+                const double tof = dist(&site_anchors, a, tg->x, tg->y, tg->z) / TDOA_C_M_S;
+
+                rx[a] = sim_raw(a, when + tof, noise_s * gauss());
+                mask |= 1u << a;
+            }
+            sc.blinks++;
+            if (opt.anchor_sync) {
+                add_anchor_synced(&b, (uint32_t)t, rx, mask, (uint32_t)(start_ms + when * 1000));
+            } else {
+                tdoa_batch_add(&b, &site, (uint32_t)t, rx, mask);
+            }
+            if (b.n == b.cap) {
+                solve_and_score(&b, &cfg, &sc);
+            }
+        }
+        if (i == intervals - 1) {
+            solve_and_score(&b, &cfg, &sc);
+            break;
+        }
+
+        // Advance the clocks to the next interval; skew wanders ~1 ppb/s
+        for (int a = 0; a < opt.anchors; a++) {
+            clocks[a].phase += (1 + clocks[a].skew) * interval / TDOA_TICK_S;
+            clocks[a].skew += 1e-9 * sqrt(interval) * gauss();
+        }
+    }
+    const double total_s = now_s() - t_start;
+    const double clk_ps = clock_error_ps(&site, 0.5 * interval,
+                                         (uint32_t)((intervals - 0.5) * opt.sync_ms));
+    const double rms = sc.solved ? sqrt(sc.err2 / sc.solved) : INFINITY;
+
+    fprintf(stderr,
+            "%d anchors, %d tags, %.0f s (%d sync intervals), %.0f ps noise, rx %.2f, %dD%s\n",
+            opt.anchors, opt.tags, opt.seconds, intervals, opt.noise_ps, opt.rx_prob, opt.dims,
+            opt.anchor_sync ? ", clocks synced on the anchors" : "");
+    fprintf(stderr, "clock model error %.0f ps RMS at the end, %u syncs rejected\n", clk_ps,
+            rejected);
+    fprintf(stderr, "blinks %llu, solvable %llu, solved %llu; error RMS %.3f m, max %.3f m\n",
+            (unsigned long long)sc.blinks, (unsigned long long)sc.solvable,
+            (unsigned long long)sc.solved, rms, sc.err_max);
+    fprintf(stderr, "solver: %.0f blinks/s (batch %d, %d GN iterations), simulation total %.2f s\n",
+            sc.solved / sc.solve_s, opt.batch, opt.iterations, total_s);
+
+    /* Timestamp noise of 100 ps is 3 cm per range, the clock model adds its
+     * own error; allow for geometry (GDOP, poorer vertically in 3D) */
+    const double limit = 5 * hypot(opt.noise_ps, clk_ps) * 1e-12 * TDOA_C_M_S + 0.02;
+    const int pass = sc.solved >= sc.solvable * 0.999 && rms < limit &&
+                     clk_ps < 2 * opt.noise_ps + 100;
+
+    fprintf(stderr, "%s\n", pass ? "PASS" : "FAIL");
+    tdoa_batch_free(&b);
+    free(tags);
+    return pass ? 0 : 1;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: tdoa_sim [--tags N] [--seconds S] [--sync-ms MS] [--noise-ps PS]\n"
+            "                [--rx-prob P] [--anchors N] [--dims 2|3] [--batch N]\n"
+            "                [--iterations N] [--anchor-sync] [--csv]\n");
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+
+        if (!strcmp(a, "--csv")) {
+            opt.csv = 1;
+            continue;
+        }
+        if (!strcmp(a, "--anchor-sync")) {
+            opt.anchor_sync = 1;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        const char *v = argv[++i];
+
+        if (!strcmp(a, "--tags")) {
+            opt.tags = atoi(v);
+        } else if (!strcmp(a, "--seconds")) {
+            opt.seconds = atof(v);
+        } else if (!strcmp(a, "--sync-ms")) {
+            opt.sync_ms = atof(v);
+        } else if (!strcmp(a, "--noise-ps")) {
+            opt.noise_ps = atof(v);
+        } else if (!strcmp(a, "--rx-prob")) {
+            opt.rx_prob = atof(v);
+        } else if (!strcmp(a, "--anchors")) {
+            opt.anchors = atoi(v);
+        } else if (!strcmp(a, "--dims")) {
+            opt.dims = atoi(v);
+        } else if (!strcmp(a, "--batch")) {
+            opt.batch = atoi(v);
+        } else if (!strcmp(a, "--iterations")) {
+            opt.iterations = atoi(v);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (opt.tags < 1 || opt.tags > MAX_TAGS || opt.anchors < opt.dims + 2 ||
+        opt.anchors > TDOA_MAX_ANCHORS || (opt.dims != 2 && opt.dims != 3) || opt.batch < 1 ||
+        opt.sync_ms <= 0 || opt.sync_ms > 4000 || opt.seconds < 2 * opt.sync_ms / 1000) {
+        usage();
+        return 2;
+    }
+    return run();
+}
@@ -0,0 +1,559 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tdoa.h"
+
+/* Every loop below runs over the blinks of a batch (index k, innermost) on
+ * plain double arrays: no per-blink branches, a fixed iteration count, and
+ * selects instead of early exits, so the compiler can vectorize all of them.
+ *
+ * Ranges are taken relative to the blink's reference anchor: the one with
+ * the earliest arrival (t = 0 after tdoa_batch_add*()). */
+
+#define ALIGN           64
+
+// Lower triangle of a symmetric matrix, row-major: (i, j) with j <= i
+#define TRI(i, j)       ((i) * ((i) + 1) / 2 + (j))
+
+enum {
+    S_XR, S_YR, S_ZR, S_KR,             // reference anchor per blink, K = |a|^2
+    S_NV,                               // receiving anchors
+    S_BAD,                              // non-zero: singular normal equations
+    S_A0,                               // 10 entries: lower triangle of up to 4x4
+    S_B0 = S_A0 + 10,                   // right-hand side (4)
+    S_X0 = S_B0 + 4,                    // solution (4)
+    S_P0 = S_X0 + 4,                    // position estimate (3)
+    S_Q0 = S_P0 + 3,                    // candidate position (3)
+    S_DR = S_Q0 + 3,                    // distance to the reference anchor
+    S_C1,                               // cost of the current position
+    S_C2,                               // cost of the candidate (S_Q0)
+    S_LAM,                              // Levenberg-Marquardt damping
+    S_BAD1,                             // Chan's first stage was singular
+    S_R0,                               // design matrix row of one anchor (4)
+    S_RHS = S_R0 + 4,
+    S_COUNT
+};
+
+_Static_assert(S_COUNT <= (int)(sizeof(((struct tdoa_batch *)0)->s) /
+                                sizeof(((struct tdoa_batch *)0)->s[0])),
+               "tdoa_batch scratch too small");
+
+static double *alloc_col(int cap) {
+    const size_t bytes = ((size_t)cap * sizeof(double) + ALIGN - 1) / ALIGN * ALIGN;
+    double *p = aligned_alloc(ALIGN, bytes);
+
+    if (p) {
+        memset(p, 0, bytes);
+    }
+    return p;
+}
+
+int tdoa_batch_init(struct tdoa_batch *b, int m, int cap) {
+    memset(b, 0, sizeof(*b));
+    if (m < 1 || m > TDOA_MAX_ANCHORS || cap < 1) {
+        return -1;
+    }
+    b->m = m;
+    b->cap = cap;
+    b->id = calloc((size_t)cap, sizeof(*b->id));
+    b->ok = calloc((size_t)cap, sizeof(*b->ok));
+    b->x = alloc_col(cap);
+    b->y = alloc_col(cap);
+    b->z = alloc_col(cap);
+    b->rms_m = alloc_col(cap);
+    int fail = !b->id || !b->ok || !b->x || !b->y || !b->z || !b->rms_m;
+
+    for (int a = 0; a < m; a++) {
+        b->t[a] = alloc_col(cap);
+        b->w[a] = alloc_col(cap);
+        fail |= !b->t[a] || !b->w[a];
+    }
+    for (int i = 0; i < S_COUNT; i++) {
+        b->s[i] = alloc_col(cap);
+        fail |= !b->s[i];
+    }
+    if (fail) {
+        tdoa_batch_free(b);
+        return -1;
+    }
+    return 0;
+}
+
+void tdoa_batch_free(struct tdoa_batch *b) {
+    free(b->id);
+    free(b->ok);
+    free(b->x);
+    free(b->y);
+    free(b->z);
+    free(b->rms_m);
+    for (int a = 0; a < TDOA_MAX_ANCHORS; a++) {
+        free(b->t[a]);
+        free(b->w[a]);
+    }
+    for (int i = 0; i < S_COUNT; i++) {
+        free(b->s[i]);
+    }
+    memset(b, 0, sizeof(*b));
+}
+
+int tdoa_batch_add_times(struct tdoa_batch *b, uint32_t id, const double *t_s,
+                         uint32_t rx_mask) {
+    double t0 = INFINITY;
+
+    if (b->n >= b->cap) {
+        return -1;
+    }
+    for (int a = 0; a < b->m; a++) {
+        if ((rx_mask >> a & 1) && t_s[a] < t0) {
+            t0 = t_s[a];
+        }
+    }
+    const int k = b->n++;
+
+    b->id[k] = id;
+    for (int a = 0; a < b->m; a++) {
+        const bool rx = (rx_mask >> a & 1) != 0;
+
+        b->t[a][k] = rx ? t_s[a] - t0 : 0;
+        b->w[a][k] = rx ? 1.0 : 0.0;
+    }
+    return k;
+}
+
+int tdoa_batch_add(struct tdoa_batch *b, struct tdoa_site *s, uint32_t id,
+                   const uint64_t *rx_raw, uint32_t rx_mask) {
+    double t[TDOA_MAX_ANCHORS];
+    uint32_t mask = 0;
+    int64_t epoch = 0;
+    bool have_epoch = false;
+
+    for (int a = 0; a < b->m && a < s->an.m; a++) {
+        if (!(rx_mask >> a & 1) || !s->clk[a].valid) {
+            continue;
+        }
+        const int64_t local = tdoa_unwrap(&s->ts[a], rx_raw[a]);
+
+        if (!have_epoch) {
+            // Any reference time near the blink keeps the doubles small
+            epoch = local - s->clk[a].base;
+            have_epoch = true;
+        }
+        t[a] = tdoa_clock_to_ref(&s->clk[a], local, epoch) * TDOA_TICK_S;
+        mask |= 1u << a;
+    }
+    return tdoa_batch_add_times(b, id, t, mask);
+}
+
+/* Kernels: one loop over the blinks each. restrict parameters let the
+ * compiler vectorize without run-time alias checks; kept out of line because
+ * inlining them into the per-anchor loops drops that information. */
+#define KERNEL          static __attribute__((noinline)) void
+
+KERNEL k_sub_mul(int n, double *restrict y, const double *restrict a,
+                      const double *restrict b) {
+    for (int k = 0; k < n; k++) {
+        y[k] -= a[k] * b[k];
+    }
+}
+
+KERNEL k_add_wmul(int n, double *restrict y, const double *restrict w,
+                       const double *restrict a, const double *restrict b) {
+    for (int k = 0; k < n; k++) {
+        y[k] += w[k] * a[k] * b[k];
+    }
+}
+
+KERNEL k_div(int n, double *restrict y, const double *restrict d) {
+    for (int k = 0; k < n; k++) {
+        y[k] /= d[k];
+    }
+}
+
+KERNEL k_pivot(int n, double *restrict ajj, double *restrict bad) {
+    for (int k = 0; k < n; k++) {
+        const int pos = ajj[k] > 1e-12;
+
+        bad[k] += pos ? 0.0 : 1.0;
+        ajj[k] = sqrt(pos ? ajj[k] : 1.0);
+    }
+}
+
+KERNEL k_back(int n, double *restrict x, const double *restrict lii,
+                   const double *restrict bad) {
+    for (int k = 0; k < n; k++) {
+        x[k] = bad[k] != 0 ? 0.0 : x[k] / lii[k];
+    }
+}
+
+/* Solve the d x d symmetric systems A x = b of every blink (Cholesky, in place
+ * on A). A non-positive pivot marks the blink in S_BAD and yields x = 0. */
+static void spd_solve(double *const *s, int d, int n) {
+    for (int j = 0; j < d; j++) {
+        for (int i = j; i < d; i++) {
+            for (int m = 0; m < j; m++) {
+                k_sub_mul(n, s[S_A0 + TRI(i, j)], s[S_A0 + TRI(i, m)], s[S_A0 + TRI(j, m)]);
+            }
+            if (i == j) {
+                k_pivot(n, s[S_A0 + TRI(j, j)], s[S_BAD]);
+            } else {
+                k_div(n, s[S_A0 + TRI(i, j)], s[S_A0 + TRI(j, j)]);
+            }
+        }
+    }
+    // L y = b (y overwrites b), then L' x = y
+    for (int i = 0; i < d; i++) {
+        for (int m = 0; m < i; m++) {
+            k_sub_mul(n, s[S_B0 + i], s[S_A0 + TRI(i, m)], s[S_B0 + m]);
+        }
+        k_div(n, s[S_B0 + i], s[S_A0 + TRI(i, i)]);
+    }
+    for (int i = d - 1; i >= 0; i--) {
+        memcpy(s[S_X0 + i], s[S_B0 + i], (size_t)n * sizeof(double));
+        for (int m = i + 1; m < d; m++) {
+            k_sub_mul(n, s[S_X0 + i], s[S_A0 + TRI(m, i)], s[S_X0 + m]);
+        }
+        k_back(n, s[S_X0 + i], s[S_A0 + TRI(i, i)], s[S_BAD]);
+    }
+}
+
+static void zero_normal(double *const *s, int d, int n) {
+    for (int i = 0; i < TRI(d, 0); i++) {
+        memset(s[S_A0 + i], 0, (size_t)n * sizeof(double));
+    }
+    for (int i = 0; i < d; i++) {
+        memset(s[S_B0 + i], 0, (size_t)n * sizeof(double));
+    }
+}
+
+// Normal equations += w * row row', w * row rhs (rows in S_R0.., S_RHS)
+static void accumulate(double *const *s, int d, int n, const double *w) {
+    for (int i = 0; i < d; i++) {
+        for (int j = 0; j <= i; j++) {
+            k_add_wmul(n, s[S_A0 + TRI(i, j)], w, s[S_R0 + i], s[S_R0 + j]);
+        }
+        k_add_wmul(n, s[S_B0 + i], w, s[S_R0 + i], s[S_RHS]);
+    }
+}
+
+// Reference anchor = the one with t == 0; count receivers
+KERNEL k_reference(int n, const double *restrict t, const double *restrict w,
+                        double ax, double ay, double az, double *restrict xr,
+                        double *restrict yr, double *restrict zr, double *restrict kr,
+                        double *restrict nv) {
+    const double ka = ax * ax + ay * ay + az * az;
+
+    for (int k = 0; k < n; k++) {
+        const int ref = (w[k] > 0) & (t[k] == 0);
+
+        xr[k] = ref ? ax : xr[k];
+        yr[k] = ref ? ay : yr[k];
+        zr[k] = ref ? az : zr[k];
+        kr[k] = ref ? ka : kr[k];
+        nv[k] += w[k] > 0 ? 1.0 : 0.0;
+    }
+}
+
+/* Chan, first stage: with r = c (t_a - t_ref) and R = |p - ref|,
+ * (a - ref).p + r R = (K_a - K_ref - r^2) / 2 is linear in (p, R). In 2D the
+ * known height moves to the right-hand side (r2 is then R's column). */
+KERNEL k_chan_rows(int n, int d, double tz, const double *restrict t, double ax,
+                        double ay, double az, const double *restrict xr,
+                        const double *restrict yr, const double *restrict zr,
+                        const double *restrict kr, double *restrict r0, double *restrict r1,
+                        double *restrict r2, double *restrict r3, double *restrict rhs) {
+    const double ka = ax * ax + ay * ay + az * az;
+
+    if (d == 3) {
+        for (int k = 0; k < n; k++) {
+            const double r = TDOA_C_M_S * t[k];
+
+            r0[k] = ax - xr[k];
+            r1[k] = ay - yr[k];
+            r2[k] = az - zr[k];
+            r3[k] = r;
+            rhs[k] = 0.5 * (ka - kr[k] - r * r);
+        }
+    } else {
+        for (int k = 0; k < n; k++) {
+            const double r = TDOA_C_M_S * t[k];
+
+            r0[k] = ax - xr[k];
+            r1[k] = ay - yr[k];
+            r2[k] = r;
+            rhs[k] = 0.5 * (ka - kr[k] - r * r) - (az - zr[k]) * tz;
+        }
+    }
+}
+
+/* Chan, second stage: R^2 = sum (p_i - ref_i)^2 is linear in u_i = (p_i - ref_i)^2.
+ * Least squares with the first-stage values h gives u = h - (sum h - R^2) / (d + 1);
+ * the signs come from the first stage. First stage -> p, second stage -> q. */
+KERNEL k_chan_stage2(int n, int d, double tz, const double *restrict s1x,
+                          const double *restrict s1y, const double *restrict s1z,
+                          const double *restrict s1r, const double *restrict xr,
+                          const double *restrict yr, const double *restrict zr,
+                          double *restrict px, double *restrict py, double *restrict pz,
+                          double *restrict qx, double *restrict qy, double *restrict qz) {
+    for (int k = 0; k < n; k++) {
+        const double ex = s1x[k] - xr[k];
+        const double ey = s1y[k] - yr[k];
+        const double ez = d == 3 ? s1z[k] - zr[k] : tz - zr[k];
+        const double hr = s1r[k] * s1r[k] - (d == 3 ? 0 : ez * ez);
+        const double corr = ((ex * ex + ey * ey + (d == 3 ? ez * ez : 0)) - hr) / (d + 1);
+        const double ux = ex * ex - corr;
+        const double uy = ey * ey - corr;
+        const double uz = ez * ez - corr;
+
+        px[k] = s1x[k];
+        py[k] = s1y[k];
+        pz[k] = d == 3 ? s1z[k] : tz;
+        qx[k] = xr[k] + copysign(sqrt(ux > 0 ? ux : 0), ex);
+        qy[k] = yr[k] + copysign(sqrt(uy > 0 ? uy : 0), ey);
+        qz[k] = d == 3 ? zr[k] + copysign(sqrt(uz > 0 ? uz : 0), ez) : tz;
+    }
+}
+
+// Move to the candidate where it lowers the cost; adapt the damping
+KERNEL k_accept(int n, double *restrict c1, const double *restrict c2,
+                double *restrict px, double *restrict py, double *restrict pz,
+                const double *restrict qx, const double *restrict qy,
+                const double *restrict qz, double *restrict lam) {
+    for (int k = 0; k < n; k++) {
+        const int better = c2[k] < c1[k];
+        const double up = lam[k] * 10 < 1e6 ? lam[k] * 10 : 1e6;
+        const double down = lam[k] * 0.1 > 1e-9 ? lam[k] * 0.1 : 1e-9;
+
+        px[k] = better ? qx[k] : px[k];
+        py[k] = better ? qy[k] : py[k];
+        pz[k] = better ? qz[k] : pz[k];
+        c1[k] = better ? c2[k] : c1[k];
+        lam[k] = better ? down : up;
+    }
+}
+
+KERNEL k_ref_dist(int n, const double *restrict px, const double *restrict py,
+                       const double *restrict pz, const double *restrict xr,
+                       const double *restrict yr, const double *restrict zr,
+                       double *restrict dr) {
+    for (int k = 0; k < n; k++) {
+        const double dx = px[k] - xr[k], dy = py[k] - yr[k], dz = pz[k] - zr[k];
+        const double r = sqrt(dx * dx + dy * dy + dz * dz);
+
+        dr[k] = r > 1e-6 ? r : 1e-6;
+    }
+}
+
+// cost += w * (|p - a| - |p - ref| - r)^2
+KERNEL k_cost(int n, const double *restrict t, const double *restrict w, double ax,
+                   double ay, double az, const double *restrict px, const double *restrict py,
+                   const double *restrict pz, const double *restrict dr,
+                   double *restrict cost) {
+    for (int k = 0; k < n; k++) {
+        const double dx = px[k] - ax, dy = py[k] - ay, dz = pz[k] - az;
+        const double res = sqrt(dx * dx + dy * dy + dz * dz) - dr[k] - TDOA_C_M_S * t[k];
+
+        cost[k] += w[k] * res * res;
+    }
+}
+
+// Gauss-Newton row: d(|p - a| - |p - ref|)/dp and the residual
+KERNEL k_gn_rows(int n, const double *restrict t, double ax, double ay, double az,
+                      const double *restrict px, const double *restrict py,
+                      const double *restrict pz, const double *restrict xr,
+                      const double *restrict yr, const double *restrict zr,
+                      const double *restrict dr, double *restrict g0, double *restrict g1,
+                      double *restrict g2, double *restrict res) {
+    for (int k = 0; k < n; k++) {
+        const double dx = px[k] - ax, dy = py[k] - ay, dz = pz[k] - az;
+        const double da0 = sqrt(dx * dx + dy * dy + dz * dz);
+        const double da = da0 > 1e-6 ? da0 : 1e-6;
+
+        res[k] = da - dr[k] - TDOA_C_M_S * t[k];
+        g0[k] = dx / da - (px[k] - xr[k]) / dr[k];
+        g1[k] = dy / da - (py[k] - yr[k]) / dr[k];
+        g2[k] = dz / da - (pz[k] - zr[k]) / dr[k];
+    }
+}
+
+KERNEL k_damp(int n, double *restrict aii, const double *restrict lam) {
+    for (int k = 0; k < n; k++) {
+        aii[k] *= 1 + lam[k];
+    }
+}
+
+KERNEL k_candidate(int n, int d, const double *restrict px, const double *restrict py,
+                   const double *restrict pz, const double *restrict sx,
+                   const double *restrict sy, const double *restrict sz,
+                   double *restrict qx, double *restrict qy, double *restrict qz) {
+    for (int k = 0; k < n; k++) {
+        qx[k] = px[k] - sx[k];
+        qy[k] = py[k] - sy[k];
+        qz[k] = d == 3 ? pz[k] - sz[k] : pz[k];
+    }
+}
+
+// Centroid of the receiving anchors, at height z
+KERNEL k_centroid_add(int n, const double *restrict w, double ax, double ay,
+                      double *restrict cx, double *restrict cy) {
+    for (int k = 0; k < n; k++) {
+        const double r = w[k] > 0 ? 1.0 : 0.0;
+
+        cx[k] += r * ax;
+        cy[k] += r * ay;
+    }
+}
+
+KERNEL k_centroid_end(int n, const double *restrict nv, double z, double *restrict cx,
+                      double *restrict cy, double *restrict cz) {
+    for (int k = 0; k < n; k++) {
+        const double v = nv[k] > 0 ? nv[k] : 1.0;
+
+        cx[k] /= v;
+        cy[k] /= v;
+        cz[k] = z;
+    }
+}
+
+// cost += penalty outside [lo, hi], for one axis
+KERNEL k_band(int n, const double *restrict p, double lo, double hi, double *restrict cost) {
+    for (int k = 0; k < n; k++) {
+        const double below = lo - p[k] > 0 ? lo - p[k] : 0;
+        const double above = p[k] - hi > 0 ? p[k] - hi : 0;
+
+        cost[k] += 1e3 * (below * below + above * above);
+    }
+}
+
+static void tdoa_cost(const struct tdoa_batch *b, const struct tdoa_anchors *an,
+                      const struct tdoa_solve_cfg *cfg, int p0, double *cost) {
+    double *const *s = b->s;
+
+    k_ref_dist(b->n, s[p0], s[p0 + 1], s[p0 + 2], s[S_XR], s[S_YR], s[S_ZR], s[S_DR]);
+    memset(cost, 0, (size_t)b->n * sizeof(double));
+    for (int a = 0; a < b->m; a++) {
+        k_cost(b->n, b->t[a], b->w[a], an->x[a], an->y[a], an->z[a], s[p0], s[p0 + 1],
+               s[p0 + 2], s[S_DR], cost);
+    }
+    for (int i = 0; i < (cfg->dims == 3 ? 3 : 2); i++) {
+        if (cfg->box_max[i] > cfg->box_min[i]) {
+            k_band(b->n, s[p0 + i], cfg->box_min[i], cfg->box_max[i], cost);
+        }
+    }
+}
+
+/* Chan's method in d dimensions (2: at height tz): first stage for (p, R),
+ * second stage from the constraint on R. Candidates go to p0 and q0. */
+static void chan(struct tdoa_batch *b, const struct tdoa_anchors *an, int d, double tz,
+                 int p0, int q0) {
+    double *const *s = b->s;
+    const int n = b->n;
+
+    zero_normal(s, d + 1, n);
+    memset(s[S_BAD], 0, (size_t)n * sizeof(double));
+    for (int a = 0; a < b->m; a++) {
+        k_chan_rows(n, d, tz, b->t[a], an->x[a], an->y[a], an->z[a], s[S_XR], s[S_YR],
+                    s[S_ZR], s[S_KR], s[S_R0], s[S_R0 + 1], s[S_R0 + 2], s[S_R0 + 3],
+                    s[S_RHS]);
+        accumulate(s, d + 1, n, b->w[a]);
+    }
+    spd_solve(s, d + 1, n);
+    k_chan_stage2(n, d, tz, s[S_X0], s[S_X0 + 1], s[S_X0 + 2], s[S_X0 + d], s[S_XR], s[S_YR],
+                  s[S_ZR], s[p0], s[p0 + 1], s[p0 + 2], s[q0], s[q0 + 1], s[q0 + 2]);
+}
+
+static void fill(double *p, int n, double v) {
+    for (int k = 0; k < n; k++) {
+        p[k] = v;
+    }
+}
+
+int tdoa_solve_batch(struct tdoa_batch *b, const struct tdoa_anchors *an,
+                     const struct tdoa_solve_cfg *cfg) {
+    double *const *s = b->s;
+    const int n = b->n;
+    const int d = cfg->dims == 3 ? 3 : 2;
+
+    if (n == 0) {
+        return 0;
+    }
+    memset(s[S_NV], 0, (size_t)n * sizeof(double));
+    for (int a = 0; a < b->m; a++) {
+        k_reference(n, b->t[a], b->w[a], an->x[a], an->y[a], an->z[a], s[S_XR], s[S_YR],
+                    s[S_ZR], s[S_KR], s[S_NV]);
+    }
+
+    /* Start from whichever fits the range differences best: Chan's two stages
+     * or the centroid of the receiving anchors (for blinks heard by few
+     * anchors, where the first stage amplifies the noise) */
+    chan(b, an, d, cfg->tag_z, S_P0, S_Q0);
+    memcpy(s[S_BAD1], s[S_BAD], (size_t)n * sizeof(double));
+    fill(s[S_LAM], n, 1e-3);
+    tdoa_cost(b, an, cfg, S_P0, s[S_C1]);
+    tdoa_cost(b, an, cfg, S_Q0, s[S_C2]);
+    k_accept(n, s[S_C1], s[S_C2], s[S_P0], s[S_P0 + 1], s[S_P0 + 2], s[S_Q0], s[S_Q0 + 1],
+             s[S_Q0 + 2], s[S_LAM]);
+    memset(s[S_Q0], 0, (size_t)n * sizeof(double));
+    memset(s[S_Q0 + 1], 0, (size_t)n * sizeof(double));
+    for (int a = 0; a < b->m; a++) {
+        k_centroid_add(n, b->w[a], an->x[a], an->y[a], s[S_Q0], s[S_Q0 + 1]);
+    }
+    k_centroid_end(n, s[S_NV], cfg->tag_z, s[S_Q0], s[S_Q0 + 1], s[S_Q0 + 2]);
+    tdoa_cost(b, an, cfg, S_Q0, s[S_C2]);
+    k_accept(n, s[S_C1], s[S_C2], s[S_P0], s[S_P0 + 1], s[S_P0 + 2], s[S_Q0], s[S_Q0 + 1],
+             s[S_Q0 + 2], s[S_LAM]);
+    if (d == 3) {
+        /* The 3D first stage is sensitive to noise when the anchors' heights
+         * vary little; the 2D solution at tag_z is a second starting point */
+        chan(b, an, 2, cfg->tag_z, S_Q0, S_R0);
+        tdoa_cost(b, an, cfg, S_Q0, s[S_C2]);
+        k_accept(n, s[S_C1], s[S_C2], s[S_P0], s[S_P0 + 1], s[S_P0 + 2], s[S_Q0],
+                 s[S_Q0 + 1], s[S_Q0 + 2], s[S_LAM]);
+        tdoa_cost(b, an, cfg, S_R0, s[S_C2]);
+        k_accept(n, s[S_C1], s[S_C2], s[S_P0], s[S_P0 + 1], s[S_P0 + 2], s[S_R0],
+                 s[S_R0 + 1], s[S_R0 + 2], s[S_LAM]);
+        for (int k = 0; k < n; k++) {
+            s[S_BAD1][k] *= s[S_BAD][k];    // usable if either start was
+        }
+    }
+
+    /* Gauss-Newton on the range differences, damped (Levenberg-Marquardt) and
+     * accepting a step only where it lowers the cost: with poor vertical
+     * geometry the plain iteration can slide along the flat direction. */
+    fill(s[S_LAM], n, 1e-2);
+    for (int it = 0; it < cfg->iterations; it++) {
+        zero_normal(s, d, n);
+        memset(s[S_BAD], 0, (size_t)n * sizeof(double));
+        k_ref_dist(n, s[S_P0], s[S_P0 + 1], s[S_P0 + 2], s[S_XR], s[S_YR], s[S_ZR], s[S_DR]);
+        for (int a = 0; a < b->m; a++) {
+            k_gn_rows(n, b->t[a], an->x[a], an->y[a], an->z[a], s[S_P0], s[S_P0 + 1],
+                      s[S_P0 + 2], s[S_XR], s[S_YR], s[S_ZR], s[S_DR], s[S_R0], s[S_R0 + 1],
+                      s[S_R0 + 2], s[S_RHS]);
+            accumulate(s, d, n, b->w[a]);
+        }
+        for (int i = 0; i < d; i++) {
+            k_damp(n, s[S_A0 + TRI(i, i)], s[S_LAM]);
+        }
+        spd_solve(s, d, n);
+        k_candidate(n, d, s[S_P0], s[S_P0 + 1], s[S_P0 + 2], s[S_X0], s[S_X0 + 1],
+                    s[S_X0 + 2], s[S_Q0], s[S_Q0 + 1], s[S_Q0 + 2]);
+        tdoa_cost(b, an, cfg, S_Q0, s[S_C2]);
+        k_accept(n, s[S_C1], s[S_C2], s[S_P0], s[S_P0 + 1], s[S_P0 + 2], s[S_Q0],
+                 s[S_Q0 + 1], s[S_Q0 + 2], s[S_LAM]);
+    }
+
+    int solved = 0;
+
+    for (int k = 0; k < n; k++) {
+        const double nv = s[S_NV][k];
+        const bool ok = nv >= d + 2 && s[S_BAD1][k] == 0 && isfinite(s[S_P0][k]) &&
+                        isfinite(s[S_P0 + 1][k]) && isfinite(s[S_P0 + 2][k]);
+
+        b->x[k] = s[S_P0][k];
+        b->y[k] = s[S_P0 + 1][k];
+        b->z[k] = s[S_P0 + 2][k];
+        b->rms_m[k] = sqrt(s[S_C1][k] / (nv > 1 ? nv - 1 : 1));
+        b->ok[k] = ok;
+        solved += ok;
+    }
+    return solved;
+}
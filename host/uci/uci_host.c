@@ -0,0 +1,311 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "uwb_frame.h"
+#include "uci_host.h"
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int uci_host_open(struct uci_host *h, const char *path) {
+    const int fd = open(path, O_RDWR | O_NOCTTY);
+    struct termios tio;
+
+    if (fd < 0) {
+        return -errno;
+    }
+    // CDC ACM ignores the baud rate; raw mode so no byte is translated
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, B115200);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+        tcflush(fd, TCIOFLUSH);
+    }
+    uci_host_attach(h, fd);
+    return 0;
+}
+
+void uci_host_attach(struct uci_host *h, int fd) {
+    h->fd = fd;
+    uci_parser_reset(&h->parser);
+}
+
+void uci_host_close(struct uci_host *h) {
+    if (h->fd >= 0) {
+        close(h->fd);
+        h->fd = -1;
+    }
+}
+
+static int write_all(int fd, const uint8_t *buf, size_t len) {
+    while (len) {
+        const ssize_t n = write(fd, buf, len);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Read until one packet is complete (in h->parser.buf) or the deadline passes.
+ * Returns the packet length, 0 on timeout or -errno. */
+static int read_pkt(struct uci_host *h, int64_t deadline) {
+    while (1) {
+        const int64_t left = deadline - now_ms();
+        struct pollfd pfd = { .fd = h->fd, .events = POLLIN };
+
+        if (left <= 0) {
+            return 0;
+        }
+        const int r = poll(&pfd, 1, (int)left);
+
+        if (r < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        if (r == 0) {
+            return 0;
+        }
+
+        uint8_t byte;
+        const ssize_t n = read(h->fd, &byte, 1);
+
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return -errno;
+        }
+        if (n == 0) {
+            return -EPIPE;      // device unplugged / peer closed
+        }
+        const uint16_t len = uci_parser_feed(&h->parser, byte);
+
+        if (len) {
+            return len;
+        }
+    }
+}
+
+static void dispatch_ntf(struct uci_host *h, uint16_t len) {
+    if (h->on_ntf) {
+        h->on_ntf(h->parser.buf, len, h->ctx);
+    }
+}
+
+int uci_host_cmd(struct uci_host *h, uint8_t gid, uint8_t oid, const uint8_t *payload,
+                 uint8_t len, uint8_t *rsp, int timeout_ms) {
+    uint8_t pkt[UCI_MAX_PKT];
+    const int64_t deadline = now_ms() + timeout_ms;
+    int ret = write_all(h->fd, pkt, uci_pkt_build(pkt, UCI_MT_CMD, gid, oid, payload, len));
+
+    if (ret) {
+        return ret;
+    }
+    while ((ret = read_pkt(h, deadline)) > 0) {
+        const uint8_t *p = h->parser.buf;
+
+        if (uci_hdr_mt(p) == UCI_MT_NTF) {
+            dispatch_ntf(h, (uint16_t)ret);
+        } else if (uci_hdr_mt(p) == UCI_MT_RSP && uci_hdr_gid(p) == gid &&
+                   uci_hdr_oid(p) == oid) {
+            memcpy(rsp, &p[UCI_HDR_LEN], p[3]);
+            return p[3];
+        }
+    }
+    return ret ? ret : -ETIMEDOUT;
+}
+
+int uci_host_poll(struct uci_host *h, int timeout_ms) {
+    const int64_t deadline = now_ms() + timeout_ms;
+    int handled = 0;
+    int ret;
+
+    while ((ret = read_pkt(h, deadline)) > 0) {
+        if (uci_hdr_mt(h->parser.buf) == UCI_MT_NTF) {
+            dispatch_ntf(h, (uint16_t)ret);
+            handled++;
+        }
+    }
+    return ret < 0 ? ret : handled;
+}
+
+#define UCI_TIMEOUT_MS  1000
+
+static int status_cmd(struct uci_host *h, uint8_t gid, uint8_t oid, const uint8_t *payload,
+                      uint8_t len) {
+    uint8_t rsp[UCI_MAX_PAYLOAD];
+    const int n = uci_host_cmd(h, gid, oid, payload, len, rsp, UCI_TIMEOUT_MS);
+
+    if (n < 0) {
+        return n;
+    }
+    return n ? rsp[0] : -EBADMSG;
+}
+
+static int session_cmd(struct uci_host *h, uint8_t gid, uint8_t oid, uint32_t session_id) {
+    uint8_t p[4];
+
+    uwb_put_u32(p, session_id);
+    return status_cmd(h, gid, oid, p, sizeof(p));
+}
+
+int uci_device_info(struct uci_host *h, char *vendor, size_t size) {
+    uint8_t rsp[UCI_MAX_PAYLOAD];
+    const int n = uci_host_cmd(h, UCI_GID_CORE, UCI_OID_DEVICE_INFO, NULL, 0, rsp,
+                               UCI_TIMEOUT_MS);
+
+    if (n < 1) {
+        return n < 0 ? n : -EBADMSG;
+    }
+    if (vendor && size) {
+        size_t vlen = (n >= 10 && rsp[9] <= n - 10) ? rsp[9] : 0;
+
+        if (vlen >= size) {
+            vlen = size - 1;
+        }
+        memcpy(vendor, &rsp[10], vlen);
+        vendor[vlen] = '\0';
+    }
+    return rsp[0];
+}
+
+int uci_session_init(struct uci_host *h, uint32_t session_id) {
+    uint8_t p[5];
+
+    uwb_put_u32(p, session_id);
+    p[4] = UCI_SESSION_TYPE_RANGING;
+    return status_cmd(h, UCI_GID_SESSION_CFG, UCI_OID_SESSION_INIT, p, sizeof(p));
+}
+
+int uci_session_deinit(struct uci_host *h, uint32_t session_id) {
+    return session_cmd(h, UCI_GID_SESSION_CFG, UCI_OID_SESSION_DEINIT, session_id);
+}
+
+int uci_set_ranging_interval(struct uci_host *h, uint32_t session_id, uint32_t interval_ms) {
+    uint8_t p[11];
+
+    uwb_put_u32(&p[0], session_id);
+    p[4] = 1;
+    p[5] = UCI_CFG_RANGING_INTERVAL;
+    p[6] = 4;
+    uwb_put_u32(&p[7], interval_ms);
+    return status_cmd(h, UCI_GID_SESSION_CFG, UCI_OID_SET_APP_CONFIG, p, sizeof(p));
+}
+
+int uci_range_start(struct uci_host *h, uint32_t session_id) {
+    return session_cmd(h, UCI_GID_SESSION_CTRL, UCI_OID_RANGE_START, session_id);
+}
+
+int uci_range_stop(struct uci_host *h, uint32_t session_id) {
+    return session_cmd(h, UCI_GID_SESSION_CTRL, UCI_OID_RANGE_STOP, session_id);
+}
+
+int uci_log_info(struct uci_host *h, struct uci_log_info *out) {
+    uint8_t rsp[UCI_MAX_PAYLOAD];
+    const int n = uci_host_cmd(h, UCI_GID_LOG, UCI_OID_LOG_INFO, NULL, 0, rsp, UCI_TIMEOUT_MS);
+
+    if (n < 1) {
+        return n < 0 ? n : -EBADMSG;
+    }
+    if (rsp[0] != UCI_STATUS_OK) {
+        return rsp[0];
+    }
+    if (n != UCI_LOG_INFO_LEN) {
+        return -EBADMSG;
+    }
+    *out = (struct uci_log_info){
+        .capacity = uwb_get_u32(&rsp[1]),
+        .used = uwb_get_u32(&rsp[5]),
+        .blocks = uwb_get_u32(&rsp[9]),
+        .records = uwb_get_u32(&rsp[13]),
+        .lost = uwb_get_u32(&rsp[17]),
+        .erases = uwb_get_u32(&rsp[21]),
+        .pending = uwb_get_u16(&rsp[25]),
+    };
+    return UCI_STATUS_OK;
+}
+
+int uci_log_read(struct uci_host *h, int restart, uint8_t *buf, uint16_t *block_len,
+                 uint16_t *offset, int *status) {
+    uint8_t rsp[UCI_MAX_PAYLOAD];
+    const uint8_t p = restart ? 1 : 0;
+    const int n = uci_host_cmd(h, UCI_GID_LOG, UCI_OID_LOG_READ, &p, 1, rsp, UCI_TIMEOUT_MS);
+
+    if (n < 1) {
+        return n < 0 ? n : -EBADMSG;
+    }
+    *status = rsp[0];
+    if (rsp[0] != UCI_STATUS_OK) {
+        return 0;
+    }
+    if (n < UCI_LOG_READ_HDR_LEN) {
+        return -EBADMSG;
+    }
+    *block_len = uwb_get_u16(&rsp[1]);
+    *offset = uwb_get_u16(&rsp[3]);
+    memcpy(buf, &rsp[UCI_LOG_READ_HDR_LEN], (size_t)(n - UCI_LOG_READ_HDR_LEN));
+    return n - UCI_LOG_READ_HDR_LEN;
+}
+
+int uci_log_erase(struct uci_host *h) {
+    uint8_t rsp[UCI_MAX_PAYLOAD];
+    // Erasing every sector stalls the tag for a while
+    const int n = uci_host_cmd(h, UCI_GID_LOG, UCI_OID_LOG_ERASE, NULL, 0, rsp, 10 * UCI_TIMEOUT_MS);
+
+    if (n < 1) {
+        return n < 0 ? n : -EBADMSG;
+    }
+    return rsp[0];
+}
+
+int uci_decode_range_ntf(const uint8_t *pkt, uint16_t len, struct uci_range_ntf *out) {
+    const uint8_t *p = &pkt[UCI_HDR_LEN];
+
+    if (len < UCI_HDR_LEN + UCI_RANGE_NTF_HDR_LEN || uci_hdr_mt(pkt) != UCI_MT_NTF ||
+        uci_hdr_gid(pkt) != UCI_GID_SESSION_CTRL || uci_hdr_oid(pkt) != UCI_OID_RANGE_START) {
+        return -EINVAL;
+    }
+    out->seq = uwb_get_u32(&p[0]);
+    out->session_id = uwb_get_u32(&p[4]);
+    out->interval_ms = uwb_get_u32(&p[8]);
+    out->type = p[12];
+    out->n = p[13];
+    if (out->n > sizeof(out->meas) / sizeof(out->meas[0]) ||
+        pkt[3] != UCI_RANGE_NTF_HDR_LEN + out->n * UCI_RANGE_MEAS_LEN) {
+        return -EINVAL;
+    }
+    for (uint8_t i = 0; i < out->n; i++) {
+        const uint8_t *m = &p[UCI_RANGE_NTF_HDR_LEN + i * UCI_RANGE_MEAS_LEN];
+
+        // m[4..5] is the distance in cm (FiRa field), redundant with dist_mm
+        out->meas[i] = (struct uci_range_meas){
+            .mac = uwb_get_u16(&m[0]),
+            .status = m[2],
+            .nlos = m[3],
+            .dist_mm = uwb_get_u32(&m[6]),
+            .report_mm = uwb_get_u32(&m[10]),
+            .toa_diff_dtu = (int16_t)uwb_get_u16(&m[14]),
+        };
+    }
+    return 0;
+}
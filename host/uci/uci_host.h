@@ -0,0 +1,63 @@
+#ifndef UCI_HOST_H
+#define UCI_HOST_H
+
+#include <stdint.h>
+#include "uwb_uci_proto.h"
+
+/* Host side of the tag's UCI interface (see src/uwb_uci_proto.h for the wire
+ * format). POSIX: a serial port (/dev/ttyACM*) or any connected stream fd. */
+
+struct uci_host {
+    int fd;
+    struct uci_parser parser;
+    // Called for every notification, including those that arrive while a
+    // command waits for its response
+    void (*on_ntf)(const uint8_t *pkt, uint16_t len, void *ctx);
+    void *ctx;
+};
+
+struct uci_range_ntf {
+    uint32_t seq;
+    uint32_t session_id;
+    uint32_t interval_ms;
+    uint8_t type;
+    uint8_t n;
+    struct uci_range_meas meas[(UCI_MAX_PAYLOAD - UCI_RANGE_NTF_HDR_LEN) / UCI_RANGE_MEAS_LEN];
+};
+
+/* Open a CDC ACM / serial port in raw mode. Returns 0 or -errno. */
+int uci_host_open(struct uci_host *h, const char *path);
+
+/* Use an already connected stream (socket, pipe pair, pty). */
+void uci_host_attach(struct uci_host *h, int fd);
+
+void uci_host_close(struct uci_host *h);
+
+/* Send a command and wait up to timeout_ms for its response. The response
+ * payload (status first) is copied to rsp (UCI_MAX_PAYLOAD bytes).
+ * Returns the payload length or -errno (-ETIMEDOUT). */
+int uci_host_cmd(struct uci_host *h, uint8_t gid, uint8_t oid, const uint8_t *payload,
+                 uint8_t len, uint8_t *rsp, int timeout_ms);
+
+/* Dispatch notifications for up to timeout_ms. Returns the number handled or -errno. */
+int uci_host_poll(struct uci_host *h, int timeout_ms);
+
+/* Convenience wrappers: return the UCI status (>= 0) or -errno. */
+int uci_device_info(struct uci_host *h, char *vendor, size_t size);
+int uci_session_init(struct uci_host *h, uint32_t session_id);
+int uci_session_deinit(struct uci_host *h, uint32_t session_id);
+int uci_set_ranging_interval(struct uci_host *h, uint32_t session_id, uint32_t interval_ms);
+int uci_range_start(struct uci_host *h, uint32_t session_id);
+int uci_range_stop(struct uci_host *h, uint32_t session_id);
+
+/* Range log (UCI_GID_LOG). uci_log_read returns the data length (0 at the end
+ * of the log) and stores the UCI status in *status, or returns -errno. */
+int uci_log_info(struct uci_host *h, struct uci_log_info *out);
+int uci_log_read(struct uci_host *h, int restart, uint8_t *buf, uint16_t *block_len,
+                 uint16_t *offset, int *status);
+int uci_log_erase(struct uci_host *h);
+
+/* Decode a RANGE_DATA_NTF packet. Returns 0 or -EINVAL. */
+int uci_decode_range_ntf(const uint8_t *pkt, uint16_t len, struct uci_range_ntf *out);
+
+#endif /* UCI_HOST_H */
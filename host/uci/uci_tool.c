@@ -0,0 +1,630 @@
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "uwb_frame.h"
+#include "uwb_rangelog_proto.h"
+#include "uci_host.h"
+
+/* UCI host tool for the tag firmware built with overlay-uci.conf.
+ *
+ *   uci_tool <port> info
+ *   uci_tool <port> start [interval_ms] [count]    range until count results or Ctrl-C
+ *   uci_tool <port> stop                           stop and deinit a stale session
+ *   uci_tool <port> log-info                       range log fill and counters
+ *   uci_tool <port> log-read <out.log>             read out the range log (host/rangelog)
+ *   uci_tool <port> log-erase
+ *   uci_tool --loopback                            scripted session against uwb_uci_proto.c
+ *
+ * --loopback links the firmware's protocol code into a stand-in device thread
+ * on the other end of a socketpair, with fake radio ops, so the host library
+ * and the device state machine can be exercised without hardware.
+ *
+ * log-read writes every stored block as len(2, little endian) + block, oldest
+ * first; rangelog_dump (host/rangelog) decodes the file.
+ */
+
+#define SESSION_ID  0x00000001u
+
+static volatile sig_atomic_t stop_requested;
+
+static const char *status_str(int st) {
+    switch (st) {
+    case UCI_STATUS_OK:                 return "OK";
+    case UCI_STATUS_REJECTED:           return "REJECTED";
+    case UCI_STATUS_FAILED:             return "FAILED";
+    case UCI_STATUS_SYNTAX_ERROR:       return "SYNTAX_ERROR";
+    case UCI_STATUS_INVALID_PARAM:      return "INVALID_PARAM";
+    case UCI_STATUS_INVALID_RANGE:      return "INVALID_RANGE";
+    case UCI_STATUS_INVALID_MSG_SIZE:   return "INVALID_MSG_SIZE";
+    case UCI_STATUS_UNKNOWN_GID:        return "UNKNOWN_GID";
+    case UCI_STATUS_UNKNOWN_OID:        return "UNKNOWN_OID";
+    case UCI_STATUS_READ_ONLY:          return "READ_ONLY";
+    case UCI_STATUS_SESSION_NOT_EXIST:  return "SESSION_NOT_EXIST";
+    case UCI_STATUS_SESSION_DUPLICATE:  return "SESSION_DUPLICATE";
+    case UCI_STATUS_SESSION_ACTIVE:     return "SESSION_ACTIVE";
+    case UCI_STATUS_MAX_SESSIONS:       return "MAX_SESSIONS";
+    case UCI_STATUS_RANGING_TX_FAILED:  return "TX_FAILED";
+    case UCI_STATUS_RANGING_RX_TIMEOUT: return "RX_TIMEOUT";
+    case UCI_STATUS_RANGING_TOA_FAILED: return "TOA_FAILED";
+    case -ETIMEDOUT:                    return "timeout";
+    default:                            return st < 0 ? strerror(-st) : "?";
+    }
+}
+
+// ================= Notification collection =================
+struct ntf_log {
+    uint32_t range_ntfs;
+    uint32_t seq_gaps;
+    uint32_t next_seq;
+    uint32_t limit;             // stop after this many range notifications (0 = none)
+    uint8_t device_state;       // last CORE_DEVICE_STATUS_NTF
+    uint8_t session_state;      // last SESSION_STATUS_NTF
+    uint32_t session_ntfs;
+    struct uci_range_ntf last;
+    int quiet;
+};
+
+static void on_ntf(const uint8_t *pkt, uint16_t len, void *ctx) {
+    struct ntf_log *log = ctx;
+    const uint8_t gid = uci_hdr_gid(pkt);
+    const uint8_t oid = uci_hdr_oid(pkt);
+
+    if (gid == UCI_GID_CORE && oid == UCI_OID_DEVICE_STATUS && len > UCI_HDR_LEN) {
+        log->device_state = pkt[UCI_HDR_LEN];
+    } else if (gid == UCI_GID_SESSION_CFG && oid == UCI_OID_SESSION_STATUS &&
+               len >= UCI_HDR_LEN + 6) {
+        log->session_state = pkt[UCI_HDR_LEN + 4];
+        log->session_ntfs++;
+    } else if (uci_decode_range_ntf(pkt, len, &log->last) == 0) {
+        if (log->range_ntfs && log->last.seq != log->next_seq) {
+            log->seq_gaps++;
+        }
+        log->next_seq = log->last.seq + 1;
+        log->range_ntfs++;
+        for (uint8_t i = 0; i < log->last.n && !log->quiet; i++) {
+            const struct uci_range_meas *m = &log->last.meas[i];
+
+            printf("seq %u anchor 0x%04x %-10s %7u mm (report %7u mm, toa diff %d%s)\n",
+                   log->last.seq, m->mac, status_str(m->status), m->dist_mm, m->report_mm,
+                   m->toa_diff_dtu, m->nlos ? ", NLOS" : "");
+        }
+        fflush(stdout);
+    }
+}
+
+// ================= Device commands =================
+static int cmd_info(struct uci_host *h) {
+    char vendor[UCI_MAX_PAYLOAD + 1];
+    const int st = uci_device_info(h, vendor, sizeof(vendor));
+
+    if (st != UCI_STATUS_OK) {
+        fprintf(stderr, "DEVICE_INFO: %s\n", status_str(st));
+        return 1;
+    }
+    printf("%s\n", vendor);
+    return 0;
+}
+
+static void on_sigint(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int cmd_stop(struct uci_host *h) {
+    const int st = uci_range_stop(h, SESSION_ID);
+    const int st2 = uci_session_deinit(h, SESSION_ID);
+
+    printf("RANGE_STOP: %s, SESSION_DEINIT: %s\n", status_str(st), status_str(st2));
+    return st2 == UCI_STATUS_OK ? 0 : 1;
+}
+
+static int cmd_start(struct uci_host *h, struct ntf_log *log, uint32_t interval_ms,
+                     uint32_t count) {
+    int st;
+
+    log->limit = count;
+    if ((st = uci_session_init(h, SESSION_ID)) != UCI_STATUS_OK) {
+        fprintf(stderr, "SESSION_INIT: %s (try 'stop' first)\n", status_str(st));
+        return 1;
+    }
+    if ((st = uci_set_ranging_interval(h, SESSION_ID, interval_ms)) != UCI_STATUS_OK ||
+        (st = uci_range_start(h, SESSION_ID)) != UCI_STATUS_OK) {
+        fprintf(stderr, "session setup: %s\n", status_str(st));
+        uci_session_deinit(h, SESSION_ID);
+        return 1;
+    }
+
+    signal(SIGINT, on_sigint);
+    while (!stop_requested && (!count || log->range_ntfs < count)) {
+        const int n = uci_host_poll(h, 200);
+
+        if (n < 0) {
+            fprintf(stderr, "port: %s\n", strerror(-n));
+            return 1;
+        }
+    }
+    const int ret = cmd_stop(h);
+
+    fprintf(stderr, "%u results, %u sequence gaps\n", log->range_ntfs, log->seq_gaps);
+    return ret;
+}
+
+// ================= Range log =================
+static int cmd_log_info(struct uci_host *h) {
+    struct uci_log_info info;
+    const int st = uci_log_info(h, &info);
+
+    if (st != UCI_STATUS_OK) {
+        fprintf(stderr, "LOG_INFO: %s\n", status_str(st));
+        return 1;
+    }
+    printf("%u of %u bytes in %u blocks (%.0f%%), %u records pending in RAM\n"
+           "since boot: %u records logged, %u lost, %u sectors erased\n",
+           info.used, info.capacity, info.blocks,
+           info.capacity ? 100.0 * info.used / info.capacity : 0.0, info.pending, info.records,
+           info.lost, info.erases);
+    return 0;
+}
+
+/* Read the whole log into `out`. Returns the number of blocks, or -1 with the
+ * UCI status / errno in *err. */
+static int log_read_all(struct uci_host *h, FILE *out, int *err) {
+    static uint8_t block[UINT16_MAX];
+    uint8_t chunk[UCI_MAX_PAYLOAD];
+    uint16_t block_len = 0;
+    uint16_t offset = 0;
+    int st = UCI_STATUS_OK;
+    int blocks = 0;
+    size_t have = 0;
+
+    for (int restart = 1;; restart = 0) {
+        const int n = uci_log_read(h, restart, chunk, &block_len, &offset, &st);
+
+        if (n < 0 || st != UCI_STATUS_OK) {
+            *err = n < 0 ? n : st;
+            return -1;
+        }
+        if (n == 0) {
+            return blocks;
+        }
+        if (offset != have || (size_t)offset + n > block_len) {
+            *err = -EBADMSG;
+            return -1;
+        }
+        memcpy(&block[offset], chunk, (size_t)n);
+        have = offset + (size_t)n;
+        if (have == block_len) {
+            uint8_t len[2];
+
+            uwb_put_u16(len, block_len);
+            if (fwrite(len, 2, 1, out) != 1 || fwrite(block, block_len, 1, out) != 1) {
+                *err = -EIO;
+                return -1;
+            }
+            blocks++;
+            have = 0;
+        }
+    }
+}
+
+static int cmd_log_read(struct uci_host *h, const char *path) {
+    // FAILED = the tag wrapped the log over the read position: start over
+    for (int attempt = 0; attempt < 3; attempt++) {
+        FILE *out = fopen(path, "wb");
+        int err = 0;
+
+        if (!out) {
+            perror(path);
+            return 1;
+        }
+        const int blocks = log_read_all(h, out, &err);
+        const long bytes = ftell(out);
+
+        fclose(out);
+        if (blocks >= 0) {
+            printf("%d blocks, %ld bytes -> %s\n", blocks, bytes, path);
+            return 0;
+        }
+        fprintf(stderr, "LOG_READ: %s\n", status_str(err));
+        if (err != UCI_STATUS_FAILED) {
+            return 1;
+        }
+    }
+    return 1;
+}
+
+static int cmd_log_erase(struct uci_host *h) {
+    const int st = uci_log_erase(h);
+
+    printf("LOG_ERASE: %s\n", status_str(st));
+    return st == UCI_STATUS_OK ? 0 : 1;
+}
+
+// ================= Loopback stand-in =================
+#define STANDIN_LOG_BLOCKS  16
+#define STANDIN_LOG_RECORDS 300
+
+struct standin {
+    int fd;
+    pthread_mutex_t lock;
+    int active;
+    uint32_t interval_ms;
+    uint32_t cycles;
+    int quit;
+    // Range log: blocks of 256 bytes, as the firmware would store them
+    uint8_t log[STANDIN_LOG_BLOCKS][256];
+    uint16_t log_len[STANDIN_LOG_BLOCKS];
+    int log_blocks;
+    int rd_block;
+    uint16_t rd_off;
+    struct uwb_stream_rec log_recs[STANDIN_LOG_RECORDS];
+};
+
+static struct standin standin;
+
+static void standin_send(const uint8_t *pkt, uint16_t len) {
+    while (len) {
+        const ssize_t n = write(standin.fd, pkt, len);
+
+        if (n <= 0) {
+            return;
+        }
+        pkt += n;
+        len -= (uint16_t)n;
+    }
+}
+
+static int standin_start(uint32_t interval_ms) {
+    standin.active = 1;
+    standin.interval_ms = interval_ms;
+    return 0;
+}
+
+static void standin_stop(void) {
+    standin.active = 0;
+}
+
+static void standin_log_fill(void) {
+    struct uwb_rangelog_enc enc;
+
+    standin.log_blocks = 0;
+    for (int i = 0; i < STANDIN_LOG_RECORDS; i++) {
+        struct uwb_stream_rec *r = &standin.log_recs[i];
+
+        *r = (struct uwb_stream_rec){
+            .t_ms = 5000 + (uint32_t)i * 100,
+            .anchor = (i % 7 == 6) ? 0 : 0x0002 + i % 3,
+            .status = (i % 7 == 6) ? -2 : 0,
+            .quality = (i % 7 == 6) ? 0 : (i % 5 == 0 ? 80 : 100),
+            .flags = (i % 7 == 6) ? 0 : UWB_STREAM_FLAG_REPORT,
+            .dist_mm = (i % 7 == 6) ? 0 : 2000 + (uint32_t)(i * 37 % 500) + (i % 3) * 1000,
+        };
+        if (i == 0) {
+            uwb_rangelog_enc_start(&enc, standin.log[0], 256, r->t_ms, 0);
+        }
+        if (!uwb_rangelog_enc_add(&enc, r)) {
+            standin.log_len[standin.log_blocks++] = uwb_rangelog_enc_finish(&enc);
+            uwb_rangelog_enc_start(&enc, standin.log[standin.log_blocks], 256, r->t_ms, 0);
+            uwb_rangelog_enc_add(&enc, r);
+        }
+    }
+    standin.log_len[standin.log_blocks++] = uwb_rangelog_enc_finish(&enc);
+}
+
+static int standin_log_info(struct uci_log_info *out) {
+    memset(out, 0, sizeof(*out));
+    out->capacity = sizeof(standin.log);
+    out->blocks = (uint32_t)standin.log_blocks;
+    for (int i = 0; i < standin.log_blocks; i++) {
+        out->used += standin.log_len[i];
+    }
+    out->records = standin.log_blocks ? STANDIN_LOG_RECORDS : 0;
+    return 0;
+}
+
+static int standin_log_read(bool restart, uint8_t *buf, uint8_t max, uint16_t *block_len,
+                            uint16_t *offset) {
+    if (restart) {
+        standin.rd_block = 0;
+        standin.rd_off = 0;
+    }
+    if (standin.rd_block < standin.log_blocks &&
+        standin.rd_off == standin.log_len[standin.rd_block]) {
+        standin.rd_block++;
+        standin.rd_off = 0;
+    }
+    if (standin.rd_block >= standin.log_blocks) {
+        return 0;
+    }
+    const uint16_t len = standin.log_len[standin.rd_block];
+    const uint16_t n = (uint16_t)(len - standin.rd_off < max ? len - standin.rd_off : max);
+
+    memcpy(buf, &standin.log[standin.rd_block][standin.rd_off], n);
+    *block_len = len;
+    *offset = standin.rd_off;
+    standin.rd_off += n;
+    return n;
+}
+
+static int standin_log_erase(void) {
+    standin.log_blocks = 0;
+    return 0;
+}
+
+static const struct uci_device_ops standin_ops = {
+    .ranging_start = standin_start,
+    .ranging_stop = standin_stop,
+    .send = standin_send,
+    .mac = UWB_TAG_ADDR,
+    .channel = 5,
+    .vendor_info = "uwb-tag loopback",
+    .log_info = standin_log_info,
+    .log_read = standin_log_read,
+    .log_erase = standin_log_erase,
+};
+
+/* Plays the firmware: uwb_uci.c's RX loop plus a fake ranging cycle that
+ * reports one anchor per interval (every 4th one with a response timeout). */
+static void *standin_thread(void *arg) {
+    struct uci_parser parser = { 0 };
+
+    (void)arg;
+    pthread_mutex_lock(&standin.lock);
+    uci_device_init(&standin_ops);
+    pthread_mutex_unlock(&standin.lock);
+
+    while (!standin.quit) {
+        // Loopback runs faster than real time: 1 ms per configured 100 ms
+        const int tick = standin.active ? (int)(standin.interval_ms / 100) : 50;
+        struct pollfd pfd = { .fd = standin.fd, .events = POLLIN };
+        const int r = poll(&pfd, 1, tick);
+
+        if (r > 0) {
+            uint8_t buf[64];
+            const ssize_t n = read(standin.fd, buf, sizeof(buf));
+
+            if (n <= 0) {
+                break;
+            }
+            for (ssize_t i = 0; i < n; i++) {
+                const uint16_t len = uci_parser_feed(&parser, buf[i]);
+
+                if (len) {
+                    pthread_mutex_lock(&standin.lock);
+                    uci_device_handle(parser.buf, len);
+                    pthread_mutex_unlock(&standin.lock);
+                }
+            }
+        } else if (r == 0 && standin.active) {
+            const uint32_t c = standin.cycles++;
+            const struct uci_range_meas m = {
+                .mac = 0x0002 + (c & 1),
+                .status = (c % 4 == 3) ? UCI_STATUS_RANGING_RX_TIMEOUT : UCI_STATUS_OK,
+                .dist_mm = (c % 4 == 3) ? 0 : 1500 + c,
+                .report_mm = (c % 4 == 3) ? 0 : 1498 + c,
+                .toa_diff_dtu = (int16_t)(c & 7) - 3,
+            };
+
+            pthread_mutex_lock(&standin.lock);
+            uci_device_range_ntf(&m, 1);
+            pthread_mutex_unlock(&standin.lock);
+        }
+    }
+    return NULL;
+}
+
+static int failures;
+
+/* The session status notification follows the response */
+static int session_state_after(struct uci_host *h, const struct ntf_log *log) {
+    uci_host_poll(h, 20);
+    return log->session_state;
+}
+
+static void check(int ok, const char *what) {
+    printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+    failures += !ok;
+}
+
+static int cmd_loopback(void) {
+    int sv[2];
+    pthread_t tid;
+    struct uci_host h = { 0 };
+    struct ntf_log log = { .quiet = 1 };
+    uint8_t rsp[UCI_MAX_PAYLOAD];
+    uint8_t p[16];
+    char vendor[64];
+    int n;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        perror("socketpair");
+        return 1;
+    }
+    standin.fd = sv[1];
+    pthread_mutex_init(&standin.lock, NULL);
+    uci_host_attach(&h, sv[0]);
+    h.on_ntf = on_ntf;
+    h.ctx = &log;
+    standin_log_fill();
+    pthread_create(&tid, NULL, standin_thread, NULL);
+
+    uci_host_poll(&h, 100);
+    check(log.device_state == UCI_DEVICE_STATE_READY, "DEVICE_STATUS_NTF READY on start-up");
+    check(uci_device_info(&h, vendor, sizeof(vendor)) == UCI_STATUS_OK &&
+          strcmp(vendor, "uwb-tag loopback") == 0, "DEVICE_INFO returns vendor info");
+    check(uci_range_start(&h, SESSION_ID) == UCI_STATUS_SESSION_NOT_EXIST,
+          "RANGE_START without a session is rejected");
+    check(uci_session_init(&h, SESSION_ID) == UCI_STATUS_OK &&
+          session_state_after(&h, &log) == UCI_SESSION_STATE_INIT, "SESSION_INIT -> INIT");
+    check(uci_session_init(&h, SESSION_ID + 1) == UCI_STATUS_MAX_SESSIONS,
+          "second session is refused");
+    check(uci_range_start(&h, SESSION_ID) == UCI_STATUS_REJECTED,
+          "RANGE_START before SET_APP_CONFIG is rejected");
+
+    uwb_put_u32(&p[0], SESSION_ID);
+    p[4] = 1;
+    p[5] = UCI_CFG_RANGING_INTERVAL;
+    p[6] = 4;
+    uwb_put_u32(&p[7], 50);
+    n = uci_host_cmd(&h, UCI_GID_SESSION_CFG, UCI_OID_SET_APP_CONFIG, p, 11, rsp, 1000);
+    check(n == 4 && rsp[0] == UCI_STATUS_INVALID_PARAM && rsp[1] == 1 &&
+          rsp[2] == UCI_CFG_RANGING_INTERVAL && rsp[3] == UCI_STATUS_INVALID_RANGE,
+          "interval below the minimum -> INVALID_RANGE");
+
+    p[5] = UCI_CFG_DEVICE_MAC_ADDRESS;
+    p[6] = 2;
+    n = uci_host_cmd(&h, UCI_GID_SESSION_CFG, UCI_OID_SET_APP_CONFIG, p, 9, rsp, 1000);
+    check(n == 4 && rsp[3] == UCI_STATUS_READ_ONLY, "MAC address is read-only");
+
+    check(uci_set_ranging_interval(&h, SESSION_ID, 200) == UCI_STATUS_OK &&
+          session_state_after(&h, &log) == UCI_SESSION_STATE_IDLE, "SET_APP_CONFIG -> IDLE");
+
+    p[4] = 0;
+    n = uci_host_cmd(&h, UCI_GID_SESSION_CFG, UCI_OID_GET_APP_CONFIG, p, 5, rsp, 1000);
+    check(n == 2 + 3 + 4 + 6 && rsp[0] == UCI_STATUS_OK && rsp[1] == 3 &&
+          rsp[2] == UCI_CFG_CHANNEL_NUMBER && rsp[4] == 5 &&
+          uwb_get_u16(&rsp[7]) == UWB_TAG_ADDR && uwb_get_u32(&rsp[11]) == 200,
+          "GET_APP_CONFIG (all) returns channel, MAC, interval");
+
+    check(uci_range_start(&h, SESSION_ID) == UCI_STATUS_OK &&
+          session_state_after(&h, &log) == UCI_SESSION_STATE_ACTIVE, "RANGE_START -> ACTIVE");
+    check(uci_set_ranging_interval(&h, SESSION_ID, 300) == UCI_STATUS_SESSION_ACTIVE,
+          "SET_APP_CONFIG while active is refused");
+
+    for (int i = 0; i < 100 && log.range_ntfs < 20; i++) {
+        uci_host_poll(&h, 10);
+    }
+    check(log.range_ntfs >= 20 && log.seq_gaps == 0, "20 RANGE_DATA_NTF in sequence");
+    check(log.last.session_id == SESSION_ID && log.last.interval_ms == 200 &&
+          log.last.type == UCI_MEAS_TYPE_TWR && log.last.n == 1,
+          "RANGE_DATA_NTF header fields");
+    check(log.last.meas[0].status == UCI_STATUS_OK
+              ? log.last.meas[0].dist_mm == 1500 + log.last.seq &&
+                log.last.meas[0].report_mm == 1498 + log.last.seq
+              : log.last.meas[0].status == UCI_STATUS_RANGING_RX_TIMEOUT,
+          "RANGE_DATA_NTF measurement fields");
+
+    check(uci_range_stop(&h, SESSION_ID) == UCI_STATUS_OK &&
+          session_state_after(&h, &log) == UCI_SESSION_STATE_IDLE && !standin.active,
+          "RANGE_STOP -> IDLE, radio stopped");
+    const uint32_t after_stop = log.range_ntfs;
+    uci_host_poll(&h, 50);
+    check(log.range_ntfs == after_stop, "no RANGE_DATA_NTF after stop");
+
+    struct uci_log_info info;
+    FILE *lf = tmpfile();
+    int err = 0;
+    int blocks;
+
+    check(uci_log_info(&h, &info) == UCI_STATUS_OK && info.blocks == (uint32_t)standin.log_blocks &&
+          info.blocks > 1 && info.records == STANDIN_LOG_RECORDS, "LOG_INFO counts");
+    blocks = lf ? log_read_all(&h, lf, &err) : -1;
+    check(blocks == standin.log_blocks, "LOG_READ returns every block");
+
+    // Decode the readout and compare with what was logged
+    int matched = 0;
+    if (lf) {
+        static uint8_t blk[UINT16_MAX];
+        struct uwb_stream_rec recs[STANDIN_LOG_RECORDS];
+        uint8_t len[2];
+        uint32_t t0;
+        uint16_t lost;
+
+        rewind(lf);
+        while (fread(len, 2, 1, lf) == 1 && fread(blk, uwb_get_u16(len), 1, lf) == 1) {
+            const int nr = uwb_rangelog_block_parse(blk, uwb_get_u16(len), &t0, &lost, recs,
+                                                    STANDIN_LOG_RECORDS);
+
+            for (int i = 0; i < nr && matched < STANDIN_LOG_RECORDS; i++, matched++) {
+                const struct uwb_stream_rec *a = &recs[i];
+                const struct uwb_stream_rec *b = &standin.log_recs[matched];
+
+                if (a->t_ms != b->t_ms || a->anchor != b->anchor || a->status != b->status ||
+                    a->dist_mm != b->dist_mm || a->quality != b->quality || a->flags != b->flags) {
+                    break;
+                }
+            }
+        }
+        fclose(lf);
+    }
+    check(matched == STANDIN_LOG_RECORDS, "range log readout decodes to the logged records");
+    uint16_t block_len, offset;
+    check(uci_log_erase(&h) == UCI_STATUS_OK &&
+          uci_log_read(&h, 1, rsp, &block_len, &offset, &err) == 0 && err == UCI_STATUS_OK,
+          "LOG_ERASE empties the log");
+
+    n = uci_host_cmd(&h, 0x7, 0x00, NULL, 0, rsp, 1000);
+    check(n == 1 && rsp[0] == UCI_STATUS_UNKNOWN_GID, "unknown GID");
+    n = uci_host_cmd(&h, UCI_GID_SESSION_CTRL, 0x3F, p, 4, rsp, 1000);
+    check(n == 1 && rsp[0] == UCI_STATUS_UNKNOWN_OID, "unknown OID");
+
+    check(uci_session_deinit(&h, SESSION_ID) == UCI_STATUS_OK &&
+          session_state_after(&h, &log) == UCI_SESSION_STATE_DEINIT, "SESSION_DEINIT -> DEINIT");
+    check(uci_range_stop(&h, SESSION_ID) == UCI_STATUS_SESSION_NOT_EXIST,
+          "session is gone after DEINIT");
+
+    standin.quit = 1;
+    shutdown(sv[0], SHUT_RDWR);
+    pthread_join(tid, NULL);
+    close(sv[0]);
+    close(sv[1]);
+
+    printf("%s (%d failed)\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: uci_tool <port> info\n"
+            "       uci_tool <port> start [interval_ms] [count]\n"
+            "       uci_tool <port> stop\n"
+            "       uci_tool <port> log-info | log-read <out.log> | log-erase\n"
+            "       uci_tool --loopback\n");
+}
+
+int main(int argc, char **argv) {
+    struct uci_host h = { 0 };
+    struct ntf_log log = { 0 };
+    int ret;
+
+    if (argc == 2 && strcmp(argv[1], "--loopback") == 0) {
+        return cmd_loopback();
+    }
+    if (argc < 3) {
+        usage();
+        return 2;
+    }
+    if ((ret = uci_host_open(&h, argv[1])) != 0) {
+        fprintf(stderr, "%s: %s\n", argv[1], strerror(-ret));
+        return 1;
+    }
+    h.on_ntf = on_ntf;
+    h.ctx = &log;
+
+    if (strcmp(argv[2], "info") == 0) {
+        ret = cmd_info(&h);
+    } else if (strcmp(argv[2], "start") == 0) {
+        ret = cmd_start(&h, &log, argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 1000,
+                        argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : 0);
+    } else if (strcmp(argv[2], "stop") == 0) {
+        ret = cmd_stop(&h);
+    } else if (strcmp(argv[2], "log-info") == 0) {
+        ret = cmd_log_info(&h);
+    } else if (strcmp(argv[2], "log-read") == 0 && argc > 3) {
+        ret = cmd_log_read(&h, argv[3]);
+    } else if (strcmp(argv[2], "log-erase") == 0) {
+        ret = cmd_log_erase(&h);
+    } else {
+        usage();
+        ret = 2;
+    }
+    uci_host_close(&h);
+    return ret;
+}
@@ -0,0 +1,69 @@
+#!/usr/bin/env pwsh
+# UWB Tag Firmware - Size Report
+# Builds each configuration and reports flash, RAM and symbol counts.
+# Usage: .\size_report.ps1 [board_name]
+#   Example: .\size_report.ps1 nrf52833dongle_nrf52833
+#
+# Boot time is not measurable offline: flash each build and read
+# "Ranging started at N ms after boot" from RTT.
+
+param(
+    [string]$Board = "nrf52833dongle_nrf52833"
+)
+
+$ErrorActionPreference = "Stop"
+
+# name -> extra CMake arguments
+$Configs = [ordered]@{
+    "default" = @()
+    "prod"    = @("-DEXTRA_CONF_FILE=overlay-prod.conf")
+    "full"    = @("-DCONFIG_DW3000_AES=y", "-DCONFIG_DW3000_STS_KEY=y", "-DCONFIG_DW3000_OTP_WRITE=y",
+                  "-DCONFIG_DW3000_TEST_MODES=y", "-DCONFIG_UWB_BEACON_TX_MODE=y",
+                  "-DCONFIG_UWB_RX_TEST_MODE=y", "-DCONFIG_UWB_GPIO_DISCO_SCAN=y")
+}
+
+Write-Host "=======================================" -ForegroundColor Cyan
+Write-Host "UWB Tag Firmware - Size Report" -ForegroundColor Cyan
+Write-Host "=======================================" -ForegroundColor Cyan
+Write-Host "Board: $Board" -ForegroundColor Yellow
+Write-Host ""
+
+$results = @()
+
+foreach ($name in $Configs.Keys) {
+    $dir = "build_size/$name"
+    Write-Host "Building '$name'..." -ForegroundColor Yellow
+
+    $log = west build -p always -b $Board -d $dir -- @($Configs[$name]) 2>&1
+    if ($LASTEXITCODE -ne 0) {
+        $log | Select-Object -Last 30 | Write-Host
+        Write-Host "BUILD FAILED: $name" -ForegroundColor Red
+        exit 1
+    }
+
+    # Linker memory summary, e.g. "           FLASH:      123456 B       512 KB     23.55%"
+    $flash = 0; $ram = 0
+    foreach ($line in $log) {
+        if ("$line" -match '^\s*FLASH:\s+(\d+)\s+B') { $flash = [int]$Matches[1] }
+        if ("$line" -match '^\s*RAM:\s+(\d+)\s+B') { $ram = [int]$Matches[1] }
+    }
+
+    # Symbol counts from the final ELF (nm from the Zephyr SDK toolchain)
+    $nm = (Select-String -Path "$dir/CMakeCache.txt" -Pattern '^CMAKE_NM:FILEPATH=(.*)$').Matches |
+          ForEach-Object { $_.Groups[1].Value } | Select-Object -First 1
+    if (-not $nm) { $nm = "arm-zephyr-eabi-nm" }
+    $syms = & $nm --defined-only "$dir/zephyr/zephyr.elf"
+    $text = @($syms | Where-Object { $_ -match ' [Tt] ' }).Count
+    $dwt = @($syms | Where-Object { $_ -match ' [Tt] dwt_' }).Count
+
+    $results += [pscustomobject]@{
+        Config = $name
+        Flash  = $flash
+        RAM    = $ram
+        Funcs  = $text
+        DwtApi = $dwt
+    }
+}
+
+Write-Host ""
+$results | Format-Table -AutoSize
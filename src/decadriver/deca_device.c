@@ -23,6 +23,15 @@
 #define UART_puts(x) printf("%s", x)
 // #include "dw3000.h"
 
+/* Register access and TX scheduling used between RESP RX and FINAL TX are
+ * placed in RAM when CONFIG_UWB_RAMFUNC_HOT_PATH is set (see platform_port.h) */
+#if defined(CONFIG_UWB_RAMFUNC_HOT_PATH)
+#include <zephyr/linker/section_tags.h>
+#define DWT_RAMFUNC __ramfunc
+#else
+#define DWT_RAMFUNC
+#endif
+
 // -------------------------------------------------------------------------------------------------------------------
 // Module Macro definitions and enumerations
 //
@@ -106,7 +115,9 @@ static uint16_t get_sts_mnth(uint16_t sts, uint8_t default_threshold, uint8_t sh
 //
 static void dwt_force_clocks(int clocks);
 static uint32_t _dwt_otpread(uint16_t address);                     // Read non-volatile memory
+#if defined(CONFIG_DW3000_OTP_WRITE)
 static void _dwt_otpprogword32(uint32_t data, uint16_t address);  // Program the non-volatile memory
+#endif
 
 // -------------------------------------------------------------------------------------------------------------------
 // Data for DW3000 Decawave Transceiver control
@@ -172,7 +183,7 @@ int32_t dwt_apiversion(void)
 *
 * no return value
 */
-static
+static DWT_RAMFUNC
 void dwt_xfer3000
 (
     uint32_t    regFileID,  //0x0, 0x04-0x7F ; 0x10000, 0x10004, 0x10008-0x1007F; 0x20000 etc
@@ -1060,6 +1071,7 @@ void dwt_configuretxrf(dwt_txconfig_t *config)
     dwt_write32bitreg(TX_POWER_ID, config->power);
 }
 
+#if defined(CONFIG_DW3000_STS_KEY)
 /*! ------------------------------------------------------------------------------------------------------------------
  * @brief This function configures the STS AES 128 bit key value.
  * the default value is [31:00]c9a375fa,
@@ -1113,6 +1125,7 @@ void dwt_configurestsloadiv(void)
 {
     dwt_or8bitoffsetreg(STS_CTRL_ID, 0, STS_CTRL_LOAD_IV_BIT_MASK);
 }
+#endif /* CONFIG_DW3000_STS_KEY */
 
 
 static uint16_t get_sts_mnth (uint16_t cipher, uint8_t threshold, uint8_t shift_val)
@@ -1681,7 +1694,7 @@ void dwt_settxantennadelay(uint16_t txDelay)
  *
  * returns DWT_SUCCESS for success, or DWT_ERROR for error
  */
-int dwt_writetxdata(uint16_t txDataLength, uint8_t *txDataBytes, uint16_t txBufferOffset)
+DWT_RAMFUNC int dwt_writetxdata(uint16_t txDataLength, uint8_t *txDataBytes, uint16_t txBufferOffset)
 {
 #ifdef DWT_API_ERROR_CHECK
     assert((pdw3000local->longFrames && (txDataLength <= EXT_FRAME_LEN)) ||\
@@ -1726,7 +1739,7 @@ int dwt_writetxdata(uint16_t txDataLength, uint8_t *txDataBytes, uint16_t txBuff
  *
  * no return value
  */
-void dwt_writetxfctrl(uint16_t txFrameLength, uint16_t txBufferOffset, uint8_t ranging)
+DWT_RAMFUNC void dwt_writetxfctrl(uint16_t txFrameLength, uint16_t txBufferOffset, uint8_t ranging)
 {
     uint32_t reg32;
 #ifdef DWT_API_ERROR_CHECK
@@ -1801,7 +1814,7 @@ void dwt_read_rx_scratch_data(uint8_t *buffer, uint16_t length, uint16_t rxBuffe
  *
  * no return value
  */
-void dwt_readrxdata(uint8_t *buffer, uint16_t length, uint16_t rxBufferOffset)
+DWT_RAMFUNC void dwt_readrxdata(uint8_t *buffer, uint16_t length, uint16_t rxBufferOffset)
 {
     uint32_t  rx_buff_addr;
 
@@ -2717,6 +2730,7 @@ static uint32_t _dwt_otpread(uint16_t address)
     return ret_data;
 }
 
+#if defined(CONFIG_DW3000_OTP_WRITE)
 /*! ------------------------------------------------------------------------------------------------------------------
  * @brief For each value to send to OTP bloc, following two register writes are required as shown below
  *
@@ -2874,6 +2888,7 @@ int dwt_otpwriteandverify(uint32_t value, uint16_t address)
         return DWT_ERROR;
     }
 }
+#endif /* CONFIG_DW3000_OTP_WRITE */
 
 int dwt_otpverify(uint32_t value, uint16_t address)
 {
@@ -3662,7 +3677,7 @@ void dwt_setreferencetrxtime(uint32_t reftime)
  *
  * no return value
  */
-void dwt_setdelayedtrxtime(uint32_t starttime)
+DWT_RAMFUNC void dwt_setdelayedtrxtime(uint32_t starttime)
 {
     dwt_write32bitoffsetreg(DX_TIME_ID, 0, starttime); // Note: bit 0 of this register is ignored
 } // end dwt_setdelayedtrxtime()
@@ -3684,7 +3699,7 @@ void dwt_setdelayedtrxtime(uint32_t starttime)
  *
  * returns DWT_SUCCESS for success, or DWT_ERROR for error (e.g. a delayed transmission will be cancelled if the delayed time has passed)
  */
-int dwt_starttx(uint8_t mode)
+DWT_RAMFUNC int dwt_starttx(uint8_t mode)
 {
     int retval = DWT_SUCCESS ;
     uint16_t checkTxOK = 0 ;
@@ -4198,6 +4213,7 @@ void dwt_enable_rf_tx(uint32_t channel, uint8_t switch_control)
 
 }
 
+#if defined(CONFIG_DW3000_TEST_MODES)
 /*! ------------------------------------------------------------------------------------------------------------------
  * @brief This function will enable a repeated continuous waveform on the device
  *
@@ -4251,6 +4267,7 @@ void dwt_repeated_frames(uint32_t framerepetitionrate)
     }
     dwt_write32bitreg(DX_TIME_ID, framerepetitionrate);
 }
+#endif /* CONFIG_DW3000_TEST_MODES */
 
 /*! ------------------------------------------------------------------------------------------------------------------
  * @brief This function disables the automatic sequencing of the tx-blocks for a specific channel.
@@ -4297,6 +4314,7 @@ void dwt_disable_rftx_blocks(void)
     dwt_write32bitoffsetreg(RF_CTRL_MASK_ID, 0, 0x00000000);
 }
 
+#if defined(CONFIG_DW3000_TEST_MODES)
 /*! ------------------------------------------------------------------------------------------------------------------
  * @brief this function sets the DW3000 to transmit cw signal at specific channel frequency
  *
@@ -4335,6 +4353,7 @@ void dwt_configcontinuousframemode(uint32_t framerepetitionrate, uint8_t channel
     dwt_force_clocks(FORCE_CLK_SYS_TX);
     dwt_repeated_frames(framerepetitionrate);
 }
+#endif /* CONFIG_DW3000_TEST_MODES */
 
 /*! ------------------------------------------------------------------------------------------------------------------
 * @brief this function reads the raw battery voltage and temperature values of the DW IC.
@@ -4541,6 +4560,7 @@ uint16_t dwt_calcpgcount(uint8_t pgdly, uint8_t channel)
 }
 
 /* AES block */
+#if defined(CONFIG_DW3000_AES)
 
 /*! ------------------------------------------------------------------------------------------------------------------
  * @brief   This function provides the API for the configuration of the AES block before first usage.
@@ -4550,7 +4570,7 @@ uint16_t dwt_calcpgcount(uint8_t pgdly, uint8_t channel)
  *
  * no return value
  */
-void dwt_configure_aes(const dwt_aes_config_t *pCfg)
+DWT_RAMFUNC void dwt_configure_aes(const dwt_aes_config_t *pCfg)
 {
     uint16_t tmp;
 
@@ -4609,7 +4629,7 @@ void dwt_set_keyreg_128(const dwt_aes_key_t  *key)
  * @return  AES_STS_ID status
  */
 static
-uint8_t dwt_wait_aes_poll(void)
+DWT_RAMFUNC uint8_t dwt_wait_aes_poll(void)
 {
     uint8_t tmp;
     do{
@@ -4648,7 +4668,7 @@ uint8_t dwt_wait_aes_poll(void)
  *
  */
 static
-void dwt_update_nonce_CCM(uint8_t *nonce, uint16_t payload)
+DWT_RAMFUNC void dwt_update_nonce_CCM(uint8_t *nonce, uint16_t payload)
 {
     uint8_t iv[16];
     iv[0] = nonce[10];
@@ -4702,7 +4722,7 @@ void dwt_update_nonce_GCM(uint8_t *nonce)
  *
  *
  */
-int8_t dwt_do_aes(dwt_aes_job_t *job, dwt_aes_core_type_e core_type)
+DWT_RAMFUNC int8_t dwt_do_aes(dwt_aes_job_t *job, dwt_aes_core_type_e core_type)
 {
     uint32_t      tmp,dest_reg;
     uint16_t    allow_size;
@@ -4874,6 +4894,7 @@ int8_t dwt_do_aes(dwt_aes_job_t *job, dwt_aes_core_type_e core_type)
     }
     return (ret);
 }
+#endif /* CONFIG_DW3000_AES */
 
 /*! ------------------------------------------------------------------------------------------------------------------
 *
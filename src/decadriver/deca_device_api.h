@@ -689,7 +689,9 @@ static void dwt_xfer3000( uint32_t    regFileID,  //0x0, 0x04-0x7F ; 0x10000, 0x
     uint8_t           *buffer,
     spi_modes_e mode);
 
+#if defined(CONFIG_DW3000_OTP_WRITE)
 static void _dwt_otpprogword32(uint32_t data, uint16_t address);
+#endif
 
 void setup_localdata();
 
@@ -4,7 +4,17 @@
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/logging/log.h>
 #include <stdint.h>
+#include <string.h>
+#if defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+#include <nrfx_gpiote.h>
+#include <nrfx_ppi.h>
+#include <hal/nrf_egu.h>
+#include <hal/nrf_gpio.h>
+#include <hal/nrf_gpiote.h>
+#include <hal/nrf_spim.h>
+#endif
 #include "deca_device_api.h"
+#include "platform_port.h"
 
 LOG_MODULE_REGISTER(platform_port, LOG_LEVEL_INF);
 
@@ -12,6 +22,23 @@ const struct device *spi_dev;
 struct spi_config spi_cfg;
 static const struct gpio_dt_spec rst_gpio = GPIO_DT_SPEC_GET(DT_NODELABEL(dw3000), reset_gpios);
 static const struct gpio_dt_spec cs_gpio = GPIO_DT_SPEC_GET(DT_NODELABEL(dw3000), cs_gpios);
+static const struct gpio_dt_spec irq_gpio = GPIO_DT_SPEC_GET_OR(DT_NODELABEL(dw3000), irq_gpios, {0});
+
+/* Two levels of mutual exclusion:
+ * - spi_lock: held for exactly one CS-framed SPI transaction, so two contexts can
+ *   never interleave bytes on the bus. Hold time = one transfer.
+ * - dev_lock: held across multi-register sequences that touch driver state
+ *   (pdw3000local) or chip state machines (TX/RX, SAR). The radio thread holds it
+ *   for a whole TWR cycle; background users only ever try-lock it.
+ * Both are k_mutex, so priority inheritance bounds any inversion to one transfer.
+ */
+static K_MUTEX_DEFINE(spi_lock);
+static K_MUTEX_DEFINE(dev_lock);
+static bool irq_armed;
+#if !defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+static struct gpio_callback irq_cb_data;
+#endif
+static void (*irq_handler)(void);
 
 void openspi(void) {
     /* dw3000'in bağlı olduğu BUS'ı (SPI3) otomatik bul */
@@ -43,40 +70,330 @@ void peripherals_init(void) {
 
 void closespi(void) {}
 
-int readfromspi(uint16_t headerLength, uint8_t *headerBuffer, uint16_t readlength, uint8_t *readBuffer) {
+#if defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+/* Hardware-chained status fetch (no CPU between the IRQ edge and the data):
+ *   P0.24 rising -> GPIOTE IN -> PPI A -> GPIOTE CLR (CS low) + fork SPIM3 START
+ *   SPIM3 END    -> PPI B -> GPIOTE SET (CS high) + fork EGU3 TRIGGER0 -> ISR
+ * The prepared EasyDMA descriptor reads SYS_STATUS .. RX_TIME (register file
+ * 0x00, 0x44..0x6B) in one burst, so the handler starts from fetched status.
+ * While armed, CS is owned by the GPIOTE task and SPIM3 pointers point at the
+ * descriptor; any normal transfer suspends the chain first (pf_suspend).
+ * One-shot: the EGU ISR turns the chain off until dw3000_irq_rearm().
+ * EXPERIMENTAL (see Kconfig): SPIM3 is shared with Zephyr's spi_nrfx_spim
+ * driver, which is only safe because every transfer here goes through
+ * spi_lock and pf_suspend(). The CS setup time before the first SCK edge
+ * has not been checked on a scope. */
+#define PF_SPIM         NRF_SPIM3
+#define PF_EGU          NRF_EGU3
+#define PF_EGU_IRQ      SWI3_EGU3_IRQn
+
+static uint8_t pf_tx[2] = { 0x41, 0x10 };      // EAM read, file 0x00, offset 0x44
+static uint8_t pf_rx[2 + DW3000_PREFETCH_LEN];
+static uint8_t pf_irq_ch;                       // GPIOTE IN channel (IRQ pin)
+static uint8_t pf_cs_ch;                        // GPIOTE task channel (CS pin)
+static nrf_ppi_channel_t pf_ppi_start;
+static nrf_ppi_channel_t pf_ppi_end;
+static volatile bool pf_chain_on;               // PPI channels enabled
+static bool pf_cs_owned;                        // CS driven by GPIOTE, not GPIO
+static atomic_t pf_valid;                       // pf_rx holds an unread fetch
+
+static inline uint32_t pf_ppi_mask(void) {
+    return BIT(pf_ppi_start) | BIT(pf_ppi_end);
+}
+
+static void pf_egu_isr(const void *arg) {
+    ARG_UNUSED(arg);
+
+    nrf_egu_event_clear(PF_EGU, NRF_EGU_EVENT_TRIGGERED0);
+    nrf_ppi_channels_disable(NRF_PPI, pf_ppi_mask());
+    nrf_spim_event_clear(PF_SPIM, NRF_SPIM_EVENT_END);
+    pf_chain_on = false;
+    atomic_set(&pf_valid, 1);
+
+    if (irq_handler) {
+        irq_handler();
+    }
+}
+
+/* Caller holds spi_lock */
+static void pf_hw_arm(void) {
+    if (!pf_cs_owned) {
+        nrf_spim_int_disable(PF_SPIM, NRF_SPIM_INT_END_MASK);
+        nrf_spim_enable(PF_SPIM);
+        nrf_spim_tx_buffer_set(PF_SPIM, pf_tx, sizeof(pf_tx));
+        nrf_spim_rx_buffer_set(PF_SPIM, pf_rx, sizeof(pf_rx));
+        nrf_gpiote_task_enable(NRF_GPIOTE, pf_cs_ch);
+        pf_cs_owned = true;
+    }
+    if (pf_chain_on) {
+        return;
+    }
+    nrf_spim_event_clear(PF_SPIM, NRF_SPIM_EVENT_STARTED);
+    nrf_spim_event_clear(PF_SPIM, NRF_SPIM_EVENT_END);
+    nrf_gpiote_event_clear(NRF_GPIOTE, nrf_gpiote_in_event_get(pf_irq_ch));
+    pf_chain_on = true;
+    nrf_ppi_channels_enable(NRF_PPI, pf_ppi_mask());
+
+    // Level IRQ already high: there will be no edge, so start the chain by hand
+    if (nrf_gpio_pin_read(irq_gpio.pin) && !nrf_spim_event_check(PF_SPIM, NRF_SPIM_EVENT_STARTED)) {
+        nrf_gpiote_task_trigger(NRF_GPIOTE, nrf_gpiote_clr_task_get(pf_cs_ch));
+        nrf_spim_task_trigger(PF_SPIM, NRF_SPIM_TASK_START);
+    }
+}
+
+/* Caller holds spi_lock. Waits for an in-flight fetch (< 200 us at 2 MHz). */
+static void pf_hw_disarm(void) {
+    const unsigned int key = irq_lock();
+    const bool was_on = pf_chain_on;
+
+    nrf_ppi_channels_disable(NRF_PPI, BIT(pf_ppi_start));
+    irq_unlock(key);
+
+    if (was_on && nrf_spim_event_check(PF_SPIM, NRF_SPIM_EVENT_STARTED)) {
+        while (pf_chain_on) {
+            // END -> PPI B still raises CS and the EGU ISR clears pf_chain_on
+        }
+    }
+    nrf_ppi_channels_disable(NRF_PPI, pf_ppi_mask());
+    pf_chain_on = false;
+
+    if (pf_cs_owned) {
+        nrf_gpiote_task_disable(NRF_GPIOTE, pf_cs_ch);
+        pf_cs_owned = false;
+    }
+}
+
+/* Normal SPI transfers run with the chain parked; returns whether to resume */
+static inline bool pf_suspend(void) {
+    const bool resume = pf_chain_on;
+
+    if (pf_cs_owned) {
+        pf_hw_disarm();
+    }
+    return resume;
+}
+
+static inline void pf_resume(bool resume) {
+    if (resume) {
+        pf_hw_arm();
+    }
+}
+
+static int pf_init(void) {
+    const uint32_t irq_pin = irq_gpio.pin;
+    const uint32_t cs_pin = cs_gpio.pin;
+    nrfx_err_t err;
+
+#if defined(NRFX_GPIOTE_INSTANCE)
+    const nrfx_gpiote_t gpiote = NRFX_GPIOTE_INSTANCE(0);
+
+    err = nrfx_gpiote_channel_alloc(&gpiote, &pf_irq_ch);
+    if (err == NRFX_SUCCESS) {
+        err = nrfx_gpiote_channel_alloc(&gpiote, &pf_cs_ch);
+    }
+#else
+    err = nrfx_gpiote_channel_alloc(&pf_irq_ch);
+    if (err == NRFX_SUCCESS) {
+        err = nrfx_gpiote_channel_alloc(&pf_cs_ch);
+    }
+#endif
+    if (err == NRFX_SUCCESS) {
+        err = nrfx_ppi_channel_alloc(&pf_ppi_start);
+    }
+    if (err == NRFX_SUCCESS) {
+        err = nrfx_ppi_channel_alloc(&pf_ppi_end);
+    }
+    if (err != NRFX_SUCCESS) {
+        LOG_ERR("PPI chain: no free GPIOTE/PPI channel (0x%08x)", err);
+        return -EBUSY;
+    }
+
+    // Both pins are on P0; CS idles high, the task only toggles it while armed
+    nrf_gpiote_event_configure(NRF_GPIOTE, pf_irq_ch, irq_pin, NRF_GPIOTE_POLARITY_LOTOHI);
+    nrf_gpiote_event_enable(NRF_GPIOTE, pf_irq_ch);
+    nrf_gpiote_task_configure(NRF_GPIOTE, pf_cs_ch, cs_pin, NRF_GPIOTE_POLARITY_TOGGLE,
+                              NRF_GPIOTE_INITIAL_VALUE_HIGH);
+
+    nrf_ppi_channel_endpoint_setup(NRF_PPI, pf_ppi_start,
+        nrf_gpiote_event_address_get(NRF_GPIOTE, nrf_gpiote_in_event_get(pf_irq_ch)),
+        nrf_gpiote_task_address_get(NRF_GPIOTE, nrf_gpiote_clr_task_get(pf_cs_ch)));
+    nrf_ppi_fork_endpoint_setup(NRF_PPI, pf_ppi_start,
+        nrf_spim_task_address_get(PF_SPIM, NRF_SPIM_TASK_START));
+
+    nrf_ppi_channel_endpoint_setup(NRF_PPI, pf_ppi_end,
+        nrf_spim_event_address_get(PF_SPIM, NRF_SPIM_EVENT_END),
+        nrf_gpiote_task_address_get(NRF_GPIOTE, nrf_gpiote_set_task_get(pf_cs_ch)));
+    nrf_ppi_fork_endpoint_setup(NRF_PPI, pf_ppi_end,
+        nrf_egu_task_address_get(PF_EGU, NRF_EGU_TASK_TRIGGER0));
+
+    nrf_egu_event_clear(PF_EGU, NRF_EGU_EVENT_TRIGGERED0);
+    nrf_egu_int_enable(PF_EGU, NRF_EGU_INT_TRIGGERED0);
+    IRQ_CONNECT(PF_EGU_IRQ, 1, pf_egu_isr, NULL, 0);
+    irq_enable(PF_EGU_IRQ);
+
+    LOG_INF("DW3000 IRQ transport: GPIOTE->PPI->SPIM prefetch (%d bytes)", DW3000_PREFETCH_LEN);
+    return 0;
+}
+
+int dw3000_irq_take_prefetch(uint8_t *buf, size_t len) {
+    if (!atomic_cas(&pf_valid, 1, 0)) {
+        return 0;
+    }
+    len = MIN(len, (size_t)DW3000_PREFETCH_LEN);
+    memcpy(buf, &pf_rx[2], len);
+    return (int)len;
+}
+#else
+static inline bool pf_suspend(void) {
+    return false;
+}
+
+static inline void pf_resume(bool resume) {
+    ARG_UNUSED(resume);
+}
+
+int dw3000_irq_take_prefetch(uint8_t *buf, size_t len) {
+    ARG_UNUSED(buf);
+    ARG_UNUSED(len);
+    return 0;
+}
+#endif /* CONFIG_UWB_IRQ_TRANSPORT_PPI */
+
+UWB_RAMFUNC int readfromspi(uint16_t headerLength, uint8_t *headerBuffer, uint16_t readlength, uint8_t *readBuffer) {
     int ret;
     struct spi_buf tx_buf = { .buf = headerBuffer, .len = headerLength };
     struct spi_buf_set tx = { .buffers = &tx_buf, .count = 1 };
     struct spi_buf rx_bufs[2] = { { .buf = NULL, .len = headerLength }, { .buf = readBuffer, .len = readlength } };
     struct spi_buf_set rx = { .buffers = rx_bufs, .count = 2 };
 
+    k_mutex_lock(&spi_lock, K_FOREVER);
+    const bool pf_resume_after = pf_suspend();
     gpio_pin_set_dt(&cs_gpio, 1); // ACTIVE_LOW: 1 = Active (Low)
     k_busy_wait(1); // Short delay for CS setup time
     ret = spi_transceive(spi_dev, &spi_cfg, &tx, &rx);
     k_busy_wait(1); // Short delay before CS release
     gpio_pin_set_dt(&cs_gpio, 0); // ACTIVE_LOW: 0 = Inactive (High)
+    pf_resume(pf_resume_after);
+    k_mutex_unlock(&spi_lock);
     
     return ret;
 }
 
-int writetospi(uint16_t headerLength, uint8_t *headerBuffer, uint16_t bodylength, uint8_t *bodyBuffer) {
+UWB_RAMFUNC int writetospi(uint16_t headerLength, uint8_t *headerBuffer, uint16_t bodylength, uint8_t *bodyBuffer) {
     int ret;
     struct spi_buf tx_bufs[2] = { { .buf = headerBuffer, .len = headerLength }, { .buf = bodyBuffer, .len = bodylength } };
     struct spi_buf_set tx = { .buffers = tx_bufs, .count = 2 };
 
+    k_mutex_lock(&spi_lock, K_FOREVER);
+    const bool pf_resume_after = pf_suspend();
     gpio_pin_set_dt(&cs_gpio, 1); // ACTIVE_LOW: 1 = Active (Low)
     k_busy_wait(1); // Short delay for CS setup time
     ret = spi_write(spi_dev, &spi_cfg, &tx);
     k_busy_wait(1); // Short delay before CS release
     gpio_pin_set_dt(&cs_gpio, 0); // ACTIVE_LOW: 0 = Inactive (High)
+    pf_resume(pf_resume_after);
+    k_mutex_unlock(&spi_lock);
 
     return ret;
 }
 
 void deca_sleep(uint8_t time_ms) { k_msleep(time_ms); }
 void deca_usleep(uint8_t time_us) { k_busy_wait(time_us); }
-decaIrqStatus_t decamutexon(void) { return 0; }
-void decamutexoff(decaIrqStatus_t s) { }
+
+/* Mask the DW3000 IRQ line (not global interrupts) so dwt_isr() cannot run
+ * in the middle of a register sequence. Returns the previous mask state. */
+decaIrqStatus_t decamutexon(void) {
+    const decaIrqStatus_t was_armed = irq_armed;
+
+    if (was_armed && irq_gpio.port) {
+#if defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+        k_mutex_lock(&spi_lock, K_FOREVER);
+        pf_hw_disarm();
+        k_mutex_unlock(&spi_lock);
+#else
+        gpio_pin_interrupt_configure_dt(&irq_gpio, GPIO_INT_DISABLE);
+#endif
+        irq_armed = false;
+    }
+    return was_armed;
+}
+
+void decamutexoff(decaIrqStatus_t s) {
+    if (s && irq_gpio.port) {
+        irq_armed = true;
+        dw3000_irq_rearm();
+    }
+}
+
+#if !defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+/* The DW3000 IRQ is level-sensitive (high until SYS_STATUS is cleared), so an
+ * event that fired while masked is still seen when the line is re-armed.
+ * The ISR masks the line; dw3000_irq_rearm() re-enables it after dwt_isr(). */
+static void dw3000_irq_gpio_isr(const struct device *dev, struct gpio_callback *cb, gpio_port_pins_t pins) {
+    ARG_UNUSED(dev);
+    ARG_UNUSED(cb);
+    ARG_UNUSED(pins);
+
+    gpio_pin_interrupt_configure_dt(&irq_gpio, GPIO_INT_DISABLE);
+    if (irq_handler) {
+        irq_handler();
+    }
+}
+#endif
+
+int dw3000_irq_init(void (*handler)(void)) {
+    if (!irq_gpio.port || !gpio_is_ready_dt(&irq_gpio)) {
+        return -ENODEV;
+    }
+    gpio_pin_configure_dt(&irq_gpio, GPIO_INPUT);
+    irq_handler = handler;
+    irq_armed = false;
+#if defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+    return pf_init();
+#else
+    gpio_init_callback(&irq_cb_data, dw3000_irq_gpio_isr, BIT(irq_gpio.pin));
+    gpio_add_callback(irq_gpio.port, &irq_cb_data);
+    return 0;
+#endif
+}
+
+void dw3000_irq_set_armed(bool armed) {
+    if (!irq_gpio.port) {
+        return;
+    }
+    irq_armed = armed;
+#if defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+    k_mutex_lock(&spi_lock, K_FOREVER);
+    if (armed) {
+        pf_hw_arm();
+    } else {
+        pf_hw_disarm();
+    }
+    k_mutex_unlock(&spi_lock);
+#else
+    gpio_pin_interrupt_configure_dt(&irq_gpio, armed ? GPIO_INT_LEVEL_ACTIVE : GPIO_INT_DISABLE);
+#endif
+}
+
+void dw3000_irq_rearm(void) {
+    if (irq_armed && irq_gpio.port) {
+#if defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+        k_mutex_lock(&spi_lock, K_FOREVER);
+        pf_hw_arm();
+        k_mutex_unlock(&spi_lock);
+#else
+        gpio_pin_interrupt_configure_dt(&irq_gpio, GPIO_INT_LEVEL_ACTIVE);
+#endif
+    }
+}
+
+int dw3000_lock(k_timeout_t timeout) {
+    return k_mutex_lock(&dev_lock, timeout);
+}
+
+void dw3000_unlock(void) {
+    k_mutex_unlock(&dev_lock);
+}
 
 void reset_DWIC(void) {
     if (!gpio_is_ready_dt(&rst_gpio)) {
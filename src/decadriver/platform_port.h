@@ -0,0 +1,43 @@
+#ifndef PLATFORM_PORT_H
+#define PLATFORM_PORT_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/linker/section_tags.h>
+#include <stdbool.h>
+
+/* Functions on the RESP RX -> FINAL scheduling path run from RAM so their
+ * timing does not depend on flash wait states / cache misses. */
+#if defined(CONFIG_UWB_RAMFUNC_HOT_PATH)
+#define UWB_RAMFUNC __ramfunc
+#else
+#define UWB_RAMFUNC
+#endif
+
+/* nRF52833 <-> DW3000 glue (SPI3, CS/RST/IRQ GPIOs) */
+void peripherals_init(void);
+void reset_DWIC(void);
+
+/* Exclusive access to the DW3000 and its driver state (pdw3000local).
+ * Take it around any multi-call sequence. Returns 0 or -EBUSY/-EAGAIN like
+ * k_mutex_lock(). Background users must pass K_NO_WAIT so they can never
+ * delay the radio thread; the radio thread holds it for a whole TWR cycle. */
+int dw3000_lock(k_timeout_t timeout);
+void dw3000_unlock(void);
+
+/* DW3000 IRQ line (P0.24). `handler` runs in ISR context with the line
+ * already masked; call dw3000_irq_rearm() once dwt_isr() has run. */
+int dw3000_irq_init(void (*handler)(void));
+
+/* Enable/disable the DW3000 IRQ line interrupt (masked by decamutexon()). */
+void dw3000_irq_set_armed(bool armed);
+void dw3000_irq_rearm(void);
+
+/* CONFIG_UWB_IRQ_TRANSPORT_PPI: the IRQ edge starts an SPIM burst read of
+ * register file 0x00 from SYS_STATUS (0x44) through RX_TIME (0x64, 5 bytes)
+ * before the CPU is involved. Copies the bytes fetched for the current IRQ
+ * (offset 0 = SYS_STATUS) and returns the count, or 0 if nothing is pending
+ * or the software transport is in use. */
+#define DW3000_PREFETCH_LEN 40
+int dw3000_irq_take_prefetch(uint8_t *buf, size_t len);
+
+#endif /* PLATFORM_PORT_H */
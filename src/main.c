@@ -3,6 +3,11 @@
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/spi.h>
 #include <hal/nrf_gpio.h>
+#include "uwb_ranging.h"
+#include "uwb_uci.h"
+#include "uwb_stream.h"
+#include "uwb_rtt_bin.h"
+#include "uwb_rangelog.h"
 
 LOG_MODULE_REGISTER(uwb_tag_firmware, CONFIG_LOG_DEFAULT_LEVEL);
 
@@ -18,6 +23,11 @@ LOG_MODULE_REGISTER(uwb_tag_firmware, CONFIG_LOG_DEFAULT_LEVEL);
 #define UWB_CAL_SAMPLES 100
 #endif
 
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && CONFIG_HEAP_MEM_POOL_SIZE > 0
+#include <zephyr/sys/sys_heap.h>
+extern struct k_heap _system_heap;
+#endif
+
 /* LED0 for nRF52833 Dongle */
 // User requested "Front LED". On nRF52833 Dongle:
 // LED0 (Green) = P0.06
@@ -36,7 +46,6 @@ static const struct gpio_dt_spec cs_gpio = GPIO_DT_SPEC_GET(DW3000_NODE, cs_gpio
 /* Forward declaration of UWB driver functions */
 extern int uwb_driver_init(void);
 extern int uwb_send_blink(void);
-extern int uwb_twr_cycle(void);
 extern int uwb_rx_test_mode(void);
 extern int uwb_beacon_tx_mode(void); // TX beacon test
 extern int uwb_calibrate_antenna_delay(uint32_t ref_mm, uint16_t samples);
@@ -72,6 +81,7 @@ void uwb_led_pulse(void) {
     */
 }
 
+#if defined(CONFIG_UWB_GPIO_DISCO_SCAN)
 void gpio_scan_disco(void) {
     printk("\n--- STARTING GPIO DISCO SCAN ---\n");
     printk("Watch the board! Each pin will blink for 200ms.\n");
@@ -105,6 +115,7 @@ void gpio_scan_disco(void) {
     }
     printk("\n--- DISCO SCAN COMPLETE ---\n");
 }
+#endif /* CONFIG_UWB_GPIO_DISCO_SCAN */
 
 void raw_spi_test(void) {
     struct spi_config spi_cfg = {
@@ -150,6 +161,28 @@ void raw_spi_test(void) {
     }
 }
 
+/* main() exits after init, so its stack high-water mark is only visible here.
+ * Feeds the sizing in overlay-prod.conf together with the thread analyzer. */
+static void log_boot_memory(void)
+{
+#if defined(CONFIG_INIT_STACKS) && defined(CONFIG_THREAD_STACK_INFO)
+    size_t unused = 0;
+
+    if (k_thread_stack_space_get(k_current_get(), &unused) == 0) {
+        LOG_INF("main stack: %u of %d bytes used", (unsigned)(CONFIG_MAIN_STACK_SIZE - unused),
+                CONFIG_MAIN_STACK_SIZE);
+    }
+#endif
+#if defined(CONFIG_SYS_HEAP_RUNTIME_STATS) && CONFIG_HEAP_MEM_POOL_SIZE > 0
+    struct sys_memory_stats heap;
+
+    if (sys_heap_runtime_stats_get(&_system_heap.heap, &heap) == 0) {
+        LOG_INF("system heap: %u allocated, %u max of %d bytes", (unsigned)heap.allocated_bytes,
+                (unsigned)heap.max_allocated_bytes, CONFIG_HEAP_MEM_POOL_SIZE);
+    }
+#endif
+}
+
 /**
  * Main application entry point
  * UWB TAG FIRMWARE - TX Mode (Transmitter/BLINK)
@@ -162,21 +195,15 @@ void raw_spi_test(void) {
 int main(void)
 {
     int ret = 0;
-    uint32_t frame_count = 0;
     bool led_available = false;
 
-#ifndef TAG_TWR_PERIOD_MS
-// Requirement: TAG must keep transmitting periodically and must not "go to sleep".
-// Use a stable period so an anchor can always rediscover the tag when it comes back in range.
-// INCREASED to 1000ms to reduce log spam and allow easier debugging.
-#define TAG_TWR_PERIOD_MS 1000
-#endif
-
     /* Wait for RTT to connect */
     k_msleep(2000);
 
+#if defined(CONFIG_UWB_GPIO_DISCO_SCAN)
     // Run Disco Scan to identify LED pin visually
     gpio_scan_disco();
+#endif
 
     printk("\n\n");
     printk("===========================================\n");
@@ -245,46 +272,37 @@ int main(void)
 #endif
 
     printk("UWB Driver initialized successfully!\n");
-    printk("TWR ranging mode: periodic TX every %d ms\n", TAG_TWR_PERIOD_MS);
     k_msleep(500);
 
-    /* Main TWR loop */
-    int fail_count = 0;
-    while (1) {
-        int64_t t_start = k_uptime_get();
-        frame_count++;
-
-        // Ensure LED is OFF between transmissions; pulses are handled inside TX paths.
-        uwb_led_off();
-
-        ret = uwb_twr_cycle();
-        if (ret) {
-            // Keep the loop running regardless of failures.
-            // Avoid spamming RTT when disconnected; errors still show if enabled.
-            LOG_WRN("TWR cycle #%u failed", frame_count);
-            fail_count++;
-            
-            // Watchdog: If we fail 10 times in a row, re-initialize the radio.
-            // This fixes issues where the DW3000 gets stuck in a weird state on battery power.
-            if (fail_count >= 10) {
-                LOG_ERR("Too many failures! Re-initializing UWB driver...");
-                uwb_driver_init();
-                fail_count = 0;
-                k_msleep(100);
-            }
-        } else {
-            LOG_DBG("TWR cycle #%u complete", frame_count);
-            fail_count = 0; // Reset counter on success
-        }
+#if defined(CONFIG_UWB_RTT_BIN)
+    (void)uwb_rtt_bin_init();
+#endif
 
-        // Stable 2s cadence (or TAG_TWR_PERIOD_MS) regardless of anchor presence.
-        int64_t elapsed = k_uptime_get() - t_start;
-        int32_t sleep_ms = (int32_t)TAG_TWR_PERIOD_MS - (int32_t)elapsed;
-        if (sleep_ms < 0) {
-            sleep_ms = 0;
-        }
-        k_msleep(sleep_ms);
+#if defined(CONFIG_UWB_RANGELOG)
+    if (uwb_rangelog_start() != 0) {
+        LOG_ERR("Range log unavailable");
     }
+#endif
+
+#if defined(CONFIG_UWB_STREAM)
+    // Open the stream port first so no early result is dropped
+    if (uwb_stream_start() != 0) {
+        LOG_ERR("Range stream unavailable");
+    }
+#endif
+
+    /* Hand the radio over to the dedicated ranging thread. From here on only
+     * uwb_radio touches the DW3000; results are consumed at lower priority. */
+    uwb_ranging_start();
+
+#if defined(CONFIG_UWB_UCI)
+    // Ranging now waits for a host session (RANGE_START) on the UCI port
+    if (uwb_uci_start() != 0) {
+        LOG_ERR("UCI host interface unavailable");
+    }
+#endif
+
+    log_boot_memory();
     
     return 0;
 }
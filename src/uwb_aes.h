@@ -0,0 +1,73 @@
+#ifndef UWB_AES_H
+#define UWB_AES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "deca_device_api.h"
+#include "uwb_frame.h"
+
+/* Authenticated payload encryption (AES-128 CCM*) on the DW3000 AES engine.
+ *
+ * Secured frames set UWB_FC_SEC in the frame control and extend the clear
+ * header with the tag's session id and the sender's frame counter:
+ *
+ *   FC(2) Seq(1) PAN(2) Dest(2) Src(2) MsgType(1) Session(4) Counter(4) |
+ *   payload (encrypted) | MIC (CONFIG_UWB_AES_MIC_LEN) | FCS(2)
+ *
+ * The header is authenticated but not encrypted, so frames are still routed
+ * by MsgType. Nonce = PAN | Src | Session | Counter | MIC length: unique per
+ * sender as long as the session id is, so the counter restarts at 0 on every
+ * uwb_aes_session_start(). The session id is random and echoed by the anchor;
+ * frames from another session or with a counter not above the last one seen
+ * from that sender are rejected before decryption.
+ *
+ * Encryption runs in place in the TX buffer (the header and plaintext are
+ * written once, as dwt_writetxdata() would), decryption in place in the RX
+ * buffer, so no ciphertext crosses the SPI bus on either side.
+ */
+
+#define UWB_SEC_IDX_SESSION     UWB_IDX_PAYLOAD
+#define UWB_SEC_IDX_CTR         (UWB_IDX_PAYLOAD + 4)
+#define UWB_SEC_HDR_LEN         (UWB_IDX_PAYLOAD + 8)
+#define UWB_AES_NONCE_LEN       13
+
+struct uwb_aes_stats {
+    uint32_t session;       // current session id
+    uint32_t tx_ctr;        // next outgoing frame counter
+    uint32_t tx_ok;
+    uint32_t rx_ok;
+    uint32_t rx_malformed;  // too short or not secured
+    uint32_t rx_session;    // session id is not ours
+    uint32_t rx_replay;     // counter not above the last one from that sender
+    uint32_t rx_auth_fail;  // MIC mismatch
+    uint32_t errors;        // AES engine / DMA errors
+    uint32_t enc_max_us;
+    uint64_t enc_sum_us;
+    uint32_t dec_max_us;
+    uint64_t dec_sum_us;
+};
+
+/* Start a payload session: program the key register (NULL = CONFIG_UWB_AES_KEY),
+ * draw a new session id and reset counters. Call after dwt_configure(). */
+int uwb_aes_session_start(const dwt_aes_key_t *key);
+
+/* Secure and write a frame to the TX buffer. `frame` holds the plain 10-byte
+ * header followed by `payload_len` bytes at UWB_SEC_HDR_LEN; session and counter
+ * are filled in here. *tx_len is set to the on-air length without FCS.
+ * Returns 0 or -EIO. */
+int uwb_aes_tx_write(uint8_t *frame, uint16_t payload_len, uint16_t *tx_len);
+
+/* Authenticate and decrypt the frame just received (still in RX buffer 0).
+ * `frame`/`len` are the copy already read (len incl. FCS); the plaintext is
+ * written to `payload` (at most `max` bytes) and its length to *payload_len.
+ * Returns 0, -EBADMSG (malformed/auth), -ESTALE (session) or -EALREADY (replay). */
+int uwb_aes_rx_open(const uint8_t *frame, uint16_t len, uint8_t *payload, uint16_t max,
+                    uint16_t *payload_len);
+
+void uwb_aes_get_stats(struct uwb_aes_stats *out);
+
+/* DW3000 AES-CCM vs. software AES-CCM on the nRF52 for a FINAL-sized payload.
+ * Uses the TX buffer: call while the radio is idle. */
+void uwb_aes_benchmark(void);
+
+#endif /* UWB_AES_H */
@@ -0,0 +1,203 @@
+#include <string.h>
+#include "uwb_anchor_table.h"
+
+/* Anchor table and best-N selection (see uwb_anchor_table.h). No RTOS
+ * dependencies. */
+
+#define ADDR_BROADCAST  0xFFFF
+
+// EWMA with weight 1/4 for the newest sample: a few exchanges move the rank
+static uint16_t ewma(uint16_t avg, uint16_t sample) {
+    return (uint16_t)((3U * avg + sample + 2U) / 4U);
+}
+
+void uwb_anchor_table_init(struct uwb_anchor_table *t, const struct uwb_anchor_cfg *cfg) {
+    memset(t, 0, sizeof(*t));
+    t->cfg = *cfg;
+    if (t->cfg.best_n == 0) {
+        t->cfg.best_n = 1;
+    }
+    if (t->cfg.best_n > UWB_ANCHOR_TABLE_SIZE) {
+        t->cfg.best_n = UWB_ANCHOR_TABLE_SIZE;
+    }
+    if (t->cfg.max_misses == 0) {
+        t->cfg.max_misses = 1;
+    }
+}
+
+static struct uwb_anchor_entry *find(struct uwb_anchor_table *t, uint16_t addr) {
+    for (int i = 0; i < UWB_ANCHOR_TABLE_SIZE; i++) {
+        if (t->e[i].addr == addr) {
+            return &t->e[i];
+        }
+    }
+    return NULL;
+}
+
+/* Existing entry, a free one, or the longest-silent one once it has been
+ * quiet for half the timeout. NULL if all are in use. */
+static struct uwb_anchor_entry *get(struct uwb_anchor_table *t, uint16_t addr, uint32_t now_ms) {
+    struct uwb_anchor_entry *e = find(t, addr);
+
+    if (e) {
+        return e;
+    }
+    e = find(t, 0);
+    if (!e) {
+        struct uwb_anchor_entry *old = &t->e[0];
+
+        t->stats.table_full++;
+        for (int i = 1; i < UWB_ANCHOR_TABLE_SIZE; i++) {
+            if ((uint32_t)(now_ms - t->e[i].heard_ms) > (uint32_t)(now_ms - old->heard_ms)) {
+                old = &t->e[i];
+            }
+        }
+        if ((uint32_t)(now_ms - old->heard_ms) < t->cfg.timeout_ms / 2U) {
+            return NULL;
+        }
+        e = old;
+    }
+    memset(e, 0, sizeof(*e));
+    e->addr = addr;
+    e->success = 128;           // unknown: ranks below proven anchors, above failing ones
+    e->quality = 50;
+    e->heard_ms = now_ms;
+    t->stats.added++;
+    return e;
+}
+
+void uwb_anchor_heard(struct uwb_anchor_table *t, uint16_t addr, uint32_t now_ms) {
+    if (addr == 0 || addr == ADDR_BROADCAST) {
+        return;
+    }
+
+    struct uwb_anchor_entry *e = get(t, addr, now_ms);
+
+    if (e) {
+        e->heard_ms = now_ms;
+    }
+}
+
+uint32_t uwb_anchor_score(const struct uwb_anchor_entry *e) {
+    return (uint32_t)e->success * e->quality;
+}
+
+static bool better(const struct uwb_anchor_entry *a, const struct uwb_anchor_entry *b) {
+    const uint32_t sa = uwb_anchor_score(a);
+    const uint32_t sb = uwb_anchor_score(b);
+
+    if (sa != sb) {
+        return sa > sb;
+    }
+    // Nearer first; no range yet counts as farthest
+    return (a->dist_mm - 1U) < (b->dist_mm - 1U);
+}
+
+static void new_epoch(struct uwb_anchor_table *t, uint32_t now_ms) {
+    const struct uwb_anchor_entry *cand[UWB_ANCHOR_TABLE_SIZE];
+    int n = 0;
+
+    for (int i = 0; i < UWB_ANCHOR_TABLE_SIZE; i++) {
+        struct uwb_anchor_entry *e = &t->e[i];
+
+        if (e->addr && (uint32_t)(now_ms - e->heard_ms) > t->cfg.timeout_ms) {
+            e->addr = 0;
+            t->stats.expired++;
+        }
+        if (e->addr && e->misses < t->cfg.max_misses) {
+            cand[n++] = e;
+        }
+    }
+
+    // Partial selection sort: the best best_n to the front
+    for (int i = 0; i < n && i < t->cfg.best_n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            if (better(cand[j], cand[i])) {
+                const struct uwb_anchor_entry *tmp = cand[i];
+
+                cand[i] = cand[j];
+                cand[j] = tmp;
+            }
+        }
+    }
+
+    t->sel_n = t->cfg.best_n;
+    t->sel_pos = 0;
+    for (int i = 0; i < t->sel_n; i++) {
+        t->sel[i] = (i < n) ? cand[i]->addr : ADDR_BROADCAST;
+    }
+    // Keep looking for anchors that are not in the table yet
+    if (n >= t->sel_n && t->cfg.discover_epochs &&
+        (t->stats.epochs % t->cfg.discover_epochs) == 0) {
+        t->sel[t->sel_n - 1] = ADDR_BROADCAST;
+    }
+    t->stats.epochs++;
+}
+
+uint16_t uwb_anchor_next(struct uwb_anchor_table *t, uint32_t now_ms) {
+    if (t->sel_pos >= t->sel_n) {
+        new_epoch(t, now_ms);
+    }
+
+    const uint16_t target = t->sel[t->sel_pos++];
+
+    if (target == ADDR_BROADCAST) {
+        t->stats.discovery++;
+    } else {
+        t->stats.unicast++;
+    }
+    return target;
+}
+
+void uwb_anchor_result(struct uwb_anchor_table *t, uint16_t target, uint16_t anchor,
+                       uint32_t now_ms, uint8_t quality, uint32_t dist_mm) {
+    if (anchor && anchor != ADDR_BROADCAST) {
+        struct uwb_anchor_entry *e = get(t, anchor, now_ms);
+
+        if (e) {
+            e->heard_ms = now_ms;
+            if (dist_mm) {
+                e->success = ewma(e->success, 256);
+                e->quality = (uint8_t)ewma(e->quality, quality);
+                e->dist_mm = dist_mm;
+                e->misses = 0;      // also brings back a skipped anchor
+                e->ok++;
+            } else {
+                e->success = ewma(e->success, 0);
+                e->fail++;
+            }
+        }
+    }
+    if (target != ADDR_BROADCAST && target != anchor) {
+        struct uwb_anchor_entry *e = find(t, target);
+
+        if (e) {
+            e->success = ewma(e->success, 0);
+            if (e->misses < UINT8_MAX) {
+                e->misses++;
+            }
+            e->fail++;
+        }
+    }
+}
+
+int uwb_anchor_count(const struct uwb_anchor_table *t) {
+    int n = 0;
+
+    for (int i = 0; i < UWB_ANCHOR_TABLE_SIZE; i++) {
+        n += (t->e[i].addr != 0);
+    }
+    return n;
+}
+
+const struct uwb_anchor_entry *uwb_anchor_find(const struct uwb_anchor_table *t, uint16_t addr) {
+    if (addr == 0) {
+        return NULL;
+    }
+    for (int i = 0; i < UWB_ANCHOR_TABLE_SIZE; i++) {
+        if (t->e[i].addr == addr) {
+            return &t->e[i];
+        }
+    }
+    return NULL;
+}
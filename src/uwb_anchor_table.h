@@ -0,0 +1,89 @@
+#ifndef UWB_ANCHOR_TABLE_H
+#define UWB_ANCHOR_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Anchor table and best-N selection (CONFIG_UWB_ANCHOR_SELECT). Plain C, no
+ * Zephyr dependencies.
+ *
+ * Anchors enter the table when the tag hears them: a RESP to one of our
+ * broadcast (discovery) POLLs, or any anchor frame overheard while listening.
+ * Each entry keeps when it was last heard, an EWMA of its exchange outcomes,
+ * an EWMA of the quality score (uwb_est_quality) of its completed exchanges,
+ * the last range and the consecutive misses. Ranging runs in epochs of
+ * `best_n` cycles. At each epoch start the tag picks the best_n usable anchors
+ * by score, then POLLs each of them unicast in turn. Slots the table cannot
+ * fill, and one slot every `discover_epochs` epochs, send a broadcast POLL
+ * instead so new anchors are found.
+ *
+ * Score = success x quality, both EWMAs, so an anchor that answers every time
+ * with clean exchanges ranks first. Ties go to the nearer anchor. An anchor
+ * that missed `max_misses` unicast POLLs in a row is left out until it
+ * completes an exchange again (answering a broadcast POLL); one not heard for
+ * `timeout_ms` is dropped. Overheard frames only keep an entry alive.
+ */
+
+#ifndef UWB_ANCHOR_TABLE_SIZE
+#define UWB_ANCHOR_TABLE_SIZE   16
+#endif
+
+#define UWB_ANCHOR_SCORE_MAX    (256U * 100U)
+
+struct uwb_anchor_cfg {
+    uint8_t best_n;             // anchors ranged per epoch (= cycles per epoch)
+    uint8_t max_misses;         // consecutive misses before an anchor is skipped
+    uint16_t discover_epochs;   // one broadcast slot every N epochs (0 = only to fill)
+    uint32_t timeout_ms;        // drop an anchor not heard for this long
+};
+
+struct uwb_anchor_entry {
+    uint16_t addr;              // 0 = free
+    uint8_t quality;            // EWMA of completed exchanges' quality, 0-100
+    uint8_t misses;             // consecutive unicast POLLs without a result
+    uint16_t success;           // EWMA of outcomes, 0-256 (256 = always completes)
+    uint32_t heard_ms;          // last frame from it
+    uint32_t dist_mm;           // last range (0 = none yet)
+    uint32_t ok;
+    uint32_t fail;
+};
+
+struct uwb_anchor_stats {
+    uint32_t epochs;
+    uint32_t unicast;           // cycles POLLing a selected anchor
+    uint32_t discovery;         // broadcast cycles
+    uint32_t added;
+    uint32_t expired;
+    uint32_t table_full;        // anchor heard while the table was full
+};
+
+struct uwb_anchor_table {
+    struct uwb_anchor_cfg cfg;
+    struct uwb_anchor_entry e[UWB_ANCHOR_TABLE_SIZE];
+    uint16_t sel[UWB_ANCHOR_TABLE_SIZE];    // this epoch's targets, 0xFFFF = broadcast
+    uint8_t sel_n;
+    uint8_t sel_pos;
+    struct uwb_anchor_stats stats;
+};
+
+void uwb_anchor_table_init(struct uwb_anchor_table *t, const struct uwb_anchor_cfg *cfg);
+
+/* A frame from anchor `addr` was heard (adds it if new). */
+void uwb_anchor_heard(struct uwb_anchor_table *t, uint16_t addr, uint32_t now_ms);
+
+/* Target for the next cycle: an anchor address, or 0xFFFF for a broadcast
+ * (discovery) POLL. Starts a new epoch when the last one is used up. */
+uint16_t uwb_anchor_next(struct uwb_anchor_table *t, uint32_t now_ms);
+
+/* Outcome of a cycle POLLing `target`. `anchor` is who answered (0 = nobody),
+ * quality its uwb_est_quality() score, dist_mm the range (0 if none). */
+void uwb_anchor_result(struct uwb_anchor_table *t, uint16_t target, uint16_t anchor,
+                       uint32_t now_ms, uint8_t quality, uint32_t dist_mm);
+
+/* 0 .. UWB_ANCHOR_SCORE_MAX */
+uint32_t uwb_anchor_score(const struct uwb_anchor_entry *e);
+
+int uwb_anchor_count(const struct uwb_anchor_table *t);
+const struct uwb_anchor_entry *uwb_anchor_find(const struct uwb_anchor_table *t, uint16_t addr);
+
+#endif /* UWB_ANCHOR_TABLE_H */
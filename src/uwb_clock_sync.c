@@ -0,0 +1,275 @@
+#include <string.h>
+#include "uwb_clock_sync.h"
+
+/* Wireless clock synchronization for TDoA anchors (see uwb_clock_sync.h).
+ * No RTOS dependencies. */
+
+/* Skew random walk (DTU^2 / DTU^3): ~2.5 ppb/sqrt(s) of crystal wander, so
+ * over a 100 ms sync period the offset prediction loses a few DTU. */
+#define CS_Q                1e-28
+#define CS_SKEW0            50e-6       // initial skew uncertainty (crystal tolerance)
+#define CS_RESTART_RUN      3           // consecutive rejects that restart the model
+
+#define TS_BITS             40
+#define TS_WRAP             ((int64_t)1 << TS_BITS)
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    const int64_t q = a / b;
+
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
+
+static int64_t round_i64(double v) {
+    return (int64_t)(v >= 0 ? v + 0.5 : v - 0.5);
+}
+
+static uint32_t isqrt_u64(uint64_t v) {
+    uint64_t r = 0;
+
+    for (uint64_t bit = 1ULL << 62; bit; bit >>= 2) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+    }
+    return (uint32_t)r;
+}
+
+int64_t uwb_cs_unwrap(struct uwb_cs_unwrap *u, uint64_t raw, uint32_t now_ms) {
+    raw &= UWB_TS_MASK;
+    if (!u->valid) {
+        u->valid = true;
+        u->last_raw = raw;
+        u->last = (int64_t)raw;
+        u->last_ms = now_ms;
+        return u->last;
+    }
+    // Distance mod 2^40, plus the wraps the uptime says went by (signed: a
+    // frame handled late can be older than the last one)
+    const int64_t expect = (int64_t)(int32_t)(now_ms - u->last_ms) * UWB_CS_DTU_PER_MS;
+    int64_t d = (int64_t)((raw - u->last_raw) & UWB_TS_MASK);
+
+    d += floor_div(expect - d + TS_WRAP / 2, TS_WRAP) * TS_WRAP;
+    if (d < 0) {
+        return u->last + d;
+    }
+    u->last_raw = raw;
+    u->last += d;
+    u->last_ms = now_ms;
+    return u->last;
+}
+
+void uwb_cs_init(struct uwb_cs_state *st, const struct uwb_cs_cfg *cfg) {
+    memset(st, 0, sizeof(*st));
+    st->cfg = *cfg;
+}
+
+void uwb_cs_sync_put(uint8_t *f, uint8_t seq, uint16_t src, uint64_t tx_ts, uint16_t period_ms) {
+    f[0] = UWB_FC_LSB;
+    f[1] = UWB_FC_MSB;
+    f[UWB_IDX_SEQ] = seq;
+    uwb_put_u16(&f[UWB_IDX_PAN], UWB_PAN_ID);
+    uwb_put_u16(&f[UWB_IDX_DEST], UWB_ADDR_BROADCAST);
+    uwb_put_u16(&f[UWB_IDX_SRC], src);
+    f[UWB_IDX_FUNC] = FUNC_CODE_SYNC;
+    uwb_put_ts40(&f[UWB_IDX_PAYLOAD], tx_ts);
+    uwb_put_u16(&f[UWB_IDX_PAYLOAD + UWB_TS_LEN], period_ms);
+}
+
+int uwb_cs_sync_get(const uint8_t *f, uint16_t len, uint16_t *src, uint8_t *seq,
+                    uint64_t *tx_ts, uint16_t *period_ms) {
+    if (len < UWB_CS_SYNC_LEN || !uwb_frame_hdr_ok(f, len) || f[UWB_IDX_FUNC] != FUNC_CODE_SYNC) {
+        return -1;
+    }
+    *src = uwb_get_u16(&f[UWB_IDX_SRC]);
+    if (*src == 0 || *src == UWB_ADDR_BROADCAST) {
+        return -1;
+    }
+    *seq = f[UWB_IDX_SEQ];
+    *tx_ts = uwb_get_ts40(&f[UWB_IDX_PAYLOAD]);
+    *period_ms = uwb_get_u16(&f[UWB_IDX_PAYLOAD + UWB_TS_LEN]);
+    return 0;
+}
+
+static struct uwb_cs_master *find(struct uwb_cs_state *st, uint16_t addr) {
+    for (int i = 0; i < UWB_CS_MASTERS; i++) {
+        if (st->m[i].addr == addr) {
+            return &st->m[i];
+        }
+    }
+    return NULL;
+}
+
+/* Existing entry, a free one, or one silent for longer than the timeout */
+static struct uwb_cs_master *get(struct uwb_cs_state *st, uint16_t addr, uint32_t now_ms) {
+    struct uwb_cs_master *m = find(st, addr);
+
+    if (m) {
+        return m;
+    }
+    m = find(st, 0);
+    for (int i = 0; !m && i < UWB_CS_MASTERS; i++) {
+        if ((uint32_t)(now_ms - st->m[i].heard_ms) > st->cfg.timeout_ms) {
+            m = &st->m[i];
+        }
+    }
+    if (!m) {
+        st->stats.table_full++;
+        return NULL;
+    }
+    memset(m, 0, sizeof(*m));
+    m->addr = addr;
+    m->heard_ms = now_ms;
+    m->tof_dtu = st->cfg.tof_dtu;
+    return m;
+}
+
+int uwb_cs_set_tof(struct uwb_cs_state *st, uint16_t master, double tof_dtu) {
+    struct uwb_cs_master *m = get(st, master, st->local.last_ms);
+
+    if (!m) {
+        return -1;
+    }
+    m->tof_dtu = tof_dtu;
+    return 0;
+}
+
+static void clock_start(struct uwb_cs_clock *c, int64_t local, int64_t master, double tof) {
+    c->base = local - master;
+    c->last = local;
+    c->off = -tof;
+    c->skew = 0;
+    c->P[0][0] = UWB_CS_MEAS_DTU * UWB_CS_MEAS_DTU;
+    c->P[0][1] = c->P[1][0] = 0;
+    c->P[1][1] = CS_SKEW0 * CS_SKEW0;
+    c->syncs = 1;
+    c->reject_run = 0;
+    c->valid = true;
+}
+
+/* One sync: 0, or -1 if gated out */
+static int clock_update(struct uwb_cs_master *m, int64_t local_rx, int64_t master_tx) {
+    struct uwb_cs_clock *c = &m->clk;
+    const double r = UWB_CS_MEAS_DTU * UWB_CS_MEAS_DTU;
+
+    if (!c->valid) {
+        clock_start(c, local_rx, master_tx, m->tof_dtu);
+        return 0;
+    }
+
+    // Predict: off += skew * dt, P = F P F' + Q
+    const double dt = (double)(local_rx - c->last);
+    const double p00 = c->P[0][0] + dt * (c->P[1][0] + c->P[0][1]) + dt * dt * c->P[1][1] +
+                       CS_Q * dt * dt * dt / 3;
+    const double p01 = c->P[0][1] + dt * c->P[1][1] + CS_Q * dt * dt / 2;
+    const double p11 = c->P[1][1] + CS_Q * dt;
+
+    c->off += c->skew * dt;
+    c->last = local_rx;
+    c->P[0][0] = p00;
+    c->P[0][1] = c->P[1][0] = p01;
+    c->P[1][1] = p11;
+
+    // The sync arrived tof after it left: local_rx - master_tx - tof is the
+    // clock offset the model predicts
+    const double y = (double)(local_rx - master_tx - c->base) - m->tof_dtu - c->off;
+    const double s = p00 + r;
+
+    if (c->syncs >= UWB_CS_WARMUP && y * y > UWB_CS_GATE * UWB_CS_GATE * s) {
+        m->rejected++;
+        if (++c->reject_run >= CS_RESTART_RUN) {
+            // The master's clock really jumped (reset): start over from this sync
+            clock_start(c, local_rx, master_tx, m->tof_dtu);
+            m->restarts++;
+        }
+        return -1;
+    }
+    c->reject_run = 0;
+
+    const double k0 = p00 / s;
+    const double k1 = p01 / s;
+
+    c->off += k0 * y;
+    c->skew += k1 * y;
+    c->P[0][0] = (1 - k0) * p00;
+    c->P[0][1] = c->P[1][0] = (1 - k0) * p01;
+    c->P[1][1] = p11 - k1 * p01;
+
+    // Keep the fractional part small so the double stays exact
+    const int64_t whole = (int64_t)c->off;
+
+    c->base += whole;
+    c->off -= (double)whole;
+    c->syncs++;
+    return 0;
+}
+
+int uwb_cs_sync(struct uwb_cs_state *st, uint16_t master, uint8_t seq, uint64_t master_tx,
+                uint64_t local_rx, uint32_t now_ms) {
+    struct uwb_cs_master *m = get(st, master, now_ms);
+
+    if (!m) {
+        return -1;
+    }
+    if (m->syncs) {
+        m->lost += (uint8_t)(seq - m->seq - 1);
+    }
+    m->seq = seq;
+    m->heard_ms = now_ms;
+    m->syncs++;
+
+    const int64_t local = uwb_cs_unwrap(&st->local, local_rx, now_ms);
+    const int64_t mtx = uwb_cs_unwrap(&m->ts, master_tx, now_ms);
+
+    return clock_update(m, local, mtx);
+}
+
+bool uwb_cs_synced(const struct uwb_cs_master *m, uint32_t now_ms, uint32_t timeout_ms) {
+    return m->addr && m->clk.valid && m->clk.syncs >= UWB_CS_WARMUP &&
+           (uint32_t)(now_ms - m->heard_ms) <= timeout_ms;
+}
+
+int uwb_cs_convert(struct uwb_cs_state *st, uint64_t local_rx, uint32_t now_ms,
+                   uint64_t *master_ts, uint16_t *master, uint32_t *sigma_dtu) {
+    const struct uwb_cs_master *best = NULL;
+
+    for (int i = 0; i < UWB_CS_MASTERS; i++) {
+        const struct uwb_cs_master *m = &st->m[i];
+
+        if (uwb_cs_synced(m, now_ms, st->cfg.timeout_ms) && (!best || m->addr < best->addr)) {
+            best = m;
+        }
+    }
+    if (!best) {
+        st->stats.unsynced++;
+        return -1;
+    }
+
+    const struct uwb_cs_clock *c = &best->clk;
+    const int64_t local = uwb_cs_unwrap(&st->local, local_rx, now_ms);
+    const double dt = (double)(local - c->last);
+
+    *master_ts = (uint64_t)(local - c->base - round_i64(c->off + c->skew * dt)) & UWB_TS_MASK;
+    *master = best->addr;
+    if (sigma_dtu) {
+        const double var = c->P[0][0] + 2 * dt * c->P[0][1] + dt * dt * c->P[1][1];
+
+        *sigma_dtu = isqrt_u64(var > 0 ? (uint64_t)var : 0);
+    }
+    st->stats.converted++;
+    return 0;
+}
+
+const struct uwb_cs_master *uwb_cs_find(const struct uwb_cs_state *st, uint16_t master) {
+    if (master == 0) {
+        return NULL;
+    }
+    for (int i = 0; i < UWB_CS_MASTERS; i++) {
+        if (st->m[i].addr == master) {
+            return &st->m[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,130 @@
+#ifndef UWB_CLOCK_SYNC_H
+#define UWB_CLOCK_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uwb_frame.h"
+
+/* Wireless clock synchronization for TDoA anchors (CONFIG_UWB_CLOCK_SYNC).
+ * Plain C: shared by the anchor role in uwb_driver_qorvo.c and the site
+ * simulator (host/tdoa, --anchor-sync).
+ *
+ * A master anchor sends a sync frame every period carrying its own TX
+ * timestamp, known in advance because the frame is a delayed TX. Every other
+ * anchor (slave) timestamps the frame and feeds the pair to its model of that
+ * master's clock,
+ *
+ *   local - master = base + off + skew * (t - last)        DTU, t local
+ *
+ * a two-state Kalman filter on offset and skew with a random-walk skew
+ * (outliers gated, restarted after a run of them: the master was reset). A
+ * slave converts the RX timestamp of any other frame into the master's
+ * timebase before reporting it, so arrivals at different anchors can be
+ * differenced directly. Up to UWB_CS_MASTERS masters are tracked. Conversions
+ * use the lowest-addressed synced one, so every slave in its range picks the
+ * same timebase, and name it.
+ *
+ * The sync frame's time of flight to the slave is part of the measured
+ * offset. uwb_cs_set_tof() removes it when the distance is known; otherwise
+ * it stays in as a constant per slave.
+ *
+ * Timestamps are the DW3000's 40-bit counters (15.65 ps, wrap every 17.2 s).
+ * They are unwrapped with the millisecond uptime alongside, so gaps between
+ * frames longer than a wrap are handled too.
+ *
+ * Sync frame, little endian: header (dest broadcast, FUNC_CODE_SYNC),
+ *   tx_ts(5) period_ms(2)
+ */
+
+#define FUNC_CODE_SYNC          0x53
+#define UWB_CS_SYNC_LEN         (UWB_IDX_PAYLOAD + UWB_TS_LEN + 2)
+
+#define UWB_CS_DTU_PER_MS       63897600LL      // 499.2 MHz x 128
+#define UWB_CS_MEAS_DTU         8.0             // sync timestamp noise (1 sigma, ~125 ps)
+#define UWB_CS_GATE             6.0
+#define UWB_CS_WARMUP           4               // syncs before gating and converting
+
+#ifndef UWB_CS_MASTERS
+#define UWB_CS_MASTERS          4
+#endif
+
+struct uwb_cs_unwrap {
+    uint64_t last_raw;
+    int64_t last;
+    uint32_t last_ms;
+    bool valid;
+};
+
+struct uwb_cs_clock {
+    int64_t base;
+    int64_t last;               // local time of the estimate
+    double off;
+    double skew;
+    double P[2][2];
+    uint32_t syncs;
+    uint8_t reject_run;
+    bool valid;
+};
+
+struct uwb_cs_master {
+    uint16_t addr;              // 0 = free
+    uint8_t seq;                // last sync frame
+    uint32_t heard_ms;
+    double tof_dtu;
+    struct uwb_cs_unwrap ts;    // its TX timestamps
+    struct uwb_cs_clock clk;
+    uint32_t syncs;
+    uint32_t rejected;
+    uint32_t lost;              // sync frames missed (sequence gaps)
+    uint32_t restarts;
+};
+
+struct uwb_cs_cfg {
+    uint32_t timeout_ms;        // stop converting with a master not heard for this long
+    double tof_dtu;             // default sync time of flight for new masters
+};
+
+struct uwb_cs_stats {
+    uint32_t converted;
+    uint32_t unsynced;          // frames no synced master could convert
+    uint32_t table_full;
+};
+
+struct uwb_cs_state {
+    struct uwb_cs_cfg cfg;
+    struct uwb_cs_unwrap local;
+    struct uwb_cs_master m[UWB_CS_MASTERS];
+    struct uwb_cs_stats stats;
+};
+
+void uwb_cs_init(struct uwb_cs_state *st, const struct uwb_cs_cfg *cfg);
+
+/* Extend a 40-bit timestamp taken at about `now_ms`. A timestamp slightly
+ * older than the last one is returned without moving it. */
+int64_t uwb_cs_unwrap(struct uwb_cs_unwrap *u, uint64_t raw, uint32_t now_ms);
+
+/* Sync frame (UWB_CS_SYNC_LEN bytes) and its parser (0 or -1) */
+void uwb_cs_sync_put(uint8_t *f, uint8_t seq, uint16_t src, uint64_t tx_ts, uint16_t period_ms);
+int uwb_cs_sync_get(const uint8_t *f, uint16_t len, uint16_t *src, uint8_t *seq,
+                    uint64_t *tx_ts, uint16_t *period_ms);
+
+/* Time of flight of `master`'s sync frames to this anchor (adds the master). */
+int uwb_cs_set_tof(struct uwb_cs_state *st, uint16_t master, double tof_dtu);
+
+/* A sync frame from `master`: its TX timestamp and our RX timestamp (raw).
+ * Returns 0, or -1 if it was rejected as an outlier or the table is full. */
+int uwb_cs_sync(struct uwb_cs_state *st, uint16_t master, uint8_t seq, uint64_t master_tx,
+                uint64_t local_rx, uint32_t now_ms);
+
+/* Local RX timestamp -> the preferred master's timebase (40-bit). sigma_dtu
+ * is the model's 1-sigma uncertainty at that time (may be NULL). Returns 0,
+ * or -1 if no master is synced. */
+int uwb_cs_convert(struct uwb_cs_state *st, uint64_t local_rx, uint32_t now_ms,
+                   uint64_t *master_ts, uint16_t *master, uint32_t *sigma_dtu);
+
+/* Synced: past warmup and heard within the timeout */
+bool uwb_cs_synced(const struct uwb_cs_master *m, uint32_t now_ms, uint32_t timeout_ms);
+
+const struct uwb_cs_master *uwb_cs_find(const struct uwb_cs_state *st, uint16_t master);
+
+#endif /* UWB_CLOCK_SYNC_H */
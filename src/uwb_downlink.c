@@ -0,0 +1,127 @@
+#include <string.h>
+#include "uwb_downlink.h"
+#include "uwb_frame.h"
+
+/* Downlink configuration commands (see uwb_downlink.h). No RTOS
+ * dependencies. */
+
+void uwb_dl_init(struct uwb_dl_state *st) {
+    memset(st, 0, sizeof(*st));
+}
+
+int uwb_dl_rx(struct uwb_dl_state *st, const uint8_t *p, uint16_t len, uint16_t src) {
+    if (len < UWB_DL_HDR_LEN || p[0] != UWB_DL_CMD_TAG) {
+        return -1;
+    }
+    st->stats.rx++;
+    if (p[3] > UWB_DL_VAL_MAX || len < UWB_DL_HDR_LEN + p[3]) {
+        st->stats.malformed++;
+        return -1;
+    }
+
+    const uint8_t seq = p[1];
+
+    if (st->done && seq == st->last_seq) {
+        // Our ack was lost: send it again, do not apply twice
+        st->stats.repeats++;
+        st->ack = true;
+        return 0;
+    }
+    if (st->pending && seq != st->cmd.seq) {
+        st->stats.replaced++;
+    }
+    st->cmd.seq = seq;
+    st->cmd.op = p[2];
+    st->cmd.len = p[3];
+    memcpy(st->cmd.val, &p[UWB_DL_HDR_LEN], p[3]);
+    st->src = src;
+    st->pending = true;
+    return 0;
+}
+
+bool uwb_dl_take(struct uwb_dl_state *st, struct uwb_dl_cmd *out) {
+    if (!st->pending) {
+        return false;
+    }
+    *out = st->cmd;
+    st->pending = false;
+    return true;
+}
+
+void uwb_dl_done(struct uwb_dl_state *st, uint8_t status) {
+    st->done = true;
+    st->last_seq = st->cmd.seq;
+    st->last_status = status;
+    st->ack = true;
+    if (status == UWB_DL_OK) {
+        st->stats.applied++;
+    } else {
+        st->stats.rejected++;
+    }
+}
+
+static bool tx_power_ok(const uint8_t *v) {
+    for (int i = 0; i < 4; i++) {
+        if (v[i] > UWB_DL_TX_POWER_MAX) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool phy_ok(uint8_t chan, uint8_t code) {
+    // DW3000: channels 5 and 9, codes 3-4 (16 MHz PRF) and 9-12 (64 MHz PRF)
+    return (chan == 5 || chan == 9) && ((code >= 3 && code <= 4) || (code >= 9 && code <= 12));
+}
+
+uint8_t uwb_dl_check(const struct uwb_dl_cmd *c) {
+    switch (c->op) {
+    case UWB_DL_OP_PERIOD: {
+        if (c->len != 2) {
+            return UWB_DL_BAD_VALUE;
+        }
+        const uint16_t ms = uwb_get_u16(c->val);
+
+        return (ms >= UWB_DL_PERIOD_MIN_MS && ms <= UWB_DL_PERIOD_MAX_MS) ? UWB_DL_OK
+                                                                          : UWB_DL_BAD_VALUE;
+    }
+    case UWB_DL_OP_TX_POWER:
+        return (c->len == 4 && tx_power_ok(c->val)) ? UWB_DL_OK : UWB_DL_BAD_VALUE;
+    case UWB_DL_OP_PHY:
+        return (c->len == 2 && phy_ok(c->val[0], c->val[1])) ? UWB_DL_OK : UWB_DL_BAD_VALUE;
+    default:
+        return UWB_DL_UNKNOWN;
+    }
+}
+
+uint16_t uwb_dl_ack_put(struct uwb_dl_state *st, uint8_t *p) {
+    if (!st->ack) {
+        return 0;
+    }
+    p[0] = UWB_DL_ACK_TAG;
+    p[1] = st->last_seq;
+    p[2] = st->last_status;
+    st->ack = false;
+    st->stats.acks++;
+    return UWB_DL_ACK_LEN;
+}
+
+uint16_t uwb_dl_cmd_put(uint8_t *p, const struct uwb_dl_cmd *c) {
+    const uint8_t len = (c->len > UWB_DL_VAL_MAX) ? UWB_DL_VAL_MAX : c->len;
+
+    p[0] = UWB_DL_CMD_TAG;
+    p[1] = c->seq;
+    p[2] = c->op;
+    p[3] = len;
+    memcpy(&p[UWB_DL_HDR_LEN], c->val, len);
+    return (uint16_t)(UWB_DL_HDR_LEN + len);
+}
+
+int uwb_dl_ack_get(const uint8_t *p, uint16_t len, uint8_t *seq, uint8_t *status) {
+    if (len < UWB_DL_ACK_LEN || p[0] != UWB_DL_ACK_TAG) {
+        return -1;
+    }
+    *seq = p[1];
+    *status = p[2];
+    return 0;
+}
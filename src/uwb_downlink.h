@@ -0,0 +1,110 @@
+#ifndef UWB_DOWNLINK_H
+#define UWB_DOWNLINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Downlink configuration commands (CONFIG_UWB_DOWNLINK). Plain C, no Zephyr
+ * dependencies: also meant for the anchor side that encodes them.
+ *
+ * An anchor attaches at most one command to a RESP or REPORT it sends the
+ * tag anyway, after the frame's usual payload:
+ *
+ *   UWB_DL_CMD_TAG(1) seq(1) op(1) len(1) value(len)    little endian
+ *
+ * The tag only copies it out while receiving (no extra RX, nothing slow in
+ * the RESP path) and applies it at the start of its next cycle. The POLL of
+ * that cycle carries the outcome after its header:
+ *
+ *   UWB_DL_ACK_TAG(1) seq(1) status(1)
+ *
+ * POLLs without a pending ack are unchanged, so the channel costs airtime
+ * only in the cycle after a command. `seq` makes commands idempotent: an
+ * anchor that missed the ack resends the same command, and the tag acks it
+ * again with the stored status without applying it twice. A newer command
+ * received before the pending one was applied replaces it.
+ */
+
+#define UWB_DL_CMD_TAG      0xDC
+#define UWB_DL_ACK_TAG      0xDA
+#define UWB_DL_HDR_LEN      4
+#define UWB_DL_VAL_MAX      4
+#define UWB_DL_CMD_MAX      (UWB_DL_HDR_LEN + UWB_DL_VAL_MAX)
+#define UWB_DL_ACK_LEN      3
+
+enum uwb_dl_op {
+    UWB_DL_OP_PERIOD = 1,       // period_ms(2)
+    UWB_DL_OP_TX_POWER = 2,     // DW3000 TX_POWER register value(4)
+    UWB_DL_OP_PHY = 3,          // channel(1) preamble_code(1)
+};
+
+enum uwb_dl_status {
+    UWB_DL_OK = 0,
+    UWB_DL_BAD_VALUE = 1,       // out of range, or wrong length for the op
+    UWB_DL_UNKNOWN = 2,         // op not known to this firmware
+    UWB_DL_REFUSED = 3,         // op disabled in this build
+    UWB_DL_FAILED = 4,          // radio refused it (change reverted)
+};
+
+#define UWB_DL_PERIOD_MIN_MS    20
+#define UWB_DL_PERIOD_MAX_MS    60000
+
+/* TX_POWER holds one byte per frame segment; a value with any byte above
+ * this is refused. */
+#if defined(CONFIG_UWB_DOWNLINK_TX_POWER_MAX)
+#define UWB_DL_TX_POWER_MAX     CONFIG_UWB_DOWNLINK_TX_POWER_MAX
+#else
+#define UWB_DL_TX_POWER_MAX     0x10
+#endif
+
+struct uwb_dl_cmd {
+    uint8_t seq;
+    uint8_t op;
+    uint8_t len;
+    uint8_t val[UWB_DL_VAL_MAX];
+};
+
+struct uwb_dl_stats {
+    uint32_t rx;                // commands received (including repeats)
+    uint32_t repeats;           // already applied: acked again
+    uint32_t replaced;          // newer command arrived before the pending one was applied
+    uint32_t malformed;
+    uint32_t applied;
+    uint32_t rejected;          // any status but UWB_DL_OK
+    uint32_t acks;
+};
+
+struct uwb_dl_state {
+    bool pending;               // cmd waits for the next cycle boundary
+    struct uwb_dl_cmd cmd;
+    uint16_t src;               // anchor that sent it
+    bool done;                  // last_seq/last_status are valid
+    uint8_t last_seq;
+    uint8_t last_status;
+    bool ack;                   // ack to send in the next POLL
+    struct uwb_dl_stats stats;
+};
+
+void uwb_dl_init(struct uwb_dl_state *st);
+
+/* The bytes following a RESP's or REPORT's payload, FCS excluded. Returns 0
+ * if a command was found (queued or to be acked again). */
+int uwb_dl_rx(struct uwb_dl_state *st, const uint8_t *p, uint16_t len, uint16_t src);
+
+/* Cycle boundary: the command to apply, if any. Report the outcome with
+ * uwb_dl_done(). */
+bool uwb_dl_take(struct uwb_dl_state *st, struct uwb_dl_cmd *out);
+void uwb_dl_done(struct uwb_dl_state *st, uint8_t status);
+
+/* Length and range checks for the ops above: UWB_DL_OK or a status. */
+uint8_t uwb_dl_check(const struct uwb_dl_cmd *c);
+
+/* POLL tail: writes the pending ack and returns its length (0 if none). */
+uint16_t uwb_dl_ack_put(struct uwb_dl_state *st, uint8_t *p);
+
+/* Anchor side: encode a command (returns its length) and parse an ack from
+ * a POLL's payload (0 or -1). */
+uint16_t uwb_dl_cmd_put(uint8_t *p, const struct uwb_dl_cmd *c);
+int uwb_dl_ack_get(const uint8_t *p, uint16_t len, uint8_t *seq, uint8_t *status);
+
+#endif /* UWB_DOWNLINK_H */
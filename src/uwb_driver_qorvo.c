@@ -1,18 +1,42 @@
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <string.h>
+#include <errno.h>
 #include "deca_device_api.h"
 #include "deca_regs.h"
+#include "platform_port.h"
+#include "uwb_frame.h"
+#include "uwb_ranging.h"
+#include "uwb_twr_est.h"
+#include "uwb_radio_events.h"
+#include "uwb_replay_window.h"
+#include "uwb_sts.h"
+#include "uwb_aes.h"
+#if defined(CONFIG_UWB_ANCHOR_SELECT)
+#include "uwb_anchor_table.h"
+#endif
+#if defined(CONFIG_UWB_PHY_SCAN)
+#include "uwb_phy_scan.h"
+#endif
+#if defined(CONFIG_UWB_DOWNLINK)
+#include "uwb_downlink.h"
+#endif
+#if defined(CONFIG_UWB_CLOCK_SYNC)
+#include "uwb_clock_sync.h"
+#endif
+#if defined(CONFIG_UWB_PEER)
+#include <zephyr/drivers/hwinfo.h>
+#include "uwb_peer_proto.h"
+#endif
 
 LOG_MODULE_REGISTER(uwb_driver, LOG_LEVEL_INF);
 
-extern void peripherals_init(void);
-extern void reset_DWIC(void);
 extern void uwb_led_pulse(void);
 
 static dwt_config_t config = {
     5, DWT_PLEN_128, DWT_PAC8, 9, 9, 1, DWT_BR_6M8, 
     DWT_PHRMODE_STD, DWT_PHRRATE_STD, (129 + 8 - 8), 
-    DWT_STS_MODE_OFF, DWT_STS_LEN_64, DWT_PDOA_M0
+    UWB_STS_MODE, DWT_STS_LEN_64, DWT_PDOA_M0
 };
 static dwt_txconfig_t txconfig = {
     0x34,           /* PG delay. */
@@ -41,21 +65,65 @@ static uint8_t seq_num = 0;
 // Trying 16000 to get back to positive range (approx 1.0m expected).
 static uint16_t g_antenna_delay = 16000;
 
-/* TWR Frame Types */
-#define FUNC_CODE_POLL   0x61
-#define FUNC_CODE_RESP   0x50
-#define FUNC_CODE_FINAL  0x23
-
-/* Optional: ANCHOR -> TAG report with computed distance */
-#define FUNC_CODE_REPORT 0x44
-
 /* TWR Timestamps (40-bit) */
 static uint64_t poll_tx_ts = 0;
 static uint64_t resp_rx_ts = 0;
 static uint64_t final_tx_ts = 0;
+static uint8_t poll_seq = 0;            // Sequence of the POLL just sent
+static uint16_t resp_anchor_addr = 0;   // Anchor that answered the current POLL
+static uint16_t poll_dest = UWB_ADDR_BROADCAST; // Anchor the current POLL is for
+#if defined(CONFIG_UWB_ANCHOR_SELECT)
+static struct uwb_anchor_table anchor_tab;
+#endif
+#if defined(CONFIG_UWB_DOWNLINK)
+static struct uwb_dl_state dl_state;    // command from RESP/REPORT, ack for the next POLL
+#endif
+#if defined(CONFIG_UWB_RESPONDER) || defined(CONFIG_UWB_PEER)
+static struct uwb_twr_ts rsp_ts;        // Responder/peer mode: the initiator's POLL_TX/RESP_RX/FINAL_TX, the responder's
+#endif
+#if defined(CONFIG_UWB_STS)
+static int32_t resp_toa_diff;           // STS - Ipatov first path of that RESP
+static bool resp_toa_mismatch;
+#endif
+
+// FINAL is scheduled this long after the current device time. Size it from the
+// worst-case RESP->FINAL turnaround in the hot-path stats plus the anchor's own
+// RX turnaround, not by padding. 100 ms covers the anchor's serial printing.
+#ifndef UWB_FINAL_DELAY_US
+#define UWB_FINAL_DELAY_US 100000
+#endif
+
+/* RESP RX -> FINAL scheduled is the only latency-critical window of a cycle.
+ * Inside it: no logging, scheduler locked (ISRs still run), and the functions
+ * involved run from RAM (UWB_RAMFUNC / DWT_RAMFUNC). Log after the window. */
+#if defined(CONFIG_UWB_RESPONDER)
+// Responder mode: POLL RX -> RESP scheduled instead
+#define HOT_PATH_NAME       "POLL->RESP"
+#define HOT_PATH_BUDGET_US  CONFIG_UWB_RESPONDER_RESP_DELAY_US
+#elif defined(CONFIG_UWB_PEER)
+// Peer mode: POLL RX -> RESP or RESP RX -> FINAL, whichever side we are on
+#define HOT_PATH_NAME       "peer reply"
+#define HOT_PATH_BUDGET_US  CONFIG_UWB_PEER_REPLY_DELAY_US
+#else
+#define HOT_PATH_NAME       "RESP->FINAL"
+#define HOT_PATH_BUDGET_US  UWB_FINAL_DELAY_US
+#endif
+
+struct hot_path_stats {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t late;          // delayed TX rejected (HPDWARN): FINAL slot missed
+};
+
+static struct hot_path_stats hot_stats = { .min_us = UINT32_MAX };
+static uint32_t hot_start_cyc;
+static bool in_hot_path;
 
 // Forward declarations (avoid implicit extern declarations before static defs)
 static int uwb_wait_report(uint32_t *dist_mm_out);
+static void uwb_session_reset(void);
 
 // Public APIs defined later in this file
 int uwb_send_poll(void);
@@ -90,7 +158,11 @@ static uint64_t get_rx_timestamp_u64(void) {
     uint8_t ts_tab[5];
     uint64_t timestamp = 0;
     
+#if defined(CONFIG_UWB_STS)
+    dwt_readrxtimestamp_sts(ts_tab);    // only the STS timestamp is authenticated
+#else
     dwt_readrxtimestamp(ts_tab);
+#endif
     
     // DW3000: Least Significant Byte is at index 0
     timestamp = ((uint64_t)ts_tab[0]) |
@@ -102,6 +174,58 @@ static uint64_t get_rx_timestamp_u64(void) {
     return timestamp;
 }
 
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+/* Events drained in one wake but not consumed yet (kept in arrival order) */
+static struct uwb_radio_event evt_backlog[4];
+static int evt_backlog_n;
+
+static void uwb_evt_reset(void) {
+    evt_backlog_n = 0;
+    uwb_radio_events_flush();
+}
+
+/* Wait for the next event of `type`. RX errors/timeouts seen while waiting for
+ * RX_OK re-enable the receiver, like the polled loops do. */
+static int uwb_evt_wait(uint8_t type, struct uwb_radio_event *out, uint32_t timeout_us) {
+    const int64_t deadline = k_uptime_ticks() + k_us_to_ticks_ceil64(timeout_us);
+
+    while (1) {
+        while (evt_backlog_n > 0) {
+            const struct uwb_radio_event ev = evt_backlog[0];
+
+            evt_backlog_n--;
+            memmove(&evt_backlog[0], &evt_backlog[1], evt_backlog_n * sizeof(ev));
+
+            if (ev.type == type) {
+                *out = ev;
+                return 0;
+            }
+            if (type == UWB_EVT_RX_OK && (ev.type == UWB_EVT_RX_ERR || ev.type == UWB_EVT_RX_TIMEOUT)) {
+                dwt_rxenable(DWT_START_RX_IMMEDIATE);
+            }
+        }
+
+        const int64_t left = deadline - k_uptime_ticks();
+        if (left <= 0) {
+            return -ETIMEDOUT;
+        }
+        const int n = uwb_radio_event_wait(evt_backlog, ARRAY_SIZE(evt_backlog), K_TICKS(left));
+        evt_backlog_n = (n > 0) ? n : 0;
+    }
+}
+#endif
+
+#if defined(CONFIG_UWB_STS_SP3)
+/* SP3 sessions switch per frame: STS-only for POLL/RESP, SP0 for data frames.
+ * RXFR is the only RX event of an STS-only packet, so it is only enabled then. */
+static void uwb_sts_frame_mode(bool no_data) {
+    dwt_configurestsmode(no_data ? DWT_STS_MODE_ND : DWT_STS_MODE_OFF);
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    dwt_setinterrupt(SYS_STATUS_RXFR_BIT_MASK, 0, no_data ? DWT_ENABLE_INT : DWT_DISABLE_INT);
+#endif
+}
+#endif
+
 int uwb_driver_init(void) {
     int ret;
     uint32_t dev_id = 0;
@@ -183,12 +307,35 @@ int uwb_driver_init(void) {
         return -1;
     }
     LOG_INF("PLL LOCK OK!");
+
+    // STS key/IV are per session: a driver (re)init starts a new one
+    if (uwb_sts_session_start(NULL, NULL) != 0) {
+        return -1;
+    }
+    uwb_sts_log_airtime(&config);
+
+#if defined(CONFIG_UWB_PAYLOAD_AES)
+    // New payload session id and frame counters on every (re)init as well
+    if (uwb_aes_session_start(NULL) != 0) {
+        return -1;
+    }
+#if defined(CONFIG_UWB_AES_BENCH)
+    uwb_aes_benchmark();
+#endif
+#endif
+
+#if defined(CONFIG_UWB_RTT_BIN_CIR)
+    // Full CIA diagnostics (first-path index) for the RTT CIR dump
+    dwt_configciadiag(DW_CIA_DIAG_LOG_ALL);
+#endif
     
     // Step 10: Configure TX power (LOW for battery stability)
     LOG_INF("Step 10: Setting TX power to LOW (0x10101010)...");
     // Battery Stability Fix:
     // High power (0x1F...) causes voltage drop -> Brownout -> Corrupted Timestamps.
     // Low power (0x10...) prevents brownout, allowing valid timestamps.
+    // On the watchdog re-init this also drops a TX power set over the
+    // downlink, which may be why ten cycles in a row failed
     txconfig.power = 0x10101010; 
     dwt_configuretxrf(&txconfig);
     
@@ -220,6 +367,16 @@ int uwb_driver_init(void) {
     LOG_INF("Step 14: Disabling frame filtering...");
     dwt_configureframefilter(DWT_FF_DISABLE, 0);
     
+    // New session: forget replay windows and rejection counters
+    uwb_session_reset();
+
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    // dwt_initialise() cleared the callbacks: re-register them on every (re)init
+    if (uwb_radio_events_init() != 0) {
+        return -1;
+    }
+#endif
+    
     LOG_INF("=== UWB Driver Initialization Complete ===");
     return 0;
 }
@@ -397,17 +554,30 @@ int uwb_send_poll(void) {
     resp_rx_ts = 0;
     
     /* IEEE 802.15.4 POLL format */
-    /* Frame: FC(2) + Seq(1) + PAN(2) + Dest(2) + Src(2) + MsgType(1) */
-    static uint8_t tx_poll_msg[10] = {
+    /* Frame: FC(2) + Seq(1) + PAN(2) + Dest(2) + Src(2) + MsgType(1) [+ downlink ack] */
+    static uint8_t tx_poll_msg[10 + 3] = {   // + room for the downlink ack
         0x41, 0x88,      // Frame Control
         0,               // Sequence Number
         0xCA, 0xDE,      // PAN ID
-        0xFF, 0xFF,      // Dest Addr (Broadcast)
+        0xFF, 0xFF,      // Dest Addr (Broadcast, or the selected anchor)
         0x01, 0x00,      // Src Addr (Tag ID 1)
         0x61             // Msg Type (POLL)
     };
     
+    uint16_t poll_len = UWB_IDX_PAYLOAD;
+
     tx_poll_msg[2] = seq_num++;
+    uwb_put_u16(&tx_poll_msg[UWB_IDX_DEST], poll_dest);
+#if defined(CONFIG_UWB_DOWNLINK)
+    // Outcome of the command applied at the start of this cycle, sent once
+    poll_len += uwb_dl_ack_put(&dl_state, &tx_poll_msg[UWB_IDX_PAYLOAD]);
+#endif
+    poll_seq = tx_poll_msg[2];
+    resp_anchor_addr = 0;
+#if defined(CONFIG_UWB_STS)
+    resp_toa_diff = 0;
+    resp_toa_mismatch = false;
+#endif
     
     // Force IDLE first
     dwt_forcetrxoff();
@@ -416,8 +586,21 @@ int uwb_send_poll(void) {
     // Clear ALL status flags
     dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_TX | SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR);
     
-    dwt_writetxdata(sizeof(tx_poll_msg), tx_poll_msg, 0);
-    dwt_writetxfctrl(sizeof(tx_poll_msg) + 2, 0, 1); // ranging=1
+    // Both ends derive this exchange's STS from the session IV + counter
+    uwb_sts_exchange_begin();
+
+#if defined(CONFIG_UWB_STS_SP3)
+    // STS-only POLL: no PHR, no payload, identified by the session schedule
+    uwb_sts_frame_mode(true);
+    dwt_writetxfctrl(0, 0, 1);
+#else
+    dwt_writetxdata(poll_len, tx_poll_msg, 0);
+    dwt_writetxfctrl(poll_len + 2, 0, 1); // ranging=1
+#endif
+    
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    uwb_evt_reset(); // nothing from a previous exchange may match this one
+#endif
     
     // *** AUTO RX ENABLE - DW3000 starts RX automatically after TX! ***
     // Reverted to DWT_RESPONSE_EXPECTED for standard TWR behavior
@@ -426,6 +609,14 @@ int uwb_send_poll(void) {
     uwb_led_pulse();
     
     // Wait TX complete
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    struct uwb_radio_event ev;
+    if (uwb_evt_wait(UWB_EVT_TX_DONE, &ev, 10000) != 0) {
+        LOG_ERR("TX timeout!");
+        return -1;
+    }
+    poll_tx_ts = ev.ts;
+#else
     int tx_timeout = 0;
     while (!((status = dwt_read32bitreg(SYS_STATUS_ID)) & SYS_STATUS_TXFRS_BIT_MASK)) {
         k_busy_wait(10);
@@ -437,6 +628,7 @@ int uwb_send_poll(void) {
     }
     
     poll_tx_ts = get_tx_timestamp_u64();
+#endif
     LOG_INF("✅ POLL sent! TX_TS: 0x%010llX (Seq: %d)", poll_tx_ts, tx_poll_msg[2]);
     
     return 0;
@@ -447,40 +639,419 @@ static uint64_t poll_rx_ts_anchor = 0;  // ANCHOR's POLL RX timestamp
 static uint64_t resp_tx_ts_anchor = 0;  // ANCHOR's RESP TX timestamp
 static uint32_t calculated_dist_mm = 0; // Best-available distance (mm)
 
+// ================= RESP / REPORT validation =================
+// A RESP is only allowed to reach the distance math when it is addressed to this tag,
+// comes from a unicast anchor, is not a replay and its timestamps are consistent with
+// the POLL we just sent. Anything else is counted and dropped; RX keeps listening.
+
+// The anchor echoes the POLL sequence number in its RESP (as the responder and
+// peer modes here do), so a RESP to an earlier POLL is rejected. Set to 0 only
+// for anchors that number their RESPs independently.
+#ifndef UWB_RESP_SEQ_ECHO
+#define UWB_RESP_SEQ_ECHO 1
+#endif
+
+// Db is counted on the anchor's crystal, Ra on ours: at short range a valid
+// exchange can come out with Ra slightly below Db. Allow both crystals'
+// tolerance (+-20 ppm each) before calling the RESP stale.
+#ifndef UWB_RESP_CLOCK_TOL_PPM
+#define UWB_RESP_CLOCK_TOL_PPM 40
+#endif
+
+// Max plausible ToF (DTU). 1 DTU ~= 4.69 mm one-way, 65536 DTU ~= 300 m.
+#ifndef UWB_MAX_TOF_DTU
+#define UWB_MAX_TOF_DTU 65536
+#endif
+
+// Per-anchor replay window for RESPs (uwb_replay_window.h). With UWB_RESP_SEQ_ECHO
+// freshness comes from the echo and the Ra/Db check; the window only catches a
+// RESP received twice.
+#define REPLAY_ANCHORS      4
+#define REPLAY_MAX_AGE_MS   1000
+
+static struct uwb_replay_entry resp_replay_tab[REPLAY_ANCHORS];
+static struct uwb_replay resp_replay = { resp_replay_tab, REPLAY_ANCHORS, REPLAY_MAX_AGE_MS };
+
+#if defined(CONFIG_UWB_RESPONDER) || defined(CONFIG_UWB_PEER)
+// Per-initiator window for POLLs. The initiator's counter also moves with its
+// frames to others, so only a POLL received twice is caught here; an older one
+// gets a RESP whose timestamps the initiator rejects. In peer mode any
+// neighbor may POLL us: one entry each, so none is evicted.
+#if defined(CONFIG_UWB_PEER)
+#define POLL_REPLAY_SENDERS UWB_PEER_NEIGHBORS
+#else
+#define POLL_REPLAY_SENDERS 4
+#endif
+
+static struct uwb_replay_entry poll_replay_tab[POLL_REPLAY_SENDERS];
+static struct uwb_replay poll_replay = { poll_replay_tab, POLL_REPLAY_SENDERS, REPLAY_MAX_AGE_MS };
+#endif
+
+struct uwb_rx_stats {
+    uint32_t resp_ok;
+    uint32_t rej_malformed;  // too short / wrong FC or PAN
+    uint32_t rej_foreign;    // not for this tag, or from an unexpected source
+    uint32_t rej_stale;      // seq or timestamps do not match the current POLL
+    uint32_t rej_replay;     // already accepted from this anchor
+};
+
+static struct uwb_rx_stats rx_stats;
+static uint32_t session_cycle = 0;      // Cycles since driver (re)init
+
+static void uwb_session_reset(void) {
+    uwb_replay_reset(&resp_replay);
+#if defined(CONFIG_UWB_RESPONDER) || defined(CONFIG_UWB_PEER)
+    uwb_replay_reset(&poll_replay);
+#endif
+    memset(&rx_stats, 0, sizeof(rx_stats));
+    resp_anchor_addr = 0;
+    session_cycle = 0;
+}
+
+static UWB_RAMFUNC uint64_t ts40_diff(uint64_t later, uint64_t earlier) {
+    return (later - earlier) & UWB_TS_MASK;
+}
+
+/* Returns 0 if the RESP may be used for ranging, otherwise a negative code
+ * after bumping the matching rejection counter. */
+static UWB_RAMFUNC int uwb_validate_resp(const uint8_t *f, uint16_t len, uint64_t rx_ts,
+                             uint64_t *poll_rx_out, uint64_t *resp_tx_out) {
+    if (!uwb_frame_hdr_ok(f, len) || len < UWB_RESP_LEN) {
+        rx_stats.rej_malformed++;
+        return -EBADMSG;
+    }
+
+    const uint16_t dest = uwb_get_u16(&f[UWB_IDX_DEST]);
+    const uint16_t src = uwb_get_u16(&f[UWB_IDX_SRC]);
+    const uint8_t seq = f[UWB_IDX_SEQ];
+
+    if (dest != UWB_TAG_ADDR || src == UWB_ADDR_BROADCAST || src == 0 || src == UWB_TAG_ADDR) {
+        rx_stats.rej_foreign++;
+        return -EACCES;
+    }
+
+    // A unicast POLL is only answered by the anchor it was for
+    if (poll_dest != UWB_ADDR_BROADCAST && src != poll_dest) {
+        rx_stats.rej_foreign++;
+        return -EACCES;
+    }
+
+    if (UWB_RESP_SEQ_ECHO && seq != poll_seq) {
+        rx_stats.rej_stale++;
+        return -ESTALE;
+    }
+
+    const uint32_t now_ms = k_uptime_get_32();
+
+    if (uwb_replay_seen(&resp_replay, src, seq, now_ms)) {
+        rx_stats.rej_replay++;
+        return -EALREADY;
+    }
+
+    // Timing: anchor reply delay must fit inside our round trip, and the
+    // difference must be a physically plausible time of flight.
+    const uint64_t poll_rx = uwb_get_ts40(&f[UWB_IDX_PAYLOAD]);
+    const uint64_t resp_tx = uwb_get_ts40(&f[UWB_IDX_PAYLOAD + UWB_TS_LEN]);
+    const uint64_t ra = ts40_diff(rx_ts, poll_tx_ts);
+    const uint64_t db = ts40_diff(resp_tx, poll_rx);
+    const uint64_t db_tol = db * UWB_RESP_CLOCK_TOL_PPM / 1000000U;
+
+    if (db == 0 || ra + db_tol <= db || (ra > db && (ra - db) / 2 > UWB_MAX_TOF_DTU)) {
+        rx_stats.rej_stale++;
+        return -ESTALE;
+    }
+
+    uwb_replay_accept(&resp_replay, src, seq, now_ms);
+    rx_stats.resp_ok++;
+    *poll_rx_out = poll_rx;
+    *resp_tx_out = resp_tx;
+    resp_anchor_addr = src;
+    return 0;
+}
+
+#if defined(CONFIG_UWB_ANCHOR_SELECT)
+static void uwb_log_anchor_table(void) {
+    const struct uwb_anchor_stats *st = &anchor_tab.stats;
+
+    LOG_INF("anchors: %d known, %u epochs, POLLs %u unicast %u broadcast, added %u, "
+            "expired %u, table full %u", uwb_anchor_count(&anchor_tab), st->epochs,
+            st->unicast, st->discovery, st->added, st->expired, st->table_full);
+    for (int i = 0; i < UWB_ANCHOR_TABLE_SIZE; i++) {
+        const struct uwb_anchor_entry *e = &anchor_tab.e[i];
+
+        if (e->addr) {
+            LOG_INF("  0x%04X: score %u, success %u%%, quality %u, %u mm, ok %u fail %u, "
+                    "misses %u, heard %u ms ago", e->addr, uwb_anchor_score(e),
+                    e->success * 100U / 256U, e->quality, e->dist_mm, e->ok, e->fail,
+                    e->misses, (uint32_t)k_uptime_get() - e->heard_ms);
+        }
+    }
+}
+#endif
+
+static void uwb_log_rx_stats(void) {
+    LOG_INF("RESP ok=%u rejected: malformed=%u foreign=%u stale=%u replay=%u",
+            rx_stats.resp_ok, rx_stats.rej_malformed, rx_stats.rej_foreign,
+            rx_stats.rej_stale, rx_stats.rej_replay);
+}
+
+static inline void uwb_hot_path_begin(uint32_t rx_cyc) {
+    hot_start_cyc = rx_cyc;
+    in_hot_path = true;
+    k_sched_lock();
+}
+
+/* Closes the window once FINAL has been handed to the chip (or rejected) */
+static inline void uwb_hot_path_end(bool late) {
+    if (!in_hot_path) {
+        return;
+    }
+    const uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - hot_start_cyc);
+
+    k_sched_unlock();
+    in_hot_path = false;
+
+    hot_stats.count++;
+    hot_stats.sum_us += us;
+    hot_stats.min_us = MIN(hot_stats.min_us, us);
+    hot_stats.max_us = MAX(hot_stats.max_us, us);
+    if (late) {
+        hot_stats.late++;
+    }
+}
+
+static void uwb_log_hot_path_stats(void) {
+    if (hot_stats.count == 0) {
+        return;
+    }
+    LOG_INF(HOT_PATH_NAME " turnaround: avg %u us, min %u us, max %u us, late %u "
+            "(TX delay %u us, headroom %d us)",
+            (uint32_t)(hot_stats.sum_us / hot_stats.count), hot_stats.min_us, hot_stats.max_us,
+            hot_stats.late, HOT_PATH_BUDGET_US, (int32_t)HOT_PATH_BUDGET_US - (int32_t)hot_stats.max_us);
+}
+
+/* Standard 802.15.4 PHY payload incl. FCS */
+#define UWB_FRAME_BUF_SIZE 128
+
+/* A received frame, read from the DW3000 once and handed by pointer to the
+ * take_*() parser for the exchange in progress. */
+struct uwb_frame_buf {
+    uint64_t ts;            // 40-bit RX timestamp (0 if unknown)
+    uint32_t cyc;           // k_cycle_get_32() when the frame was detected
+    uint16_t len;           // valid bytes in data[]
+    uint8_t flags;          // DWT_CB_DATA_RX_FLAG_* for RX frames
+    uint8_t data[UWB_FRAME_BUF_SIZE];
+};
+
+/* Replaces the per-call rx_buffer[] arrays that used to live on the radio
+ * thread stack (128 B in uwb_wait_resp, 64 B in uwb_wait_report, 128 B in
+ * uwb_rx_test_mode). Every parser is done with a frame before the next one
+ * is read, and only the radio thread (or the RX test mode instead of it)
+ * receives, so one buffer is enough. */
+static struct uwb_frame_buf rx_frame;
+
+/* Read the frame that just completed into rx_frame (the only copy made).
+ * Returns NULL if the length is bad. */
+static struct uwb_frame_buf *uwb_frame_read(uint16_t frame_len, uint64_t rx_ts) {
+    if (frame_len == 0 || frame_len > UWB_FRAME_BUF_SIZE) {
+        rx_stats.rej_malformed++;
+        return NULL;
+    }
+
+    struct uwb_frame_buf *fb = &rx_frame;
+
+    dwt_readrxdata(fb->data, frame_len, 0);
+    fb->len = frame_len;
+    fb->flags = 0;
+    fb->ts = rx_ts;
+    fb->cyc = k_cycle_get_32();
+    return fb;
+}
+
+/* REPORT handling shared by the polled and interrupt-driven RX paths.
+ * Returns 0 if the frame is the REPORT for the current exchange. */
+static int uwb_take_report(const struct uwb_frame_buf *fb, void *arg) {
+    uint32_t *dist_mm_out = arg;
+    const uint8_t *rx_buffer = fb->data;
+    const uint16_t frame_len = fb->len;
+
+    // MsgType at index 9 (same as other frames)
+    if (frame_len < UWB_REPORT_LEN || rx_buffer[UWB_IDX_FUNC] != FUNC_CODE_REPORT) {
+        return -1;
+    }
+
+    // Only accept the REPORT from the anchor that answered our POLL
+    if (!uwb_frame_hdr_ok(rx_buffer, frame_len) ||
+        uwb_get_u16(&rx_buffer[UWB_IDX_DEST]) != UWB_TAG_ADDR ||
+        uwb_get_u16(&rx_buffer[UWB_IDX_SRC]) != resp_anchor_addr) {
+        rx_stats.rej_foreign++;
+        return -1;
+    }
+
+    const uint8_t *payload = &rx_buffer[UWB_IDX_PAYLOAD];
+#if defined(CONFIG_UWB_PAYLOAD_AES)
+    // Secured REPORTs only: a plain one could come from anyone. Decrypted in
+    // the RX buffer, so this must run before RX is re-enabled.
+#if defined(CONFIG_UWB_DOWNLINK)
+    uint8_t plain[8 + UWB_DL_CMD_MAX];
+#else
+    uint8_t plain[8];
+#endif
+    uint16_t plain_len;
+
+    if (uwb_aes_rx_open(rx_buffer, frame_len, plain, sizeof(plain), &plain_len) != 0 ||
+        plain_len < 4) {
+        return -1;
+    }
+    payload = plain;
+#endif
+
+    if (dist_mm_out) {
+        *dist_mm_out = uwb_get_u32(payload);
+    }
+
+#if defined(CONFIG_UWB_DOWNLINK)
+    // A command after the distance (authenticated along with it when secured)
+#if defined(CONFIG_UWB_PAYLOAD_AES)
+    const uint16_t payload_len = plain_len;
+#else
+    const uint16_t payload_len = frame_len - 2 - UWB_IDX_PAYLOAD;
+#endif
+    if (payload_len > 4) {
+        (void)uwb_dl_rx(&dl_state, &payload[4], payload_len - 4, resp_anchor_addr);
+    }
+#endif
+    return 0;
+}
+
+#if defined(CONFIG_UWB_STS)
+/* Ipatov/STS consistency of the RESP just received (one SPI burst). Replaces
+ * *rx_ts with the configured source; a mismatch fails unless only flagged. */
+static UWB_RAMFUNC int uwb_take_toa(uint64_t *rx_ts) {
+    resp_toa_mismatch = uwb_sts_toa_select(rx_ts, &resp_toa_diff) != 0;
+    return (resp_toa_mismatch && IS_ENABLED(CONFIG_UWB_TOA_MISMATCH_REJECT)) ? -1 : 0;
+}
+#endif
+
+/* RESP handling shared by the polled and interrupt-driven RX paths.
+ * `arg` optionally points at the RX timestamp to use instead of the frame's
+ * own (SP3: the STS-only RESP that preceded this data frame).
+ * Returns 0 once a validated RESP has been committed to the TWR state. */
+static UWB_RAMFUNC int uwb_take_resp(const struct uwb_frame_buf *fb, void *arg) {
+    const uint8_t *rx_buffer = fb->data;
+    const uint16_t frame_len = fb->len;
+    uint64_t rx_ts = arg ? *(const uint64_t *)arg : fb->ts;
+
+    // IEEE 802.15.4 RESPONSE format: 
+    // FC(2) + Seq(1) + PAN(2) + Dest(2) + Src(2) + MsgType(1) + Payload...
+    // MsgType at index 9 should be 0x50 (RESP)
+    if (frame_len <= UWB_IDX_FUNC || rx_buffer[UWB_IDX_FUNC] != FUNC_CODE_RESP) {
+        return -1;
+    }
+
+#if defined(CONFIG_UWB_ANCHOR_SELECT)
+    // Any anchor's RESP, even to another tag, shows it is in range
+    if (uwb_frame_hdr_ok(rx_buffer, frame_len)) {
+        const uint16_t src = uwb_get_u16(&rx_buffer[UWB_IDX_SRC]);
+
+        if (src != UWB_TAG_ADDR) {
+            uwb_anchor_heard(&anchor_tab, src, (uint32_t)k_uptime_get());
+        }
+    }
+#endif
+
+#if defined(CONFIG_UWB_STS_SP1)
+    // The STS timestamp is only trustworthy if the STS itself was received well
+    // and agrees with the Ipatov first path
+    if (uwb_sts_rx_check() != 0 || uwb_take_toa(&rx_ts) != 0) {
+        return -1;
+    }
+#endif
+
+    // TAG's RESP RX timestamp + ANCHOR's POLL_RX / RESP_TX (bytes 10-19).
+    // Only committed to the TWR state once the frame passes validation.
+    uint64_t poll_rx = 0;
+    uint64_t resp_tx = 0;
+
+    if (uwb_validate_resp(rx_buffer, frame_len, rx_ts, &poll_rx, &resp_tx) != 0) {
+        LOG_WRN("RESP dropped (seq %u from 0x%04X)", rx_buffer[UWB_IDX_SEQ],
+                uwb_get_u16(&rx_buffer[UWB_IDX_SRC]));
+        return -1;
+    }
+
+    resp_rx_ts = rx_ts;
+    poll_rx_ts_anchor = poll_rx;
+    resp_tx_ts_anchor = resp_tx;
+
+#if defined(CONFIG_UWB_DOWNLINK) && !defined(CONFIG_UWB_PAYLOAD_AES)
+    // Copied out only; applied at the next cycle boundary. RESPs are not
+    // authenticated, so secured builds take commands from REPORTs alone.
+    if (frame_len > UWB_RESP_LEN + 2) {
+        (void)uwb_dl_rx(&dl_state, &rx_buffer[UWB_RESP_LEN], frame_len - 2 - UWB_RESP_LEN,
+                        resp_anchor_addr);
+    }
+#endif
+
+    // From here until FINAL is scheduled: no logging
+    uwb_hot_path_begin(fb->cyc);
+    return 0;
+}
+
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+/* Interrupt-driven RX: every RX_OK event is offered to `take` until it accepts
+ * one or the timeout expires. Length and timestamp come from the event. */
+static int uwb_evt_rx_loop(uint32_t timeout_us,
+                           int (*take)(const struct uwb_frame_buf *, void *), void *arg) {
+    const int64_t deadline = k_uptime_ticks() + k_us_to_ticks_ceil64(timeout_us);
+    struct uwb_radio_event ev;
+
+    while (1) {
+        const int64_t left = deadline - k_uptime_ticks();
+        if (left <= 0 || uwb_evt_wait(UWB_EVT_RX_OK, &ev, (uint32_t)k_ticks_to_us_ceil64(left)) != 0) {
+            return -1;
+        }
+        struct uwb_frame_buf *fb = uwb_frame_read(ev.len, ev.ts);
+        if (fb) {
+            fb->flags = ev.rx_flags;
+            fb->cyc = ev.cyc;   // captured in the dwt_isr() callback
+            const int taken = take(fb, arg);
+            if (taken == 0) {
+                return 0;
+            }
+        }
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    }
+}
+#endif
+
 static int uwb_wait_report(uint32_t *dist_mm_out) {
     if (dist_mm_out) {
         *dist_mm_out = 0;
     }
 
-    uint32_t status;
-    uint8_t rx_buffer[64];
-    uint16_t frame_len;
-
     // Clear status and enable RX immediately
     dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_TX | SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR);
     dwt_rxenable(DWT_START_RX_IMMEDIATE);
 
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    if (uwb_evt_rx_loop(200000, uwb_take_report, dist_mm_out) == 0) {
+        return 0;
+    }
+    dwt_forcetrxoff();
+    return -1;
+#else
+    uint32_t status;
+
     // Keep this bounded so the tag never "stalls" a cycle when anchor is absent.
     // REPORT is optional; a short wait is enough when it exists.
     for (int i = 0; i < 200; i++) {
         status = dwt_read32bitreg(SYS_STATUS_ID);
 
         if (status & SYS_STATUS_RXFCG_BIT_MASK) {
-            frame_len = dwt_read32bitreg(RX_FINFO_ID) & 0x3FF;
-            if (frame_len > 0 && frame_len <= sizeof(rx_buffer)) {
-                dwt_readrxdata(rx_buffer, frame_len, 0);
-
-                // MsgType at index 9 (same as other frames)
-                if (frame_len >= 14 && rx_buffer[9] == FUNC_CODE_REPORT) {
-                    uint32_t dist_mm = 0;
-                    dist_mm |= (uint32_t)rx_buffer[10];
-                    dist_mm |= ((uint32_t)rx_buffer[11]) << 8;
-                    dist_mm |= ((uint32_t)rx_buffer[12]) << 16;
-                    dist_mm |= ((uint32_t)rx_buffer[13]) << 24;
-
-                    if (dist_mm_out) {
-                        *dist_mm_out = dist_mm;
-                    }
+            struct uwb_frame_buf *fb = uwb_frame_read(dwt_read32bitreg(RX_FINFO_ID) & 0x3FF, 0);
+            if (fb) {
+                const int taken = uwb_take_report(fb, dist_mm_out);
+                if (taken == 0) {
                     dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR);
                     return 0;
                 }
@@ -498,18 +1069,80 @@ static int uwb_wait_report(uint32_t *dist_mm_out) {
     }
 
     return -1;
+#endif
+}
+
+#if defined(CONFIG_UWB_STS_SP3)
+/* Wait for the STS-only RESP (RXFR, no FCG) and check its STS. On success the
+ * receiver is re-enabled in SP0 for the RESP data frame that follows. */
+static int uwb_wait_sts_resp(uint64_t *rx_ts) {
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    struct uwb_radio_event ev;
+
+    if (uwb_evt_wait(UWB_EVT_RX_OK, &ev, 200000) != 0 || !(ev.rx_flags & DWT_CB_DATA_RX_FLAG_ND)) {
+        return -1;
+    }
+    *rx_ts = ev.ts;
+#else
+    uint32_t status = 0;
+
+    for (int i = 0; i < 2000 && !(status & SYS_STATUS_RXFR_BIT_MASK); i++) {
+        status = dwt_read32bitreg(SYS_STATUS_ID);
+        if (status & SYS_STATUS_ALL_RX_ERR) {
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_ERR);
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        }
+        if (!(status & SYS_STATUS_RXFR_BIT_MASK)) {
+            k_busy_wait(100);
+        }
+    }
+    if (!(status & SYS_STATUS_RXFR_BIT_MASK)) {
+        return -1;
+    }
+    *rx_ts = get_rx_timestamp_u64();
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_RXFCE_BIT_MASK);
+#endif
+
+    const int sts_ok = (uwb_sts_rx_check() == 0 && uwb_take_toa(rx_ts) == 0) ? 0 : -1;
+
+    uwb_sts_frame_mode(false);
+    if (sts_ok != 0) {
+        return -1;
+    }
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    return 0;
 }
+#endif
 
 int uwb_wait_resp(void) {
-    uint32_t status;
-    uint8_t rx_buffer[128];
-    uint16_t frame_len;
-    int status_check_count = 0;
+    uint64_t *rx_ts_override = NULL;
     
     LOG_DBG("Waiting for RESPONSE (bounded timeout)...");
 
     // NOTE: RX is already enabled by DWT_RESPONSE_EXPECTED in uwb_send_poll()
 
+#if defined(CONFIG_UWB_STS_SP3)
+    static uint64_t sts_resp_rx_ts;
+
+    if (uwb_wait_sts_resp(&sts_resp_rx_ts) != 0) {
+        LOG_ERR("❌ STS RESP timeout or bad STS");
+        dwt_forcetrxoff();
+        return -1;
+    }
+    rx_ts_override = &sts_resp_rx_ts;
+#endif
+
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    if (uwb_evt_rx_loop(200000, uwb_take_resp, rx_ts_override) == 0) {
+        return 0;
+    }
+    LOG_ERR("❌ RESP timeout");
+    dwt_forcetrxoff();
+    return -1;
+#else
+    uint32_t status;
+    int status_check_count = 0;
+
     // Bounded wait so main loop can keep periodic TX.
     // Increased timeout to ensure we catch the frame even if timing is loose.
     for (int i = 0; i < 2000; i++) { // Increased to 2000 iterations (approx 200ms)
@@ -518,45 +1151,22 @@ int uwb_wait_resp(void) {
         
         // Good frame received
         if (status & SYS_STATUS_RXFCG_BIT_MASK) {
-            frame_len = dwt_read32bitreg(RX_FINFO_ID) & 0x3FF;
+            struct uwb_frame_buf *fb =
+                uwb_frame_read(dwt_read32bitreg(RX_FINFO_ID) & 0x3FF, get_rx_timestamp_u64());
             
-            if (frame_len > 0 && frame_len < 128) {
-                dwt_readrxdata(rx_buffer, frame_len, 0);
+            if (fb) {
+                const int taken = uwb_take_resp(fb, rx_ts_override);
                 
-                // IEEE 802.15.4 RESPONSE format: 
-                // FC(2) + Seq(1) + PAN(2) + Dest(2) + Src(2) + MsgType(1) + Payload...
-                // MsgType at index 9 should be 0x50 (RESP)
-                
-                if (frame_len >= 20 && rx_buffer[9] == FUNC_CODE_RESP) {
-                    
-                    // REMOVED: uwb_led_pulse(); // Don't block here!
-                    
-                    // Get TAG's RESP RX timestamp
-                    resp_rx_ts = get_rx_timestamp_u64();
-                    
-                    // Extract ANCHOR's POLL_RX timestamp (bytes 10-14)
-                    poll_rx_ts_anchor = 0;
-                    for (int i = 0; i < 5; i++) {
-                        poll_rx_ts_anchor |= ((uint64_t)rx_buffer[10 + i]) << (i * 8);
-                    }
-                    
-                    // Extract ANCHOR's RESP_TX timestamp (bytes 15-19)
-                    resp_tx_ts_anchor = 0;
-                    for (int i = 0; i < 5; i++) {
-                        resp_tx_ts_anchor |= ((uint64_t)rx_buffer[15 + i]) << (i * 8);
-                    }
-                    
-                    LOG_INF("⏱️  TAG: POLL_TX=0x%010llX, RESP_RX=0x%010llX", poll_tx_ts, resp_rx_ts);
-                    
+                if (taken == 0) {
                     // Clear status and return success immediately
                     dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR);
                     return 0;
-                } else {
-                    // Not a RESP frame, clear and re-enable RX
-                    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD);
-                    dwt_rxenable(DWT_START_RX_IMMEDIATE);
                 }
             }
+            
+            // Not a (valid) RESP frame, clear and re-enable RX
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD);
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
         }
         
         // RX errors - clear and RE-ENABLE RX
@@ -572,10 +1182,11 @@ int uwb_wait_resp(void) {
     LOG_ERR("❌ RESP timeout");
     dwt_forcetrxoff();
     return -1;
+#endif
 }
 
 /* TWR: Step 3 - Send FINAL frame with calculated distance */
-int uwb_send_final(void) {
+UWB_RAMFUNC int uwb_send_final(void) {
     uint32_t status;
     int timeout = 0;
 
@@ -589,7 +1200,7 @@ int uwb_send_final(void) {
     // Give generous margin so delayed-TX programming + SPI writes never miss the scheduled slot.
     // This directly improves reliability of FINAL reception on the anchor.
     // INCREASED to 100ms to ensure Anchor has finished printing to Serial (approx 26ms) and enabled RX.
-    const uint64_t FINAL_DLY_DTU = 100000ULL * 63898ULL; // 100ms
+    const uint64_t FINAL_DLY_DTU = (uint64_t)UWB_FINAL_DELAY_US * 63898ULL;
     const uint64_t sys_time_40 = ((uint64_t)dwt_readsystimestamphi32()) << 8; // bits[39:8] -> align low 8
 
     // IMPORTANT (timestamp domain): RX/TX timestamps used for DS-TWR must be in the same domain.
@@ -608,7 +1219,7 @@ int uwb_send_final(void) {
         0x41, 0x88,           // [0-1] Frame Control
         0,                    // [2] Sequence
         0xCA, 0xDE,           // [3-4] PAN ID
-        0x02, 0x00,           // [5-6] Destination (ANCHOR ID = 0x0002)
+        0, 0,                 // [5-6] Destination: the anchor that answered
         0x01, 0x00,           // [7-8] Source (TAG ID = 0x0001)
         0x23,                 // [9] Msg Type: FINAL (0x23)
         0, 0, 0, 0, 0,        // [10-14] POLL_TX (40-bit)
@@ -617,6 +1228,7 @@ int uwb_send_final(void) {
     };
     
     final_frame[2] = seq_num++;
+    uwb_put_u16(&final_frame[UWB_IDX_DEST], resp_anchor_addr);
 
     // Embed timestamps (Little Endian, 40-bit)
     for (int i = 0; i < 5; i++) {
@@ -634,11 +1246,31 @@ int uwb_send_final(void) {
     // Program delayed TX absolute time (bits [39:8]) using the scheduled time (without antenna delay)
     dwt_setdelayedtrxtime((uint32_t)(final_tx_scheduled >> 8));
     
+#if defined(CONFIG_UWB_PAYLOAD_AES)
+    // Same header and timestamps; session, counter and MIC are added on the chip
+    uint8_t sec_frame[UWB_SEC_HDR_LEN + 3 * UWB_TS_LEN];
+    uint16_t sec_len;
+
+    memcpy(sec_frame, final_frame, UWB_IDX_PAYLOAD);
+    memcpy(&sec_frame[UWB_SEC_HDR_LEN], &final_frame[UWB_IDX_PAYLOAD], 3 * UWB_TS_LEN);
+    if (uwb_aes_tx_write(sec_frame, 3 * UWB_TS_LEN, &sec_len) != 0) {
+        uwb_hot_path_end(false);
+        LOG_ERR("FINAL encryption failed");
+        return -1;
+    }
+    dwt_writetxfctrl(sec_len + 2, 0, 1); // +2 FCS, ranging=1
+#else
     dwt_writetxdata(sizeof(final_frame), final_frame, 0);
     dwt_writetxfctrl(sizeof(final_frame) + 2, 0, 1); // +2 FCS, ranging=1
+#endif
 
     // Delayed TX at DX_TIME
-    if (dwt_starttx(DWT_START_TX_DELAYED) != DWT_SUCCESS) {
+    const int tx_ret = dwt_starttx(DWT_START_TX_DELAYED);
+    uwb_hot_path_end(tx_ret != DWT_SUCCESS);
+
+    LOG_INF("⏱️  TAG: POLL_TX=0x%010llX, RESP_RX=0x%010llX", poll_tx_ts, resp_rx_ts);
+
+    if (tx_ret != DWT_SUCCESS) {
         const uint32_t st_lo = dwt_read32bitreg(SYS_STATUS_ID);
         const uint32_t st_hi = dwt_read32bitreg(SYS_STATUS_HI_ID);
         LOG_ERR("FINAL TX start failed (SYS_STATUS=0x%08X, SYS_STATUS_HI=0x%08X)", st_lo, st_hi);
@@ -649,6 +1281,13 @@ int uwb_send_final(void) {
     
     uwb_led_pulse(); // LED pulse when sending FINAL
     
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    struct uwb_radio_event ev;
+    if (uwb_evt_wait(UWB_EVT_TX_DONE, &ev, 10000) == 0) {
+        LOG_INF("✅ FINAL sent!");
+        return 0;
+    }
+#else
     while (timeout < 10000) {
         status = dwt_read32bitreg(SYS_STATUS_ID);
         if (status & SYS_STATUS_TXFRS_BIT_MASK) {
@@ -659,130 +1298,1364 @@ int uwb_send_final(void) {
         k_busy_wait(100);
         timeout += 100;
     }
+#endif
     
     LOG_ERR("FINAL TX timeout!");
     return -1;
 }
 
-/* Calculate distance using TWR timestamps - SS-TWR with explicit Anchor Delay */
-static double calculate_distance(void) {
-    double tof;
-    double distance;
-    
+/* Calculate distance using TWR timestamps - SS-TWR with explicit Anchor Delay.
+ * The math is in uwb_twr_est.c, shared with the host replay tool. */
+static void twr_timestamps(struct uwb_twr_ts *ts) {
+#if defined(CONFIG_UWB_RESPONDER) || defined(CONFIG_UWB_PEER)
+    *ts = rsp_ts;
+#else
     // Already masked to 40-bit in get_timestamp functions
-    uint64_t poll_tx_40 = poll_tx_ts;
-    uint64_t resp_rx_40 = resp_rx_ts;
-    uint64_t poll_rx_anchor_40 = poll_rx_ts_anchor;
-    uint64_t resp_tx_anchor_40 = resp_tx_ts_anchor;
-    
-    // Calculate Ra (Tag Round Trip)
-    int64_t Ra;
-    if (resp_rx_40 >= poll_tx_40) {
-        Ra = (int64_t)(resp_rx_40 - poll_tx_40);
-    } else {
-        Ra = (int64_t)((0x10000000000ULL - poll_tx_40) + resp_rx_40);
+    ts->poll_tx = poll_tx_ts;
+    ts->resp_rx = resp_rx_ts;
+    ts->poll_rx = poll_rx_ts_anchor;
+    ts->resp_tx = resp_tx_ts_anchor;
+    ts->final_tx = final_tx_ts;
+#endif
+}
+
+static uint32_t calculate_distance_mm(void) {
+    struct uwb_twr_ts ts;
+
+    twr_timestamps(&ts);
+
+    const double tof = uwb_twr_ss_tof_dtu(&ts);
+
+    // NOTE: Zephyr LOG/CBPRINTF often has float formatting disabled.
+    // Keep logs integer-only so RTT output remains readable.
+    LOG_DBG("═══ Distance Calculation (SS-TWR) ═══");
+    LOG_DBG("  TAG POLL_TX:    0x%010llX", ts.poll_tx);
+    LOG_DBG("  TAG RESP_RX:    0x%010llX", ts.resp_rx);
+    LOG_DBG("  ANCHOR POLL_RX: 0x%010llX", ts.poll_rx);
+    LOG_DBG("  ANCHOR RESP_TX: 0x%010llX", ts.resp_tx);
+    LOG_DBG("  ToF (calculated): %lld DU", (int64_t)((tof >= 0.0) ? (tof + 0.5) : (tof - 0.5)));
+
+    // Within the crystal tolerance uwb_validate_resp() lets through, a very
+    // short range can still come out slightly negative: no SS-TWR distance then
+    if (tof < 0) {
+        LOG_DBG("  Negative ToF (Ra < Db within clock tolerance), no SS-TWR distance");
+        return 0;
     }
-    
-    // Calculate Db (Anchor Reply Delay)
-    int64_t Db;
-    if (resp_tx_anchor_40 >= poll_rx_anchor_40) {
-        Db = (int64_t)(resp_tx_anchor_40 - poll_rx_anchor_40);
-    } else {
-        Db = (int64_t)((0x10000000000ULL - poll_rx_anchor_40) + resp_tx_anchor_40);
+
+    const uint32_t dist_mm = uwb_twr_ss_dist_mm(&ts);
+
+    LOG_DBG("  📏 Distance: %u mm", dist_mm);
+    return dist_mm;
+}
+
+void uwb_twr_get_timestamps(struct uwb_twr_ts *ts) {
+    twr_timestamps(ts);
+}
+
+void uwb_driver_get_config(struct uwb_radio_config *out) {
+    out->antenna_delay = g_antenna_delay;
+    out->channel = config.chan;
+    out->preamble_code = config.txCode;
+    out->sts_mode = config.stsMode;
+}
+
+#if defined(CONFIG_UWB_PHY_SCAN)
+// ================= PHY discovery scan =================
+// Until the tag has heard its network, each cycle probes a few candidate
+// PHYs (uwb_phy_scan.h) instead of ranging. A probe is a broadcast POLL and
+// a receive window from RX_DELAY to RX_DELAY + WINDOW after it, which is where
+// an anchor's RESP lands. The preamble-detect timeout switches the receiver
+// off as soon as the window passes without a preamble, so an empty PHY costs
+// the POLL plus about WINDOW of RX.
+
+// Preamble-detect timeout counts PACs: 8 symbols of ~1.0176 us (DWT_PAC8)
+#define PHY_SCAN_PRE_TO_PAC     ((CONFIG_UWB_PHY_SCAN_WINDOW_US * 100U) / 814U)
+// dwt_setrxaftertxdelay() takes UWB microseconds (512/499.2 us)
+#define PHY_SCAN_RX_DELAY_UUS   ((CONFIG_UWB_PHY_SCAN_RX_DELAY_US * 4992U) / 5120U)
+// MCU-side bound: window, plus a frame that started at its end
+#define PHY_SCAN_LISTEN_US      (CONFIG_UWB_PHY_SCAN_RX_DELAY_US + CONFIG_UWB_PHY_SCAN_WINDOW_US + 1000)
+
+static struct uwb_phy_scan phy_scan;
+static uint32_t phy_scan_since_ms;     // when the current scan started
+
+static int uwb_phy_apply(const struct uwb_phy *phy) {
+    config.chan = phy->chan;
+    config.txCode = phy->code;
+    config.rxCode = phy->code;
+    dwt_forcetrxoff();
+    // Channel and code only: antenna delays and the STS key are kept
+    if (dwt_configure(&config) != DWT_SUCCESS) {
+        LOG_ERR("PHY scan: PLL lock failed on channel %u", phy->chan);
+        return -1;
     }
-    
-    LOG_INF("═══ Distance Calculation (SS-TWR) ═══");
-    LOG_INF("  TAG POLL_TX:    0x%010llX", poll_tx_40);
-    LOG_INF("  TAG RESP_RX:    0x%010llX", resp_rx_40);
-    LOG_INF("  ANCHOR POLL_RX: 0x%010llX", poll_rx_anchor_40);
-    LOG_INF("  ANCHOR RESP_TX: 0x%010llX", resp_tx_anchor_40);
-    LOG_INF("  Ra (Tag Loop):  %lld DU", Ra);
-    LOG_INF("  Db (Anchor Dly):%lld DU", Db);
-    
-    // TWR Formula: ToF = (Ra - Db) / 2
-    tof = ((double)Ra - (double)Db) / 2.0;
-    
-    // NOTE: Zephyr LOG/CBPRINTF often has float formatting disabled.
-    // Keep logs integer-only so RTT output remains readable.
-    const int64_t tof_du_i = (int64_t)((tof >= 0.0) ? (tof + 0.5) : (tof - 0.5));
-    const int64_t tof_ns_i = (int64_t)((tof * 15.65) >= 0.0 ? ((tof * 15.65) + 0.5) : ((tof * 15.65) - 0.5));
-    LOG_INF("  ToF (calculated): %lld DU (~%lld ns)", tof_du_i, tof_ns_i);
-    
-    // Sanity checks
-    if (tof < 0) {
-        LOG_WRN("  ⚠️  Negative ToF! Ra < Db. Setting to 0.");
-        tof = 0.0;
+    dwt_configuretxrf(&txconfig);
+    return 0;
+}
+
+/* Listen for any frame of our network. Polled in both RX modes: the IRQ
+ * event path re-enables the receiver on a timeout, which is what the scan
+ * wants to avoid, and the IRQ line is not armed outside its waits. */
+static int uwb_phy_listen(uint16_t *src) {
+    const int64_t deadline = k_uptime_ticks() + k_us_to_ticks_ceil64(PHY_SCAN_LISTEN_US);
+
+    while (k_uptime_ticks() < deadline) {
+        const uint32_t status = dwt_read32bitreg(SYS_STATUS_ID);
+
+        if (status & SYS_STATUS_RXFCG_BIT_MASK) {
+            struct uwb_frame_buf *fb = uwb_frame_read(dwt_read32bitreg(RX_FINFO_ID) & 0x3FF, 0);
+            int found = -1;
+
+            if (fb) {
+                if (uwb_frame_hdr_ok(fb->data, fb->len)) {
+                    *src = uwb_get_u16(&fb->data[UWB_IDX_SRC]);
+                    found = 0;
+                }
+            }
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD);
+            if (found == 0) {
+                return 0;
+            }
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        }
+        if (status & SYS_STATUS_ALL_RX_TO) {
+            // No preamble in the window: nobody here
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_TO);
+            return -1;
+        }
+        if (status & SYS_STATUS_ALL_RX_ERR) {
+            // Something is on air on this PHY: keep listening
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_ERR);
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        }
+        k_busy_wait(50);
     }
-    
-    // Convert DU to seconds: 1 DU = 1/(499.2 MHz × 128) ≈ 15.65 picoseconds
-    double tof_sec = tof * (1.0 / (499.2e6 * 128.0));
-    
-    // Distance = ToF × Speed of Light
-    distance = tof_sec * SPEED_OF_LIGHT;
-    
-    const int64_t tof_us_i = (int64_t)((tof_sec * 1e6) >= 0.0 ? ((tof_sec * 1e6) + 0.5) : ((tof_sec * 1e6) - 0.5));
-    const uint32_t dist_mm_i = (distance <= 0.0) ? 0U : (uint32_t)((distance * 1000.0) + 0.5);
-    LOG_INF("  ⏱️  ToF: ~%lld us", tof_us_i);
-    LOG_INF("  📏 Distance: %u mm", dist_mm_i);
-    
-    return distance;
+    return -1;
 }
 
-/* Complete TWR cycle - DS-TWR METHOD (3 messages with FINAL) */
-int uwb_twr_cycle(void) {
-    LOG_INF("━━━━━━ Starting SS-TWR Cycle ━━━━━━");
+/* One unlocked cycle: probe candidates until one is heard or this cycle's
+ * budget is used up. -ENODATA unless the radio itself failed. */
+static int uwb_phy_scan_step(struct uwb_range_result *res) {
+    const uint32_t sweeps = phy_scan.stats.sweeps;
+    struct uwb_phy phy;
+    int ret = -ENODATA;
+
+    for (int i = 0; i < phy_scan.cfg.per_cycle && uwb_phy_scan_next(&phy_scan, &phy); i++) {
+        uint16_t src = 0;
+
+        if (uwb_phy_apply(&phy) != 0) {
+            continue;
+        }
+        poll_dest = UWB_ADDR_BROADCAST;
+        dwt_setrxaftertxdelay(PHY_SCAN_RX_DELAY_UUS);
+        dwt_setpreambledetecttimeout(PHY_SCAN_PRE_TO_PAC);
+        if (uwb_send_poll() != 0) {
+            res->status = UWB_RANGE_ERR_POLL;
+            ret = res->status;
+        } else if (uwb_phy_listen(&src) == 0) {
+            uwb_phy_scan_found(&phy_scan, &phy);
+        }
+        dwt_forcetrxoff();
+        dwt_setrxaftertxdelay(0);
+        dwt_setpreambledetecttimeout(0);
+
+        if (phy_scan.locked) {
+            LOG_INF("PHY scan: locked on channel %u code %u (0x%04X) after %u probes, %u ms",
+                    phy.chan, phy.code, src, phy_scan.stats.lock_probes,
+                    (uint32_t)k_uptime_get() - phy_scan_since_ms);
+            return ret;
+        }
+    }
+
+    if (phy_scan.stats.sweeps != sweeps) {
+        LOG_WRN("PHY scan: no network on %u PHYs (%u sweeps), next sweep in %u cycles",
+                phy_scan.n, phy_scan.stats.sweeps, phy_scan.idle);
+    }
+    return ret;
+}
+#endif
+
+#if defined(CONFIG_UWB_DOWNLINK)
+// ================= Downlink commands =================
+static uint8_t uwb_dl_exec(const struct uwb_dl_cmd *c) {
+    const uint8_t status = uwb_dl_check(c);
+
+    if (status != UWB_DL_OK) {
+        return status;
+    }
+    switch (c->op) {
+    case UWB_DL_OP_PERIOD:
+        if (!IS_ENABLED(CONFIG_UWB_DOWNLINK_PERIOD)) {
+            return UWB_DL_REFUSED;
+        }
+        // Takes effect from the next cycle
+        uwb_ranging_set_period(uwb_get_u16(c->val));
+        return UWB_DL_OK;
+
+    case UWB_DL_OP_TX_POWER:
+        if (!IS_ENABLED(CONFIG_UWB_DOWNLINK_TX_POWER)) {
+            return UWB_DL_REFUSED;
+        }
+        txconfig.power = uwb_get_u32(c->val);
+        dwt_configuretxrf(&txconfig);
+        return UWB_DL_OK;
+
+    case UWB_DL_OP_PHY: {
+        if (!IS_ENABLED(CONFIG_UWB_DOWNLINK_PHY)) {
+            return UWB_DL_REFUSED;
+        }
+        const uint8_t chan = config.chan;
+        const uint8_t code = config.txCode;
+        uint8_t ret = UWB_DL_OK;
+
+        dwt_forcetrxoff();
+        config.chan = c->val[0];
+        config.txCode = c->val[1];
+        config.rxCode = c->val[1];
+        if (dwt_configure(&config) != DWT_SUCCESS) {
+            // Back to the PHY that worked
+            config.chan = chan;
+            config.txCode = code;
+            config.rxCode = code;
+            (void)dwt_configure(&config);
+            ret = UWB_DL_FAILED;
+        }
+        dwt_configuretxrf(&txconfig);
+#if defined(CONFIG_UWB_PHY_SCAN)
+        if (ret == UWB_DL_OK) {
+            // Rescans start from the new PHY
+            const struct uwb_phy phy = { config.chan, config.txCode };
+
+            uwb_phy_scan_found(&phy_scan, &phy);
+        }
+#endif
+        return ret;
+    }
+
+    default:
+        return UWB_DL_UNKNOWN;
+    }
+}
+
+/* Cycle boundary: apply the command received during the last cycle. The
+ * ack goes out in this cycle's POLL, so a PHY change is acked on the new PHY. */
+static void uwb_dl_apply(void) {
+    struct uwb_dl_cmd c;
+
+    if (!uwb_dl_take(&dl_state, &c)) {
+        return;
+    }
+
+    const uint8_t status = uwb_dl_exec(&c);
+
+    uwb_dl_done(&dl_state, status);
+    LOG_INF("downlink: command %u (op %u) from 0x%04X: status %u", c.seq, c.op, dl_state.src,
+            status);
+}
+#endif
+
+/* Complete TWR cycle - DS-TWR METHOD (3 messages with FINAL)
+ * Runs in the radio thread: results are handed to consumers via *res, so keep
+ * logging here to the minimum needed to diagnose a failed step. */
+int uwb_twr_cycle(struct uwb_range_result *res) {
+    const uint32_t cyc_start = k_cycle_get_32();
+
+    memset(res, 0, sizeof(*res));
+    LOG_DBG("━━━━━━ Starting SS-TWR Cycle ━━━━━━");
+    
+    session_cycle++;
+    if ((session_cycle % 10) == 0) {
+        uwb_log_rx_stats();
+        uwb_log_hot_path_stats();
+#if defined(CONFIG_UWB_STS)
+        struct uwb_sts_stats sts;
+        uwb_sts_get_stats(&sts);
+        LOG_INF("STS %s: %u exchanges, ok %u, bad quality %u, bad status %u, min quality %d",
+                uwb_sts_mode_name(), sts.exchanges, sts.rx_ok, sts.rx_bad_qual,
+                sts.rx_bad_status, sts.qual_min);
+        LOG_INF("Ipatov/STS: %u checked, %u mismatched, |diff| avg %u max %u DTU (limit %d)",
+                sts.toa_checked, sts.toa_mismatch,
+                sts.toa_checked ? (uint32_t)(sts.toa_diff_sum / sts.toa_checked) : 0,
+                sts.toa_diff_max, CONFIG_UWB_TOA_MAX_DIFF_DTU);
+#endif
+#if defined(CONFIG_UWB_PAYLOAD_AES)
+        struct uwb_aes_stats aes;
+        uwb_aes_get_stats(&aes);
+        LOG_INF("AES 0x%08X: tx %u, rx ok %u, rejected malformed %u session %u replay %u "
+                "auth %u, errors %u, enc avg %u max %u us, dec avg %u max %u us",
+                aes.session, aes.tx_ok, aes.rx_ok, aes.rx_malformed, aes.rx_session,
+                aes.rx_replay, aes.rx_auth_fail, aes.errors,
+                aes.tx_ok ? (uint32_t)(aes.enc_sum_us / aes.tx_ok) : 0, aes.enc_max_us,
+                aes.rx_ok ? (uint32_t)(aes.dec_sum_us / aes.rx_ok) : 0, aes.dec_max_us);
+#endif
+#if defined(CONFIG_UWB_DOWNLINK)
+        const struct uwb_dl_stats *dl = &dl_state.stats;
+
+        if (dl->rx) {
+            LOG_INF("downlink: %u commands, applied %u, rejected %u, repeats %u, replaced %u, "
+                    "malformed %u, acks %u", dl->rx, dl->applied, dl->rejected, dl->repeats,
+                    dl->replaced, dl->malformed, dl->acks);
+        }
+#endif
+    }
     
     // *** CRITICAL: Reset ALL timestamps at start of EVERY cycle! ***
     poll_tx_ts = 0;
     resp_rx_ts = 0;
     final_tx_ts = 0;
-    LOG_INF("🔹 Timestamps RESET: poll_tx=0x%llX, resp_rx=0x%llX", poll_tx_ts, resp_rx_ts);
+    poll_rx_ts_anchor = 0;
+    resp_tx_ts_anchor = 0;
+
+#if defined(CONFIG_UWB_DOWNLINK)
+    uwb_dl_apply();
+#endif
+
+#if defined(CONFIG_UWB_PHY_SCAN)
+    // No network yet (or lost): this cycle probes PHYs instead of ranging
+    if (phy_scan.cfg.per_cycle == 0) {
+        const struct uwb_phy_scan_cfg pcfg = {
+            .chan_mask = CONFIG_UWB_PHY_SCAN_CHANNELS,
+            .code_mask = CONFIG_UWB_PHY_SCAN_CODES,
+            .per_cycle = CONFIG_UWB_PHY_SCAN_PROBES,
+            .lost_cycles = CONFIG_UWB_PHY_SCAN_LOST_CYCLES,
+            .backoff = CONFIG_UWB_PHY_SCAN_BACKOFF_CYCLES,
+            .backoff_max = CONFIG_UWB_PHY_SCAN_BACKOFF_MAX_CYCLES,
+        };
+        const struct uwb_phy home = { config.chan, config.txCode };
+
+        uwb_phy_scan_init(&phy_scan, &pcfg, &home);
+        phy_scan_since_ms = (uint32_t)k_uptime_get();
+    }
+    if (!phy_scan.locked) {
+        const int ret = uwb_phy_scan_step(res);
+
+        res->cycle_us = k_cyc_to_us_floor32(k_cycle_get_32() - cyc_start);
+        return ret;
+    }
+#endif
+
+#if defined(CONFIG_UWB_ANCHOR_SELECT)
+    // One of this epoch's best anchors, or a broadcast to discover more
+    if (anchor_tab.cfg.best_n == 0) {
+        const struct uwb_anchor_cfg acfg = {
+            .best_n = CONFIG_UWB_ANCHOR_BEST_N,
+            .max_misses = CONFIG_UWB_ANCHOR_MAX_MISSES,
+            .discover_epochs = CONFIG_UWB_ANCHOR_DISCOVER_EPOCHS,
+            .timeout_ms = CONFIG_UWB_ANCHOR_TIMEOUT_MS,
+        };
+        uwb_anchor_table_init(&anchor_tab, &acfg);
+    }
+    poll_dest = uwb_anchor_next(&anchor_tab, (uint32_t)k_uptime_get());
+    if ((session_cycle % CONFIG_UWB_ANCHOR_LOG_CYCLES) == 0) {
+        uwb_log_anchor_table();
+    }
+#endif
     
     // Step 1: Send POLL
     if (uwb_send_poll() != 0) {
         LOG_ERR("❌ POLL failed");
-        return -1;
+        res->status = UWB_RANGE_ERR_POLL;
+        goto out;
     }
+    res->seq = poll_seq;
     
     // k_msleep(5); // REMOVED: Do not sleep! Anchor replies in 2ms.
     
     // Step 2: Wait for RESP
     if (uwb_wait_resp() != 0) {
         LOG_ERR("❌ RESP not received");
-        return -1;
+        res->status = UWB_RANGE_ERR_RESP;
+        goto out;
+    }
+    res->anchor = resp_anchor_addr;
+#if defined(CONFIG_UWB_STS)
+    res->toa_diff_dtu = resp_toa_diff;
+    if (resp_toa_mismatch) {
+        res->flags |= UWB_RANGE_FLAG_TOA;
     }
+#endif
     
     // Step 3: Send FINAL with TAG timestamps to ANCHOR
     if (uwb_send_final() != 0) {
         LOG_ERR("❌ FINAL send failed");
-        return -1;
+        res->status = UWB_RANGE_ERR_FINAL;
+        goto out;
     }
 
     // Step 3b: Optional REPORT (anchor-computed DS-TWR distance)
     uint32_t report_dist_mm = 0;
     if (uwb_wait_report(&report_dist_mm) == 0 && report_dist_mm > 0) {
-        LOG_INF("📩 REPORT received: %u mm (anchor DS-TWR)", report_dist_mm);
-    } else {
-        LOG_WRN("(no REPORT) anchor may not support DS-TWR report yet");
+        res->report_mm = report_dist_mm;
     }
     
     // Step 4: Calculate distance at TAG (we have all timestamps now)
-    LOG_INF("━━━━━━ Calculating Distance at TAG ━━━━━━");
-    LOG_INF("   POLL_TX:  0x%010llX", poll_tx_ts);
-    LOG_INF("   RESP_RX:  0x%010llX", resp_rx_ts);
-    LOG_INF("   FINAL_TX: 0x%010llX", final_tx_ts);
-    
-    double distance = calculate_distance();
-    if (distance > 0) {
-        const uint32_t dist_mm = (uint32_t)((distance * 1000.0) + 0.5);
-        LOG_INF("✅ TWR SUCCESS: %u mm", dist_mm);
+    LOG_DBG("   POLL_TX:  0x%010llX", poll_tx_ts);
+    LOG_DBG("   RESP_RX:  0x%010llX", resp_rx_ts);
+    LOG_DBG("   FINAL_TX: 0x%010llX", final_tx_ts);
+    
+    res->dist_mm = calculate_distance_mm();
+
+out:
+    uwb_hot_path_end(false);   // no-op unless a step bailed out inside the window
+#if defined(CONFIG_UWB_ANCHOR_SELECT)
+    uwb_anchor_result(&anchor_tab, poll_dest, res->anchor, (uint32_t)k_uptime_get(),
+                      uwb_est_quality(res->status, res->dist_mm, res->report_mm,
+                                      (res->flags & UWB_RANGE_FLAG_TOA) != 0),
+                      res->status ? 0 : res->dist_mm);
+#endif
+#if defined(CONFIG_UWB_PHY_SCAN)
+    if (uwb_phy_scan_cycle(&phy_scan, res->anchor != 0)) {
+        LOG_WRN("PHY scan: no anchor on channel %u code %u for %u cycles, rescanning",
+                config.chan, config.txCode, phy_scan.cfg.lost_cycles);
+        phy_scan_since_ms = (uint32_t)k_uptime_get();
+    }
+#endif
+    res->cycle_us = k_cyc_to_us_floor32(k_cycle_get_32() - cyc_start);
+    return res->status;
+}
+
+#if defined(CONFIG_UWB_RESPONDER) || defined(CONFIG_UWB_PEER) || defined(CONFIG_UWB_CLOCK_SYNC)
+// ================= Listening modes: shared RX and reply helpers =================
+// Responder and peer mode both answer POLLs addressed to this tag: RESP a
+// fixed delay after the POLL arrived (delayed TX, so its timestamp can be sent
+// in the frame), then a DS-TWR distance from the initiator's FINAL. The clock
+// sync role only shares the RX loop and the frame header.
+
+static uint16_t own_addr = UWB_TAG_ADDR;    // peer mode: set at the first window
+
+/* Offer received frames to `take` until it accepts one or timeout_us passes.
+ * The receiver must already be on. */
+static int uwb_rx_loop(uint32_t timeout_us,
+                       int (*take)(const struct uwb_frame_buf *, void *), void *arg) {
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    return uwb_evt_rx_loop(timeout_us, take, arg);
+#else
+    const int64_t deadline = k_uptime_ticks() + k_us_to_ticks_ceil64(timeout_us);
+
+    while (k_uptime_ticks() < deadline) {
+        const uint32_t status = dwt_read32bitreg(SYS_STATUS_ID);
+
+        if (status & SYS_STATUS_RXFCG_BIT_MASK) {
+            struct uwb_frame_buf *fb =
+                uwb_frame_read(dwt_read32bitreg(RX_FINFO_ID) & 0x3FF, get_rx_timestamp_u64());
+
+            if (fb) {
+                const int taken = take(fb, arg);
+                if (taken == 0) {
+                    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR);
+                    return 0;
+                }
+            }
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD);
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        }
+        if (status & SYS_STATUS_ALL_RX_ERR) {
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_ERR);
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        }
+        k_busy_wait(100);
+    }
+    return -1;
+#endif
+}
+
+static int uwb_wait_tx_done(uint32_t timeout_us) {
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    struct uwb_radio_event ev;
+
+    return (uwb_evt_wait(UWB_EVT_TX_DONE, &ev, timeout_us) == 0) ? 0 : -1;
+#else
+    for (uint32_t t = 0; t < timeout_us; t += 10) {
+        if (dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_TXFRS_BIT_MASK) {
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS_BIT_MASK);
+            return 0;
+        }
+        k_busy_wait(10);
+    }
+    return -1;
+#endif
+}
+
+static void uwb_put_hdr(uint8_t *f, uint8_t seq, uint16_t dest, uint8_t func) {
+    f[0] = UWB_FC_LSB;
+    f[1] = UWB_FC_MSB;
+    f[UWB_IDX_SEQ] = seq;
+    uwb_put_u16(&f[UWB_IDX_PAN], UWB_PAN_ID);
+    uwb_put_u16(&f[UWB_IDX_DEST], dest);
+    uwb_put_u16(&f[UWB_IDX_SRC], own_addr);
+    f[UWB_IDX_FUNC] = func;
+}
+#endif /* CONFIG_UWB_RESPONDER || CONFIG_UWB_PEER || CONFIG_UWB_CLOCK_SYNC */
+
+#if defined(CONFIG_UWB_RESPONDER) || defined(CONFIG_UWB_PEER)
+#if defined(CONFIG_UWB_RESPONDER)
+#define RESP_DLY_DTU    ((uint64_t)CONFIG_UWB_RESPONDER_RESP_DELAY_US * 63898ULL)
+#else
+#define RESP_DLY_DTU    ((uint64_t)CONFIG_UWB_PEER_REPLY_DELAY_US * 63898ULL)
+#endif
+
+static uint64_t rsp_final_rx;
+static uint16_t rsp_anchor;                 // the other end of the current exchange
+static uint8_t rsp_poll_seq;
+
+/* A POLL for us (not a broadcast one) that is not a replay */
+static UWB_RAMFUNC int uwb_take_poll(const struct uwb_frame_buf *fb, void *arg) {
+    ARG_UNUSED(arg);
+    const uint8_t *f = fb->data;
+
+    if (fb->len <= UWB_IDX_FUNC || f[UWB_IDX_FUNC] != FUNC_CODE_POLL) {
+        return -1;
+    }
+    if (!uwb_frame_hdr_ok(f, fb->len)) {
+        rx_stats.rej_malformed++;
+        return -1;
+    }
+
+    const uint16_t src = uwb_get_u16(&f[UWB_IDX_SRC]);
+
+    // Tag-initiated POLLs from other tags are broadcast: not for us
+    if (uwb_get_u16(&f[UWB_IDX_DEST]) != own_addr ||
+        src == UWB_ADDR_BROADCAST || src == 0 || src == own_addr) {
+        rx_stats.rej_foreign++;
+        return -1;
+    }
+    const uint32_t now_ms = k_uptime_get_32();
+
+    if (uwb_replay_seen(&poll_replay, src, f[UWB_IDX_SEQ], now_ms)) {
+        rx_stats.rej_replay++;
+        return -1;
+    }
+    uwb_replay_accept(&poll_replay, src, f[UWB_IDX_SEQ], now_ms);
+
+    rsp_anchor = src;
+    rsp_poll_seq = f[UWB_IDX_SEQ];
+    rsp_ts.poll_rx = fb->ts;
+
+    // From here until RESP is scheduled: no logging
+    uwb_hot_path_begin(fb->cyc);
+    return 0;
+}
+
+/* RESP a fixed delay after the POLL: POLL_RX, RESP_TX and our schedule */
+static UWB_RAMFUNC int uwb_send_resp(uint32_t period_ms, uint32_t offset_us) {
+    // DX_TIME ignores the low 9 bits; the on-air time adds the TX antenna delay
+    const uint64_t resp_tx_scheduled = (rsp_ts.poll_rx + RESP_DLY_DTU) & 0xFFFFFFFE00ULL;
+    uint8_t frame[UWB_RESP_SCHED_LEN];
+
+    rsp_ts.resp_tx = (resp_tx_scheduled + (uint64_t)g_antenna_delay) & UWB_TS_MASK;
+
+    uwb_put_hdr(frame, rsp_poll_seq, rsp_anchor, FUNC_CODE_RESP);
+    uwb_put_ts40(&frame[UWB_IDX_PAYLOAD], rsp_ts.poll_rx);
+    uwb_put_ts40(&frame[UWB_IDX_PAYLOAD + UWB_TS_LEN], rsp_ts.resp_tx);
+    uwb_put_u16(&frame[UWB_RESP_LEN], (uint16_t)MIN(period_ms, UINT16_MAX));
+    uwb_put_u16(&frame[UWB_RESP_LEN + 2], (uint16_t)MIN(offset_us, UINT16_MAX));
+
+    dwt_writetxdata(sizeof(frame), frame, 0);
+    dwt_writetxfctrl(sizeof(frame) + 2, 0, 1); // +2 FCS, ranging=1
+    dwt_setdelayedtrxtime((uint32_t)(resp_tx_scheduled >> 8));
+
+    // RX follows the RESP for the initiator's FINAL
+    const int tx_ret = dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED);
+    uwb_hot_path_end(tx_ret != DWT_SUCCESS);
+    return (tx_ret == DWT_SUCCESS) ? 0 : -1;
+}
+
+/* The initiator's FINAL for this exchange: its POLL_TX, RESP_RX and FINAL_TX */
+static int uwb_take_final(const struct uwb_frame_buf *fb, void *arg) {
+    ARG_UNUSED(arg);
+    const uint8_t *f = fb->data;
+
+    if (fb->len < UWB_FINAL_LEN || f[UWB_IDX_FUNC] != FUNC_CODE_FINAL) {
+        return -1;
+    }
+    if (!uwb_frame_hdr_ok(f, fb->len) ||
+        uwb_get_u16(&f[UWB_IDX_DEST]) != own_addr ||
+        uwb_get_u16(&f[UWB_IDX_SRC]) != rsp_anchor) {
+        rx_stats.rej_foreign++;
+        return -1;
+    }
+    rsp_ts.poll_tx = uwb_get_ts40(&f[UWB_IDX_PAYLOAD]);
+    rsp_ts.resp_rx = uwb_get_ts40(&f[UWB_IDX_PAYLOAD + UWB_TS_LEN]);
+    rsp_ts.final_tx = uwb_get_ts40(&f[UWB_IDX_PAYLOAD + 2 * UWB_TS_LEN]);
+    rsp_final_rx = fb->ts;
+    return 0;
+}
+#endif /* CONFIG_UWB_RESPONDER || CONFIG_UWB_PEER */
+
+#if defined(CONFIG_UWB_RESPONDER)
+// ================= Responder mode (anchor-initiated ranging) =================
+// The tag only listens in a short window on the period grid; an anchor that
+// wants a range POLLs it there and the helpers above answer it. Outside the
+// windows the transceiver is forced off, and the time it is on is measured.
+
+static struct uwb_responder_stats rsp_stats;
+
+/* Window announcement, then RX straight after it (anchors may POLL at once) */
+static int uwb_send_window(uint32_t period_ms) {
+    uint8_t frame[UWB_WINDOW_LEN];
+
+    uwb_put_hdr(frame, seq_num++, UWB_ADDR_BROADCAST, FUNC_CODE_WINDOW);
+    uwb_put_u16(&frame[UWB_IDX_PAYLOAD], (uint16_t)MIN(period_ms, UINT16_MAX));
+    uwb_put_u16(&frame[UWB_IDX_PAYLOAD + 2], CONFIG_UWB_RESPONDER_WINDOW_US);
+
+    dwt_writetxdata(sizeof(frame), frame, 0);
+    dwt_writetxfctrl(sizeof(frame) + 2, 0, 0);
+    if (dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED) != DWT_SUCCESS) {
+        return -1;
+    }
+    return uwb_wait_tx_done(10000);
+}
+
+int uwb_responder_window(struct uwb_range_result *res, uint32_t period_ms, bool announce) {
+    const uint32_t cyc_start = k_cycle_get_32();
+
+    memset(res, 0, sizeof(*res));
+    memset(&rsp_ts, 0, sizeof(rsp_ts));
+    rsp_final_rx = 0;
+    rsp_anchor = 0;
+
+    session_cycle++;
+    if ((session_cycle % CONFIG_UWB_RESPONDER_LOG_WINDOWS) == 0) {
+        uwb_log_rx_stats();
+        uwb_log_hot_path_stats();
+    }
+    if (rsp_stats.windows++ == 0) {
+        rsp_stats.first_ms = k_uptime_get();
+    }
+
+    dwt_forcetrxoff();
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_TX | SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR);
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    uwb_evt_reset();
+#endif
+
+    // Radio on from here until the dwt_forcetrxoff() at the end
+    const uint32_t on_cyc = k_cycle_get_32();
+
+    if (announce) {
+        rsp_stats.announced++;
+        if (uwb_send_window(period_ms) != 0) {
+            // Still listen: anchors that know the schedule do not need it
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        }
     } else {
-        LOG_WRN("⚠️ Distance calculation failed (invalid timestamps)");
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    }
+
+    if (uwb_rx_loop(CONFIG_UWB_RESPONDER_WINDOW_US, uwb_take_poll, NULL) != 0) {
+        res->status = -ENODATA;
+        goto out;
+    }
+    rsp_stats.polled++;
+    res->anchor = rsp_anchor;
+    res->seq = rsp_poll_seq;
+
+    if (uwb_send_resp(period_ms, k_cyc_to_us_floor32(k_cycle_get_32() - on_cyc)) != 0 ||
+        uwb_wait_tx_done(CONFIG_UWB_RESPONDER_RESP_DELAY_US + 10000) != 0) {
+        rsp_stats.resp_late++;
+        res->status = UWB_RANGE_ERR_RESP;
+        goto out;
+    }
+
+    if (CONFIG_UWB_RESPONDER_FINAL_TIMEOUT_US == 0) {
+        goto out;   // the anchor ranges alone (SS-TWR from the RESP)
+    }
+    if (uwb_rx_loop(CONFIG_UWB_RESPONDER_FINAL_TIMEOUT_US, uwb_take_final, NULL) != 0) {
+        res->status = UWB_RANGE_ERR_FINAL;
+        goto out;
+    }
+    rsp_stats.final_ok++;
+    res->dist_mm = uwb_twr_ds_dist_mm(&rsp_ts, rsp_final_rx);
+
+out:
+    uwb_hot_path_end(false);   // no-op unless the RESP was never scheduled
+    dwt_forcetrxoff();
+
+    const uint32_t on_us = k_cyc_to_us_floor32(k_cycle_get_32() - on_cyc);
+
+    rsp_stats.radio_on_us += on_us;
+    rsp_stats.radio_on_max_us = MAX(rsp_stats.radio_on_max_us, on_us);
+    res->cycle_us = k_cyc_to_us_floor32(k_cycle_get_32() - cyc_start);
+    return res->status;
+}
+
+void uwb_responder_get_stats(struct uwb_responder_stats *out) {
+    *out = rsp_stats;
+}
+#endif /* CONFIG_UWB_RESPONDER */
+
+#if defined(CONFIG_UWB_PEER)
+// ================= Peer mode (tag-to-tag ranging) =================
+// One window of the schedule in uwb_peer_proto.h per period. Positions inside
+// the window are DW3000 system time from its start: everything we send is a
+// delayed TX at its slot, and a beacon's offset is its on-air time, so window
+// alignment does not pick up MCU wakeup or SPI latency. The window timer
+// itself runs off the MCU clock (radio thread).
+
+BUILD_ASSERT(CONFIG_UWB_PEER_SLOT_US >= 2 * CONFIG_UWB_PEER_REPLY_DELAY_US + 1500,
+             "peer slot too short for POLL, RESP, FINAL and REPORT");
+
+#define PEER_DTU_PER_US_X10 638976ULL   // 499.2 MHz x 128
+#define PEER_TX_PREP_US     300         // stop listening this long before our own TX slot
+#define PEER_RX_MARGIN_US   1000        // on top of the reply delay when waiting for the peer
+#define PEER_SCAN_MAX_US    10000000U   // within one wrap of the 40-bit system time
+
+static struct uwb_peer_state peer;
+static struct uwb_peer_plan peer_ho;    // handover beacon for the old window
+static bool peer_ho_pending;
+static uint64_t peer_t0;                // window start, system time
+static uint32_t peer_on_cyc;
+static uint32_t peer_late;
+static uint32_t peer_on_max_us;
+static uint64_t peer_on_us;
+static int64_t peer_first_ms;
+
+/* Frames heard in one window */
+struct peer_rx {
+    uint32_t now_ms;
+    uint32_t period_us;
+    bool follow;
+    int32_t shift_us;       // latest follow wins: each is relative to our window
+};
+
+static uint32_t peer_dtu_to_us(uint64_t dtu) {
+    return (uint32_t)((dtu & UWB_TS_MASK) * 10U / PEER_DTU_PER_US_X10);
+}
+
+static uint32_t peer_elapsed_us(void) {
+    return k_cyc_to_us_floor32(k_cycle_get_32() - peer_on_cyc);
+}
+
+/* DX_TIME for a slot `at_us` into the window (low 9 bits are ignored) */
+static uint64_t peer_tx_time(uint32_t at_us) {
+    return (peer_t0 + (uint64_t)at_us * PEER_DTU_PER_US_X10 / 10U) & 0xFFFFFFFE00ULL;
+}
+
+static void peer_start(void) {
+    uint8_t id[16] = { 0 };
+    const ssize_t n = hwinfo_get_device_id(id, sizeof(id));
+    uint32_t fold = 2166136261U;
+
+    for (ssize_t i = 0; i < n; i++) {
+        fold = (fold ^ id[i]) * 16777619U;
+    }
+#if CONFIG_UWB_PEER_ADDR != 0
+    own_addr = CONFIG_UWB_PEER_ADDR;
+#else
+    // Top bit set keeps it clear of the anchors' addresses
+    own_addr = (uint16_t)(0x8000U | ((fold ^ (fold >> 16)) & 0x7FFFU));
+    if (own_addr == UWB_ADDR_BROADCAST) {
+        own_addr--;
+    }
+#endif
+    const struct uwb_peer_cfg cfg = {
+        .self = own_addr,
+        .slots = CONFIG_UWB_PEER_SLOTS,
+        .beacon_slots = CONFIG_UWB_PEER_BEACON_SLOTS,
+        .slot_us = CONFIG_UWB_PEER_SLOT_US,
+        .guard_us = CONFIG_UWB_PEER_GUARD_US,
+        .beacon_periods = CONFIG_UWB_PEER_BEACON_PERIODS,
+        .scan_periods = CONFIG_UWB_PEER_SCAN_PERIODS,
+        .range_periods = CONFIG_UWB_PEER_RANGE_PERIODS,
+        .timeout_ms = CONFIG_UWB_PEER_TIMEOUT_MS,
+    };
+
+    uwb_peer_init(&peer, &cfg, fold ^ k_cycle_get_32());
+    peer_first_ms = k_uptime_get();
+    LOG_INF("Peer mode: address 0x%04X, window %u us", own_addr, uwb_peer_window_us(&cfg));
+}
+
+static void peer_open(void) {
+    dwt_forcetrxoff();
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_TX | SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR);
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    uwb_evt_reset();
+#endif
+    // Radio on from here until peer_close()
+    peer_on_cyc = k_cycle_get_32();
+    peer_t0 = ((uint64_t)dwt_readsystimestamphi32()) << 8;
+}
+
+static uint32_t peer_close(void) {
+    dwt_forcetrxoff();
+
+    const uint32_t on_us = peer_elapsed_us();
+
+    peer_on_us += on_us;
+    peer_on_max_us = MAX(peer_on_max_us, on_us);
+    return on_us;
+}
+
+/* Beacon in the slot `at_us` into this window. Its offset is into the window
+ * `shift_us` from this one: ours, or after a handover the one we moved to.
+ * -EAGAIN if the slot was missed, -EIO if the TX never completed. */
+static int peer_send_beacon(uint32_t at_us, int32_t shift_us, uint32_t period_us,
+                            uint32_t period_ms) {
+    uint8_t frame[UWB_PEER_BEACON_LEN];
+    const uint64_t sched = peer_tx_time(at_us);
+    const uint64_t tx = (sched + (uint64_t)g_antenna_delay) & UWB_TS_MASK;
+    int64_t offset_us = ((int64_t)peer_dtu_to_us(tx - peer_t0) - shift_us) % (int64_t)period_us;
+
+    if (offset_us < 0) {
+        offset_us += period_us;
+    }
+    uwb_peer_beacon_put(frame, seq_num++, &peer, (uint16_t)MIN(period_ms, UINT16_MAX),
+                        (uint32_t)offset_us);
+
+    dwt_writetxdata(sizeof(frame), frame, 0);
+    dwt_writetxfctrl(sizeof(frame) + 2, 0, 0);
+    dwt_setdelayedtrxtime((uint32_t)(sched >> 8));
+    if (dwt_starttx(DWT_START_TX_DELAYED) != DWT_SUCCESS) {
+        return -EAGAIN;
+    }
+    return (uwb_wait_tx_done(PEER_TX_PREP_US + 2000) == 0) ? 0 : -EIO;
+}
+
+/* Anything heard in a window: beacons feed the alignment, any other frame
+ * proves its sender is in range, and a POLL for us is taken. */
+static int uwb_take_peer(const struct uwb_frame_buf *fb, void *arg) {
+    struct peer_rx *rx = arg;
+    const uint8_t *f = fb->data;
+
+    if (fb->len <= UWB_IDX_FUNC) {
+        return -1;
+    }
+    if (!uwb_frame_hdr_ok(f, fb->len)) {
+        rx_stats.rej_malformed++;
+        return -1;
+    }
+    if (f[UWB_IDX_FUNC] == FUNC_CODE_PEER_BEACON) {
+        uint16_t src, root, period_ms;
+        uint8_t hops;
+        uint32_t offset_us;
+
+        if (uwb_peer_beacon_get(f, fb->len, &src, &root, &hops, &period_ms, &offset_us) != 0) {
+            rx_stats.rej_malformed++;
+            return -1;
+        }
+        if (uwb_peer_heard(&peer, rx->now_ms, src, root, hops)) {
+            // The sender's window started offset_us before the beacon went on air
+            const int64_t start_us = (int64_t)peer_dtu_to_us(fb->ts - peer_t0) - offset_us;
+
+            rx->shift_us = uwb_peer_phase_shift(start_us, rx->period_us);
+            rx->follow = true;
+        }
+        return -1;
+    }
+    (void)uwb_peer_heard(&peer, rx->now_ms, uwb_get_u16(&f[UWB_IDX_SRC]), 0, 0);
+    return uwb_take_poll(fb, NULL);
+}
+
+/* The RESP to our POLL: the responder's POLL_RX and RESP_TX */
+static UWB_RAMFUNC int uwb_take_peer_resp(const struct uwb_frame_buf *fb, void *arg) {
+    ARG_UNUSED(arg);
+    const uint8_t *f = fb->data;
+
+    if (fb->len < UWB_RESP_LEN || f[UWB_IDX_FUNC] != FUNC_CODE_RESP) {
+        return -1;
+    }
+    if (!uwb_frame_hdr_ok(f, fb->len) ||
+        uwb_get_u16(&f[UWB_IDX_DEST]) != own_addr ||
+        uwb_get_u16(&f[UWB_IDX_SRC]) != rsp_anchor || f[UWB_IDX_SEQ] != rsp_poll_seq) {
+        rx_stats.rej_foreign++;
+        return -1;
+    }
+    rsp_ts.resp_rx = fb->ts;
+    rsp_ts.poll_rx = uwb_get_ts40(&f[UWB_IDX_PAYLOAD]);
+    rsp_ts.resp_tx = uwb_get_ts40(&f[UWB_IDX_PAYLOAD + UWB_TS_LEN]);
+
+    // From here until FINAL is scheduled: no logging
+    uwb_hot_path_begin(fb->cyc);
+    return 0;
+}
+
+/* The responder's REPORT: its DS-TWR distance */
+static int uwb_take_peer_report(const struct uwb_frame_buf *fb, void *arg) {
+    const uint8_t *f = fb->data;
+
+    if (fb->len < UWB_REPORT_LEN || f[UWB_IDX_FUNC] != FUNC_CODE_REPORT) {
+        return -1;
+    }
+    if (!uwb_frame_hdr_ok(f, fb->len) ||
+        uwb_get_u16(&f[UWB_IDX_DEST]) != own_addr ||
+        uwb_get_u16(&f[UWB_IDX_SRC]) != rsp_anchor || f[UWB_IDX_SEQ] != rsp_poll_seq) {
+        rx_stats.rej_foreign++;
+        return -1;
+    }
+    *(uint32_t *)arg = uwb_get_u32(&f[UWB_IDX_PAYLOAD]);
+    return 0;
+}
+
+/* Our exchange with `dst`, POLL in the slot `at_us` into the window. Fills *r
+ * and returns its status, -EAGAIN if the slot was missed, -EIO if a TX never
+ * completed. */
+static int peer_initiate(uint16_t dst, uint32_t at_us, struct uwb_range_result *r) {
+    uint8_t frame[UWB_FINAL_LEN];
+    const uint64_t poll_sched = peer_tx_time(at_us);
+
+    memset(&rsp_ts, 0, sizeof(rsp_ts));
+    rsp_anchor = dst;
+    rsp_poll_seq = seq_num++;
+    r->anchor = dst;
+    r->seq = rsp_poll_seq;
+    rsp_ts.poll_tx = (poll_sched + (uint64_t)g_antenna_delay) & UWB_TS_MASK;
+
+    uwb_put_hdr(frame, rsp_poll_seq, dst, FUNC_CODE_POLL);
+    dwt_writetxdata(UWB_IDX_PAYLOAD, frame, 0);
+    dwt_writetxfctrl(UWB_IDX_PAYLOAD + 2, 0, 1); // +2 FCS, ranging=1
+    dwt_setdelayedtrxtime((uint32_t)(poll_sched >> 8));
+    if (dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) != DWT_SUCCESS) {
+        return -EAGAIN;
+    }
+    if (uwb_wait_tx_done(PEER_TX_PREP_US + 2000) != 0) {
+        return -EIO;
+    }
+
+    if (uwb_rx_loop(CONFIG_UWB_PEER_REPLY_DELAY_US + PEER_RX_MARGIN_US,
+                    uwb_take_peer_resp, NULL) != 0) {
+        return r->status = UWB_RANGE_ERR_RESP;
+    }
+
+    const uint64_t final_sched = (rsp_ts.resp_rx + RESP_DLY_DTU) & 0xFFFFFFFE00ULL;
+
+    rsp_ts.final_tx = (final_sched + (uint64_t)g_antenna_delay) & UWB_TS_MASK;
+    uwb_put_hdr(frame, rsp_poll_seq, dst, FUNC_CODE_FINAL);
+    uwb_put_ts40(&frame[UWB_IDX_PAYLOAD], rsp_ts.poll_tx);
+    uwb_put_ts40(&frame[UWB_IDX_PAYLOAD + UWB_TS_LEN], rsp_ts.resp_rx);
+    uwb_put_ts40(&frame[UWB_IDX_PAYLOAD + 2 * UWB_TS_LEN], rsp_ts.final_tx);
+    dwt_writetxdata(sizeof(frame), frame, 0);
+    dwt_writetxfctrl(sizeof(frame) + 2, 0, 1);
+    dwt_setdelayedtrxtime((uint32_t)(final_sched >> 8));
+
+    // RX follows the FINAL for the responder's REPORT
+    const int tx_ret = dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED);
+    uwb_hot_path_end(tx_ret != DWT_SUCCESS);
+    if (tx_ret != DWT_SUCCESS) {
+        return r->status = UWB_RANGE_ERR_FINAL;
+    }
+    if (uwb_wait_tx_done(CONFIG_UWB_PEER_REPLY_DELAY_US + 10000) != 0) {
+        return -EIO;
+    }
+    r->dist_mm = uwb_twr_ss_dist_mm(&rsp_ts);
+
+    // No REPORT still leaves our own SS-TWR range
+    (void)uwb_rx_loop(CONFIG_UWB_PEER_REPLY_DELAY_US + PEER_RX_MARGIN_US,
+                      uwb_take_peer_report, &r->report_mm);
+    return r->status = 0;
+}
+
+/* Answer the POLL uwb_take_peer() took. Fills *r; -EIO if a TX never completed. */
+static int peer_respond(struct uwb_range_result *r, uint32_t period_ms) {
+    r->anchor = rsp_anchor;
+    r->seq = rsp_poll_seq;
+
+    if (uwb_send_resp(period_ms, peer_elapsed_us()) != 0) {
+        peer_late++;
+        return r->status = UWB_RANGE_ERR_RESP;
+    }
+    if (uwb_wait_tx_done(CONFIG_UWB_PEER_REPLY_DELAY_US + 10000) != 0) {
+        return -EIO;
+    }
+    if (uwb_rx_loop(CONFIG_UWB_PEER_REPLY_DELAY_US + PEER_RX_MARGIN_US,
+                    uwb_take_final, NULL) != 0) {
+        return r->status = UWB_RANGE_ERR_FINAL;
+    }
+    r->dist_mm = uwb_twr_ds_dist_mm(&rsp_ts, rsp_final_rx);
+
+    // The initiator listens straight after its FINAL: no slot to wait for
+    uint8_t frame[UWB_REPORT_LEN];
+
+    uwb_put_hdr(frame, rsp_poll_seq, rsp_anchor, FUNC_CODE_REPORT);
+    uwb_put_u32(&frame[UWB_IDX_PAYLOAD], r->dist_mm);
+    dwt_writetxdata(sizeof(frame), frame, 0);
+    dwt_writetxfctrl(sizeof(frame) + 2, 0, 0);
+    if (dwt_starttx(DWT_START_TX_IMMEDIATE) != DWT_SUCCESS ||
+        uwb_wait_tx_done(2000) != 0) {
+        return -EIO;
+    }
+    return r->status = 0;
+}
+
+int uwb_peer_window(struct uwb_peer_outcome *out, uint32_t period_ms) {
+    const uint32_t cyc_start = k_cycle_get_32();
+    struct uwb_peer_plan plan;
+    struct peer_rx rx = {
+        .now_ms = (uint32_t)k_uptime_get(),
+        .period_us = period_ms * 1000U,
+    };
+    bool radio_err = false;
+
+    if (peer.cfg.self == 0) {
+        peer_start();
+    }
+    memset(out, 0, sizeof(*out));
+    uwb_peer_plan(&peer, rx.now_ms, &plan);
+
+    session_cycle++;
+    if ((session_cycle % CONFIG_UWB_PEER_LOG_WINDOWS) == 0) {
+        uwb_log_rx_stats();
+        uwb_log_hot_path_stats();
+    }
+
+    // A scan listens up to the next window
+    uint32_t end_us = uwb_peer_window_us(&peer.cfg);
+
+    if (plan.scan && rx.period_us > end_us + CONFIG_UWB_PEER_GUARD_US) {
+        end_us = MIN(rx.period_us - CONFIG_UWB_PEER_GUARD_US, PEER_SCAN_MAX_US);
+    }
+
+    peer_open();
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+
+    while (!radio_err) {
+        const bool beacon_next = plan.beacon && (!plan.poll || plan.beacon_at_us <= plan.poll_at_us);
+        const bool tx_next = plan.beacon || plan.poll;
+        const uint32_t at_us = beacon_next ? plan.beacon_at_us : plan.poll ? plan.poll_at_us : end_us;
+        const uint32_t stop_us = !tx_next ? end_us : (at_us > PEER_TX_PREP_US) ? at_us - PEER_TX_PREP_US : 0;
+        const uint32_t el_us = peer_elapsed_us();
+
+        if (el_us < stop_us) {
+            if (uwb_rx_loop(stop_us - el_us, uwb_take_peer, &rx) == 0) {
+                struct uwb_range_result r = { 0 };
+
+                radio_err = (peer_respond(&r, period_ms) == -EIO);
+                uwb_hot_path_end(false);   // no-op unless the RESP was never scheduled
+                uwb_peer_ranged(&peer, r.anchor, false, r.status ? 0 : r.dist_mm);
+                if (r.status == 0 && out->n < ARRAY_SIZE(out->res)) {
+                    out->res[out->n++] = r;
+                }
+                dwt_forcetrxoff();
+                dwt_rxenable(DWT_START_RX_IMMEDIATE);
+            }
+            continue;
+        }
+        if (!tx_next) {
+            break;
+        }
+
+        int ret;
+
+        dwt_forcetrxoff();
+        if (beacon_next) {
+            plan.beacon = false;
+            ret = peer_send_beacon(at_us, 0, rx.period_us, period_ms);
+        } else {
+            struct uwb_range_result r = { 0 };
+
+            plan.poll = false;
+            ret = peer_initiate(plan.peer, at_us, &r);
+            uwb_hot_path_end(false);
+            if (ret != -EAGAIN) {
+                const uint32_t dist_mm = r.report_mm ? r.report_mm : r.dist_mm;
+
+                uwb_peer_ranged(&peer, plan.peer, true, (ret == 0) ? dist_mm : 0);
+            }
+            if (ret == 0 && out->n < ARRAY_SIZE(out->res)) {
+                out->res[out->n++] = r;
+            }
+        }
+        if (ret == -EAGAIN) {
+            peer_late++;   // still busy answering someone else's POLL
+        }
+        radio_err = (ret == -EIO);
+        dwt_forcetrxoff();
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    }
+    out->window_us = peer_close();
+
+    const uint32_t cycle_us = k_cyc_to_us_floor32(k_cycle_get_32() - cyc_start);
+
+    for (int i = 0; i < out->n; i++) {
+        out->res[i].cycle_us = cycle_us;
+    }
+
+    // Keep pace with the parent, then move onto it
+    if (rx.follow) {
+        uwb_peer_shifted(&peer, rx.now_ms, rx.shift_us);
+        out->shift_us = rx.shift_us;
+    }
+    out->period_us = uwb_peer_period_us(&peer, rx.period_us);
+    // A small move keeps the old window inside the guard: no handover needed
+    peer_ho_pending = uwb_peer_handover(&peer, &peer_ho) &&
+                      (out->shift_us > CONFIG_UWB_PEER_GUARD_US ||
+                       out->shift_us < -CONFIG_UWB_PEER_GUARD_US);
+    out->handover = peer_ho_pending;
+
+    return radio_err ? UWB_RANGE_ERR_POLL : out->n;
+}
+
+int uwb_peer_handover_tx(int32_t shift_us, uint32_t period_ms) {
+    if (!peer_ho_pending) {
+        return -ENODATA;
+    }
+    peer_ho_pending = false;
+
+    peer_open();
+    if (peer_ho.beacon_at_us > PEER_TX_PREP_US) {
+        k_usleep(peer_ho.beacon_at_us - PEER_TX_PREP_US);
+    }
+
+    const int ret = peer_send_beacon(peer_ho.beacon_at_us, shift_us, period_ms * 1000U, period_ms);
+
+    (void)peer_close();
+    if (ret == -EAGAIN) {
+        peer_late++;
+    }
+    return ret;
+}
+
+void uwb_peer_get_info(struct uwb_peer_info *out) {
+    out->self = own_addr;
+    out->root = peer.root;
+    out->hops = peer.hops;
+    out->neighbors = (uint8_t)uwb_peer_count(&peer);
+    out->rate_ppb = peer.rate_ppb;
+    out->stats = peer.stats;
+    out->late = peer_late;
+    out->radio_on_max_us = peer_on_max_us;
+    out->radio_on_us = peer_on_us;
+    out->first_ms = peer_first_ms;
+}
+#endif /* CONFIG_UWB_PEER */
+
+#if defined(CONFIG_UWB_CLOCK_SYNC)
+// ================= Clock sync role (TDoA anchor) =================
+// See uwb_clock_sync.h. The master sends its sync frame early in each window
+// as a delayed TX, so the frame can carry its own on-air timestamp. Every
+// anchor then listens for the rest of the window and reports each other frame
+// it hears (a tag's POLL is its blink) with the arrival time in the master's
+// timebase: its own timestamps on the master, converted ones on a slave.
+
+#define CS_DTU_PER_US       63898ULL
+#define CS_DTU_PER_CM       2.1314      // air, 1 cm of flight in DTU
+#define CS_TX_LEAD_US       500         // sync TX this long after the window opens
+#define CS_GUARD_US         2000        // radio off before the next window
+#define CS_RX_SLICE_US      10000       // RX loop slices: the window end can move
+#define CS_ARRIVALS         8           // reported per window, the rest counted
+
+struct cs_arrival {
+    uint16_t src;
+    uint8_t seq;
+    uint8_t func;
+    uint64_t ts;                // master timebase
+    uint32_t sigma_dtu;
+};
+
+/* One window's RX state */
+struct cs_rx {
+    uint32_t now_ms;
+    uint32_t sync_at_us;        // into the window, 0 = no sync from the preferred master
+    uint8_t n;
+    struct cs_arrival a[CS_ARRIVALS];
+};
+
+static struct uwb_cs_state cs;
+static bool cs_started;
+static uint32_t cs_on_cyc;
+static uint64_t cs_t0;
+static uint32_t cs_dropped;             // arrivals past CS_ARRIVALS in a window
+static uint32_t cs_tx_late;
+
+static uint32_t cs_elapsed_us(void) {
+    return k_cyc_to_us_floor32(k_cycle_get_32() - cs_on_cyc);
+}
+
+static void cs_start(void) {
+    const struct uwb_cs_cfg cfg = {
+        .timeout_ms = CONFIG_UWB_CLOCK_SYNC_TIMEOUT_MS,
+        .tof_dtu = CONFIG_UWB_CLOCK_SYNC_MASTER_DIST_CM * CS_DTU_PER_CM,
+    };
+
+    own_addr = CONFIG_UWB_CLOCK_SYNC_ADDR;
+    uwb_cs_init(&cs, &cfg);
+    uwb_ranging_set_period(CONFIG_UWB_CLOCK_SYNC_PERIOD_MS);
+    cs_started = true;
+    LOG_INF("Clock sync: anchor 0x%04X, %s, sync every %d ms", own_addr,
+            IS_ENABLED(CONFIG_UWB_CLOCK_SYNC_MASTER) ? "master" : "slave",
+            CONFIG_UWB_CLOCK_SYNC_PERIOD_MS);
+}
+
+/* Sync frames feed the clock models; every other frame is an arrival.
+ * Always declines, so the RX loop keeps listening to the window end. */
+static int uwb_take_cs(const struct uwb_frame_buf *fb, void *arg) {
+    struct cs_rx *rx = arg;
+    const uint8_t *f = fb->data;
+    uint16_t src;
+    uint8_t seq;
+    uint64_t tx_ts;
+    uint16_t period_ms;
+
+    if (fb->len <= UWB_IDX_FUNC || !uwb_frame_hdr_ok(f, fb->len)) {
+        rx_stats.rej_malformed++;
+        return -1;
+    }
+    if (uwb_cs_sync_get(f, fb->len, &src, &seq, &tx_ts, &period_ms) == 0) {
+        if (!IS_ENABLED(CONFIG_UWB_CLOCK_SYNC_MASTER) &&
+            uwb_cs_sync(&cs, src, seq, tx_ts, fb->ts, rx->now_ms) == 0) {
+            const struct uwb_cs_master *first = NULL;
+
+            for (int i = 0; i < UWB_CS_MASTERS; i++) {
+                if (cs.m[i].addr && (!first || cs.m[i].addr < first->addr)) {
+                    first = &cs.m[i];
+                }
+            }
+            if (first && first->addr == src) {
+                rx->sync_at_us = MAX(cs_elapsed_us(), 1U);
+            }
+        }
+        return -1;
+    }
+
+    struct cs_arrival *a = &rx->a[rx->n];
+
+    if (rx->n >= CS_ARRIVALS) {
+        cs_dropped++;
+        return -1;
+    }
+    if (IS_ENABLED(CONFIG_UWB_CLOCK_SYNC_MASTER)) {
+        // Our own clock is the timebase
+        a->ts = fb->ts;
+        a->sigma_dtu = 0;
+    } else if (uwb_cs_convert(&cs, fb->ts, rx->now_ms, &a->ts, &src, &a->sigma_dtu) != 0) {
+        return -1;
+    }
+    a->src = uwb_get_u16(&f[UWB_IDX_SRC]);
+    a->seq = f[UWB_IDX_SEQ];
+    a->func = f[UWB_IDX_FUNC];
+    rx->n++;
+    return -1;
+}
+
+/* Sync frame CS_TX_LEAD_US into the window, RX straight after it */
+static int cs_send_sync(uint32_t period_ms) {
+    const uint64_t tx_scheduled = (cs_t0 + CS_TX_LEAD_US * CS_DTU_PER_US) & 0xFFFFFFFE00ULL;
+    const uint64_t tx_ts = (tx_scheduled + (uint64_t)g_antenna_delay) & UWB_TS_MASK;
+    uint8_t frame[UWB_CS_SYNC_LEN];
+
+    uwb_cs_sync_put(frame, seq_num++, own_addr, tx_ts, (uint16_t)MIN(period_ms, UINT16_MAX));
+    dwt_writetxdata(sizeof(frame), frame, 0);
+    dwt_writetxfctrl(sizeof(frame) + 2, 0, 1); // +2 FCS, ranging=1
+    dwt_setdelayedtrxtime((uint32_t)(tx_scheduled >> 8));
+    if (dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) != DWT_SUCCESS) {
+        cs_tx_late++;
+        return -EAGAIN;
+    }
+    return (uwb_wait_tx_done(CS_TX_LEAD_US + 10000) == 0) ? 0 : -EIO;
+}
+
+static void cs_log(const struct cs_rx *rx) {
+    for (int i = 0; i < rx->n; i++) {
+        const struct cs_arrival *a = &rx->a[i];
+
+        // 40-bit master time, printed in two parts (no 64-bit printf)
+        LOG_INF("tdoa 0x%04X seq %u func 0x%02X at 0x%02X%08X (sigma %u DTU)", a->src, a->seq,
+                a->func, (uint32_t)(a->ts >> 32) & 0xFF, (uint32_t)a->ts, a->sigma_dtu);
+    }
+}
+
+static void cs_log_stats(uint32_t now_ms) {
+    uwb_log_rx_stats();
+    LOG_INF("clock sync: %u converted, %u unsynced, %u dropped, sync TX late %u, table full %u",
+            cs.stats.converted, cs.stats.unsynced, cs_dropped, cs_tx_late, cs.stats.table_full);
+    for (int i = 0; i < UWB_CS_MASTERS; i++) {
+        const struct uwb_cs_master *m = &cs.m[i];
+
+        if (m->addr == 0) {
+            continue;
+        }
+        const int32_t skew_ppb = (int32_t)(m->clk.skew * 1e9);
+        const uint32_t var_dtu2 = (uint32_t)(m->clk.P[0][0] > 0 ? m->clk.P[0][0] : 0);
+
+        LOG_INF("  master 0x%04X: %s, %u syncs (%u lost, %u rejected, %u restarts), "
+                "skew %d ppb, offset var %u DTU^2", m->addr,
+                uwb_cs_synced(m, now_ms, cs.cfg.timeout_ms) ? "synced" : "not synced",
+                m->syncs, m->lost, m->rejected, m->restarts, skew_ppb, var_dtu2);
+    }
+}
+
+int uwb_clock_sync_window(uint32_t period_ms, int32_t *shift_us, uint32_t *on_us) {
+    static struct cs_rx rx;
+    const uint32_t window_us = (period_ms * 1000U > 2 * CS_GUARD_US) ? period_ms * 1000U - CS_GUARD_US
+                                                                    : CS_GUARD_US;
+    int ret = 0;
+
+    if (!cs_started) {
+        cs_start();
+    }
+    memset(&rx, 0, sizeof(rx));
+    rx.now_ms = (uint32_t)k_uptime_get();
+    *shift_us = 0;
+
+    session_cycle++;
+    if ((session_cycle % CONFIG_UWB_CLOCK_SYNC_LOG_WINDOWS) == 0) {
+        cs_log_stats(rx.now_ms);
+    }
+
+    dwt_forcetrxoff();
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_TX | SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_ALL_RX_ERR);
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    uwb_evt_reset();
+#endif
+    // Radio on from here until the dwt_forcetrxoff() at the end
+    cs_on_cyc = k_cycle_get_32();
+    cs_t0 = ((uint64_t)dwt_readsystimestamphi32()) << 8;
+
+    if (IS_ENABLED(CONFIG_UWB_CLOCK_SYNC_MASTER)) {
+        ret = cs_send_sync(period_ms);
+        if (ret == -EAGAIN) {
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        }
+    } else {
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    }
+    // Slave: the windows run off our own MCU clock. Keep the master's sync
+    // mid-window, away from the gap between windows, as the two drift. The
+    // window grid moves by shift_us; moving it earlier ends this window early.
+    uint32_t end_us = window_us;
+    bool checked = false;
+
+    for (uint32_t el_us = cs_elapsed_us(); ret != -EIO && el_us < end_us; el_us = cs_elapsed_us()) {
+        (void)uwb_rx_loop(MIN(end_us - el_us, CS_RX_SLICE_US), uwb_take_cs, &rx);
+        if (rx.sync_at_us == 0 || checked) {
+            continue;
+        }
+        checked = true;
+
+        const int32_t off_us = (int32_t)rx.sync_at_us - (int32_t)(window_us / 2);
+
+        if (off_us > (int32_t)(window_us / 8) || off_us < -(int32_t)(window_us / 8)) {
+            *shift_us = CLAMP(off_us, -(int32_t)(window_us / 4), (int32_t)(window_us / 4));
+            end_us = (uint32_t)MIN((int32_t)window_us, (int32_t)window_us + *shift_us);
+        }
+    }
+    dwt_forcetrxoff();
+    *on_us = cs_elapsed_us();
+
+    cs_log(&rx);
+    return (ret == -EIO) ? UWB_RANGE_ERR_POLL : rx.n;
+}
+#endif /* CONFIG_UWB_CLOCK_SYNC */
+
+/* Housekeeping: DW3000 die temperature and supply voltage.
+ * Safe from any thread: only runs if the radio is idle (try-lock), so it can
+ * never delay a scheduled TX. Returns -EBUSY if the radio thread owns the chip. */
+int uwb_read_temp_vbat(int16_t *temp_cdeg, uint16_t *vbat_mv) {
+    if (dw3000_lock(K_NO_WAIT) != 0) {
+        return -EBUSY;
+    }
+    const uint16_t raw = dwt_readtempvbat();
+    dw3000_unlock();
+
+    // Zephyr LOG/CBPRINTF often has float formatting disabled: return fixed point.
+    if (temp_cdeg) {
+        *temp_cdeg = (int16_t)(dwt_convertrawtemperature((uint8_t)(raw >> 8)) * 100.0f);
+    }
+    if (vbat_mv) {
+        *vbat_mv = (uint16_t)(dwt_convertrawvoltage((uint8_t)raw) * 1000.0f);
     }
-    
     return 0;
 }
 
+#if defined(CONFIG_UWB_BEACON_TX_MODE)
 /* ============ TX BEACON TEST MODE ============ */
 int uwb_beacon_tx_mode(void) {
     uint32_t status;
@@ -821,11 +2694,12 @@ int uwb_beacon_tx_mode(void) {
     
     return 0;
 }
+#endif /* CONFIG_UWB_BEACON_TX_MODE */
 
+#if defined(CONFIG_UWB_RX_TEST_MODE)
 /* ============ RX HARDWARE TEST MODE ============ */
 int uwb_rx_test_mode(void) {
     uint32_t status;
-    uint8_t rx_buffer[128];
     uint16_t frame_len;
     uint32_t rx_count = 0;
     
@@ -845,11 +2719,13 @@ int uwb_rx_test_mode(void) {
         if (status & SYS_STATUS_RXFCG_BIT_MASK) {
             rx_count++;
             frame_len = dwt_read32bitreg(RX_FINFO_ID) & 0x3FF;
-            dwt_readrxdata(rx_buffer, (frame_len < 128 ? frame_len : 128), 0);
+            struct uwb_frame_buf *fb = uwb_frame_read(MIN(frame_len, UWB_FRAME_BUF_SIZE), 0);
             
             LOG_INF("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━");
             LOG_INF("🎉 FRAME #%u RECEIVED! (%d bytes)", rx_count, frame_len);
-            LOG_HEXDUMP_INF(rx_buffer, (frame_len < 20 ? frame_len : 20), "Data:");
+            if (fb) {
+                LOG_HEXDUMP_INF(fb->data, MIN(fb->len, 20), "Data:");
+            }
             LOG_INF("━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━");
             
             // Clear RX flag and restart
@@ -869,3 +2745,4 @@ int uwb_rx_test_mode(void) {
     
     return 0;
 }
+#endif /* CONFIG_UWB_RX_TEST_MODE */
@@ -0,0 +1,89 @@
+#ifndef UWB_FRAME_H
+#define UWB_FRAME_H
+
+#include <stdint.h>
+
+/* IEEE 802.15.4 data frame layout shared by all TWR messages:
+ * FC(2) + Seq(1) + PAN(2) + Dest(2) + Src(2) + MsgType(1) + Payload...
+ * Multi-byte fields are little endian, timestamps are 40-bit.
+ */
+#define UWB_FC_LSB          0x41
+#define UWB_FC_MSB          0x88
+#define UWB_FC_SEC          0x08        // FC bit 3: security enabled (uwb_aes.h)
+#define UWB_PAN_ID          0xDECA
+#define UWB_TAG_ADDR        0x0001
+#define UWB_ADDR_BROADCAST  0xFFFF
+
+#define UWB_IDX_SEQ         2
+#define UWB_IDX_PAN         3
+#define UWB_IDX_DEST        5
+#define UWB_IDX_SRC         7
+#define UWB_IDX_FUNC        9
+#define UWB_IDX_PAYLOAD     10
+
+#define UWB_TS_LEN          5
+#define UWB_TS_MASK         0xFFFFFFFFFFULL
+
+/* TWR Frame Types */
+#define FUNC_CODE_POLL   0x61
+#define FUNC_CODE_RESP   0x50
+#define FUNC_CODE_FINAL  0x23
+
+/* Optional: ANCHOR -> TAG report with computed distance */
+#define FUNC_CODE_REPORT 0x44
+
+/* Responder mode (CONFIG_UWB_RESPONDER): TAG -> broadcast listen window
+ * announcement, payload period_ms(2) window_us(2) */
+#define FUNC_CODE_WINDOW 0x57
+
+/* Minimum on-air lengths (without FCS) */
+#define UWB_RESP_LEN        (UWB_IDX_PAYLOAD + 2 * UWB_TS_LEN)  // POLL_RX + RESP_TX
+#define UWB_REPORT_LEN      (UWB_IDX_PAYLOAD + 4)               // dist_mm (u32)
+#define UWB_FINAL_LEN       (UWB_IDX_PAYLOAD + 3 * UWB_TS_LEN)  // POLL_TX + RESP_RX + FINAL_TX
+#define UWB_WINDOW_LEN      (UWB_IDX_PAYLOAD + 4)               // period_ms + window_us
+// Responder RESP: the tag's schedule after the timestamps, period_ms(2) and
+// offset_us(2) of the POLL into the window, so the anchor can find the next one
+#define UWB_RESP_SCHED_LEN  (UWB_RESP_LEN + 4)
+
+static inline uint16_t uwb_get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static inline uint32_t uwb_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t uwb_get_ts40(const uint8_t *p) {
+    uint64_t ts = 0;
+    for (int i = 0; i < UWB_TS_LEN; i++) {
+        ts |= ((uint64_t)p[i]) << (i * 8);
+    }
+    return ts;
+}
+
+static inline void uwb_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void uwb_put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static inline void uwb_put_ts40(uint8_t *p, uint64_t ts) {
+    for (int i = 0; i < UWB_TS_LEN; i++) {
+        p[i] = (uint8_t)(ts >> (8 * i));
+    }
+}
+
+/* Header sanity: data frame, short addressing, our PAN (secured or not) */
+static inline int uwb_frame_hdr_ok(const uint8_t *f, uint16_t len) {
+    return len > UWB_IDX_FUNC &&
+           (f[0] & ~UWB_FC_SEC) == UWB_FC_LSB && f[1] == UWB_FC_MSB &&
+           uwb_get_u16(&f[UWB_IDX_PAN]) == UWB_PAN_ID;
+}
+
+#endif /* UWB_FRAME_H */
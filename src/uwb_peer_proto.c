@@ -0,0 +1,345 @@
+#include <string.h>
+#include "uwb_peer_proto.h"
+
+/* Peer mode schedule and neighbor table (see uwb_peer_proto.h). No RTOS
+ * dependencies: also built into the host simulator. */
+
+static uint32_t rnd(struct uwb_peer_state *st, uint32_t n) {
+    // xorshift32: cheap, and each tag's sequence differs by its seed
+    uint32_t x = st->rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    st->rng = x;
+    return n ? x % n : 0;
+}
+
+// N/2 .. 3N/2 windows, so tags started together drift apart
+static uint32_t jitter(struct uwb_peer_state *st, uint16_t n) {
+    const uint32_t j = n / 2U + rnd(st, n ? n : 1);
+
+    return j ? j : 1;
+}
+
+void uwb_peer_init(struct uwb_peer_state *st, const struct uwb_peer_cfg *cfg, uint32_t seed) {
+    memset(st, 0, sizeof(*st));
+    st->cfg = *cfg;
+    if (st->cfg.slots == 0) {
+        st->cfg.slots = 1;
+    }
+    if (st->cfg.beacon_slots == 0) {
+        st->cfg.beacon_slots = 1;
+    }
+    st->root = cfg->self;
+    st->rng = seed ? seed : 0x9E3779B9U;
+    st->next_scan = 1;     // look for an existing cluster first
+}
+
+static void forget_parent(struct uwb_peer_state *st, uint32_t now_ms) {
+    st->lost_root = st->root;
+    st->lost_until_ms = now_ms + st->cfg.timeout_ms;
+    st->root = st->cfg.self;
+    st->parent = 0;
+    st->hops = 0;
+    st->rate_ppb = 0;           // we are the reference now
+    st->shifted_ms = 0;
+    st->next_scan = st->window; // find out where the others went
+    st->stats.root_changes++;
+}
+
+static void expire(struct uwb_peer_state *st, uint32_t now_ms) {
+    bool lost = false;
+
+    for (int i = 0; i < UWB_PEER_NEIGHBORS; i++) {
+        struct uwb_peer_nbr *nb = &st->nbr[i];
+
+        if (nb->addr && (uint32_t)(now_ms - nb->heard_ms) > st->cfg.timeout_ms) {
+            if (nb->addr == st->parent) {
+                forget_parent(st, now_ms);
+            }
+            memset(nb, 0, sizeof(*nb));
+            lost = true;
+        }
+    }
+    if (lost && uwb_peer_count(st) == 0) {
+        st->next_scan = st->window;
+    }
+    if (st->lost_root && (int32_t)(now_ms - st->lost_until_ms) >= 0) {
+        st->lost_root = 0;
+    }
+}
+
+int uwb_peer_count(const struct uwb_peer_state *st) {
+    int n = 0;
+
+    for (int i = 0; i < UWB_PEER_NEIGHBORS; i++) {
+        n += st->nbr[i].addr != 0;
+    }
+    return n;
+}
+
+const struct uwb_peer_nbr *uwb_peer_find(const struct uwb_peer_state *st, uint16_t addr) {
+    for (int i = 0; i < UWB_PEER_NEIGHBORS; i++) {
+        if (addr && st->nbr[i].addr == addr) {
+            return &st->nbr[i];
+        }
+    }
+    return NULL;
+}
+
+/* The neighbor due for ranging longest, among those in our windows */
+static const struct uwb_peer_nbr *pick_peer(const struct uwb_peer_state *st) {
+    const struct uwb_peer_nbr *best = NULL;
+
+    for (int i = 0; i < UWB_PEER_NEIGHBORS; i++) {
+        const struct uwb_peer_nbr *nb = &st->nbr[i];
+
+        // Only a neighbor that beaconed our root shares our window
+        if (!nb->addr || nb->root != st->root) {
+            continue;
+        }
+        if (nb->ranged && st->window - nb->ranged < st->cfg.range_periods) {
+            continue;
+        }
+        if (!best || nb->ranged < best->ranged) {
+            best = nb;
+        }
+    }
+    return best;
+}
+
+uint32_t uwb_peer_window_us(const struct uwb_peer_cfg *cfg) {
+    return 2U * cfg->guard_us + (uint32_t)cfg->beacon_slots * UWB_PEER_BEACON_SLOT_US +
+           (uint32_t)cfg->slots * cfg->slot_us;
+}
+
+static void plan_beacon(struct uwb_peer_state *st, struct uwb_peer_plan *out) {
+    out->beacon = true;
+    out->beacon_at_us = st->cfg.guard_us +
+                        rnd(st, st->cfg.beacon_slots) * UWB_PEER_BEACON_SLOT_US;
+    st->stats.beacons_tx++;
+}
+
+void uwb_peer_plan(struct uwb_peer_state *st, uint32_t now_ms, struct uwb_peer_plan *out) {
+    memset(out, 0, sizeof(*out));
+    st->window++;
+    st->stats.windows++;
+    expire(st, now_ms);
+
+    if (st->window >= st->next_scan) {
+        out->scan = true;
+        st->next_scan = st->window + jitter(st, st->cfg.scan_periods);
+        st->stats.scans++;
+    }
+
+    // A root (or a lone tag) beacons every window: its followers track it and
+    // a scanning tag finds it within one period
+    if (st->root == st->cfg.self || st->window >= st->next_beacon) {
+        plan_beacon(st, out);
+        st->next_beacon = st->window + jitter(st, st->cfg.beacon_periods);
+    }
+
+    const int n = uwb_peer_count(st);
+    const struct uwb_peer_nbr *due = pick_peer(st);
+
+    // Contend with probability slots / (n + 1): about one sender per slot
+    if (!due || rnd(st, (uint32_t)n + 1U) >= st->cfg.slots) {
+        return;
+    }
+    out->poll = true;
+    out->peer = due->addr;
+    out->poll_at_us = st->cfg.guard_us +
+                      (uint32_t)st->cfg.beacon_slots * UWB_PEER_BEACON_SLOT_US +
+                      rnd(st, st->cfg.slots) * st->cfg.slot_us;
+    st->stats.polls_tx++;
+}
+
+bool uwb_peer_handover(struct uwb_peer_state *st, struct uwb_peer_plan *out) {
+    if (!st->moved) {
+        return false;
+    }
+    st->moved = false;
+    memset(out, 0, sizeof(*out));
+    plan_beacon(st, out);
+    return true;
+}
+
+/* Find `addr`, or make room for it: a free entry, else the least recently
+ * heard one that is not our parent, if it has been quiet for half the
+ * timeout. A full table of live neighbors keeps its members. */
+static struct uwb_peer_nbr *nbr_get(struct uwb_peer_state *st, uint32_t now_ms, uint16_t addr) {
+    struct uwb_peer_nbr *free_nb = NULL;
+    struct uwb_peer_nbr *oldest = NULL;
+
+    for (int i = 0; i < UWB_PEER_NEIGHBORS; i++) {
+        struct uwb_peer_nbr *nb = &st->nbr[i];
+
+        if (nb->addr == addr) {
+            return nb;
+        }
+        if (!nb->addr) {
+            free_nb = free_nb ? free_nb : nb;
+        } else if (nb->addr != st->parent &&
+                   (!oldest || (int32_t)(nb->heard_ms - oldest->heard_ms) < 0)) {
+            oldest = nb;
+        }
+    }
+
+    struct uwb_peer_nbr *nb = free_nb;
+
+    if (!nb) {
+        st->stats.table_full++;
+        if (!oldest || (uint32_t)(now_ms - oldest->heard_ms) < st->cfg.timeout_ms / 2U) {
+            return NULL;
+        }
+        nb = oldest;
+    }
+    memset(nb, 0, sizeof(*nb));
+    nb->addr = addr;
+    return nb;
+}
+
+static void follow(struct uwb_peer_state *st, uint16_t src, uint16_t root, uint8_t hops) {
+    if (root != st->root || src != st->parent) {
+        st->moved = true;
+        st->shifted_ms = 0;
+    }
+    if (root != st->root) {
+        st->root = root;
+        st->stats.root_changes++;
+    }
+    st->parent = src;
+    st->hops = (uint8_t)(hops + 1U);
+    st->stats.follows++;
+}
+
+bool uwb_peer_heard(struct uwb_peer_state *st, uint32_t now_ms, uint16_t src, uint16_t root,
+                    uint8_t hops) {
+    if (src == 0 || src == UWB_ADDR_BROADCAST || src == st->cfg.self) {
+        return false;
+    }
+    struct uwb_peer_nbr *nb = nbr_get(st, now_ms, src);
+
+    if (!nb) {
+        return false;
+    }
+    nb->heard_ms = now_ms;
+    if (!root) {
+        return false;
+    }
+    nb->root = root;
+    nb->hops = hops;
+    st->stats.beacons_rx++;
+
+    if (src == st->parent) {
+        // The parent's root moved (it lost or found one): follow it, unless
+        // we are now the lowest address ourselves or it is caught in a loop
+        if (root > st->cfg.self || hops >= UWB_PEER_MAX_HOPS) {
+            forget_parent(st, now_ms);
+            return false;
+        }
+        follow(st, src, root, hops);    // also tracks the parent's clock drift
+        return true;
+    }
+    if (root == st->lost_root || hops >= UWB_PEER_MAX_HOPS) {
+        return false;
+    }
+    if (root < st->root || (root == st->root && st->parent && hops + 1U < st->hops)) {
+        follow(st, src, root, hops);
+        return true;
+    }
+    return false;
+}
+
+void uwb_peer_ranged(struct uwb_peer_state *st, uint16_t peer, bool initiator, uint32_t dist_mm) {
+    struct uwb_peer_nbr *nb = (struct uwb_peer_nbr *)uwb_peer_find(st, peer);
+
+    if (!nb) {
+        return;
+    }
+    if (dist_mm == 0) {
+        if (initiator) {
+            nb->fail++;
+        }
+        return;
+    }
+    nb->ranged = st->window;
+    nb->dist_mm = dist_mm;
+    nb->ok++;
+    if (initiator) {
+        st->stats.ranged_init++;
+    } else {
+        st->stats.ranged_resp++;
+    }
+}
+
+void uwb_peer_beacon_put(uint8_t *f, uint8_t seq, const struct uwb_peer_state *st,
+                         uint16_t period_ms, uint32_t offset_us) {
+    f[0] = UWB_FC_LSB;
+    f[1] = UWB_FC_MSB;
+    f[UWB_IDX_SEQ] = seq;
+    uwb_put_u16(&f[UWB_IDX_PAN], UWB_PAN_ID);
+    uwb_put_u16(&f[UWB_IDX_DEST], UWB_ADDR_BROADCAST);
+    uwb_put_u16(&f[UWB_IDX_SRC], st->cfg.self);
+    f[UWB_IDX_FUNC] = FUNC_CODE_PEER_BEACON;
+    uwb_put_u16(&f[UWB_IDX_PAYLOAD], st->root);
+    f[UWB_IDX_PAYLOAD + 2] = st->hops;
+    f[UWB_IDX_PAYLOAD + 3] = (uint8_t)uwb_peer_count(st);
+    uwb_put_u16(&f[UWB_IDX_PAYLOAD + 4], period_ms);
+    uwb_put_u32(&f[UWB_IDX_PAYLOAD + 6], offset_us);
+}
+
+int uwb_peer_beacon_get(const uint8_t *f, uint16_t len, uint16_t *src, uint16_t *root,
+                        uint8_t *hops, uint16_t *period_ms, uint32_t *offset_us) {
+    if (len < UWB_PEER_BEACON_LEN || !uwb_frame_hdr_ok(f, len) ||
+        f[UWB_IDX_FUNC] != FUNC_CODE_PEER_BEACON) {
+        return -1;
+    }
+    *src = uwb_get_u16(&f[UWB_IDX_SRC]);
+    *root = uwb_get_u16(&f[UWB_IDX_PAYLOAD]);
+    *hops = f[UWB_IDX_PAYLOAD + 2];
+    *period_ms = uwb_get_u16(&f[UWB_IDX_PAYLOAD + 4]);
+    *offset_us = uwb_get_u32(&f[UWB_IDX_PAYLOAD + 6]);
+    return (*root != 0 && *period_ms != 0) ? 0 : -1;
+}
+
+// Rate updates: half the measured error, from shifts small enough to be drift
+#define RATE_MAX_SHIFT_US   5000
+#define RATE_MIN_GAP_MS     2000
+#define RATE_MAX_PPB        200000
+
+void uwb_peer_shifted(struct uwb_peer_state *st, uint32_t now_ms, int32_t shift_us) {
+    const uint32_t gap_ms = now_ms - st->shifted_ms;
+
+    if (st->shifted_ms && gap_ms < RATE_MIN_GAP_MS) {
+        return;                 // keep the older reference point
+    }
+    if (st->shifted_ms && shift_us > -RATE_MAX_SHIFT_US && shift_us < RATE_MAX_SHIFT_US) {
+        // Parent's window started shift_us later: our periods are too short
+        int64_t r = st->rate_ppb + (int64_t)shift_us * 1000000 / (int64_t)gap_ms / 2;
+
+        r = (r > RATE_MAX_PPB) ? RATE_MAX_PPB : (r < -RATE_MAX_PPB) ? -RATE_MAX_PPB : r;
+        st->rate_ppb = (int32_t)r;
+    }
+    st->shifted_ms = now_ms ? now_ms : 1;
+}
+
+uint32_t uwb_peer_period_us(const struct uwb_peer_state *st, uint32_t period_us) {
+    return (uint32_t)((int64_t)period_us + (int64_t)period_us * st->rate_ppb / 1000000000);
+}
+
+int32_t uwb_peer_phase_shift(int64_t start_us, uint32_t period_us) {
+    if (period_us == 0) {
+        return 0;
+    }
+    int64_t m = start_us % (int64_t)period_us;
+
+    if (m < 0) {
+        m += period_us;
+    }
+    if (m > (int64_t)(period_us / 2U)) {
+        m -= period_us;
+    }
+    return (int32_t)m;
+}
@@ -0,0 +1,156 @@
+#ifndef UWB_PEER_PROTO_H
+#define UWB_PEER_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uwb_frame.h"
+
+/* Tag-to-tag ranging (CONFIG_UWB_PEER): neighbor table, slot planning and
+ * window alignment. Plain C: shared by the firmware (uwb_driver_qorvo.c) and
+ * the multi-tag simulator (host/peer).
+ *
+ * Every tag runs the same schedule: one window per period,
+ *
+ *   guard | beacon_slots x UWB_PEER_BEACON_SLOT_US | slots x slot_us | guard
+ *
+ * and listens through it except where it transmits. Discovery beacons go in
+ * a random beacon slot: every window for a root (below), about every
+ * beacon_periods windows otherwise. An exchange (POLL/RESP/FINAL from
+ * uwb_frame.h, then a REPORT with the responder's DS-TWR distance) goes in a
+ * random exchange slot, and a tag only takes one with probability
+ * slots / (neighbors + 1), so a crowd of tags shares the slots like slotted
+ * ALOHA at its best load. Radio-on time per period is one window, plus a
+ * scan (listen up to the next window) every ~scan_periods windows.
+ *
+ * Windows are aligned without a coordinator. Each tag follows the lowest
+ * address it knows of (its root): a beacon carries the sender's root, its hop
+ * count from the root and the sender's offset into its window. A tag that
+ * hears a lower root, a shorter path to its root, or its parent (the neighbor
+ * it took the root from), moves its window onto the sender's. Clusters that
+ * meet merge onto the lower root. If the parent goes silent, the tag becomes
+ * its own root again and ignores the lost root for one neighbor timeout; a
+ * parent whose hop count climbs past UWB_PEER_MAX_HOPS is dropped the same
+ * way, so stale roots cannot circulate in a loop. A tag that moved sends one
+ * handover beacon in its old window, with its offset into the new one, so
+ * the tags following it move along instead of timing out. Between beacons a
+ * tag keeps pace with its parent by scaling its period with the rate learned
+ * from successive shifts (the window timer runs off the MCU clock, not the
+ * radio's, so the radio's clock offset estimate does not apply).
+ *
+ * Beacon, little endian: header (dest broadcast, FUNC_CODE_PEER_BEACON),
+ *   root(2) hops(1) neighbors(1) period_ms(2) offset_us(4)
+ */
+
+#define FUNC_CODE_PEER_BEACON   0x42
+#define UWB_PEER_BEACON_LEN     (UWB_IDX_PAYLOAD + 10)
+#define UWB_PEER_BEACON_SLOT_US 400
+#define UWB_PEER_MAX_HOPS       15
+
+#ifndef UWB_PEER_NEIGHBORS
+#define UWB_PEER_NEIGHBORS      64
+#endif
+
+struct uwb_peer_cfg {
+    uint16_t self;              // own short address
+    uint8_t slots;              // exchange slots per window
+    uint8_t beacon_slots;       // beacon slots per window
+    uint16_t slot_us;
+    uint16_t guard_us;
+    uint16_t beacon_periods;    // beacon about every N windows (jittered)
+    uint16_t scan_periods;      // scan about every N windows (jittered)
+    uint16_t range_periods;     // range a neighbor again after N windows
+    uint32_t timeout_ms;        // forget a neighbor not heard for this long
+};
+
+struct uwb_peer_nbr {
+    uint16_t addr;              // 0 = free
+    uint16_t root;              // root it follows (0 = not heard in a beacon)
+    uint8_t hops;               // its hop count from that root
+    uint32_t heard_ms;          // last frame from it
+    uint32_t ranged;            // window of the last exchange (either side started it)
+    uint32_t dist_mm;           // last distance (0 = none)
+    uint16_t ok;
+    uint16_t fail;              // exchanges we started that did not complete
+};
+
+struct uwb_peer_plan {
+    bool scan;                  // keep listening up to the next window
+    bool beacon;
+    bool poll;
+    uint16_t peer;              // POLL target
+    uint32_t beacon_at_us;      // TX offsets into the window
+    uint32_t poll_at_us;
+};
+
+struct uwb_peer_stats {
+    uint32_t windows;
+    uint32_t scans;
+    uint32_t beacons_tx;
+    uint32_t beacons_rx;
+    uint32_t polls_tx;          // exchanges started
+    uint32_t ranged_init;       // ... completed
+    uint32_t ranged_resp;       // exchanges completed as responder
+    uint32_t follows;           // window moved onto a neighbor's
+    uint32_t root_changes;
+    uint32_t table_full;        // unknown sender while the table was full
+};
+
+struct uwb_peer_state {
+    struct uwb_peer_cfg cfg;
+    uint16_t root;              // lowest address followed (self = own root)
+    uint16_t parent;            // neighbor our window follows (0 = none)
+    uint8_t hops;               // 0 = we are the root
+    bool moved;                 // handover beacon pending
+    uint16_t lost_root;         // ignored until lost_until_ms
+    uint32_t lost_until_ms;
+    int32_t rate_ppb;           // period correction to keep pace with the parent
+    uint32_t shifted_ms;        // last shift onto the parent (0 = none yet)
+    uint32_t window;            // windows planned so far
+    uint32_t next_beacon;
+    uint32_t next_scan;
+    uint32_t rng;
+    struct uwb_peer_nbr nbr[UWB_PEER_NEIGHBORS];
+    struct uwb_peer_stats stats;
+};
+
+void uwb_peer_init(struct uwb_peer_state *st, const struct uwb_peer_cfg *cfg, uint32_t seed);
+
+/* Window length (us) for this configuration */
+uint32_t uwb_peer_window_us(const struct uwb_peer_cfg *cfg);
+
+/* Start of a window: expire neighbors and decide what to do in it. */
+void uwb_peer_plan(struct uwb_peer_state *st, uint32_t now_ms, struct uwb_peer_plan *out);
+
+/* After a follow that moved our window: the handover beacon to send in the
+ * old window (see above). Returns false if none is pending. */
+bool uwb_peer_handover(struct uwb_peer_state *st, struct uwb_peer_plan *out);
+
+/* A frame from `src`. For a beacon, `root` and `hops` are the sender's
+ * (root 0 for any other frame). Returns true if our window should be moved
+ * onto the sender's. */
+bool uwb_peer_heard(struct uwb_peer_state *st, uint32_t now_ms, uint16_t src, uint16_t root,
+                    uint8_t hops);
+
+/* An exchange with `peer` ended. dist_mm = 0 if it did not complete. */
+void uwb_peer_ranged(struct uwb_peer_state *st, uint16_t peer, bool initiator, uint32_t dist_mm);
+
+/* Our window was moved by `shift_us` onto the parent's: learns the rate. */
+void uwb_peer_shifted(struct uwb_peer_state *st, uint32_t now_ms, int32_t shift_us);
+
+/* Nominal period corrected by the learned rate */
+uint32_t uwb_peer_period_us(const struct uwb_peer_state *st, uint32_t period_us);
+
+int uwb_peer_count(const struct uwb_peer_state *st);
+const struct uwb_peer_nbr *uwb_peer_find(const struct uwb_peer_state *st, uint16_t addr);
+
+/* Beacon frame (UWB_PEER_BEACON_LEN bytes) and its parser (0 or -1). */
+void uwb_peer_beacon_put(uint8_t *f, uint8_t seq, const struct uwb_peer_state *st,
+                         uint16_t period_ms, uint32_t offset_us);
+int uwb_peer_beacon_get(const uint8_t *f, uint16_t len, uint16_t *src, uint16_t *root,
+                        uint8_t *hops, uint16_t *period_ms, uint32_t *offset_us);
+
+/* Shortest move (us) that puts our window start onto a window that starts
+ * `start_us` after ours, modulo the period: in (-period/2, period/2]. */
+int32_t uwb_peer_phase_shift(int64_t start_us, uint32_t period_us);
+
+#endif /* UWB_PEER_PROTO_H */
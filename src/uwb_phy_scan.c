@@ -0,0 +1,111 @@
+#include <string.h>
+#include "uwb_phy_scan.h"
+
+/* Channel / preamble code discovery scan (see uwb_phy_scan.h). No RTOS
+ * dependencies. */
+
+static void add(struct uwb_phy_scan *st, uint8_t chan, uint8_t code) {
+    for (int i = 0; i < st->n; i++) {
+        if (st->cand[i].chan == chan && st->cand[i].code == code) {
+            return;
+        }
+    }
+    if (st->n < UWB_PHY_SCAN_MAX) {
+        st->cand[st->n].chan = chan;
+        st->cand[st->n].code = code;
+        st->n++;
+    }
+}
+
+// Home first, then the rest of its channel, then the other channels
+static void order(struct uwb_phy_scan *st) {
+    st->n = 0;
+    add(st, st->home.chan, st->home.code);
+    for (int code = 1; code < 32; code++) {
+        if (st->cfg.code_mask & (1UL << code)) {
+            add(st, st->home.chan, (uint8_t)code);
+        }
+    }
+    for (int chan = 1; chan < 16; chan++) {
+        if (chan == st->home.chan || !(st->cfg.chan_mask & (1U << chan))) {
+            continue;
+        }
+        for (int code = 1; code < 32; code++) {
+            if (st->cfg.code_mask & (1UL << code)) {
+                add(st, (uint8_t)chan, (uint8_t)code);
+            }
+        }
+    }
+    st->pos = 0;
+}
+
+static void unlock(struct uwb_phy_scan *st) {
+    st->locked = false;
+    st->misses = 0;
+    st->idle = 0;
+    st->backoff = st->cfg.backoff;
+    st->probes = 0;
+    order(st);
+}
+
+void uwb_phy_scan_init(struct uwb_phy_scan *st, const struct uwb_phy_scan_cfg *cfg,
+                       const struct uwb_phy *home) {
+    memset(st, 0, sizeof(*st));
+    st->cfg = *cfg;
+    if (st->cfg.per_cycle == 0) {
+        st->cfg.per_cycle = 1;
+    }
+    if (st->cfg.lost_cycles == 0) {
+        st->cfg.lost_cycles = 1;
+    }
+    if (st->cfg.backoff_max < st->cfg.backoff) {
+        st->cfg.backoff_max = st->cfg.backoff;
+    }
+    st->home = *home;
+    unlock(st);
+}
+
+bool uwb_phy_scan_next(struct uwb_phy_scan *st, struct uwb_phy *out) {
+    if (st->idle > 0) {
+        st->idle--;
+        st->stats.idle++;
+        return false;
+    }
+    if (st->pos >= st->n) {
+        // Nothing anywhere: wait longer before each new sweep
+        st->stats.sweeps++;
+        st->pos = 0;
+        st->idle = st->backoff;
+        st->backoff = (st->backoff > st->cfg.backoff_max / 2U) ? st->cfg.backoff_max
+                                                               : (uint16_t)(st->backoff * 2U);
+        return false;
+    }
+    *out = st->cand[st->pos++];
+    st->probes++;
+    st->stats.probes++;
+    return true;
+}
+
+void uwb_phy_scan_found(struct uwb_phy_scan *st, const struct uwb_phy *phy) {
+    st->home = *phy;
+    st->locked = true;
+    st->misses = 0;
+    st->stats.locks++;
+    st->stats.lock_probes = st->probes;
+}
+
+bool uwb_phy_scan_cycle(struct uwb_phy_scan *st, bool heard) {
+    if (!st->locked) {
+        return false;
+    }
+    if (heard) {
+        st->misses = 0;
+        return false;
+    }
+    if (++st->misses < st->cfg.lost_cycles) {
+        return false;
+    }
+    st->stats.losses++;
+    unlock(st);
+    return true;
+}
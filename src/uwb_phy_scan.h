@@ -0,0 +1,78 @@
+#ifndef UWB_PHY_SCAN_H
+#define UWB_PHY_SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Channel / preamble code discovery scan (CONFIG_UWB_PHY_SCAN). Plain C, no
+ * Zephyr dependencies: decides which PHY the driver probes next.
+ *
+ * A candidate is a (channel, preamble code) pair from the configured masks.
+ * While unlocked, the tag spends each ranging cycle on up to `per_cycle`
+ * probes instead: a broadcast POLL on the candidate PHY and a short receive
+ * window, cut short by the preamble-detect timeout when nothing is on air.
+ * The first candidate on which a frame of our network (PAN id) is heard wins
+ * and the tag ranges there. Candidates go in order: the PHY last locked onto
+ * (the compiled-in one after boot), the other codes on its channel, then the
+ * other channels, so a tag in a known site locks on its first probe. A sweep
+ * that finds nothing is followed by `backoff` idle cycles, doubled for every
+ * further empty sweep up to `backoff_max`, so a tag out of coverage spends
+ * little energy. Once locked, `lost_cycles` cycles in a row without an anchor
+ * answering unlock it, and scanning starts again from the PHY just lost.
+ */
+
+#define UWB_PHY_SCAN_MAX        16
+
+struct uwb_phy {
+    uint8_t chan;
+    uint8_t code;               // TX and RX preamble code
+};
+
+struct uwb_phy_scan_cfg {
+    uint16_t chan_mask;         // bit n = channel n
+    uint32_t code_mask;         // bit n = preamble code n
+    uint8_t per_cycle;          // probes per unlocked cycle
+    uint16_t lost_cycles;       // cycles without an anchor before rescanning
+    uint16_t backoff;           // idle cycles after the first empty sweep
+    uint16_t backoff_max;
+};
+
+struct uwb_phy_scan_stats {
+    uint32_t probes;
+    uint32_t sweeps;            // full sweeps that found nothing
+    uint32_t idle;              // unlocked cycles spent backing off
+    uint32_t locks;
+    uint32_t losses;
+    uint32_t lock_probes;       // probes it took to find the current PHY
+};
+
+struct uwb_phy_scan {
+    struct uwb_phy_scan_cfg cfg;
+    struct uwb_phy cand[UWB_PHY_SCAN_MAX];
+    uint8_t n;
+    uint8_t pos;                // next candidate of the current sweep
+    bool locked;
+    struct uwb_phy home;        // locked / last locked PHY
+    uint16_t misses;            // locked cycles in a row without an anchor
+    uint16_t backoff;           // idle cycles after the next empty sweep
+    uint16_t idle;              // idle cycles left
+    uint32_t probes;            // since unlocked
+    struct uwb_phy_scan_stats stats;
+};
+
+/* Starts unlocked, with `home` (the compiled-in PHY) first in line. */
+void uwb_phy_scan_init(struct uwb_phy_scan *st, const struct uwb_phy_scan_cfg *cfg,
+                       const struct uwb_phy *home);
+
+/* Unlocked: the next candidate to probe. Returns false when this cycle has no
+ * more probes: the sweep ended empty (backoff starts) or it is backing off. */
+bool uwb_phy_scan_next(struct uwb_phy_scan *st, struct uwb_phy *out);
+
+/* A frame of our network was heard on `phy`: lock onto it. */
+void uwb_phy_scan_found(struct uwb_phy_scan *st, const struct uwb_phy *phy);
+
+/* Locked: outcome of a ranging cycle (an anchor answered or not). Returns
+ * true when the lock is lost and scanning starts again. */
+bool uwb_phy_scan_cycle(struct uwb_phy_scan *st, bool heard);
+
+#endif /* UWB_PHY_SCAN_H */
@@ -0,0 +1,271 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "platform_port.h"
+#include "uwb_radio_events.h"
+#include "uwb_spsc.h"
+#include "uwb_frame.h"
+
+LOG_MODULE_REGISTER(uwb_events, LOG_LEVEL_INF);
+
+/* IRQ flow (SPI cannot be used from a Zephyr ISR):
+ *   DW3000 IRQ (level) -> GPIO ISR masks the line, wakes dw_irq thread
+ *   dw_irq thread (cooperative, highest prio) -> dwt_isr() -> callbacks
+ *   callbacks capture status/timestamp/length -> SPSC ring -> radio thread
+ * The ring is the only shared state: no locks, no allocation. The dw_irq
+ * thread runs to completion before the radio thread is scheduled again, so
+ * dwt_isr() never interleaves with a radio-thread register sequence.
+ *
+ * With CONFIG_UWB_IRQ_TRANSPORT_PPI the status burst has already been fetched
+ * by hardware when the thread wakes; TX/RX events are decoded from it and
+ * dwt_isr() only runs for whatever else is still pending.
+ */
+
+UWB_SPSC_DEFINE(evt_ring, struct uwb_radio_event, CONFIG_UWB_EVENT_RING_SIZE);
+static K_SEM_DEFINE(irq_sem, 0, 1);     // GPIO ISR -> dw_irq thread
+static K_SEM_DEFINE(evt_sem, 0, 1);     // dw_irq thread -> radio thread
+
+static atomic_t produced;
+static uint32_t wakes;
+static uint32_t max_batch;
+static uint32_t prefetched;
+
+#if defined(CONFIG_UWB_IRQ_LATENCY_STATS)
+static uint32_t lat_count;
+static uint64_t lat_sum_us;
+static uint32_t lat_max_us;
+
+/* RMARKER (RX_TIME) -> status in hand. SYS_TIME hi32 ticks are 256 DTU. */
+static void lat_sample(uint64_t rx_ts) {
+    const uint32_t ticks = dwt_readsystimestamphi32() - (uint32_t)(rx_ts >> 8);
+    const uint32_t us = (uint32_t)(((uint64_t)ticks * 256U) / 63898U);
+
+    lat_count++;
+    lat_sum_us += us;
+    lat_max_us = MAX(lat_max_us, us);
+}
+#else
+static inline void lat_sample(uint64_t rx_ts) {
+    ARG_UNUSED(rx_ts);
+}
+#endif
+
+static void evt_push(uint8_t type, const dwt_cb_data_t *cb, uint64_t ts) {
+    const struct uwb_radio_event ev = {
+        .type = type,
+        .rx_flags = cb->rx_flags,
+        .len = cb->datalength,
+        .status = cb->status,
+        .ts = ts,
+        .cyc = k_cycle_get_32(),
+    };
+
+    if (uwb_spsc_put(&evt_ring, &ev)) {
+        atomic_inc(&produced);
+    }
+}
+
+static uint64_t ts_read(void (*reader)(uint8_t *)) {
+    uint8_t ts_tab[5];
+    reader(ts_tab);
+    return ((uint64_t)ts_tab[0]) | (((uint64_t)ts_tab[1]) << 8) | (((uint64_t)ts_tab[2]) << 16) |
+           (((uint64_t)ts_tab[3]) << 24) | (((uint64_t)ts_tab[4]) << 32);
+}
+
+static void cb_tx_done(const dwt_cb_data_t *cb) {
+    evt_push(UWB_EVT_TX_DONE, cb, ts_read(dwt_readtxtimestamp));
+}
+
+#if defined(CONFIG_UWB_STS)
+#define rx_ts_reader    dwt_readrxtimestamp_sts     // only the STS timestamp is authenticated
+#else
+#define rx_ts_reader    dwt_readrxtimestamp
+#endif
+
+static void cb_rx_ok(const dwt_cb_data_t *cb) {
+    const uint64_t ts = ts_read(rx_ts_reader);
+
+    lat_sample(ts);
+    evt_push(UWB_EVT_RX_OK, cb, ts);
+}
+
+static void cb_rx_to(const dwt_cb_data_t *cb) {
+    evt_push(UWB_EVT_RX_TIMEOUT, cb, 0);
+}
+
+static void cb_rx_err(const dwt_cb_data_t *cb) {
+    evt_push(UWB_EVT_RX_ERR, cb, 0);
+}
+
+static void cb_spi_err(const dwt_cb_data_t *cb) {
+    evt_push(UWB_EVT_SPI_ERR, cb, 0);
+}
+
+#if defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+#define PF_OFS(reg) ((reg) - SYS_STATUS_ID)
+
+/* Same clearing order and callbacks data as dwt_isr(), minus the status reads */
+static void evt_from_prefetch(const uint8_t *pf) {
+    const uint32_t status = uwb_get_u32(&pf[PF_OFS(SYS_STATUS_ID)]);
+    dwt_cb_data_t cb = { .status = status };
+
+    if (status & SYS_STATUS_TXFRS_BIT_MASK) {
+        dwt_write8bitoffsetreg(SYS_STATUS_ID, 0, (uint8_t)SYS_STATUS_ALL_TX);
+        evt_push(UWB_EVT_TX_DONE, &cb, ts_read(dwt_readtxtimestamp));
+    }
+
+#if defined(CONFIG_UWB_STS_SP3)
+    // STS-only packets (RXFR without FCG) are left to dwt_isr(), which knows the STS mode
+    if ((status & (SYS_STATUS_RXFR_BIT_MASK | SYS_STATUS_RXFCG_BIT_MASK)) == SYS_STATUS_RXFR_BIT_MASK) {
+        prefetched++;
+        return;
+    }
+#endif
+
+    if (status & SYS_STATUS_RXFCG_BIT_MASK) {
+        const uint16_t finfo = uwb_get_u16(&pf[PF_OFS(RX_FINFO_ID)]);
+#if defined(CONFIG_UWB_STS)
+        const uint64_t ts = ts_read(rx_ts_reader);
+#else
+        const uint64_t ts = uwb_get_ts40(&pf[PF_OFS(RX_TIME_0_ID)]);
+#endif
+
+        cb.datalength = finfo & RX_FINFO_STD_RXFLEN_MASK;
+        cb.rx_flags = (finfo & RX_FINFO_RNG_BIT_MASK) ? DWT_CB_DATA_RX_FLAG_RNG : 0;
+        if (status & SYS_STATUS_CIADONE_BIT_MASK) {
+            cb.rx_flags |= DWT_CB_DATA_RX_FLAG_CIA;
+        }
+        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_GOOD | SYS_STATUS_CIAERR_BIT_MASK |
+                                         SYS_STATUS_CPERR_BIT_MASK);
+        lat_sample(ts);
+        evt_push(UWB_EVT_RX_OK, &cb, ts);
+    } else if (status & SYS_STATUS_ALL_RX_ERR) {
+        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_ERR);
+        evt_push(UWB_EVT_RX_ERR, &cb, 0);
+    }
+
+    if (status & SYS_STATUS_ALL_RX_TO) {
+        dwt_write8bitoffsetreg(SYS_STATUS_ID, 2, (uint8_t)(SYS_STATUS_ALL_RX_TO >> 16));
+        evt_push(UWB_EVT_RX_TIMEOUT, &cb, 0);
+    }
+    prefetched++;
+}
+#endif
+
+/* Runs in ISR context: the line is already masked by platform_port */
+static void dw_irq_isr(void) {
+    k_sem_give(&irq_sem);
+}
+
+static void dw_irq_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    while (1) {
+        k_sem_take(&irq_sem, K_FOREVER);
+
+        const atomic_val_t before = atomic_get(&produced);
+
+#if defined(CONFIG_UWB_IRQ_TRANSPORT_PPI)
+        uint8_t pf[DW3000_PREFETCH_LEN];
+
+        if (dw3000_irq_take_prefetch(pf, sizeof(pf)) == sizeof(pf)) {
+            evt_from_prefetch(pf);
+        }
+        // Anything the burst does not cover (SPI errors, SPIRDY, ...)
+        while (dwt_checkirq()) {
+            dwt_isr();
+        }
+#else
+        // Level IRQ: keep servicing until the DW3000 releases the line
+        do {
+            dwt_isr();
+        } while (dwt_checkirq());
+#endif
+
+        if (atomic_get(&produced) != before) {
+            k_sem_give(&evt_sem);
+        }
+        dw3000_irq_rearm();
+    }
+}
+
+K_THREAD_DEFINE(dw_irq, CONFIG_UWB_IRQ_THREAD_STACK_SIZE, dw_irq_thread, NULL, NULL, NULL,
+                K_PRIO_COOP(CONFIG_UWB_IRQ_THREAD_PRIORITY), 0, 0);
+
+int uwb_radio_events_init(void) {
+    static bool irq_ready;
+
+    if (!irq_ready) {
+        const int ret = dw3000_irq_init(dw_irq_isr);
+        if (ret) {
+            LOG_ERR("DW3000 IRQ line unavailable (%d)", ret);
+            return ret;
+        }
+        irq_ready = true;
+    }
+
+    dwt_setcallbacks(cb_tx_done, cb_rx_ok, cb_rx_to, cb_rx_err, cb_spi_err, NULL);
+    dwt_setinterrupt(DWT_INT_TFRS | DWT_INT_RFCG | DWT_INT_RPHE | DWT_INT_RFCE | DWT_INT_RFSL |
+                     DWT_INT_RFTO | DWT_INT_RXPTO | DWT_INT_SFDT | DWT_INT_ARFE | DWT_INT_SCRC,
+                     0, DWT_ENABLE_INT_ONLY);
+    uwb_radio_events_flush();
+
+    LOG_INF("DW3000 interrupt events enabled (ring %d)", CONFIG_UWB_EVENT_RING_SIZE);
+    return 0;
+}
+
+static int evt_drain(struct uwb_radio_event *evs, size_t max) {
+    size_t n = 0;
+
+    while (n < max && uwb_spsc_get(&evt_ring, &evs[n])) {
+        n++;
+    }
+    if (n) {
+        wakes++;
+        if (n > max_batch) {
+            max_batch = n;
+        }
+    }
+    return (int)n;
+}
+
+int uwb_radio_event_wait(struct uwb_radio_event *evs, size_t max, k_timeout_t timeout) {
+    int n = evt_drain(evs, max);
+    if (n) {
+        return n;
+    }
+
+    dw3000_irq_set_armed(true);
+    (void)k_sem_take(&evt_sem, timeout);
+    dw3000_irq_set_armed(false);
+
+    n = evt_drain(evs, max);
+    return n ? n : -EAGAIN;
+}
+
+void uwb_radio_events_flush(void) {
+    struct uwb_radio_event ev;
+
+    while (uwb_spsc_get(&evt_ring, &ev)) {
+    }
+    k_sem_reset(&evt_sem);
+}
+
+void uwb_radio_events_get_stats(struct uwb_radio_event_stats *out) {
+    out->produced = (uint32_t)atomic_get(&produced);
+    out->overflows = (uint32_t)atomic_get(&evt_ring.dropped);
+    out->wakes = wakes;
+    out->max_batch = max_batch;
+    out->high_water = (uint32_t)atomic_get(&evt_ring.high_water);
+    out->prefetched = prefetched;
+#if defined(CONFIG_UWB_IRQ_LATENCY_STATS)
+    out->lat_avg_us = lat_count ? (uint32_t)(lat_sum_us / lat_count) : 0;
+    out->lat_max_us = lat_max_us;
+#else
+    out->lat_avg_us = 0;
+    out->lat_max_us = 0;
+#endif
+}
@@ -0,0 +1,51 @@
+#ifndef UWB_RADIO_EVENTS_H
+#define UWB_RADIO_EVENTS_H
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+/* DW3000 interrupt events, captured in the dwt_isr() callbacks and handed to
+ * the protocol (radio) thread through a lock-free SPSC ring. */
+enum uwb_radio_evt_type {
+    UWB_EVT_TX_DONE = 0,
+    UWB_EVT_RX_OK,
+    UWB_EVT_RX_TIMEOUT,
+    UWB_EVT_RX_ERR,
+    UWB_EVT_SPI_ERR,
+};
+
+struct uwb_radio_event {
+    uint8_t type;           // enum uwb_radio_evt_type
+    uint8_t rx_flags;       // DWT_CB_DATA_RX_FLAG_*
+    uint16_t len;           // RX frame length incl. FCS (RX_OK only)
+    uint32_t status;        // SYS_STATUS as seen on ISR entry
+    uint64_t ts;            // 40-bit TX (TX_DONE) or RX (RX_OK) timestamp, else 0
+    uint32_t cyc;           // k_cycle_get_32() when the event was captured
+};
+
+struct uwb_radio_event_stats {
+    uint32_t produced;
+    uint32_t overflows;     // events lost because the ring was full
+    uint32_t wakes;         // consumer wakes that returned events
+    uint32_t max_batch;     // most events drained in one wake
+    uint32_t high_water;    // max ring fill level
+    uint32_t prefetched;    // wakes served from the PPI status prefetch
+    uint32_t lat_avg_us;    // RMARKER -> status in hand (CONFIG_UWB_IRQ_LATENCY_STATS)
+    uint32_t lat_max_us;
+};
+
+/* Register the dwt callbacks and enable the DW3000 interrupt sources.
+ * Call after every dwt_initialise() (it clears the callbacks). */
+int uwb_radio_events_init(void);
+
+/* Block until at least one event is queued or the timeout expires, then drain
+ * up to `max` events in order. Returns the count, or -EAGAIN on timeout.
+ * The DW3000 IRQ line is only armed while waiting. */
+int uwb_radio_event_wait(struct uwb_radio_event *evs, size_t max, k_timeout_t timeout);
+
+/* Drop events left over from a previous exchange. */
+void uwb_radio_events_flush(void);
+
+void uwb_radio_events_get_stats(struct uwb_radio_event_stats *out);
+
+#endif /* UWB_RADIO_EVENTS_H */
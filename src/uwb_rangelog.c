@@ -0,0 +1,331 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/storage/flash_map.h>
+#include <errno.h>
+#include <string.h>
+#include "uwb_frame.h"
+#include "uwb_stream_proto.h"
+#include "uwb_rangelog_proto.h"
+#include "uwb_twr_est.h"
+#include "uwb_rangelog.h"
+
+LOG_MODULE_REGISTER(uwb_rangelog, LOG_LEVEL_INF);
+
+// Log the writer counters every N blocks
+#ifndef UWB_RANGELOG_STATS_BLOCKS
+#define UWB_RANGELOG_STATS_BLOCKS 16
+#endif
+
+#define RANGELOG_AREA           FIXED_PARTITION_ID(storage_partition)
+#define RANGELOG_MAGIC          0x55574C47      // "UWLG"
+#define RANGELOG_MAX_SECTORS    128
+
+BUILD_ASSERT(CONFIG_UWB_RANGELOG_BLOCK_SIZE >= UWB_RANGELOG_HDR_LEN + UWB_RANGELOG_REC_MAX,
+             "block too small");
+
+/* Two RAM blocks: the consumer thread fills one while the writer thread
+ * programs the other. enc_lock guards the encoder and the block ownership;
+ * log_lock the FCB and the readout position. */
+static K_MUTEX_DEFINE(enc_lock);
+static K_MUTEX_DEFINE(log_lock);
+static K_SEM_DEFINE(block_ready, 0, 1);
+static K_SEM_DEFINE(block_written, 0, 1);
+
+static uint8_t blocks[2][CONFIG_UWB_RANGELOG_BLOCK_SIZE];
+static struct uwb_rangelog_enc enc;
+static uint8_t fill_idx;                // block the encoder fills
+static uint16_t write_len;              // length of the block being written, 0 = none
+static uint16_t pending_lost;           // records lost since the last block started
+
+static struct fcb fcb;
+static struct flash_sector sectors[RANGELOG_MAX_SECTORS];
+static struct fcb_entry rd_loc;         // readout position
+static uint16_t rd_off;
+static uint32_t rd_erases;              // erases when the readout started
+static bool started;
+
+static struct {
+    uint32_t records;
+    uint32_t lost;
+    uint32_t blocks;
+    uint32_t bytes;
+    uint32_t erases;
+    uint32_t write_max_us;
+    uint32_t erase_max_us;
+} log_stats;
+
+static uint32_t cyc_to_us(uint32_t cycles) {
+    return (uint32_t)k_cyc_to_us_floor64(cycles);
+}
+
+/* Append one block, erasing the oldest sector if the log is full. Caller
+ * holds log_lock. */
+static int log_append(const uint8_t *blk, uint16_t len) {
+    struct fcb_entry loc;
+    int ret = fcb_append(&fcb, len, &loc);
+
+    if (ret == -ENOSPC) {
+        const uint32_t t0 = k_cycle_get_32();
+
+        ret = fcb_rotate(&fcb);
+        log_stats.erase_max_us = MAX(log_stats.erase_max_us, cyc_to_us(k_cycle_get_32() - t0));
+        log_stats.erases++;
+        if (ret == 0) {
+            ret = fcb_append(&fcb, len, &loc);
+        }
+    }
+    if (ret) {
+        return ret;
+    }
+    const uint32_t t0 = k_cycle_get_32();
+
+    ret = flash_area_write(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), blk, len);
+    if (ret == 0) {
+        ret = fcb_append_finish(&fcb, &loc);
+    }
+    log_stats.write_max_us = MAX(log_stats.write_max_us, cyc_to_us(k_cycle_get_32() - t0));
+    return ret;
+}
+
+/* Caller holds enc_lock */
+static void block_start(uint32_t t0_ms) {
+    uwb_rangelog_enc_start(&enc, blocks[fill_idx], sizeof(blocks[0]), t0_ms, pending_lost);
+    pending_lost = 0;
+}
+
+/* Hand the filled block to the writer. Caller holds enc_lock. Returns false
+ * if the writer is still busy with the other one. */
+static bool block_submit(void) {
+    if (write_len) {
+        return false;
+    }
+    write_len = uwb_rangelog_enc_finish(&enc);
+    fill_idx ^= 1;
+    enc.n = 0;
+    k_sem_give(&block_ready);
+    return true;
+}
+
+void uwb_rangelog_report(const struct uwb_range_result *res) {
+    const struct uwb_stream_rec rec = {
+        .t_ms = (uint32_t)res->uptime_ms,
+        .anchor = res->anchor,
+        .status = res->status,
+        .quality = uwb_est_quality(res->status, res->dist_mm, res->report_mm,
+                                   (res->flags & UWB_RANGE_FLAG_TOA) != 0),
+        .flags = ((res->flags & UWB_RANGE_FLAG_TOA) ? UWB_STREAM_FLAG_TOA : 0) |
+                 (res->report_mm ? UWB_STREAM_FLAG_REPORT : 0),
+        .dist_mm = res->dist_mm,
+    };
+
+    if (!started) {
+        return;
+    }
+    k_mutex_lock(&enc_lock, K_FOREVER);
+    if (enc.n == 0) {
+        block_start(rec.t_ms);
+    }
+    if (!uwb_rangelog_enc_add(&enc, &rec)) {
+        // Block full: it goes to flash now, right after this cycle, while the
+        // radio thread sleeps until the next one
+        if (block_submit()) {
+            block_start(rec.t_ms);
+            (void)uwb_rangelog_enc_add(&enc, &rec);
+        } else {
+            log_stats.lost++;
+            pending_lost = (uint16_t)MIN((uint32_t)pending_lost + 1, UINT16_MAX);
+        }
+    }
+    k_mutex_unlock(&enc_lock);
+}
+
+static void rangelog_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    while (1) {
+        k_sem_take(&block_ready, K_FOREVER);
+
+        // The block in flight is the one the encoder is not filling
+        k_mutex_lock(&enc_lock, K_FOREVER);
+        const uint8_t *blk = blocks[fill_idx ^ 1];
+        const uint16_t len = write_len;
+        k_mutex_unlock(&enc_lock);
+
+        k_mutex_lock(&log_lock, K_FOREVER);
+        const int ret = log_append(blk, len);
+        k_mutex_unlock(&log_lock);
+
+        if (ret) {
+            LOG_ERR("Range log: block write failed (%d)", ret);
+        } else {
+            log_stats.blocks++;
+            log_stats.bytes += len;
+            log_stats.records += uwb_get_u16(&blk[1]);
+        }
+
+        k_mutex_lock(&enc_lock, K_FOREVER);
+        write_len = 0;
+        k_mutex_unlock(&enc_lock);
+        k_sem_give(&block_written);
+
+        if (log_stats.blocks % UWB_RANGELOG_STATS_BLOCKS == 0 && ret == 0) {
+            LOG_INF("Range log: %u records in %u blocks (%u B/record), %u erases, lost %u, "
+                    "write max %u us, erase max %u us",
+                    log_stats.records, log_stats.blocks,
+                    log_stats.records ? log_stats.bytes / log_stats.records : 0,
+                    log_stats.erases, log_stats.lost, log_stats.write_max_us,
+                    log_stats.erase_max_us);
+        }
+    }
+}
+
+int uwb_rangelog_flush(void) {
+    if (!started) {
+        return -ENODEV;
+    }
+    // The writer may still be busy with the previous block: submit once it is done
+    for (int i = 0; i < 10; i++) {
+        k_mutex_lock(&enc_lock, K_FOREVER);
+        if (enc.n > 0) {
+            (void)block_submit();
+        }
+        const bool busy = write_len != 0;
+        k_mutex_unlock(&enc_lock);
+
+        if (!busy) {
+            return 0;
+        }
+        (void)k_sem_take(&block_written, K_MSEC(100));
+    }
+    return -ETIMEDOUT;
+}
+
+int uwb_rangelog_read(bool restart, uint8_t *buf, size_t max, uint16_t *block_len,
+                      uint16_t *offset) {
+    int ret = 0;
+
+    if (!started) {
+        return -ENODEV;
+    }
+    if (restart) {
+        (void)uwb_rangelog_flush();
+    }
+    k_mutex_lock(&log_lock, K_FOREVER);
+    if (restart) {
+        memset(&rd_loc, 0, sizeof(rd_loc));
+        rd_off = 0;
+        rd_erases = log_stats.erases;
+    } else if (log_stats.erases != rd_erases) {
+        ret = -ESTALE;
+    }
+    if (ret == 0 && (rd_loc.fe_sector == NULL || rd_off == rd_loc.fe_data_len)) {
+        rd_off = 0;
+        if (fcb_getnext(&fcb, &rd_loc) != 0) {
+            rd_loc.fe_data_len = 0;     // end of the log
+        }
+    }
+    if (ret == 0 && rd_off < rd_loc.fe_data_len) {
+        const size_t n = MIN(max, (size_t)(rd_loc.fe_data_len - rd_off));
+
+        ret = flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(rd_loc) + rd_off, buf, n);
+        if (ret == 0) {
+            *block_len = rd_loc.fe_data_len;
+            *offset = rd_off;
+            rd_off += (uint16_t)n;
+            ret = (int)n;
+        }
+    }
+    k_mutex_unlock(&log_lock);
+    return ret;
+}
+
+int uwb_rangelog_erase(void) {
+    if (!started) {
+        return -ENODEV;
+    }
+    (void)uwb_rangelog_flush();
+    k_mutex_lock(&log_lock, K_FOREVER);
+    const int ret = fcb_clear(&fcb);
+
+    memset(&rd_loc, 0, sizeof(rd_loc));
+    rd_off = 0;
+    log_stats.erases += fcb.f_sector_cnt;
+    k_mutex_unlock(&log_lock);
+    LOG_INF("Range log erased (%d)", ret);
+    return ret;
+}
+
+void uwb_rangelog_get_stats(struct uwb_rangelog_stats *out) {
+    struct fcb_entry loc = { 0 };
+
+    memset(out, 0, sizeof(*out));
+    k_mutex_lock(&log_lock, K_FOREVER);
+    for (int i = 0; i < fcb.f_sector_cnt; i++) {
+        out->capacity += sectors[i].fs_size;
+    }
+    while (started && fcb_getnext(&fcb, &loc) == 0) {
+        out->blocks++;
+        out->used += loc.fe_data_len;
+    }
+    out->records = log_stats.records;
+    out->lost = log_stats.lost;
+    out->bytes = log_stats.bytes;
+    out->erases = log_stats.erases;
+    out->write_max_us = log_stats.write_max_us;
+    out->erase_max_us = log_stats.erase_max_us;
+    k_mutex_unlock(&log_lock);
+
+    k_mutex_lock(&enc_lock, K_FOREVER);
+    out->pending = enc.n;
+    k_mutex_unlock(&enc_lock);
+}
+
+K_THREAD_STACK_DEFINE(rangelog_stack, CONFIG_UWB_RANGELOG_THREAD_STACK_SIZE);
+static struct k_thread rangelog_thread_data;
+
+int uwb_rangelog_start(void) {
+    uint32_t count = ARRAY_SIZE(sectors);
+    int ret = flash_area_get_sectors(RANGELOG_AREA, &count, sectors);
+
+    if (ret) {
+        LOG_ERR("Range log: no sectors in storage_partition (%d)", ret);
+        return ret;
+    }
+    fcb.f_magic = RANGELOG_MAGIC;
+    fcb.f_version = UWB_RANGELOG_BLOCK_V1;
+    fcb.f_sectors = sectors;
+    fcb.f_sector_cnt = (uint8_t)count;
+    fcb.f_scratch_cnt = 0;      // plain circular log, nothing is ever copied
+    ret = fcb_init(RANGELOG_AREA, &fcb);
+    if (ret) {
+        // Foreign or corrupt content: start over rather than run without a log
+        const struct flash_area *fa;
+
+        LOG_WRN("Range log: mount failed (%d), erasing", ret);
+
+        if (flash_area_open(RANGELOG_AREA, &fa) == 0) {
+            ret = flash_area_erase(fa, 0, fa->fa_size);
+            flash_area_close(fa);
+        }
+        if (ret == 0) {
+            ret = fcb_init(RANGELOG_AREA, &fcb);
+        }
+        if (ret) {
+            LOG_ERR("Range log unavailable (%d)", ret);
+            return ret;
+        }
+    }
+    started = true;
+
+    k_thread_create(&rangelog_thread_data, rangelog_stack, K_THREAD_STACK_SIZEOF(rangelog_stack),
+                    rangelog_thread, NULL, NULL, NULL,
+                    CONFIG_UWB_RANGELOG_THREAD_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&rangelog_thread_data, "uwb_rangelog");
+
+    LOG_INF("Range log: %u sectors of %u bytes, %d-byte blocks%s", count, sectors[0].fs_size,
+            CONFIG_UWB_RANGELOG_BLOCK_SIZE, fcb_is_empty(&fcb) ? ", empty" : "");
+    return 0;
+}
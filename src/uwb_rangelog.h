@@ -0,0 +1,51 @@
+#ifndef UWB_RANGELOG_H
+#define UWB_RANGELOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "uwb_ranging.h"
+
+/* Range history in internal flash (CONFIG_UWB_RANGELOG), for tags that leave
+ * USB/RTT coverage. Results are delta-coded into a RAM block (format in
+ * uwb_rangelog_proto.h); full blocks are appended to a flash circular buffer
+ * (FCB) on storage_partition by a low-priority thread, right after the cycle
+ * that filled them. When the log is full the oldest sector is erased. The
+ * log survives reboots; blocks of a new boot start again at a low uptime. */
+
+struct uwb_rangelog_stats {
+    uint32_t capacity;          // flash bytes for the log
+    uint32_t used;              // bytes in stored blocks (walks the log)
+    uint32_t blocks;            // blocks stored
+    uint32_t records;           // records written to flash since boot
+    uint32_t lost;              // records not logged: both RAM blocks busy
+    uint32_t bytes;             // block bytes written since boot
+    uint32_t erases;            // sectors erased since boot (log wrapped)
+    uint32_t write_max_us;      // longest block write (CPU stalls meanwhile)
+    uint32_t erase_max_us;      // longest sector erase
+    uint16_t pending;           // records in the RAM block
+};
+
+/* Mount the log and start the writer thread. Call before uwb_ranging_start(). */
+int uwb_rangelog_start(void);
+
+/* Consumer thread: encode one result; never touches flash. */
+void uwb_rangelog_report(const struct uwb_range_result *res);
+
+/* Write the partial RAM block now and wait for it (up to 1 s). Returns 0 or
+ * -errno. */
+int uwb_rangelog_flush(void);
+
+/* Bulk readout, oldest block first. restart = true flushes the RAM block and
+ * starts from the oldest block. Copies up to `max` bytes of the current block
+ * at *offset of *block_len. Returns the bytes copied, 0 at the end of the log,
+ * or -ESTALE if the log wrapped over the read position (restart). */
+int uwb_rangelog_read(bool restart, uint8_t *buf, size_t max, uint16_t *block_len,
+                      uint16_t *offset);
+
+/* Erase the whole log (stalls the CPU for each sector erase). */
+int uwb_rangelog_erase(void);
+
+void uwb_rangelog_get_stats(struct uwb_rangelog_stats *out);
+
+#endif /* UWB_RANGELOG_H */
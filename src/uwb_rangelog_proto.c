@@ -0,0 +1,194 @@
+#include <string.h>
+#include "uwb_frame.h"
+#include "uwb_rangelog_proto.h"
+
+/* Range log block coding (see uwb_rangelog_proto.h). No RTOS dependencies:
+ * also built into the host decoder. */
+
+static size_t put_varint(uint8_t *out, uint32_t v) {
+    size_t n = 0;
+
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+/* Returns the bytes consumed, 0 if the varint overruns `len` or 5 bytes */
+static size_t get_varint(const uint8_t *in, size_t len, uint32_t *v) {
+    uint32_t x = 0;
+
+    for (size_t i = 0; i < len && i < 5; i++) {
+        x |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80)) {
+            *v = x;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+void uwb_rangelog_enc_start(struct uwb_rangelog_enc *e, uint8_t *buf, uint16_t size,
+                            uint32_t t0_ms, uint16_t lost) {
+    memset(e, 0, sizeof(*e));
+    e->buf = buf;
+    e->size = size;
+    e->len = UWB_RANGELOG_HDR_LEN;
+    e->t_prev = t0_ms;
+    buf[0] = UWB_RANGELOG_BLOCK_V1;
+    uwb_put_u16(&buf[1], 0);
+    uwb_put_u32(&buf[3], t0_ms);
+    uwb_put_u16(&buf[7], lost);
+}
+
+static int slot_find(const struct uwb_rangelog_enc *e, uint16_t anchor) {
+    for (int i = 0; i < e->used; i++) {
+        if (e->anchor[i] == anchor) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool uwb_rangelog_enc_add(struct uwb_rangelog_enc *e, const struct uwb_stream_rec *r) {
+    uint8_t rec[UWB_RANGELOG_REC_MAX];
+    size_t n = 1;
+    uint8_t tag = 0;
+    int slot = -1;
+
+    if (e->n == UINT16_MAX || e->len + UWB_RANGELOG_REC_MAX > e->size) {
+        return false;
+    }
+    if (r->anchor == 0) {
+        tag |= UWB_RANGELOG_TAG_NO_ANCHOR;
+    } else if ((slot = slot_find(e, r->anchor)) < 0) {
+        slot = e->used < UWB_RANGELOG_SLOTS ? e->used++ : e->next;
+        e->next = (uint8_t)((slot + 1) % UWB_RANGELOG_SLOTS);
+        e->anchor[slot] = r->anchor;
+        e->dist_mm[slot] = 0;
+        e->quality[slot] = 100;
+        tag |= UWB_RANGELOG_TAG_NEW;
+        uwb_put_u16(&rec[n], r->anchor);
+        n += 2;
+    }
+    if (slot >= 0) {
+        tag |= (uint8_t)slot;
+    }
+    if (r->status) {
+        tag |= UWB_RANGELOG_TAG_FAIL;
+        rec[n++] = (uint8_t)-r->status;
+    } else if (slot < 0 || r->quality != e->quality[slot]) {
+        tag |= UWB_RANGELOG_TAG_QUALITY;
+        rec[n++] = r->quality;
+    }
+    tag |= (r->flags & UWB_STREAM_FLAG_TOA) ? UWB_RANGELOG_TAG_TOA : 0;
+    tag |= (r->flags & UWB_STREAM_FLAG_REPORT) ? UWB_RANGELOG_TAG_REPORT : 0;
+    rec[0] = tag;
+
+    n += put_varint(&rec[n], r->t_ms - e->t_prev);
+    if (!r->status) {
+        const uint32_t prev = slot >= 0 ? e->dist_mm[slot] : 0;
+
+        n += put_varint(&rec[n], zigzag((int32_t)(r->dist_mm - prev)));
+        if (slot >= 0) {
+            e->dist_mm[slot] = r->dist_mm;
+            e->quality[slot] = r->quality;
+        }
+    }
+    memcpy(&e->buf[e->len], rec, n);
+    e->len += (uint16_t)n;
+    e->t_prev = r->t_ms;
+    e->n++;
+    return true;
+}
+
+uint16_t uwb_rangelog_enc_finish(struct uwb_rangelog_enc *e) {
+    uwb_put_u16(&e->buf[1], e->n);
+    return e->len;
+}
+
+int uwb_rangelog_block_parse(const uint8_t *blk, size_t len, uint32_t *t0_ms, uint16_t *lost,
+                             struct uwb_stream_rec *recs, int max) {
+    uint16_t anchor[UWB_RANGELOG_SLOTS] = { 0 };
+    uint32_t dist[UWB_RANGELOG_SLOTS] = { 0 };
+    uint8_t quality[UWB_RANGELOG_SLOTS] = { 0 };
+    size_t pos = UWB_RANGELOG_HDR_LEN;
+    uint32_t v;
+    size_t k;
+
+    if (len < UWB_RANGELOG_HDR_LEN || blk[0] != UWB_RANGELOG_BLOCK_V1) {
+        return -1;
+    }
+    const uint16_t n = uwb_get_u16(&blk[1]);
+    uint32_t t = uwb_get_u32(&blk[3]);
+
+    *t0_ms = t;
+    *lost = uwb_get_u16(&blk[7]);
+    for (uint16_t i = 0; i < n; i++) {
+        struct uwb_stream_rec r = { 0 };
+
+        if (pos >= len) {
+            return -1;
+        }
+        const uint8_t tag = blk[pos++];
+        const int slot = (tag & UWB_RANGELOG_TAG_NO_ANCHOR) ? -1 : (tag & UWB_RANGELOG_TAG_SLOT);
+
+        if (tag & UWB_RANGELOG_TAG_NEW) {
+            if (slot < 0 || pos + 2 > len) {
+                return -1;
+            }
+            anchor[slot] = uwb_get_u16(&blk[pos]);
+            dist[slot] = 0;
+            quality[slot] = 100;
+            pos += 2;
+        }
+        r.anchor = slot >= 0 ? anchor[slot] : 0;
+        if (tag & UWB_RANGELOG_TAG_FAIL) {
+            if (pos >= len) {
+                return -1;
+            }
+            r.status = (int8_t)-blk[pos++];
+        }
+        if (tag & UWB_RANGELOG_TAG_QUALITY) {
+            if (pos >= len) {
+                return -1;
+            }
+            r.quality = blk[pos++];
+        } else if (!r.status && slot >= 0) {
+            r.quality = quality[slot];
+        }
+        r.flags = ((tag & UWB_RANGELOG_TAG_TOA) ? UWB_STREAM_FLAG_TOA : 0) |
+                  ((tag & UWB_RANGELOG_TAG_REPORT) ? UWB_STREAM_FLAG_REPORT : 0);
+        if ((k = get_varint(&blk[pos], len - pos, &v)) == 0) {
+            return -1;
+        }
+        pos += k;
+        t += v;
+        r.t_ms = t;
+        if (!r.status) {
+            if ((k = get_varint(&blk[pos], len - pos, &v)) == 0) {
+                return -1;
+            }
+            pos += k;
+            r.dist_mm = (slot >= 0 ? dist[slot] : 0) + (uint32_t)unzigzag(v);
+            if (slot >= 0) {
+                dist[slot] = r.dist_mm;
+                quality[slot] = r.quality;
+            }
+        }
+        if (i < max) {
+            recs[i] = r;
+        }
+    }
+    return pos == len ? n : -1;
+}
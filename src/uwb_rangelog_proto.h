@@ -0,0 +1,76 @@
+#ifndef UWB_RANGELOG_PROTO_H
+#define UWB_RANGELOG_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "uwb_stream_proto.h"
+
+/* Block format of the on-device range log (CONFIG_UWB_RANGELOG). Plain C:
+ * shared by the firmware (uwb_rangelog.c) and the host decoder (host/rangelog).
+ *
+ * Records are buffered in RAM and written as one block per flash entry. Each
+ * block decodes on its own (the oldest are erased as the log wraps), little
+ * endian:
+ *   [0]    UWB_RANGELOG_BLOCK_V1
+ *   [1..2] n, number of records
+ *   [3..6] t0_ms, uptime of the first record
+ *   [7..8] records not logged before this block (RAM buffer full, saturating)
+ *   n records, delta-coded against the previous record and, per anchor,
+ *   against the previous distance of that anchor:
+ *     tag(1)       UWB_RANGELOG_TAG_*, slot = tag & UWB_RANGELOG_TAG_SLOT
+ *     anchor(2)    if TAG_NEW: the anchor now using that slot (distance 0,
+ *                  quality 100)
+ *     status(1)    if TAG_FAIL: -status; no distance follows
+ *     quality(1)   if TAG_QUALITY: differs from the slot's previous one
+ *     dt_ms        unsigned varint, time since the previous record (t0 first)
+ *     d_dist_mm    zigzag varint, distance minus the slot's previous distance
+ * A varint is 7 bits per byte, low bits first, bit 7 = more. A range at 10 Hz
+ * takes 3-5 bytes instead of the 16 of a stream record.
+ */
+
+#define UWB_RANGELOG_BLOCK_V1       0x4C
+#define UWB_RANGELOG_HDR_LEN        9
+#define UWB_RANGELOG_REC_MAX        15      // worst-case encoded record
+#define UWB_RANGELOG_SLOTS          4
+
+#define UWB_RANGELOG_TAG_SLOT       0x03
+#define UWB_RANGELOG_TAG_NEW        0x04
+#define UWB_RANGELOG_TAG_FAIL       0x08
+#define UWB_RANGELOG_TAG_QUALITY    0x10
+#define UWB_RANGELOG_TAG_TOA        0x20    // UWB_STREAM_FLAG_TOA
+#define UWB_RANGELOG_TAG_REPORT     0x40    // UWB_STREAM_FLAG_REPORT
+#define UWB_RANGELOG_TAG_NO_ANCHOR  0x80    // nobody answered (anchor 0), no slot
+
+/* Log records use the stream record; filt_mm and vel_cm_s are not stored
+ * (the host recomputes them with uwb_twr_est.c if needed). */
+struct uwb_rangelog_enc {
+    uint8_t *buf;
+    uint16_t size;
+    uint16_t len;
+    uint16_t n;
+    uint32_t t_prev;
+    uint16_t anchor[UWB_RANGELOG_SLOTS];
+    uint32_t dist_mm[UWB_RANGELOG_SLOTS];
+    uint8_t quality[UWB_RANGELOG_SLOTS];
+    uint8_t used;           // slots assigned so far in this block
+    uint8_t next;           // round-robin slot once all are used
+};
+
+/* Start a block in buf (size >= UWB_RANGELOG_HDR_LEN + UWB_RANGELOG_REC_MAX). */
+void uwb_rangelog_enc_start(struct uwb_rangelog_enc *e, uint8_t *buf, uint16_t size,
+                            uint32_t t0_ms, uint16_t lost);
+
+/* Append one record. Returns false, leaving the block unchanged, if it does
+ * not fit: finish the block and start the next one with this record. */
+bool uwb_rangelog_enc_add(struct uwb_rangelog_enc *e, const struct uwb_stream_rec *r);
+
+/* Write the record count into the header. Returns the block length. */
+uint16_t uwb_rangelog_enc_finish(struct uwb_rangelog_enc *e);
+
+/* Decode one block. Returns the record count (records unpacked into recs, at
+ * most max) or -1 if the block is malformed. */
+int uwb_rangelog_block_parse(const uint8_t *blk, size_t len, uint32_t *t0_ms, uint16_t *lost,
+                             struct uwb_stream_rec *recs, int max);
+
+#endif /* UWB_RANGELOG_PROTO_H */
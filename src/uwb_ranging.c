@@ -0,0 +1,459 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <errno.h>
+#include "uwb_ranging.h"
+#include "uwb_spsc.h"
+#include "platform_port.h"
+#include "uwb_radio_events.h"
+#include "uwb_sts.h"
+#include "uwb_uci.h"
+#include "uwb_stream.h"
+#include "uwb_rtt_bin.h"
+#include "uwb_rangelog.h"
+
+LOG_MODULE_REGISTER(uwb_ranging, LOG_LEVEL_INF);
+
+extern int uwb_driver_init(void);
+extern void uwb_led_off(void);
+extern int uwb_read_temp_vbat(int16_t *temp_cdeg, uint16_t *vbat_mv);
+
+#ifndef TAG_TWR_PERIOD_MS
+// Requirement: TAG must keep transmitting periodically and must not "go to sleep".
+// Use a stable period so an anchor can always rediscover the tag when it comes back in range.
+// INCREASED to 1000ms to reduce log spam and allow easier debugging.
+#define TAG_TWR_PERIOD_MS 1000
+#endif
+
+// Print radio-thread timing margins every N cycles
+#ifndef UWB_TIMING_REPORT_CYCLES
+#define UWB_TIMING_REPORT_CYCLES 30
+#endif
+
+// Background temperature / VBAT read every N results (0 = off)
+#ifndef UWB_HOUSEKEEPING_RESULTS
+#define UWB_HOUSEKEEPING_RESULTS 30
+#endif
+
+/* Radio thread -> consumer thread handoff. The radio thread never blocks on it:
+ * if consumers fall behind, results are dropped and counted. */
+UWB_SPSC_DEFINE(range_ring, struct uwb_range_result, CONFIG_UWB_RESULT_RING_SIZE);
+static K_SEM_DEFINE(range_ready, 0, 1);
+
+/* Radio deadline bookkeeping (radio thread only) */
+struct radio_timing {
+    uint32_t cycles;
+    uint32_t wake_late_max_us;      // worst wakeup lateness vs. the period grid
+    uint64_t wake_late_sum_us;
+    uint32_t cycle_max_us;          // longest radio cycle
+    uint32_t overruns;              // cycle did not fit into the period
+};
+
+static struct radio_timing timing;
+
+/* Runtime control: period and run state are written by the host interface and
+ * read by the radio thread once per cycle. */
+static atomic_t period_ms = ATOMIC_INIT(TAG_TWR_PERIOD_MS);
+static atomic_t running = ATOMIC_INIT(IS_ENABLED(CONFIG_UWB_UCI) ? 0 : 1);
+static K_SEM_DEFINE(resume_sem, 0, 1);
+
+static struct k_thread radio_thread_data;
+static struct k_thread consumer_thread_data;
+
+static uint32_t stack_used(struct k_thread *thread) {
+#if defined(CONFIG_INIT_STACKS) && defined(CONFIG_THREAD_STACK_INFO)
+    size_t unused = 0;
+
+    if (k_thread_stack_space_get(thread, &unused) == 0) {
+        return (uint32_t)(thread->stack_info.size - unused);
+    }
+#else
+    ARG_UNUSED(thread);
+#endif
+    return 0;
+}
+
+static void radio_timing_report(void) {
+    const uint32_t n = timing.cycles ? timing.cycles : 1;
+    const int32_t margin_ms = (int32_t)atomic_get(&period_ms) -
+                              (int32_t)((timing.cycle_max_us + timing.wake_late_max_us) / 1000U);
+
+    LOG_INF("radio: %u cycles, wake late avg %u us max %u us, cycle max %u us, "
+            "margin %d ms, overruns %u, ring hw %u dropped %u",
+            timing.cycles, (uint32_t)(timing.wake_late_sum_us / n), timing.wake_late_max_us,
+            timing.cycle_max_us, margin_ms, timing.overruns,
+            (uint32_t)atomic_get(&range_ring.high_water),
+            (uint32_t)atomic_get(&range_ring.dropped));
+
+#if defined(CONFIG_UWB_IRQ_EVENTS)
+    struct uwb_radio_event_stats ev;
+    uwb_radio_events_get_stats(&ev);
+    LOG_INF("radio events: %u produced, %u overflows, %u wakes, max batch %u, ring hw %u, "
+            "prefetched %u, RX latency avg %u us max %u us",
+            ev.produced, ev.overflows, ev.wakes, ev.max_batch, ev.high_water,
+            ev.prefetched, ev.lat_avg_us, ev.lat_max_us);
+#endif
+
+#if defined(CONFIG_UWB_RTT_BIN)
+    struct uwb_rtt_bin_stats rb;
+    uwb_rtt_bin_get_stats(&rb);
+    LOG_INF("RTT bin: %u records (%u bytes), dropped %u (full) %u (busy)",
+            rb.written, rb.bytes, rb.drop_full, rb.drop_busy);
+#endif
+
+#if defined(CONFIG_UWB_RESPONDER)
+    struct uwb_responder_stats rs;
+    uwb_responder_get_stats(&rs);
+    const uint64_t span_us = (uint64_t)(k_uptime_get() - rs.first_ms) * 1000U;
+    const uint32_t duty_ppm = span_us ? (uint32_t)(rs.radio_on_us * 1000000U / span_us) : 0;
+    LOG_INF("responder: %u windows (%u announced), polled %u, RESP late %u, FINAL %u, "
+            "radio on %u.%04u%% (window max %u us)",
+            rs.windows, rs.announced, rs.polled, rs.resp_late, rs.final_ok,
+            duty_ppm / 10000U, duty_ppm % 10000U, rs.radio_on_max_us);
+#endif
+
+#if defined(CONFIG_UWB_PEER)
+    struct uwb_peer_info pi;
+    uwb_peer_get_info(&pi);
+    const uint64_t peer_span_us = (uint64_t)(k_uptime_get() - pi.first_ms) * 1000U;
+    const uint32_t peer_ppm = peer_span_us ? (uint32_t)(pi.radio_on_us * 1000000U / peer_span_us) : 0;
+    LOG_INF("peer 0x%04X: root 0x%04X (%u hops, rate %d ppb), %u neighbors, %u windows "
+            "(%u scans), beacons %u/%u TX/RX, POLLs %u -> %u ranged, %u as responder, "
+            "follows %u, late %u, table full %u, radio on %u.%04u%% (window max %u us)",
+            pi.self, pi.root, pi.hops, pi.rate_ppb, pi.neighbors, pi.stats.windows,
+            pi.stats.scans, pi.stats.beacons_tx, pi.stats.beacons_rx, pi.stats.polls_tx,
+            pi.stats.ranged_init, pi.stats.ranged_resp, pi.stats.follows, pi.late,
+            pi.stats.table_full, peer_ppm / 10000U, peer_ppm % 10000U, pi.radio_on_max_us);
+#endif
+
+    LOG_INF("memory: stack hw radio %u/%d consumer %u/%d",
+            stack_used(&radio_thread_data), CONFIG_UWB_RADIO_THREAD_STACK_SIZE,
+            stack_used(&consumer_thread_data), CONFIG_UWB_CONSUMER_THREAD_STACK_SIZE);
+}
+
+/* Distance spread over one reporting window (consumer thread only). At a fixed
+ * distance this is the accuracy figure to compare STS modes/builds against. */
+struct range_spread {
+    uint32_t n;
+    uint32_t min_mm;
+    uint32_t max_mm;
+    uint64_t sum_mm;
+    uint64_t sum_sq_mm;
+};
+
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t r = 0;
+
+    for (uint64_t bit = 1ULL << 62; bit; bit >>= 2) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+    }
+    return (uint32_t)r;
+}
+
+static void range_spread_add(struct range_spread *s, uint32_t mm) {
+    if (s->n == 0) {
+        s->min_mm = mm;
+        s->max_mm = mm;
+    }
+    s->n++;
+    s->min_mm = MIN(s->min_mm, mm);
+    s->max_mm = MAX(s->max_mm, mm);
+    s->sum_mm += mm;
+    s->sum_sq_mm += (uint64_t)mm * mm;
+}
+
+static void range_spread_report(struct range_spread *s) {
+    if (s->n == 0) {
+        return;
+    }
+    const uint64_t mean = s->sum_mm / s->n;
+    const uint64_t mean_sq = s->sum_sq_mm / s->n;
+
+    LOG_INF("range spread (%s): %u samples, mean %u mm, std %u mm, min %u max %u",
+            uwb_sts_mode_name(), s->n, (uint32_t)mean,
+            isqrt64(mean_sq > mean * mean ? mean_sq - mean * mean : 0), s->min_mm, s->max_mm);
+    memset(s, 0, sizeof(*s));
+}
+
+static void radio_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    int64_t next = k_uptime_ticks();
+    uint32_t cycle = 0;
+    int fail_count = 0;
+#if defined(CONFIG_UWB_PEER) || defined(CONFIG_UWB_CLOCK_SYNC)
+    // Window grid in us: the trimmed period is finer than a tick
+    int64_t next_us = k_ticks_to_us_floor64(next);
+#endif
+#if defined(CONFIG_UWB_PEER)
+    static struct uwb_peer_outcome peer_out;
+#elif defined(CONFIG_UWB_CLOCK_SYNC)
+    int32_t cs_shift_us = 0;
+#endif
+
+    while (1) {
+        if (!atomic_get(&running)) {
+            k_sem_take(&resume_sem, K_FOREVER);
+            next = k_uptime_ticks();
+#if defined(CONFIG_UWB_PEER) || defined(CONFIG_UWB_CLOCK_SYNC)
+            next_us = k_ticks_to_us_floor64(next);
+#endif
+            continue;
+        }
+
+        const int64_t period_ticks = k_ms_to_ticks_ceil64((uint32_t)atomic_get(&period_ms));
+        const int64_t late_us = (int64_t)k_ticks_to_us_floor64(k_uptime_ticks() - next);
+        struct uwb_range_result res;
+        const int64_t start_ms = k_uptime_get();   // results are stamped with the cycle start
+
+        cycle++;
+
+        // Ensure LED is OFF between transmissions; pulses are handled inside TX paths.
+        uwb_led_off();
+
+        // Own the chip for the whole exchange: background readers try-lock and back off
+        dw3000_lock(K_FOREVER);
+#if defined(CONFIG_UWB_RESPONDER)
+        const bool announce = CONFIG_UWB_RESPONDER_ANNOUNCE > 0 &&
+                              ((cycle - 1) % MAX(CONFIG_UWB_RESPONDER_ANNOUNCE, 1)) == 0;
+        const int ret = uwb_responder_window(&res, (uint32_t)atomic_get(&period_ms), announce);
+#elif defined(CONFIG_UWB_PEER)
+        const int n = uwb_peer_window(&peer_out, (uint32_t)atomic_get(&period_ms));
+
+        for (int i = 0; i < peer_out.n; i++) {
+            peer_out.res[i].cycle = cycle;
+            peer_out.res[i].uptime_ms = start_ms;
+            (void)uwb_spsc_put(&range_ring, &peer_out.res[i]);
+        }
+        if (peer_out.n) {
+            k_sem_give(&range_ready);
+        }
+
+        // Exchanges are published above; only a radio failure goes on below
+        memset(&res, 0, sizeof(res));
+        res.status = (int8_t)MIN(n, 0);
+        res.cycle_us = peer_out.window_us;
+        const int ret = (n < 0) ? n : -ENODATA;
+#elif defined(CONFIG_UWB_CLOCK_SYNC)
+        // Arrivals are logged by the driver; only a radio failure goes on below
+        memset(&res, 0, sizeof(res));
+        const int n = uwb_clock_sync_window((uint32_t)atomic_get(&period_ms), &cs_shift_us,
+                                            &res.cycle_us);
+
+        res.status = (int8_t)MIN(n, 0);
+        const int ret = (n < 0) ? n : -ENODATA;
+#else
+        const int ret = uwb_twr_cycle(&res);
+#endif
+        res.cycle = cycle;
+        res.uptime_ms = start_ms;
+
+        // A window nobody polled has no result
+        if (ret != -ENODATA) {
+            (void)uwb_spsc_put(&range_ring, &res);
+            k_sem_give(&range_ready);
+
+#if defined(CONFIG_UWB_RTT_BIN)
+            // Still holding the DW3000 for the optional CIR read
+            uwb_rtt_bin_cycle(&res, (late_us > 0) ? (uint32_t)late_us : 0);
+#endif
+        }
+
+        timing.cycles++;
+        timing.wake_late_sum_us += (late_us > 0) ? (uint64_t)late_us : 0;
+        if (late_us > (int64_t)timing.wake_late_max_us) {
+            timing.wake_late_max_us = (uint32_t)late_us;
+        }
+        if (res.cycle_us > timing.cycle_max_us) {
+            timing.cycle_max_us = res.cycle_us;
+        }
+        if ((timing.cycles % UWB_TIMING_REPORT_CYCLES) == 0) {
+            radio_timing_report();
+        }
+
+        if (ret && ret != -ENODATA) {
+            fail_count++;
+
+            // Watchdog: If we fail 10 times in a row, re-initialize the radio.
+            // This fixes issues where the DW3000 gets stuck in a weird state on battery power.
+            if (fail_count >= 10) {
+                LOG_ERR("Too many failures! Re-initializing UWB driver...");
+                uwb_driver_init();
+#if defined(CONFIG_UWB_RTT_BIN)
+                // Re-init restores the default antenna delay
+                uwb_rtt_bin_config((uint32_t)atomic_get(&period_ms));
+#endif
+                fail_count = 0;
+                k_msleep(100);
+            }
+        } else {
+            fail_count = 0; // Reset counter on success
+        }
+        dw3000_unlock();
+
+        // Stable cadence on an absolute grid, so consumer load or logging cannot
+        // accumulate drift. If a cycle overran, skip to the next future slot.
+#if defined(CONFIG_UWB_PEER)
+        // Peer mode: keep pace with the parent, then move onto its window. A
+        // handover beacon goes out in the old window first; if that leaves the
+        // new one behind, the one after it is next.
+        next_us += peer_out.period_us;
+        if (peer_out.handover) {
+            k_sleep(K_TIMEOUT_ABS_TICKS(k_us_to_ticks_floor64(next_us)));
+            dw3000_lock(K_FOREVER);
+            (void)uwb_peer_handover_tx(peer_out.shift_us, (uint32_t)atomic_get(&period_ms));
+            dw3000_unlock();
+        }
+        next_us += peer_out.shift_us;
+        if (peer_out.handover && next_us <= (int64_t)k_ticks_to_us_floor64(k_uptime_ticks())) {
+            next_us += peer_out.period_us;
+        }
+        next = k_us_to_ticks_floor64(next_us);
+#elif defined(CONFIG_UWB_CLOCK_SYNC)
+        // Slave: move the window grid to keep the master's sync mid-window
+        next_us += (int64_t)atomic_get(&period_ms) * 1000 + cs_shift_us;
+        next = k_us_to_ticks_floor64(next_us);
+#else
+        next += period_ticks;
+#endif
+        if (next <= k_uptime_ticks()) {
+            timing.overruns++;
+            next = k_uptime_ticks() + period_ticks;
+#if defined(CONFIG_UWB_PEER) || defined(CONFIG_UWB_CLOCK_SYNC)
+            next_us = k_ticks_to_us_floor64(next);
+#endif
+        }
+        k_sleep(K_TIMEOUT_ABS_TICKS(next));
+    }
+}
+
+static void consumer_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    struct uwb_range_result res;
+    struct range_spread spread = { 0 };
+    uint32_t results = 0;
+
+    while (1) {
+        k_sem_take(&range_ready, K_FOREVER);
+
+        // Drain everything published since the last wake
+        while (uwb_spsc_get(&range_ring, &res)) {
+            if (res.status) {
+                LOG_WRN("TWR cycle #%u failed (%d)", res.cycle, res.status);
+            } else if (res.dist_mm > 0) {
+                LOG_INF("✅ TWR #%u anchor 0x%04X: %u mm (report %u mm, %u us)",
+                        res.cycle, res.anchor, res.dist_mm, res.report_mm, res.cycle_us);
+                if (res.flags & UWB_RANGE_FLAG_TOA) {
+                    LOG_WRN("⚠️ TWR #%u: Ipatov/STS first paths differ by %d DTU (NLOS or attack)",
+                            res.cycle, res.toa_diff_dtu);
+                }
+                range_spread_add(&spread, res.dist_mm);
+                if (spread.n >= UWB_TIMING_REPORT_CYCLES) {
+                    range_spread_report(&spread);
+                }
+            } else {
+                LOG_WRN("⚠️ TWR #%u: distance calculation failed (invalid timestamps)", res.cycle);
+            }
+#if defined(CONFIG_UWB_UCI)
+            uwb_uci_report(&res);
+#endif
+#if defined(CONFIG_UWB_STREAM)
+            uwb_stream_report(&res);
+#endif
+#if defined(CONFIG_UWB_RANGELOG)
+            uwb_rangelog_report(&res);
+#endif
+
+#if CONFIG_UWB_CONSUMER_LOAD_US > 0
+            // Artificial consumer load for timing-margin tests; must never show up
+            // in the radio thread's wake lateness.
+            k_busy_wait(CONFIG_UWB_CONSUMER_LOAD_US);
+#endif
+            results++;
+        }
+
+        if (UWB_HOUSEKEEPING_RESULTS > 0 && results >= UWB_HOUSEKEEPING_RESULTS) {
+            int16_t temp_cdeg;
+            uint16_t vbat_mv;
+
+            // Radio is idle right after publishing; if not, just try again later
+            if (uwb_read_temp_vbat(&temp_cdeg, &vbat_mv) == 0) {
+                LOG_INF("DW3000 temp %d.%02d C, VBAT %u mV",
+                        temp_cdeg / 100, (temp_cdeg < 0 ? -temp_cdeg : temp_cdeg) % 100, vbat_mv);
+#if defined(CONFIG_UWB_RTT_BIN)
+                uwb_rtt_bin_diag(temp_cdeg, vbat_mv);
+#endif
+                results = 0;
+            }
+        }
+    }
+}
+
+void uwb_ranging_resume(uint32_t period) {
+    atomic_set(&period_ms, (atomic_val_t)period);
+#if defined(CONFIG_UWB_RTT_BIN)
+    uwb_rtt_bin_config(period);
+#endif
+    atomic_set(&running, 1);
+    k_sem_give(&resume_sem);
+}
+
+void uwb_ranging_pause(void) {
+    atomic_set(&running, 0);
+}
+
+void uwb_ranging_set_period(uint32_t period) {
+    atomic_set(&period_ms, (atomic_val_t)period);
+#if defined(CONFIG_UWB_RTT_BIN)
+    uwb_rtt_bin_config(period);
+#endif
+}
+
+K_THREAD_STACK_DEFINE(radio_stack, CONFIG_UWB_RADIO_THREAD_STACK_SIZE);
+K_THREAD_STACK_DEFINE(consumer_stack, CONFIG_UWB_CONSUMER_THREAD_STACK_SIZE);
+
+void uwb_ranging_start(void) {
+#if defined(CONFIG_UWB_RTT_BIN)
+    uwb_rtt_bin_config((uint32_t)atomic_get(&period_ms));
+#endif
+    k_thread_create(&consumer_thread_data, consumer_stack, K_THREAD_STACK_SIZEOF(consumer_stack),
+                    consumer_thread, NULL, NULL, NULL,
+                    CONFIG_UWB_CONSUMER_THREAD_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&consumer_thread_data, "uwb_consumer");
+
+    k_thread_create(&radio_thread_data, radio_stack, K_THREAD_STACK_SIZEOF(radio_stack),
+                    radio_thread, NULL, NULL, NULL,
+                    CONFIG_UWB_RADIO_THREAD_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&radio_thread_data, "uwb_radio");
+
+    // Boot time is measured to this point (size_report.ps1 compares it per configuration)
+    LOG_INF("Ranging started at %u ms after boot: radio prio %d, consumer prio %d, period %d ms",
+            (uint32_t)k_uptime_get(), CONFIG_UWB_RADIO_THREAD_PRIORITY,
+            CONFIG_UWB_CONSUMER_THREAD_PRIORITY, TAG_TWR_PERIOD_MS);
+#if defined(CONFIG_UWB_RESPONDER)
+    LOG_INF("Responder mode: %d us listen window per period, RESP %d us after POLL, "
+            "announced every %d windows", CONFIG_UWB_RESPONDER_WINDOW_US,
+            CONFIG_UWB_RESPONDER_RESP_DELAY_US, CONFIG_UWB_RESPONDER_ANNOUNCE);
+#endif
+#if defined(CONFIG_UWB_PEER)
+    LOG_INF("Peer mode: %d beacon + %d x %d us exchange slots per window, reply delay %d us, "
+            "beacon every ~%d windows, scan every ~%d", CONFIG_UWB_PEER_BEACON_SLOTS,
+            CONFIG_UWB_PEER_SLOTS, CONFIG_UWB_PEER_SLOT_US, CONFIG_UWB_PEER_REPLY_DELAY_US,
+            CONFIG_UWB_PEER_BEACON_PERIODS, CONFIG_UWB_PEER_SCAN_PERIODS);
+#endif
+#if defined(CONFIG_UWB_CLOCK_SYNC)
+    LOG_INF("Clock sync %s: anchor 0x%04X, sync every %d ms, master timeout %d ms",
+            IS_ENABLED(CONFIG_UWB_CLOCK_SYNC_MASTER) ? "master" : "slave",
+            CONFIG_UWB_CLOCK_SYNC_ADDR, CONFIG_UWB_CLOCK_SYNC_PERIOD_MS,
+            CONFIG_UWB_CLOCK_SYNC_TIMEOUT_MS);
+#endif
+}
@@ -0,0 +1,126 @@
+#ifndef UWB_RANGING_H
+#define UWB_RANGING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uwb_peer_proto.h"
+
+/* One TWR exchange as seen by the tag. Produced by the radio thread,
+ * consumed by the lower-priority output/filter threads. */
+struct uwb_range_result {
+    int64_t uptime_ms;      // cycle start (k_uptime_get)
+    uint32_t cycle;         // cycle counter since boot
+    uint16_t anchor;        // anchor that answered (0 = none)
+    uint8_t seq;            // POLL sequence number
+    int8_t status;          // 0 = OK, <0 = failed step (see UWB_RANGE_ERR_*)
+    uint32_t dist_mm;       // tag-side SS-TWR estimate (0 if invalid)
+    uint32_t report_mm;     // anchor DS-TWR REPORT (0 if none)
+    uint32_t cycle_us;      // radio time spent in this cycle
+    uint32_t flags;         // UWB_RANGE_FLAG_*
+    int32_t toa_diff_dtu;   // RESP STS - Ipatov first path (STS builds), NLOS hint
+};
+
+#define UWB_RANGE_FLAG_TOA   0x01   // Ipatov/STS first paths disagree (attack or NLOS)
+
+#define UWB_RANGE_ERR_POLL   -1
+#define UWB_RANGE_ERR_RESP   -2
+#define UWB_RANGE_ERR_FINAL  -3
+
+/* Radio-side TWR cycle (uwb_driver_qorvo.c). Fills *res and returns its status. */
+int uwb_twr_cycle(struct uwb_range_result *res);
+
+/* Responder mode (CONFIG_UWB_RESPONDER): one listen window instead of a
+ * cycle. Answers an anchor's POLL with a RESP and waits for its FINAL; the
+ * distance is the tag's DS-TWR estimate. UWB_RANGE_ERR_RESP means our RESP
+ * missed its slot. Returns res->status, or -ENODATA if nobody polled (no
+ * result). `announce` broadcasts the schedule at the window start. */
+int uwb_responder_window(struct uwb_range_result *res, uint32_t period_ms, bool announce);
+
+struct uwb_responder_stats {
+    uint32_t windows;
+    uint32_t announced;         // windows opened with an announcement
+    uint32_t polled;            // POLLs for this tag
+    uint32_t resp_late;         // RESP not sent (slot missed or TX failed)
+    uint32_t final_ok;          // exchanges completed with the anchor's FINAL
+    uint32_t radio_on_max_us;   // longest window, TX and RX
+    uint64_t radio_on_us;       // transceiver not forced off, since the first window
+    int64_t first_ms;           // uptime of the first window
+};
+
+void uwb_responder_get_stats(struct uwb_responder_stats *out);
+
+/* Peer mode (CONFIG_UWB_PEER): one window of the tag-to-tag schedule in
+ * uwb_peer_proto.h instead of a cycle. Completed exchanges go to out->res,
+ * with anchor = the peer and dist_mm = our estimate: DS-TWR as responder,
+ * SS-TWR as initiator with the peer's DS-TWR in report_mm. Returns how many,
+ * or UWB_RANGE_ERR_POLL if a TX never completed (radio stuck). */
+#define UWB_PEER_WINDOW_RESULTS 4
+
+struct uwb_peer_outcome {
+    uint32_t period_us;         // to the next window, trimmed to the parent's pace
+    int32_t shift_us;           // then move it by this onto a followed neighbor (0 = stay)
+    bool handover;              // uwb_peer_handover_tx() due in the old window first
+    uint32_t window_us;         // radio on time
+    uint8_t n;
+    struct uwb_range_result res[UWB_PEER_WINDOW_RESULTS];
+};
+
+int uwb_peer_window(struct uwb_peer_outcome *out, uint32_t period_ms);
+
+/* Handover beacon (see uwb_peer_proto.h): call at the start of the window
+ * we are moving away from, with the outcome's shift_us. -ENODATA if none is
+ * pending, -EAGAIN if its slot was missed. */
+int uwb_peer_handover_tx(int32_t shift_us, uint32_t period_ms);
+
+struct uwb_peer_info {
+    uint16_t self;
+    uint16_t root;
+    uint8_t hops;
+    uint8_t neighbors;
+    int32_t rate_ppb;
+    struct uwb_peer_stats stats;
+    uint32_t late;              // own TX slots missed (busy answering a POLL)
+    uint32_t radio_on_max_us;
+    uint64_t radio_on_us;       // transceiver not forced off, since the first window
+    int64_t first_ms;           // uptime of the first window
+};
+
+void uwb_peer_get_info(struct uwb_peer_info *out);
+
+/* Clock sync role (CONFIG_UWB_CLOCK_SYNC): one window of the TDoA anchor
+ * service in uwb_clock_sync.h instead of a cycle. The master sends its sync
+ * frame; every anchor then logs the frames it hears with their arrival time
+ * in the master's timebase. shift_us moves the next window (slave: keeps the
+ * sync mid-window), on_us is the radio on time. Returns the number of
+ * arrivals, or UWB_RANGE_ERR_POLL if the sync TX never completed. */
+int uwb_clock_sync_window(uint32_t period_ms, int32_t *shift_us, uint32_t *on_us);
+
+struct uwb_twr_ts;
+
+/* Radio settings that decide how raw timestamps turn into ranges */
+struct uwb_radio_config {
+    uint16_t antenna_delay;     // DTU, TX and RX
+    uint8_t channel;
+    uint8_t preamble_code;
+    uint8_t sts_mode;           // DWT_STS_MODE_*
+};
+
+void uwb_driver_get_config(struct uwb_radio_config *out);
+
+/* Raw timestamps of the last uwb_twr_cycle() (radio thread). Zero for the
+ * steps it did not reach. */
+void uwb_twr_get_timestamps(struct uwb_twr_ts *ts);
+
+/* Start the radio and consumer threads. uwb_driver_init() must have succeeded.
+ * With CONFIG_UWB_UCI the radio thread waits for uwb_ranging_resume(). */
+void uwb_ranging_start(void);
+
+/* Runtime control (host interface). The radio thread finishes the current
+ * cycle before pausing; resume restarts the period grid from now. */
+void uwb_ranging_resume(uint32_t period_ms);
+void uwb_ranging_pause(void);
+
+/* New period while running (downlink commands), from the next cycle on. */
+void uwb_ranging_set_period(uint32_t period_ms);
+
+#endif /* UWB_RANGING_H */
@@ -0,0 +1,109 @@
+#ifndef UWB_REPLAY_WINDOW_H
+#define UWB_REPLAY_WINDOW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Per-sender replay window over 8-bit frame sequence numbers. Plain C and
+ * header only: inlined into the RX hot path, and built by host/replaywin.
+ *
+ * Each sender has the highest sequence number accepted from it and a bitmap
+ * of the UWB_REPLAY_WINDOW numbers below that. A number is a replay if it is
+ * the highest or its bit is set. A sender's counter also counts its frames to
+ * others, and we miss some of its frames, so its numbers can jump by any
+ * amount between two we accept. A number further back than the window is
+ * therefore a jump that restarts the window there, not a replay. An entry not
+ * used for max_age_ms is forgotten: with only 256 numbers, its bitmap says
+ * nothing about the sender's numbers by then. What the window catches is a
+ * frame sent again shortly after the original. Older replays have to fail
+ * the exchange's own checks (RESP sequence echo and timestamps, FINAL
+ * timestamps).
+ */
+
+#define UWB_REPLAY_WINDOW   32
+
+struct uwb_replay_entry {
+    uint16_t addr;          // 0 = free
+    uint8_t last_seq;       // highest accepted
+    uint32_t seen;          // bit n = (last_seq - n) accepted, 0 = nothing yet
+    uint32_t last_ms;       // last accept (ageing, LRU)
+};
+
+struct uwb_replay {
+    struct uwb_replay_entry *e;
+    uint16_t n;
+    uint32_t max_age_ms;
+};
+
+static inline void uwb_replay_reset(struct uwb_replay *r) {
+    memset(r->e, 0, sizeof(r->e[0]) * r->n);
+}
+
+static inline bool uwb_replay_fresh(const struct uwb_replay *r, const struct uwb_replay_entry *e,
+                                    uint32_t now_ms) {
+    return e->seen != 0 && (uint32_t)(now_ms - e->last_ms) <= r->max_age_ms;
+}
+
+static inline struct uwb_replay_entry *uwb_replay_find(struct uwb_replay *r, uint16_t addr) {
+    for (int i = 0; i < r->n; i++) {
+        if (r->e[i].addr == addr) {
+            return &r->e[i];
+        }
+    }
+    return NULL;
+}
+
+/* True if `seq` from `addr` was already accepted */
+static inline bool uwb_replay_seen(struct uwb_replay *r, uint16_t addr, uint8_t seq,
+                                   uint32_t now_ms) {
+    const struct uwb_replay_entry *e = uwb_replay_find(r, addr);
+
+    if (!e || !uwb_replay_fresh(r, e, now_ms)) {
+        return false;
+    }
+
+    const uint8_t back = (uint8_t)(e->last_seq - seq);
+
+    // Ahead of last_seq (back >= 128) or a jump back past the window: new
+    return back < UWB_REPLAY_WINDOW && (e->seen & (1UL << back));
+}
+
+/* Record `seq` from `addr` once the frame has passed all other checks */
+static inline void uwb_replay_accept(struct uwb_replay *r, uint16_t addr, uint8_t seq,
+                                     uint32_t now_ms) {
+    struct uwb_replay_entry *e = uwb_replay_find(r, addr);
+
+    if (!e) {
+        // A free entry, else the one unused for longest
+        e = &r->e[0];
+        for (int i = 0; i < r->n && e->addr; i++) {
+            if (!r->e[i].addr ||
+                (uint32_t)(now_ms - r->e[i].last_ms) > (uint32_t)(now_ms - e->last_ms)) {
+                e = &r->e[i];
+            }
+        }
+        memset(e, 0, sizeof(*e));
+        e->addr = addr;
+    }
+
+    const uint8_t back = (uint8_t)(e->last_seq - seq);
+    const uint8_t ahead = (uint8_t)(seq - e->last_seq);
+
+    if (!uwb_replay_fresh(r, e, now_ms)) {
+        e->seen = 1;
+        e->last_seq = seq;
+    } else if (back < UWB_REPLAY_WINDOW) {
+        e->seen |= 1UL << back;
+    } else if (ahead < 128) {
+        e->seen = (ahead >= UWB_REPLAY_WINDOW) ? 1 : ((e->seen << ahead) | 1);
+        e->last_seq = seq;
+    } else {
+        // Jumped back past the window: restart it here
+        e->seen = 1;
+        e->last_seq = seq;
+    }
+    e->last_ms = now_ms;
+}
+
+#endif /* UWB_REPLAY_WINDOW_H */
@@ -0,0 +1,195 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <SEGGER_RTT.h>
+#include <errno.h>
+#include "deca_device_api.h"
+#include "uwb_frame.h"
+#include "uwb_twr_est.h"
+#include "uwb_rtt_bin.h"
+
+LOG_MODULE_REGISTER(uwb_rtt_bin, LOG_LEVEL_INF);
+
+BUILD_ASSERT(CONFIG_UWB_RTT_BIN_CHANNEL < CONFIG_SEGGER_RTT_MAX_NUM_UP_BUFFERS,
+             "raise CONFIG_SEGGER_RTT_MAX_NUM_UP_BUFFERS");
+
+#define RTT_BIN_CH      CONFIG_UWB_RTT_BIN_CHANNEL
+#define UWB_CIR_SAMPLES 1016    // Ipatov CIR length at 64 MHz PRF
+
+static uint8_t rtt_bin_buf[CONFIG_UWB_RTT_BIN_BUF_SIZE];
+
+/* Serialises writers. Taken with K_NO_WAIT: a writer that would have to wait
+ * drops its record instead, so a low-priority producer holding the lock can
+ * never delay the radio thread. */
+static K_MUTEX_DEFINE(rtt_bin_lock);
+
+static bool rtt_bin_ready;
+static atomic_t rec_seq;
+static atomic_t stat_written;
+static atomic_t stat_bytes;
+static atomic_t stat_drop_full;
+static atomic_t stat_drop_busy;
+
+#if defined(CONFIG_UWB_RTT_BIN_CIR)
+// +1: dwt_readaccdata() returns a dummy byte first
+static uint8_t cir_buf[1 + CONFIG_UWB_RTT_BIN_CIR_SAMPLES * UWB_RTT_CIR_SAMPLE_LEN];
+#endif
+
+int uwb_rtt_bin_init(void) {
+    const int ret = SEGGER_RTT_ConfigUpBuffer(RTT_BIN_CH, "uwb_bin", rtt_bin_buf,
+                                              sizeof(rtt_bin_buf), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    if (ret < 0) {
+        LOG_ERR("RTT up-buffer %d config failed (%d)", RTT_BIN_CH, ret);
+        return -EINVAL;
+    }
+    rtt_bin_ready = true;
+    LOG_INF("Binary diagnostics on RTT up-channel %d (%d bytes)", RTT_BIN_CH,
+            CONFIG_UWB_RTT_BIN_BUF_SIZE);
+    return 0;
+}
+
+int uwb_rtt_bin_write(uint8_t type, const void *a, uint16_t alen, const void *b, uint16_t blen) {
+    const uint32_t len = (uint32_t)alen + blen;
+    const uint32_t seq = (uint32_t)atomic_inc(&rec_seq);
+    uint8_t hdr[UWB_RTT_BIN_HDR_LEN];
+
+    if (!rtt_bin_ready || len > UINT16_MAX ||
+        UWB_RTT_BIN_HDR_LEN + len > sizeof(rtt_bin_buf) - 1) {
+        return -EINVAL;
+    }
+    if (k_is_in_isr() || k_mutex_lock(&rtt_bin_lock, K_NO_WAIT) != 0) {
+        atomic_inc(&stat_drop_busy);
+        return -EBUSY;
+    }
+    // Checked once for the whole record: the host only ever frees space
+    if (SEGGER_RTT_GetAvailWriteSpace(RTT_BIN_CH) < UWB_RTT_BIN_HDR_LEN + len) {
+        k_mutex_unlock(&rtt_bin_lock);
+        atomic_inc(&stat_drop_full);
+        return -ENOSPC;
+    }
+
+    hdr[0] = UWB_RTT_BIN_MAGIC;
+    hdr[1] = type;
+    uwb_put_u16(&hdr[2], (uint16_t)len);
+    uwb_put_u32(&hdr[4], seq);
+    SEGGER_RTT_WriteNoLock(RTT_BIN_CH, hdr, sizeof(hdr));
+    if (alen) {
+        SEGGER_RTT_WriteNoLock(RTT_BIN_CH, a, alen);
+    }
+    if (blen) {
+        SEGGER_RTT_WriteNoLock(RTT_BIN_CH, b, blen);
+    }
+    k_mutex_unlock(&rtt_bin_lock);
+
+    atomic_inc(&stat_written);
+    atomic_add(&stat_bytes, (atomic_val_t)(UWB_RTT_BIN_HDR_LEN + len));
+    return 0;
+}
+
+#if defined(CONFIG_UWB_RTT_BIN_CIR)
+/* Read a window around the Ipatov first path of the last received frame. */
+static void rtt_bin_cir(const struct uwb_range_result *res) {
+    dwt_rxdiag_t diag;
+    uint8_t hdr[UWB_RTT_CIR_HDR_LEN];
+
+    if (!rtt_bin_ready) {
+        return;
+    }
+    dwt_readdiagnostics(&diag);
+
+    const int fp = diag.ipatovFpIndex >> 6;
+    const int first = CLAMP(fp - CONFIG_UWB_RTT_BIN_CIR_PRE, 0,
+                            UWB_CIR_SAMPLES - CONFIG_UWB_RTT_BIN_CIR_SAMPLES);
+
+    // Skip the SPI read entirely when the record could not be written anyway
+    if (SEGGER_RTT_GetAvailWriteSpace(RTT_BIN_CH) <
+        UWB_RTT_BIN_HDR_LEN + sizeof(hdr) + sizeof(cir_buf) - 1) {
+        (void)atomic_inc(&rec_seq);
+        atomic_inc(&stat_drop_full);
+        return;
+    }
+    dwt_readaccdata(cir_buf, sizeof(cir_buf), (uint16_t)first);
+
+    uwb_put_u32(&hdr[0], res->cycle);
+    uwb_put_u16(&hdr[4], res->anchor);
+    uwb_put_u16(&hdr[6], diag.ipatovFpIndex);
+    uwb_put_u16(&hdr[8], (uint16_t)first);
+    uwb_put_u16(&hdr[10], CONFIG_UWB_RTT_BIN_CIR_SAMPLES);
+    (void)uwb_rtt_bin_write(UWB_RTT_REC_CIR, hdr, sizeof(hdr), &cir_buf[1], sizeof(cir_buf) - 1);
+}
+#endif
+
+void uwb_rtt_bin_cycle(const struct uwb_range_result *res, uint32_t wake_late_us) {
+    uint8_t p[UWB_RTT_CYCLE_LEN];
+
+    uwb_put_u32(&p[0], res->cycle);
+    uwb_put_u32(&p[4], (uint32_t)res->uptime_ms);
+    uwb_put_u32(&p[8], wake_late_us);
+    uwb_put_u32(&p[12], res->cycle_us);
+    uwb_put_u16(&p[16], res->anchor);
+    p[18] = res->seq;
+    p[19] = (uint8_t)res->status;
+    uwb_put_u32(&p[20], res->dist_mm);
+    uwb_put_u32(&p[24], res->report_mm);
+    uwb_put_u32(&p[28], (uint32_t)res->toa_diff_dtu);
+    (void)uwb_rtt_bin_write(UWB_RTT_REC_CYCLE, p, sizeof(p), NULL, 0);
+
+    if (res->anchor != 0) {
+        uint8_t t[UWB_RTT_TWR_LEN];
+        struct uwb_twr_ts ts;
+
+        uwb_twr_get_timestamps(&ts);
+        uwb_put_u32(&t[0], res->cycle);
+        uwb_put_u32(&t[4], (uint32_t)res->uptime_ms);
+        uwb_put_u16(&t[8], res->anchor);
+        t[10] = res->seq;
+        t[11] = (uint8_t)res->status;
+        t[12] = (uint8_t)res->flags;
+        uwb_put_ts40(&t[13], ts.poll_tx);
+        uwb_put_ts40(&t[18], ts.resp_rx);
+        uwb_put_ts40(&t[23], ts.poll_rx);
+        uwb_put_ts40(&t[28], ts.resp_tx);
+        uwb_put_ts40(&t[33], ts.final_tx);
+        uwb_put_u32(&t[38], res->dist_mm);
+        uwb_put_u32(&t[42], res->report_mm);
+        (void)uwb_rtt_bin_write(UWB_RTT_REC_TWR, t, sizeof(t), NULL, 0);
+    }
+
+#if defined(CONFIG_UWB_RTT_BIN_CIR)
+    if (res->status == 0 || res->status == UWB_RANGE_ERR_FINAL) {
+        rtt_bin_cir(res);
+    }
+#endif
+}
+
+void uwb_rtt_bin_config(uint32_t period_ms) {
+    struct uwb_radio_config rc;
+    uint8_t p[UWB_RTT_CONFIG_LEN];
+
+    uwb_driver_get_config(&rc);
+    uwb_put_u32(&p[0], (uint32_t)k_uptime_get());
+    uwb_put_u32(&p[4], period_ms);
+    uwb_put_u16(&p[8], rc.antenna_delay);
+    p[10] = rc.channel;
+    p[11] = rc.preamble_code;
+    p[12] = rc.sts_mode;
+    p[13] = (IS_ENABLED(CONFIG_UWB_STS) ? UWB_RTT_FEAT_STS : 0) |
+            (IS_ENABLED(CONFIG_UWB_PAYLOAD_AES) ? UWB_RTT_FEAT_AES : 0) |
+            (IS_ENABLED(CONFIG_UWB_IRQ_EVENTS) ? UWB_RTT_FEAT_IRQ_EVENTS : 0);
+    (void)uwb_rtt_bin_write(UWB_RTT_REC_CONFIG, p, sizeof(p), NULL, 0);
+}
+
+void uwb_rtt_bin_diag(int16_t temp_cdeg, uint16_t vbat_mv) {
+    uint8_t p[UWB_RTT_DIAG_LEN];
+
+    uwb_put_u32(&p[0], (uint32_t)k_uptime_get());
+    uwb_put_u16(&p[4], (uint16_t)temp_cdeg);
+    uwb_put_u16(&p[6], vbat_mv);
+    (void)uwb_rtt_bin_write(UWB_RTT_REC_DIAG, p, sizeof(p), NULL, 0);
+}
+
+void uwb_rtt_bin_get_stats(struct uwb_rtt_bin_stats *out) {
+    out->written = (uint32_t)atomic_get(&stat_written);
+    out->bytes = (uint32_t)atomic_get(&stat_bytes);
+    out->drop_full = (uint32_t)atomic_get(&stat_drop_full);
+    out->drop_busy = (uint32_t)atomic_get(&stat_drop_busy);
+}
@@ -0,0 +1,40 @@
+#ifndef UWB_RTT_BIN_H
+#define UWB_RTT_BIN_H
+
+#include <stdint.h>
+#include "uwb_ranging.h"
+#include "uwb_rtt_bin_proto.h"
+
+/* Binary diagnostics on a dedicated RTT up-channel (CONFIG_UWB_RTT_BIN), so
+ * bulk records never share the log channel's buffer. The writer never waits:
+ * a record that does not fit, or that races another writer, is dropped and
+ * counted (the sequence gap tells the host). Thread context only. */
+
+struct uwb_rtt_bin_stats {
+    uint32_t written;
+    uint32_t bytes;
+    uint32_t drop_full;     // not enough free space (host not reading fast enough)
+    uint32_t drop_busy;     // another thread was writing, or called from an ISR
+};
+
+/* Register the up-buffer. Call once before any write. */
+int uwb_rtt_bin_init(void);
+
+/* Write one record: header, then `a` and `b` back to back (either may be NULL).
+ * Returns 0, -ENOSPC, -EBUSY or -EINVAL (too long, or channel not set up). */
+int uwb_rtt_bin_write(uint8_t type, const void *a, uint16_t alen, const void *b, uint16_t blen);
+
+/* Radio thread, right after uwb_twr_cycle() while it still owns the DW3000:
+ * cycle record, the raw timestamps when a RESP was accepted and, with
+ * CONFIG_UWB_RTT_BIN_CIR, the CIR window. */
+void uwb_rtt_bin_cycle(const struct uwb_range_result *res, uint32_t wake_late_us);
+
+/* Configuration record: the ranging period plus the radio settings (any thread) */
+void uwb_rtt_bin_config(uint32_t period_ms);
+
+/* Housekeeping record (consumer thread) */
+void uwb_rtt_bin_diag(int16_t temp_cdeg, uint16_t vbat_mv);
+
+void uwb_rtt_bin_get_stats(struct uwb_rtt_bin_stats *out);
+
+#endif /* UWB_RTT_BIN_H */
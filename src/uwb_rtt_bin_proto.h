@@ -0,0 +1,61 @@
+#ifndef UWB_RTT_BIN_PROTO_H
+#define UWB_RTT_BIN_PROTO_H
+
+#include <stdint.h>
+
+/* Record format of the binary diagnostics RTT up-channel (CONFIG_UWB_RTT_BIN).
+ * Plain C: shared with the host reader (host/rtt).
+ *
+ * Every record is written whole or not at all, little endian:
+ *   [0]    magic (UWB_RTT_BIN_MAGIC)
+ *   [1]    type (UWB_RTT_REC_*)
+ *   [2..3] payload length
+ *   [4..7] record sequence number; incremented for every record the firmware
+ *          tried to write, so a gap is the number of records it dropped
+ *   payload
+ *
+ * UWB_RTT_REC_CYCLE (radio thread, once per TWR cycle), 32 bytes:
+ *   cycle(4) uptime_ms(4) wake_late_us(4) cycle_us(4) anchor(2) seq(1) status(1)
+ *   dist_mm(4) report_mm(4) toa_diff_dtu(4, signed)
+ *
+ * UWB_RTT_REC_CIR (CONFIG_UWB_RTT_BIN_CIR, after the cycle), 12 + n * 6 bytes:
+ *   cycle(4) anchor(2) fp_index(2, Ipatov first path, 10.6 fixed point)
+ *   first_sample(2) n(2) | n x { re(3) im(3) } 18-bit signed, as read from ACC_MEM
+ *   The CIR is the one of the last frame received in the cycle (the REPORT, or
+ *   the RESP when no REPORT arrived).
+ *
+ * UWB_RTT_REC_TWR (radio thread, after the cycle record when a RESP was
+ * accepted), 46 bytes: the estimator's inputs, for capture and replay:
+ *   cycle(4) uptime_ms(4) anchor(2) seq(1) status(1) flags(1, UWB_RANGE_FLAG_*)
+ *   poll_tx(5) resp_rx(5) poll_rx(5) resp_tx(5) final_tx(5)   raw 40-bit DTU
+ *   dist_mm(4, tag estimate) report_mm(4)
+ *
+ * UWB_RTT_REC_CONFIG (at start and whenever one of the values changes), 14 bytes:
+ *   uptime_ms(4) period_ms(4) antenna_delay(2) channel(1) preamble_code(1)
+ *   sts_mode(1) features(1, UWB_RTT_FEAT_*)
+ *
+ * UWB_RTT_REC_DIAG (consumer thread, with the housekeeping read), 8 bytes:
+ *   uptime_ms(4) temp_cdeg(2, signed) vbat_mv(2)
+ */
+
+#define UWB_RTT_BIN_MAGIC           0xA5
+#define UWB_RTT_BIN_HDR_LEN         8
+
+#define UWB_RTT_REC_CYCLE           0x01
+#define UWB_RTT_REC_CIR             0x02
+#define UWB_RTT_REC_TWR             0x03
+#define UWB_RTT_REC_CONFIG          0x04
+#define UWB_RTT_REC_DIAG            0x05
+
+#define UWB_RTT_CYCLE_LEN           32
+#define UWB_RTT_CIR_HDR_LEN         12
+#define UWB_RTT_CIR_SAMPLE_LEN      6
+#define UWB_RTT_TWR_LEN             46
+#define UWB_RTT_CONFIG_LEN          14
+#define UWB_RTT_DIAG_LEN            8
+
+#define UWB_RTT_FEAT_STS            0x01
+#define UWB_RTT_FEAT_AES            0x02
+#define UWB_RTT_FEAT_IRQ_EVENTS     0x04
+
+#endif /* UWB_RTT_BIN_PROTO_H */
@@ -0,0 +1,67 @@
+#ifndef UWB_SPSC_H
+#define UWB_SPSC_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <string.h>
+
+/* Lock-free single-producer / single-consumer ring of fixed-size elements.
+ *
+ * The producer only writes `head`, the consumer only writes `tail`, so neither
+ * side ever blocks or takes a lock. Safe between two threads or between an ISR
+ * (producer) and a thread (consumer). Capacity must be a power of two.
+ * A full ring drops the new element and counts it in `dropped`.
+ */
+struct uwb_spsc {
+    atomic_t head;          // next slot to write (producer)
+    atomic_t tail;          // next slot to read (consumer)
+    atomic_t dropped;       // elements rejected because the ring was full
+    atomic_t high_water;    // max fill level seen by the producer
+    uint8_t *buf;
+    uint16_t elem_size;
+    uint16_t mask;
+};
+
+#define UWB_SPSC_DEFINE(name, type, capacity)                                  \
+    BUILD_ASSERT(IS_POWER_OF_TWO(capacity), "SPSC capacity must be 2^n");      \
+    static uint8_t name##_storage[sizeof(type) * (capacity)] __aligned(4);     \
+    static struct uwb_spsc name = {                                            \
+        .buf = name##_storage,                                                 \
+        .elem_size = sizeof(type),                                             \
+        .mask = (capacity) - 1,                                                \
+    }
+
+static inline uint32_t uwb_spsc_count(const struct uwb_spsc *r) {
+    return (uint32_t)(atomic_get(&r->head) - atomic_get(&r->tail));
+}
+
+static inline bool uwb_spsc_put(struct uwb_spsc *r, const void *elem) {
+    const uint32_t head = (uint32_t)atomic_get(&r->head);
+    const uint32_t used = head - (uint32_t)atomic_get(&r->tail);
+
+    if (used > r->mask) {
+        atomic_inc(&r->dropped);
+        return false;
+    }
+    memcpy(&r->buf[(head & r->mask) * r->elem_size], elem, r->elem_size);
+    // Publish the element before the index (atomic_set is a full barrier)
+    atomic_set(&r->head, (atomic_val_t)(head + 1));
+
+    if (used + 1 > (uint32_t)atomic_get(&r->high_water)) {
+        atomic_set(&r->high_water, (atomic_val_t)(used + 1));
+    }
+    return true;
+}
+
+static inline bool uwb_spsc_get(struct uwb_spsc *r, void *elem) {
+    const uint32_t tail = (uint32_t)atomic_get(&r->tail);
+
+    if (tail == (uint32_t)atomic_get(&r->head)) {
+        return false;
+    }
+    memcpy(elem, &r->buf[(tail & r->mask) * r->elem_size], r->elem_size);
+    atomic_set(&r->tail, (atomic_val_t)(tail + 1));
+    return true;
+}
+
+#endif /* UWB_SPSC_H */
@@ -0,0 +1,189 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/ring_buffer.h>
+#include <zephyr/usb/usb_device.h>
+#include <errno.h>
+#include "uwb_stream_proto.h"
+#include "uwb_stream.h"
+#include "uwb_twr_est.h"
+
+LOG_MODULE_REGISTER(uwb_stream, LOG_LEVEL_INF);
+
+// Log stream counters every N records
+#ifndef UWB_STREAM_STATS_RECORDS
+#define UWB_STREAM_STATS_RECORDS 1000
+#endif
+
+#define STREAM_FIFO_CHUNK       64      // one full-speed bulk packet per uart_fifo_fill()
+
+BUILD_ASSERT(CONFIG_UWB_STREAM_BATCH_RECORDS <= UWB_STREAM_MAX_RECORDS, "batch too large");
+
+static const struct device *const stream_dev = DEVICE_DT_GET(DT_CHOSEN(uwb_stream_uart));
+
+/* Encoded frames -> TX interrupt. The stream lock holders are the only
+ * producer, the ISR the only consumer. */
+RING_BUF_DECLARE(stream_tx_ring, CONFIG_UWB_STREAM_TX_BUF_SIZE);
+
+/* Consumer thread (uwb_stream_report) and system work queue (flush timeout)
+ * share the open batch */
+static K_MUTEX_DEFINE(stream_lock);
+
+static struct {
+    uint8_t frame[UWB_STREAM_FRAME_LEN(CONFIG_UWB_STREAM_BATCH_RECORDS)];
+    uint8_t n;
+    uint16_t seq;           // seq of the first record in frame
+} batch;
+
+static struct uwb_range_filter filter;
+
+static struct {
+    uint32_t records;
+    uint32_t frames;
+    uint32_t drop_full;     // records lost to a full TX ring
+    uint32_t drop_no_host;  // records discarded while DTR was low
+    uint32_t ring_high_water;
+} stream_stats;
+
+static uint16_t rec_seq;        // next record's sequence number
+static uint16_t pending_drops;  // reported in the next frame header
+static bool started;
+
+static void flush_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(flush_work, flush_work_handler);
+
+static void stream_uart_isr(const struct device *dev, void *user_data) {
+    ARG_UNUSED(user_data);
+
+    while (uart_irq_update(dev) && uart_irq_tx_ready(dev)) {
+        uint8_t *data;
+        const uint32_t len = ring_buf_get_claim(&stream_tx_ring, &data, STREAM_FIFO_CHUNK);
+
+        if (len == 0) {
+            uart_irq_tx_disable(dev);
+            break;
+        }
+        const int sent = uart_fifo_fill(dev, data, (int)len);
+
+        ring_buf_get_finish(&stream_tx_ring, sent > 0 ? (uint32_t)sent : 0);
+        if (sent < (int)len) {
+            break;      // CDC ACM buffer full, resume on the next TX-ready interrupt
+        }
+    }
+}
+
+static bool host_connected(void) {
+    uint32_t dtr = 0;
+
+    return uart_line_ctrl_get(stream_dev, UART_LINE_CTRL_DTR, &dtr) == 0 && dtr;
+}
+
+static void count_drops(uint32_t n) {
+    pending_drops = (uint16_t)MIN((uint32_t)pending_drops + n, UINT16_MAX);
+}
+
+/* Close the open batch and queue it. Caller holds stream_lock. */
+static void batch_flush(void) {
+    uint8_t enc[UWB_STREAM_COBS_LEN(sizeof(batch.frame))];
+    const uint8_t n = batch.n;
+
+    if (n == 0) {
+        return;
+    }
+    batch.n = 0;
+
+    const size_t len = uwb_stream_frame_finish(batch.frame, n, batch.seq, pending_drops);
+    const size_t enc_len = uwb_cobs_encode(batch.frame, len, enc);
+
+    // Whole frames only: a partial frame would cost the host the next one too
+    if (ring_buf_space_get(&stream_tx_ring) < enc_len) {
+        stream_stats.drop_full += n;
+        count_drops(n);
+        return;
+    }
+    ring_buf_put(&stream_tx_ring, enc, enc_len);
+    pending_drops = 0;
+    stream_stats.frames++;
+    stream_stats.ring_high_water = MAX(stream_stats.ring_high_water,
+                                       ring_buf_size_get(&stream_tx_ring));
+    uart_irq_tx_enable(stream_dev);
+}
+
+static void flush_work_handler(struct k_work *work) {
+    ARG_UNUSED(work);
+
+    k_mutex_lock(&stream_lock, K_FOREVER);
+    batch_flush();
+    k_mutex_unlock(&stream_lock);
+}
+
+void uwb_stream_report(const struct uwb_range_result *res) {
+    if (!started) {
+        return;
+    }
+    struct uwb_stream_rec rec = {
+        .t_ms = (uint32_t)res->uptime_ms,
+        .anchor = res->anchor,
+        .status = res->status,
+        .quality = uwb_est_quality(res->status, res->dist_mm, res->report_mm,
+                                   (res->flags & UWB_RANGE_FLAG_TOA) != 0),
+        .flags = ((res->flags & UWB_RANGE_FLAG_TOA) ? UWB_STREAM_FLAG_TOA : 0) |
+                 (res->report_mm ? UWB_STREAM_FLAG_REPORT : 0),
+        .dist_mm = res->dist_mm,
+    };
+
+    k_mutex_lock(&stream_lock, K_FOREVER);
+    if (uwb_range_filter_update(&filter, res->anchor, rec.t_ms,
+                                res->status == 0 && res->dist_mm > 0, res->dist_mm,
+                                &rec.filt_mm, &rec.vel_cm_s)) {
+        rec.flags |= UWB_STREAM_FLAG_FILT_RESET;
+    }
+
+    const uint16_t seq = rec_seq++;
+
+    if (!host_connected()) {
+        stream_stats.drop_no_host++;
+        count_drops(1);
+    } else {
+        if (batch.n == 0) {
+            batch.seq = seq;
+            k_work_reschedule(&flush_work, K_MSEC(CONFIG_UWB_STREAM_FLUSH_MS));
+        }
+        uwb_stream_rec_pack(&batch.frame[UWB_STREAM_HDR_LEN + batch.n * UWB_STREAM_REC_LEN],
+                            &rec);
+        if (++batch.n == CONFIG_UWB_STREAM_BATCH_RECORDS) {
+            batch_flush();
+        }
+    }
+
+    if (++stream_stats.records % UWB_STREAM_STATS_RECORDS == 0) {
+        LOG_INF("stream: %u records, %u frames, dropped %u (TX full) %u (no host), "
+                "TX ring high water %u/%d",
+                stream_stats.records, stream_stats.frames, stream_stats.drop_full,
+                stream_stats.drop_no_host, stream_stats.ring_high_water,
+                CONFIG_UWB_STREAM_TX_BUF_SIZE);
+    }
+    k_mutex_unlock(&stream_lock);
+}
+
+int uwb_stream_start(void) {
+    if (!device_is_ready(stream_dev)) {
+        LOG_ERR("stream port not ready");
+        return -ENODEV;
+    }
+
+    const int ret = usb_enable(NULL);
+    if (ret != 0 && ret != -EALREADY) {
+        LOG_ERR("usb_enable failed (%d)", ret);
+        return ret;
+    }
+
+    uart_irq_callback_set(stream_dev, stream_uart_isr);
+    uwb_range_filter_init(&filter);
+    started = true;
+
+    LOG_INF("Range stream on %s: %d records/frame, flush %d ms",
+            stream_dev->name, CONFIG_UWB_STREAM_BATCH_RECORDS, CONFIG_UWB_STREAM_FLUSH_MS);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef UWB_STREAM_H
+#define UWB_STREAM_H
+
+#include "uwb_ranging.h"
+
+/* Binary range stream over USB CDC ACM (CONFIG_UWB_STREAM). Records are
+ * batched into COBS frames (format in uwb_stream_proto.h) and queued for the
+ * UART TX interrupt; nothing here blocks. */
+
+/* Enable USB and open the stream port. Call before uwb_ranging_start(). */
+int uwb_stream_start(void);
+
+/* Consumer thread: filter, encode and queue one result. Results are dropped
+ * and counted while no host has the port open or the TX buffer is full. */
+void uwb_stream_report(const struct uwb_range_result *res);
+
+#endif /* UWB_STREAM_H */
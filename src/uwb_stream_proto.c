@@ -0,0 +1,128 @@
+#include <string.h>
+#include "uwb_frame.h"
+#include "uwb_stream_proto.h"
+
+/* Range stream frame format and COBS framing (see uwb_stream_proto.h).
+ * No RTOS dependencies: also built into the host decoder. */
+
+uint16_t uwb_stream_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void put_u24(uint8_t *p, uint32_t v) {
+    if (v > UWB_STREAM_MM_MAX) {
+        v = UWB_STREAM_MM_MAX;
+    }
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+}
+
+static uint32_t get_u24(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+void uwb_stream_rec_pack(uint8_t *out, const struct uwb_stream_rec *r) {
+    uwb_put_u32(&out[0], r->t_ms);
+    uwb_put_u16(&out[4], r->anchor);
+    put_u24(&out[6], r->dist_mm);
+    put_u24(&out[9], r->filt_mm);
+    uwb_put_u16(&out[12], (uint16_t)r->vel_cm_s);
+    out[14] = r->quality;
+    out[15] = (uint8_t)((r->flags << 4) | ((uint8_t)(-r->status) & 0x0F));
+}
+
+void uwb_stream_rec_unpack(const uint8_t *in, struct uwb_stream_rec *r) {
+    r->t_ms = uwb_get_u32(&in[0]);
+    r->anchor = uwb_get_u16(&in[4]);
+    r->dist_mm = get_u24(&in[6]);
+    r->filt_mm = get_u24(&in[9]);
+    r->vel_cm_s = (int16_t)uwb_get_u16(&in[12]);
+    r->quality = in[14];
+    r->flags = in[15] >> 4;
+    r->status = (int8_t)-(int8_t)(in[15] & 0x0F);
+}
+
+size_t uwb_stream_frame_finish(uint8_t *out, uint8_t n, uint16_t seq, uint16_t dropped) {
+    const size_t body = UWB_STREAM_HDR_LEN + (size_t)n * UWB_STREAM_REC_LEN;
+
+    out[0] = UWB_STREAM_TYPE_RANGES;
+    out[1] = n;
+    uwb_put_u16(&out[2], seq);
+    uwb_put_u16(&out[4], dropped);
+    uwb_put_u16(&out[body], uwb_stream_crc16(out, body));
+    return body + UWB_STREAM_CRC_LEN;
+}
+
+int uwb_stream_frame_parse(const uint8_t *frame, size_t len, uint16_t *seq, uint16_t *dropped,
+                           struct uwb_stream_rec *recs, int max) {
+    if (len < UWB_STREAM_FRAME_LEN(0) || frame[0] != UWB_STREAM_TYPE_RANGES ||
+        frame[1] > UWB_STREAM_MAX_RECORDS || len != (size_t)UWB_STREAM_FRAME_LEN(frame[1])) {
+        return -1;
+    }
+    const size_t body = len - UWB_STREAM_CRC_LEN;
+
+    if (uwb_get_u16(&frame[body]) != uwb_stream_crc16(frame, body)) {
+        return -1;
+    }
+    const int n = frame[1] < max ? frame[1] : max;
+
+    *seq = uwb_get_u16(&frame[2]);
+    *dropped = uwb_get_u16(&frame[4]);
+    for (int i = 0; i < n; i++) {
+        uwb_stream_rec_unpack(&frame[UWB_STREAM_HDR_LEN + i * UWB_STREAM_REC_LEN], &recs[i]);
+    }
+    return n;
+}
+
+size_t uwb_cobs_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_pos = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] != 0) {
+            out[o++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+    out[o++] = 0x00;
+    return o;
+}
+
+size_t uwb_cobs_decode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t i = 0;
+    size_t o = 0;
+
+    while (i < len) {
+        const uint8_t code = in[i++];
+
+        if (code == 0 || i + code - 1 > len) {
+            return 0;
+        }
+        for (uint8_t k = 1; k < code; k++) {
+            if (in[i] == 0) {
+                return 0;
+            }
+            out[o++] = in[i++];
+        }
+        if (code != 0xFF && i < len) {
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
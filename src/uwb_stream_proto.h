@@ -0,0 +1,77 @@
+#ifndef UWB_STREAM_PROTO_H
+#define UWB_STREAM_PROTO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Binary range stream format (CONFIG_UWB_STREAM). Plain C: shared by the
+ * firmware encoder (uwb_stream.c) and the host decoder (host/stream).
+ *
+ * The byte stream is a sequence of COBS-encoded frames, each terminated by
+ * 0x00, so a reader can start anywhere and resynchronise on the next zero.
+ * Decoded frame, little endian:
+ *   [0]    type (UWB_STREAM_TYPE_RANGES)
+ *   [1]    n, number of records
+ *   [2..3] seq of the first record (record counter since boot, mod 2^16)
+ *   [4..5] records dropped before this frame (host absent / TX full, saturating)
+ *   n x 16-byte record:
+ *   [0..3]   t_ms        cycle start, ms since boot
+ *   [4..5]   anchor
+ *   [6..8]   dist_mm     SS-TWR distance (24 bit, 0 = invalid)
+ *   [9..11]  filt_mm     alpha-beta filtered distance for this anchor (24 bit)
+ *   [12..13] vel_cm_s    filtered range rate (signed, + = moving away)
+ *   [14]     quality     0 (failed) .. 100
+ *   [15]     flags << 4 | -status (UWB_RANGE_ERR_*, 0 = OK)
+ *   CRC-16/CCITT-FALSE over everything above
+ */
+
+#define UWB_STREAM_TYPE_RANGES      0x52
+#define UWB_STREAM_HDR_LEN          6
+#define UWB_STREAM_REC_LEN          16
+#define UWB_STREAM_CRC_LEN          2
+#define UWB_STREAM_MAX_RECORDS      15      // keeps a frame in one COBS block (< 254 bytes)
+#define UWB_STREAM_FRAME_LEN(n)     (UWB_STREAM_HDR_LEN + (n) * UWB_STREAM_REC_LEN + UWB_STREAM_CRC_LEN)
+#define UWB_STREAM_FRAME_MAX        UWB_STREAM_FRAME_LEN(UWB_STREAM_MAX_RECORDS)
+// Encoded size incl. overhead byte(s) and the 0x00 delimiter
+#define UWB_STREAM_COBS_LEN(len)    ((len) + (len) / 254 + 2)
+
+#define UWB_STREAM_FLAG_TOA         0x1     // UWB_RANGE_FLAG_TOA: NLOS / first-path mismatch
+#define UWB_STREAM_FLAG_REPORT      0x2     // anchor DS-TWR REPORT received
+#define UWB_STREAM_FLAG_FILT_RESET  0x4     // filter (re)started on this record
+
+#define UWB_STREAM_MM_MAX           0xFFFFFFu
+
+struct uwb_stream_rec {
+    uint32_t t_ms;
+    uint16_t anchor;
+    int8_t status;
+    uint8_t quality;
+    uint8_t flags;          // UWB_STREAM_FLAG_*
+    uint32_t dist_mm;
+    uint32_t filt_mm;
+    int16_t vel_cm_s;
+};
+
+uint16_t uwb_stream_crc16(const uint8_t *data, size_t len);
+
+void uwb_stream_rec_pack(uint8_t *out, const struct uwb_stream_rec *r);
+void uwb_stream_rec_unpack(const uint8_t *in, struct uwb_stream_rec *r);
+
+/* Frame header at out[0..5] for n records already packed at out[6..]; appends
+ * the CRC. Returns the frame length. */
+size_t uwb_stream_frame_finish(uint8_t *out, uint8_t n, uint16_t seq, uint16_t dropped);
+
+/* Validate a decoded frame. Returns the record count (records unpacked into
+ * recs, at most max) or -1 for a bad type, length or CRC. */
+int uwb_stream_frame_parse(const uint8_t *frame, size_t len, uint16_t *seq, uint16_t *dropped,
+                           struct uwb_stream_rec *recs, int max);
+
+/* COBS encode `len` bytes and append the 0x00 delimiter. `out` must hold
+ * UWB_STREAM_COBS_LEN(len). Returns the encoded length. */
+size_t uwb_cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+
+/* Decode one frame without its delimiter. Returns the decoded length, or 0 if
+ * the input contains a zero or a code overruns it. In place is allowed. */
+size_t uwb_cobs_decode(const uint8_t *in, size_t len, uint8_t *out);
+
+#endif /* UWB_STREAM_PROTO_H */
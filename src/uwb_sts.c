@@ -0,0 +1,228 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <errno.h>
+#include <string.h>
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "uwb_frame.h"
+#include "uwb_sts.h"
+
+LOG_MODULE_REGISTER(uwb_sts, LOG_LEVEL_INF);
+
+static struct uwb_sts_stats stats = { .qual_min = INT16_MAX };
+
+int uwb_hex128_parse(const char *s, uint32_t w[4]) {
+    if (strlen(s) != 32) {
+        return -EINVAL;
+    }
+    for (int i = 0; i < 32; i++) {
+        const char c = s[i];
+        uint32_t nib;
+
+        if (c >= '0' && c <= '9') {
+            nib = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            nib = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            nib = c - 'A' + 10;
+        } else {
+            return -EINVAL;
+        }
+        w[i / 8] = (w[i / 8] << 4) | nib;
+    }
+    return 0;
+}
+
+#if defined(CONFIG_UWB_STS)
+static dwt_sts_cp_key_t sts_key;
+static dwt_sts_cp_iv_t sts_iv;          // iv0 = base, advanced per exchange
+
+int uwb_sts_session_start(const dwt_sts_cp_key_t *key, const dwt_sts_cp_iv_t *iv) {
+    uint32_t w[4] = { 0 };
+
+    if (key) {
+        sts_key = *key;
+    } else if (uwb_hex128_parse(CONFIG_UWB_STS_KEY, w) == 0) {
+        sts_key = (dwt_sts_cp_key_t){ w[0], w[1], w[2], w[3] };
+    } else {
+        LOG_ERR("CONFIG_UWB_STS_KEY must be 32 hex digits");
+        return -EINVAL;
+    }
+
+    memset(w, 0, sizeof(w));
+    if (iv) {
+        sts_iv = *iv;
+    } else if (uwb_hex128_parse(CONFIG_UWB_STS_IV, w) == 0) {
+        sts_iv = (dwt_sts_cp_iv_t){ w[0], w[1], w[2], w[3] };
+    } else {
+        LOG_ERR("CONFIG_UWB_STS_IV must be 32 hex digits");
+        return -EINVAL;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    stats.qual_min = INT16_MAX;
+
+    dwt_configurestskey(&sts_key);
+    dwt_configurestsiv(&sts_iv);
+    dwt_configurestsloadiv();
+
+    LOG_INF("STS session started (%s, IV base 0x%08X)", uwb_sts_mode_name(), sts_iv.iv0);
+    return 0;
+}
+
+void uwb_sts_exchange_begin(void) {
+    dwt_sts_cp_iv_t iv = sts_iv;
+
+    // Only the counter word moves; a lost exchange is re-synced by the next one
+    iv.iv0 += stats.exchanges++;
+    dwt_configurestsiv(&iv);
+    dwt_configurestsloadiv();
+}
+
+int uwb_sts_rx_check(void) {
+    int16_t qual;
+    uint16_t status;
+
+    if (dwt_readstsquality(&qual) < 0) {
+        stats.rx_bad_qual++;
+        return -EBADMSG;
+    }
+    if (dwt_readstsstatus(&status, 0) != DWT_SUCCESS) {
+        stats.rx_bad_status++;
+        return -EBADMSG;
+    }
+    stats.rx_ok++;
+    stats.qual_min = MIN(stats.qual_min, qual);
+    return 0;
+}
+
+// IP_TOA_LO..STS_TOA_HI are contiguous: one transfer instead of two
+#define TOA_BURST_LEN   16
+#define TOA_IP_OFS      (IP_TOA_LO_ID - IP_TOA_LO_ID)
+#define TOA_STS_OFS     (STS_TOA_LO_ID - IP_TOA_LO_ID)
+
+int uwb_sts_toa_select(uint64_t *ts, int32_t *diff_dtu) {
+    uint8_t buf[TOA_BURST_LEN];
+
+    dwt_readfromdevice(IP_TOA_LO_ID, 0, sizeof(buf), buf);
+
+    const uint64_t ip = uwb_get_ts40(&buf[TOA_IP_OFS]);
+    const uint64_t sts = uwb_get_ts40(&buf[TOA_STS_OFS]);
+    // 40-bit wrap-safe signed difference
+    const int64_t diff = (int64_t)(((sts - ip) & UWB_TS_MASK) << 24) >> 24;
+    const uint32_t adiff = (uint32_t)MIN(diff < 0 ? -diff : diff, (int64_t)UINT32_MAX);
+
+    *ts = IS_ENABLED(CONFIG_UWB_TS_SOURCE_IPATOV) ? ip : sts;
+    *diff_dtu = (int32_t)CLAMP(diff, INT32_MIN, INT32_MAX);
+
+    stats.toa_checked++;
+    stats.toa_diff_sum += adiff;
+    stats.toa_diff_max = MAX(stats.toa_diff_max, adiff);
+    if (adiff > CONFIG_UWB_TOA_MAX_DIFF_DTU) {
+        stats.toa_mismatch++;
+        return -EBADMSG;
+    }
+    return 0;
+}
+#else
+int uwb_sts_session_start(const dwt_sts_cp_key_t *key, const dwt_sts_cp_iv_t *iv) {
+    ARG_UNUSED(key);
+    ARG_UNUSED(iv);
+    return 0;
+}
+
+void uwb_sts_exchange_begin(void) {
+}
+
+int uwb_sts_rx_check(void) {
+    return 0;
+}
+
+int uwb_sts_toa_select(uint64_t *ts, int32_t *diff_dtu) {
+    uint8_t ts_tab[5];
+
+    dwt_readrxtimestamp(ts_tab);
+    *ts = uwb_get_ts40(ts_tab);
+    *diff_dtu = 0;
+    return 0;
+}
+#endif /* CONFIG_UWB_STS */
+
+void uwb_sts_get_stats(struct uwb_sts_stats *out) {
+    *out = stats;
+    if (out->rx_ok == 0) {
+        out->qual_min = 0;
+    }
+}
+
+const char *uwb_sts_mode_name(void) {
+    switch (UWB_STS_MODE) {
+    case DWT_STS_MODE_1:
+        return "SP1";
+    case DWT_STS_MODE_ND:
+        return "SP3";
+    default:
+        return "SP0";
+    }
+}
+
+// ================= Airtime =================
+// Symbol durations in ps (DW3000 user manual, 499.2 MHz chipping rate)
+#define PRE_SYM_PS_PRF64    1017630U    // preamble/SFD symbol, codes 9..24
+#define PRE_SYM_PS_PRF16    993590U     // preamble/SFD symbol, codes 1..8
+#define STS_BLOCK_PS        1025640U    // 512 chips
+#define BIT_PS_850K         1025640U
+#define BIT_PS_6M8          128210U
+#define PHR_BITS            21U
+#define RS_BLOCK_BITS       330U        // Reed-Solomon: 48 parity bits per block
+#define RS_PARITY_BITS      48U
+
+static uint32_t preamble_symbols(uint8_t plen) {
+    switch (plen) {
+    case DWT_PLEN_32:   return 32;
+    case DWT_PLEN_64:   return 64;
+    case DWT_PLEN_72:   return 72;
+    case DWT_PLEN_128:  return 128;
+    case DWT_PLEN_256:  return 256;
+    case DWT_PLEN_512:  return 512;
+    case DWT_PLEN_1024: return 1024;
+    case DWT_PLEN_1536: return 1536;
+    case DWT_PLEN_2048: return 2048;
+    default:            return 4096;
+    }
+}
+
+uint32_t uwb_airtime_ns(const dwt_config_t *cfg, uint8_t sts_mode, uint16_t psdu_len) {
+    const uint64_t sym_ps = (cfg->txCode >= 9) ? PRE_SYM_PS_PRF64 : PRE_SYM_PS_PRF16;
+    const uint32_t sfd_syms = (cfg->sfdType == DWT_SFD_DW_16) ? 16 : 8;
+    const uint64_t bit_ps = (cfg->dataRate == DWT_BR_6M8) ? BIT_PS_6M8 : BIT_PS_850K;
+    const uint64_t phr_bit_ps = (cfg->phrRate == DWT_PHRRATE_DTA) ? bit_ps : BIT_PS_850K;
+    uint64_t ps = (preamble_symbols(cfg->txPreambLength) + sfd_syms) * sym_ps;
+
+    if ((sts_mode & DWT_STS_CONFIG_MASK) != DWT_STS_MODE_OFF) {
+        ps += (uint64_t)(32U << cfg->stsLength) * STS_BLOCK_PS;
+    }
+    if ((sts_mode & DWT_STS_MODE_ND) != DWT_STS_MODE_ND) {
+        const uint32_t bits = 8U * psdu_len;
+        const uint32_t rs = ((bits + RS_BLOCK_BITS - 1) / RS_BLOCK_BITS) * RS_PARITY_BITS;
+
+        ps += PHR_BITS * phr_bit_ps + (uint64_t)(bits + rs) * bit_ps;
+    }
+    return (uint32_t)(ps / 1000U);
+}
+
+void uwb_sts_log_airtime(const dwt_config_t *cfg) {
+    // POLL / RESP as sent today (+2 FCS); SP3 adds the RESP data frame (SP0)
+    const uint16_t poll_len = UWB_IDX_FUNC + 1 + 2;
+    const uint16_t resp_len = UWB_RESP_LEN + 2;
+    const uint32_t sp0 = uwb_airtime_ns(cfg, DWT_STS_MODE_OFF, poll_len) +
+                         uwb_airtime_ns(cfg, DWT_STS_MODE_OFF, resp_len);
+    const uint32_t sp1 = uwb_airtime_ns(cfg, DWT_STS_MODE_1, poll_len) +
+                         uwb_airtime_ns(cfg, DWT_STS_MODE_1, resp_len);
+    const uint32_t sp3_rng = 2U * uwb_airtime_ns(cfg, DWT_STS_MODE_ND, 0);
+    const uint32_t sp3 = sp3_rng + uwb_airtime_ns(cfg, DWT_STS_MODE_OFF, resp_len);
+
+    LOG_INF("POLL+RESP airtime: SP0 %u us, SP1 %u us, SP3 %u us (+RESP data %u us) [%s active]",
+            sp0 / 1000U, sp1 / 1000U, sp3_rng / 1000U, (sp3 - sp3_rng) / 1000U,
+            uwb_sts_mode_name());
+}
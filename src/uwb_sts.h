@@ -0,0 +1,73 @@
+#ifndef UWB_STS_H
+#define UWB_STS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "deca_device_api.h"
+
+/* Scrambled timestamp sequence (IEEE 802.15.4z) for secure ranging.
+ *
+ * SP1: every frame carries an STS after the SFD; the RX timestamp is taken from
+ *      the STS CIR and only used if the STS quality and status checks pass.
+ * SP3: POLL and RESP are STS-only packets (no PHR, no payload). The anchor
+ *      follows its SP3 RESP with the usual RESP data frame (SP0) carrying
+ *      POLL_RX / RESP_TX of the SP3 packets; FINAL and REPORT stay SP0.
+ *
+ * Key and IV are per session: uwb_sts_session_start() loads them and resets the
+ * exchange counter. Each exchange reloads the IV with iv0 = base + counter, so
+ * both ends generate the same STS without exchanging anything on air.
+ */
+
+#if defined(CONFIG_UWB_STS_SP3)
+#define UWB_STS_MODE    DWT_STS_MODE_ND
+#elif defined(CONFIG_UWB_STS_SP1)
+#define UWB_STS_MODE    DWT_STS_MODE_1
+#else
+#define UWB_STS_MODE    DWT_STS_MODE_OFF
+#endif
+
+struct uwb_sts_stats {
+    uint32_t exchanges;     // IV reloads since the session started
+    uint32_t rx_ok;         // STS timestamps accepted
+    uint32_t rx_bad_qual;   // STS quality below the driver threshold
+    uint32_t rx_bad_status; // STS status error bits set
+    int16_t qual_min;       // worst quality index among accepted frames
+    uint32_t toa_checked;   // frames with an Ipatov/STS consistency check
+    uint32_t toa_mismatch;  // |STS - Ipatov| above CONFIG_UWB_TOA_MAX_DIFF_DTU
+    uint32_t toa_diff_max;  // largest |STS - Ipatov| seen (DTU)
+    uint64_t toa_diff_sum;  // sum of |STS - Ipatov| (DTU), for the average
+};
+
+/* Start a ranging session. NULL key/iv use CONFIG_UWB_STS_KEY / CONFIG_UWB_STS_IV.
+ * Call after dwt_configure(). Returns 0 or -EINVAL for a malformed key/IV. */
+int uwb_sts_session_start(const dwt_sts_cp_key_t *key, const dwt_sts_cp_iv_t *iv);
+
+/* Reload the IV for the next exchange (before the POLL is sent). */
+void uwb_sts_exchange_begin(void);
+
+/* STS quality/status of the frame just received. 0 = timestamp may be used. */
+int uwb_sts_rx_check(void);
+
+/* Ipatov vs STS first path of the frame just received, read in one 16-byte
+ * burst (IP_TOA + STS_TOA, register file 0x0C). Writes the timestamp selected
+ * by CONFIG_UWB_TS_SOURCE_* to *ts and STS - Ipatov (DTU) to *diff_dtu.
+ * Returns -EBADMSG if the two disagree by more than CONFIG_UWB_TOA_MAX_DIFF_DTU
+ * (spoofed STS or severe multipath), else 0. Without STS: RX_TIME, diff 0. */
+int uwb_sts_toa_select(uint64_t *ts, int32_t *diff_dtu);
+
+void uwb_sts_get_stats(struct uwb_sts_stats *out);
+
+/* "0011223344556677..." (32 hex digits) -> four words, first word first.
+ * Shared with the payload key (uwb_aes.c). Returns 0 or -EINVAL. */
+int uwb_hex128_parse(const char *s, uint32_t w[4]);
+
+/* On-air duration of a frame with `psdu_len` bytes (incl. FCS) for `cfg`,
+ * with the STS mode overridden by `sts_mode`. SP3 ignores psdu_len. */
+uint32_t uwb_airtime_ns(const dwt_config_t *cfg, uint8_t sts_mode, uint16_t psdu_len);
+
+/* Log POLL + RESP airtime for SP0 / SP1 / SP3 with the current PHY settings. */
+void uwb_sts_log_airtime(const dwt_config_t *cfg);
+
+const char *uwb_sts_mode_name(void);
+
+#endif /* UWB_STS_H */
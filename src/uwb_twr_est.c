@@ -0,0 +1,110 @@
+#include <stdlib.h>
+#include <string.h>
+#include "uwb_frame.h"
+#include "uwb_twr_est.h"
+
+/* Range estimation (see uwb_twr_est.h). No RTOS dependencies: also built into
+ * the host replay tool. */
+
+double uwb_twr_ss_tof_dtu(const struct uwb_twr_ts *ts) {
+    const uint64_t ra = (ts->resp_rx - ts->poll_tx) & UWB_TS_MASK;     // tag round trip
+    const uint64_t db = (ts->resp_tx - ts->poll_rx) & UWB_TS_MASK;     // anchor reply delay
+
+    return ((double)ra - (double)db) / 2.0;
+}
+
+static uint32_t tof_to_mm(double tof) {
+    if (tof <= 0.0) {
+        return 0;
+    }
+    const double distance = tof * UWB_TWR_DTU_S * UWB_TWR_C_M_S;
+
+    return (uint32_t)((distance * 1000.0) + 0.5);
+}
+
+uint32_t uwb_twr_ss_dist_mm(const struct uwb_twr_ts *ts) {
+    return tof_to_mm(uwb_twr_ss_tof_dtu(ts));
+}
+
+double uwb_twr_ds_tof_dtu(const struct uwb_twr_ts *ts, uint64_t final_rx) {
+    const double ra = (double)((ts->resp_rx - ts->poll_tx) & UWB_TS_MASK);   // initiator round trip
+    const double db = (double)((ts->resp_tx - ts->poll_rx) & UWB_TS_MASK);   // responder reply delay
+    const double rb = (double)((final_rx - ts->resp_tx) & UWB_TS_MASK);      // responder round trip
+    const double da = (double)((ts->final_tx - ts->resp_rx) & UWB_TS_MASK);  // initiator reply delay
+    const double sum = ra + rb + da + db;
+
+    return (sum > 0.0) ? (ra * rb - da * db) / sum : 0.0;
+}
+
+uint32_t uwb_twr_ds_dist_mm(const struct uwb_twr_ts *ts, uint64_t final_rx) {
+    return tof_to_mm(uwb_twr_ds_tof_dtu(ts, final_rx));
+}
+
+uint8_t uwb_est_quality(int8_t status, uint32_t dist_mm, uint32_t report_mm, bool toa_mismatch) {
+    if (status || dist_mm == 0) {
+        return 0;
+    }
+    uint8_t q = 100;
+
+    if (toa_mismatch) {
+        q -= 50;
+    }
+    if (report_mm == 0) {
+        q -= 20;
+    } else if (abs((int32_t)(dist_mm - report_mm)) > UWB_EST_REPORT_TOL_MM) {
+        q -= 30;
+    }
+    return q;
+}
+
+void uwb_range_filter_init(struct uwb_range_filter *f) {
+    memset(f, 0, sizeof(*f));
+    f->alpha_q8 = UWB_EST_ALPHA_Q8;
+    f->beta_q8 = UWB_EST_BETA_Q8;
+    f->gap_ms = UWB_EST_FILT_GAP_MS;
+}
+
+static struct uwb_range_track *track_get(struct uwb_range_filter *f, uint16_t anchor) {
+    for (int i = 0; i < UWB_EST_ANCHORS; i++) {
+        if (f->tracks[i].anchor == anchor) {
+            return &f->tracks[i];
+        }
+    }
+    struct uwb_range_track *t = &f->tracks[f->next];
+
+    f->next = (uint8_t)((f->next + 1) % UWB_EST_ANCHORS);
+    *t = (struct uwb_range_track){ .anchor = anchor };
+    return t;
+}
+
+bool uwb_range_filter_update(struct uwb_range_filter *f, uint16_t anchor, uint32_t t_ms,
+                             bool valid, uint32_t dist_mm, uint32_t *filt_mm,
+                             int16_t *vel_cm_s) {
+    bool reset = false;
+
+    if (anchor == 0) {
+        return false;
+    }
+    struct uwb_range_track *t = track_get(f, anchor);
+    const int32_t dt_ms = (int32_t)(t_ms - t->t_ms);
+
+    if (valid && (t->t_ms == 0 || dt_ms <= 0 || dt_ms > f->gap_ms)) {
+        t->x_mm = (int32_t)dist_mm;
+        t->v_mm_s = 0;
+        t->t_ms = t_ms ? t_ms : 1;
+        reset = true;
+    } else if (valid) {
+        const int32_t pred = t->x_mm + (int32_t)((int64_t)t->v_mm_s * dt_ms / 1000);
+        const int32_t r = (int32_t)dist_mm - pred;
+
+        t->x_mm = pred + (f->alpha_q8 * r) / 256;
+        t->v_mm_s += (int32_t)((int64_t)f->beta_q8 * r * 1000 / 256 / dt_ms);
+        t->t_ms = t_ms;
+    }
+
+    const int32_t v_cm_s = t->v_mm_s / 10;
+
+    *filt_mm = t->x_mm > 0 ? (uint32_t)t->x_mm : 0;
+    *vel_cm_s = (int16_t)(v_cm_s < INT16_MIN ? INT16_MIN : v_cm_s > INT16_MAX ? INT16_MAX : v_cm_s);
+    return reset;
+}
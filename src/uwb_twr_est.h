@@ -0,0 +1,87 @@
+#ifndef UWB_TWR_EST_H
+#define UWB_TWR_EST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Tag-side range estimation: SS-TWR distance from the raw timestamps, the
+ * per-anchor alpha-beta filter and the quality score of the range stream.
+ * Plain C: the firmware and the host replay tool (host/capture) build the
+ * same code, so a captured session replays to the same numbers. */
+
+#define UWB_TWR_C_M_S           299702547.0             // in air
+#define UWB_TWR_DTU_S           (1.0 / (499.2e6 * 128.0))
+
+// Alpha-beta range filter gains (Q8) and reset gap
+#ifndef UWB_EST_ALPHA_Q8
+#define UWB_EST_ALPHA_Q8        128     // 0.5
+#endif
+#ifndef UWB_EST_BETA_Q8
+#define UWB_EST_BETA_Q8         26      // ~0.1
+#endif
+#ifndef UWB_EST_FILT_GAP_MS
+#define UWB_EST_FILT_GAP_MS     3000    // restart the filter after this long without a range
+#endif
+
+// SS-TWR vs. anchor DS-TWR disagreement that lowers the quality score
+#ifndef UWB_EST_REPORT_TOL_MM
+#define UWB_EST_REPORT_TOL_MM   150
+#endif
+
+#define UWB_EST_ANCHORS         4
+
+/* Raw 40-bit timestamps of one exchange (DTU). poll_tx/resp_rx/final_tx are
+ * the initiator's, poll_rx/resp_tx the responder's: normally the tag and the
+ * anchor (from its RESP), swapped in responder mode (anchor's FINAL). */
+struct uwb_twr_ts {
+    uint64_t poll_tx;
+    uint64_t resp_rx;
+    uint64_t poll_rx;
+    uint64_t resp_tx;
+    uint64_t final_tx;
+};
+
+/* SS-TWR time of flight, (Ra - Db) / 2 in DTU, with 40-bit wrap handling */
+double uwb_twr_ss_tof_dtu(const struct uwb_twr_ts *ts);
+
+/* SS-TWR distance in mm, 0 if the time of flight is not positive */
+uint32_t uwb_twr_ss_dist_mm(const struct uwb_twr_ts *ts);
+
+/* Asymmetric DS-TWR time of flight in DTU, (Ra * Rb - Da * Db) / (Ra + Rb +
+ * Da + Db), on the responder side: final_rx is its FINAL arrival. The clock
+ * offset between the two ends cancels to first order. */
+double uwb_twr_ds_tof_dtu(const struct uwb_twr_ts *ts, uint64_t final_rx);
+
+/* DS-TWR distance in mm, 0 if the time of flight is not positive */
+uint32_t uwb_twr_ds_dist_mm(const struct uwb_twr_ts *ts, uint64_t final_rx);
+
+/* 100 for a clean exchange; lowered by a first-path mismatch, a missing anchor
+ * REPORT or a REPORT that disagrees with the tag's own estimate. */
+uint8_t uwb_est_quality(int8_t status, uint32_t dist_mm, uint32_t report_mm, bool toa_mismatch);
+
+struct uwb_range_track {
+    uint16_t anchor;
+    uint32_t t_ms;          // last update, 0 = no range yet
+    int32_t x_mm;           // filtered distance
+    int32_t v_mm_s;         // filtered range rate
+};
+
+struct uwb_range_filter {
+    int32_t alpha_q8;
+    int32_t beta_q8;
+    int32_t gap_ms;
+    struct uwb_range_track tracks[UWB_EST_ANCHORS];
+    uint8_t next;           // round-robin slot for a new anchor
+};
+
+/* Gains from UWB_EST_*; the host may change them afterwards */
+void uwb_range_filter_init(struct uwb_range_filter *f);
+
+/* Alpha-beta filter on the SS-TWR distance of `anchor` (0 = nobody answered:
+ * no output). An invalid range leaves the track untouched and reports its
+ * prediction. Returns true if the track was (re)started on this range. */
+bool uwb_range_filter_update(struct uwb_range_filter *f, uint16_t anchor, uint32_t t_ms,
+                             bool valid, uint32_t dist_mm, uint32_t *filt_mm,
+                             int16_t *vel_cm_s);
+
+#endif /* UWB_TWR_EST_H */
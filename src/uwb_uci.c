@@ -0,0 +1,198 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/ring_buffer.h>
+#include <zephyr/usb/usb_device.h>
+#include <errno.h>
+#include "uwb_frame.h"
+#include "uwb_ranging.h"
+#include "uwb_uci_proto.h"
+#include "uwb_uci.h"
+#include "uwb_rangelog.h"
+
+LOG_MODULE_REGISTER(uwb_uci, LOG_LEVEL_INF);
+
+// A partial packet older than this is dropped (host restarted mid-packet)
+#define UCI_RX_GAP_MS       50
+
+static const struct device *const uci_dev = DEVICE_DT_GET(DT_CHOSEN(uwb_uci_uart));
+
+RING_BUF_DECLARE(uci_rx_ring, CONFIG_UWB_UCI_RX_BUF_SIZE);
+static K_SEM_DEFINE(uci_rx_sem, 0, 1);
+
+/* uci_device_handle() (uwb_uci thread) and uci_device_range_ntf() (consumer
+ * thread) share the session state and the TX path */
+static K_MUTEX_DEFINE(uci_lock);
+
+static struct {
+    uint32_t rx_overflow;   // bytes lost because the RX ring was full
+    uint32_t rx_resync;     // partial packets dropped after UCI_RX_GAP_MS
+    uint32_t ntf_dropped;   // range notifications not sent (host not connected)
+} uci_stats;
+
+static void uci_uart_isr(const struct device *dev, void *user_data) {
+    ARG_UNUSED(user_data);
+
+    while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+        if (!uart_irq_rx_ready(dev)) {
+            continue;
+        }
+        uint8_t buf[64];
+        const int n = uart_fifo_read(dev, buf, sizeof(buf));
+
+        if (n > 0) {
+            const uint32_t put = ring_buf_put(&uci_rx_ring, buf, n);
+
+            uci_stats.rx_overflow += n - put;
+            k_sem_give(&uci_rx_sem);
+        }
+    }
+}
+
+static bool host_connected(void) {
+    uint32_t dtr = 0;
+
+    return uart_line_ctrl_get(uci_dev, UART_LINE_CTRL_DTR, &dtr) == 0 && dtr;
+}
+
+static void uci_send(const uint8_t *pkt, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) {
+        uart_poll_out(uci_dev, pkt[i]);
+    }
+}
+
+static int uci_ranging_start(uint32_t interval_ms) {
+    uwb_ranging_resume(interval_ms);
+    LOG_INF("UCI: ranging started, interval %u ms", interval_ms);
+    return 0;
+}
+
+static void uci_ranging_stop(void) {
+    uwb_ranging_pause();
+    LOG_INF("UCI: ranging stopped (RX overflow %u, resync %u, notifications dropped %u)",
+            uci_stats.rx_overflow, uci_stats.rx_resync, uci_stats.ntf_dropped);
+}
+
+#if defined(CONFIG_UWB_RANGELOG)
+static int uci_log_info(struct uci_log_info *out) {
+    struct uwb_rangelog_stats st;
+
+    uwb_rangelog_get_stats(&st);
+    *out = (struct uci_log_info){
+        .capacity = st.capacity,
+        .used = st.used,
+        .blocks = st.blocks,
+        .records = st.records,
+        .lost = st.lost,
+        .erases = st.erases,
+        .pending = st.pending,
+    };
+    return 0;
+}
+
+static int uci_log_read(bool restart, uint8_t *buf, uint8_t max, uint16_t *block_len,
+                        uint16_t *offset) {
+    return uwb_rangelog_read(restart, buf, max, block_len, offset);
+}
+#endif
+
+static const struct uci_device_ops uci_ops = {
+    .ranging_start = uci_ranging_start,
+    .ranging_stop = uci_ranging_stop,
+    .send = uci_send,
+    .mac = UWB_TAG_ADDR,
+    .channel = 5,
+    .vendor_info = "uwb-tag " CONFIG_APP_VERSION,
+#if defined(CONFIG_UWB_RANGELOG)
+    .log_info = uci_log_info,
+    .log_read = uci_log_read,
+    .log_erase = uwb_rangelog_erase,
+#endif
+};
+
+void uwb_uci_report(const struct uwb_range_result *res) {
+    struct uci_range_meas m = {
+        .mac = res->anchor,
+        .status = UCI_STATUS_OK,
+        .nlos = (res->flags & UWB_RANGE_FLAG_TOA) ? 1 : 0,
+        .dist_mm = res->dist_mm,
+        .report_mm = res->report_mm,
+        .toa_diff_dtu = (int16_t)CLAMP(res->toa_diff_dtu, INT16_MIN, INT16_MAX),
+    };
+
+    if (res->status == UWB_RANGE_ERR_RESP) {
+        m.status = UCI_STATUS_RANGING_RX_TIMEOUT;
+    } else if (res->status) {
+        m.status = UCI_STATUS_RANGING_TX_FAILED;
+    } else if (res->dist_mm == 0) {
+        m.status = UCI_STATUS_RANGING_TOA_FAILED;
+    }
+
+    if (!host_connected()) {
+        uci_stats.ntf_dropped++;
+        return;
+    }
+    k_mutex_lock(&uci_lock, K_FOREVER);
+    (void)uci_device_range_ntf(&m, 1);
+    k_mutex_unlock(&uci_lock);
+}
+
+static void uci_thread(void *p1, void *p2, void *p3) {
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    static struct uci_parser parser;
+
+    k_mutex_lock(&uci_lock, K_FOREVER);
+    uci_device_init(&uci_ops);
+    k_mutex_unlock(&uci_lock);
+
+    while (1) {
+        // Wait forever between packets, but only UCI_RX_GAP_MS inside one
+        if (k_sem_take(&uci_rx_sem, parser.n ? K_MSEC(UCI_RX_GAP_MS) : K_FOREVER) != 0) {
+            uci_parser_reset(&parser);
+            uci_stats.rx_resync++;
+            continue;
+        }
+
+        uint8_t byte;
+        while (ring_buf_get(&uci_rx_ring, &byte, 1) == 1) {
+            const uint16_t len = uci_parser_feed(&parser, byte);
+
+            if (len) {
+                k_mutex_lock(&uci_lock, K_FOREVER);
+                uci_device_handle(parser.buf, len);
+                k_mutex_unlock(&uci_lock);
+            }
+        }
+    }
+}
+
+K_THREAD_STACK_DEFINE(uci_stack, CONFIG_UWB_UCI_THREAD_STACK_SIZE);
+static struct k_thread uci_thread_data;
+
+int uwb_uci_start(void) {
+    if (!device_is_ready(uci_dev)) {
+        LOG_ERR("UCI port not ready");
+        return -ENODEV;
+    }
+
+    const int ret = usb_enable(NULL);
+    if (ret != 0 && ret != -EALREADY) {
+        LOG_ERR("usb_enable failed (%d)", ret);
+        return ret;
+    }
+
+    uart_irq_callback_set(uci_dev, uci_uart_isr);
+    uart_irq_rx_enable(uci_dev);
+
+    k_thread_create(&uci_thread_data, uci_stack, K_THREAD_STACK_SIZEOF(uci_stack),
+                    uci_thread, NULL, NULL, NULL,
+                    CONFIG_UWB_UCI_THREAD_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(&uci_thread_data, "uwb_uci");
+
+    LOG_INF("UCI host interface on %s, ranging waits for RANGE_START", uci_dev->name);
+    return 0;
+}
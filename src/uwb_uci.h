@@ -0,0 +1,17 @@
+#ifndef UWB_UCI_H
+#define UWB_UCI_H
+
+#include "uwb_ranging.h"
+
+/* UCI host interface over USB CDC ACM (CONFIG_UWB_UCI). Protocol and session
+ * handling live in uwb_uci_proto.c; this is the Zephyr transport and the glue
+ * to the ranging threads. */
+
+/* Enable USB, open the UCI port and start the uwb_uci thread. */
+int uwb_uci_start(void);
+
+/* Consumer thread: forward one result as RANGE_DATA_NTF (no-op without an
+ * active session or when the host is not connected). */
+void uwb_uci_report(const struct uwb_range_result *res);
+
+#endif /* UWB_UCI_H */
@@ -0,0 +1,498 @@
+#include <string.h>
+#include "uwb_frame.h"
+#include "uwb_uci_proto.h"
+
+/* UCI packet handling and session state machine (see uwb_uci_proto.h).
+ * No RTOS dependencies: also built into the host loopback stand-in. */
+
+#define UCI_VERSION         0x0101  // generic / MAC / PHY version reported (1.1)
+#define NTF_MAX_MEAS        ((UCI_MAX_PAYLOAD - UCI_RANGE_NTF_HDR_LEN) / UCI_RANGE_MEAS_LEN)
+
+struct uci_session {
+    bool exists;
+    uint8_t state;          // UCI_SESSION_STATE_*
+    uint32_t id;
+    uint32_t interval_ms;
+    uint32_t ntf_seq;       // RANGE_DATA_NTF sequence, reset on RANGE_START
+};
+
+static const struct uci_device_ops *dev_ops;
+static struct uci_session session;
+
+uint16_t uci_pkt_build(uint8_t *out, uint8_t mt, uint8_t gid, uint8_t oid,
+                       const uint8_t *payload, uint8_t len) {
+    out[0] = (uint8_t)((mt << 5) | (gid & 0x0F));
+    out[1] = oid & 0x3F;
+    out[2] = 0;
+    out[3] = len;
+    if (len) {
+        memcpy(&out[UCI_HDR_LEN], payload, len);
+    }
+    return UCI_HDR_LEN + len;
+}
+
+uint16_t uci_parser_feed(struct uci_parser *p, uint8_t byte) {
+    p->buf[p->n++] = byte;
+    if (p->n < UCI_HDR_LEN) {
+        return 0;
+    }
+    const uint16_t total = UCI_HDR_LEN + p->buf[3];
+
+    if (p->n < total) {
+        return 0;
+    }
+    p->n = 0;
+    return total;
+}
+
+static void send_msg(uint8_t mt, uint8_t gid, uint8_t oid, const uint8_t *payload, uint8_t len) {
+    uint8_t pkt[UCI_MAX_PKT];
+
+    dev_ops->send(pkt, uci_pkt_build(pkt, mt, gid, oid, payload, len));
+}
+
+static void send_status_rsp(uint8_t gid, uint8_t oid, uint8_t status) {
+    send_msg(UCI_MT_RSP, gid, oid, &status, 1);
+}
+
+static void send_session_status(uint8_t state) {
+    uint8_t p[6];
+
+    uwb_put_u32(&p[0], session.id);
+    p[4] = state;
+    p[5] = 0x00;            // reason: state change by session management command
+    send_msg(UCI_MT_NTF, UCI_GID_SESSION_CFG, UCI_OID_SESSION_STATUS, p, sizeof(p));
+}
+
+static void send_device_status(uint8_t state) {
+    send_msg(UCI_MT_NTF, UCI_GID_CORE, UCI_OID_DEVICE_STATUS, &state, 1);
+}
+
+static void session_set_state(uint8_t state) {
+    session.state = state;
+    send_session_status(state);
+}
+
+/* Common session id check; returns a UCI status */
+static uint8_t session_lookup(const uint8_t *payload, uint8_t len, uint8_t min_len) {
+    if (len < min_len) {
+        return UCI_STATUS_SYNTAX_ERROR;
+    }
+    if (!session.exists || uwb_get_u32(payload) != session.id) {
+        return UCI_STATUS_SESSION_NOT_EXIST;
+    }
+    return UCI_STATUS_OK;
+}
+
+static void session_stop(void) {
+    if (session.state == UCI_SESSION_STATE_ACTIVE) {
+        dev_ops->ranging_stop();
+        session_set_state(UCI_SESSION_STATE_IDLE);
+    }
+}
+
+// ================= Core group =================
+static void core_cmd(uint8_t oid, const uint8_t *payload, uint8_t len) {
+    switch (oid) {
+    case UCI_OID_DEVICE_RESET:
+        send_status_rsp(UCI_GID_CORE, oid, UCI_STATUS_OK);
+        session_stop();
+        if (session.exists) {
+            session_set_state(UCI_SESSION_STATE_DEINIT);
+        }
+        memset(&session, 0, sizeof(session));
+        send_device_status(UCI_DEVICE_STATE_READY);
+        break;
+
+    case UCI_OID_DEVICE_INFO: {
+        const char *vendor = dev_ops->vendor_info ? dev_ops->vendor_info : "";
+        const size_t vlen = strnlen(vendor, UCI_MAX_PAYLOAD - 10);
+        uint8_t p[UCI_MAX_PAYLOAD];
+
+        p[0] = UCI_STATUS_OK;
+        uwb_put_u16(&p[1], UCI_VERSION);    // generic
+        uwb_put_u16(&p[3], UCI_VERSION);    // MAC
+        uwb_put_u16(&p[5], UCI_VERSION);    // PHY
+        uwb_put_u16(&p[7], 0);              // test
+        p[9] = (uint8_t)vlen;
+        memcpy(&p[10], vendor, vlen);
+        send_msg(UCI_MT_RSP, UCI_GID_CORE, oid, p, (uint8_t)(10 + vlen));
+        break;
+    }
+
+    default:
+        send_status_rsp(UCI_GID_CORE, oid, UCI_STATUS_UNKNOWN_OID);
+        break;
+    }
+    (void)payload;
+    (void)len;
+}
+
+// ================= App config =================
+/* Apply one parameter. Returns a UCI status. */
+static uint8_t cfg_set(uint8_t id, const uint8_t *v, uint8_t vlen) {
+    switch (id) {
+    case UCI_CFG_RANGING_INTERVAL: {
+        if (vlen != 4) {
+            return UCI_STATUS_INVALID_PARAM;
+        }
+        const uint32_t ms = uwb_get_u32(v);
+
+        if (ms < UCI_RANGING_INTERVAL_MIN_MS || ms > UCI_RANGING_INTERVAL_MAX_MS) {
+            return UCI_STATUS_INVALID_RANGE;
+        }
+        session.interval_ms = ms;
+        return UCI_STATUS_OK;
+    }
+    case UCI_CFG_CHANNEL_NUMBER:
+    case UCI_CFG_DEVICE_MAC_ADDRESS:
+        return UCI_STATUS_READ_ONLY;
+    default:
+        return UCI_STATUS_INVALID_PARAM;
+    }
+}
+
+/* Append id/len/value to out. Returns bytes written, 0 if unknown or no room. */
+static uint8_t cfg_get(uint8_t id, uint8_t *out, uint16_t room) {
+    switch (id) {
+    case UCI_CFG_RANGING_INTERVAL:
+        if (room < 6) {
+            return 0;
+        }
+        out[0] = id;
+        out[1] = 4;
+        uwb_put_u32(&out[2], session.interval_ms);
+        return 6;
+    case UCI_CFG_DEVICE_MAC_ADDRESS:
+        if (room < 4) {
+            return 0;
+        }
+        out[0] = id;
+        out[1] = 2;
+        uwb_put_u16(&out[2], dev_ops->mac);
+        return 4;
+    case UCI_CFG_CHANNEL_NUMBER:
+        if (room < 3) {
+            return 0;
+        }
+        out[0] = id;
+        out[1] = 1;
+        out[2] = dev_ops->channel;
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+static void set_app_config(const uint8_t *payload, uint8_t len) {
+    uint8_t rsp[2 + 2 * 32];
+    uint8_t nbad = 0;
+    uint8_t status = session_lookup(payload, len, 5);
+
+    if (status == UCI_STATUS_OK && session.state == UCI_SESSION_STATE_ACTIVE) {
+        status = UCI_STATUS_SESSION_ACTIVE;
+    }
+    if (status != UCI_STATUS_OK) {
+        rsp[0] = status;
+        rsp[1] = 0;
+        send_msg(UCI_MT_RSP, UCI_GID_SESSION_CFG, UCI_OID_SET_APP_CONFIG, rsp, 2);
+        return;
+    }
+
+    const uint8_t n = payload[4];
+    uint16_t pos = 5;
+
+    for (uint8_t i = 0; i < n; i++) {
+        if (pos + 2 > len || pos + 2 + payload[pos + 1] > len) {
+            rsp[0] = UCI_STATUS_SYNTAX_ERROR;
+            rsp[1] = 0;
+            send_msg(UCI_MT_RSP, UCI_GID_SESSION_CFG, UCI_OID_SET_APP_CONFIG, rsp, 2);
+            return;
+        }
+        const uint8_t id = payload[pos];
+        const uint8_t vlen = payload[pos + 1];
+        const uint8_t st = cfg_set(id, &payload[pos + 2], vlen);
+
+        if (st != UCI_STATUS_OK && nbad < 32) {
+            rsp[2 + 2 * nbad] = id;
+            rsp[3 + 2 * nbad] = st;
+            nbad++;
+        }
+        pos += 2 + vlen;
+    }
+    rsp[0] = nbad ? UCI_STATUS_INVALID_PARAM : UCI_STATUS_OK;
+    rsp[1] = nbad;
+    send_msg(UCI_MT_RSP, UCI_GID_SESSION_CFG, UCI_OID_SET_APP_CONFIG, rsp, (uint8_t)(2 + 2 * nbad));
+    if (session.state == UCI_SESSION_STATE_INIT && nbad == 0) {
+        session_set_state(UCI_SESSION_STATE_IDLE);
+    }
+}
+
+static void get_app_config(const uint8_t *payload, uint8_t len) {
+    static const uint8_t all[] = {
+        UCI_CFG_CHANNEL_NUMBER, UCI_CFG_DEVICE_MAC_ADDRESS, UCI_CFG_RANGING_INTERVAL
+    };
+    uint8_t rsp[UCI_MAX_PAYLOAD];
+    uint8_t status = session_lookup(payload, len, 5);
+
+    if (status == UCI_STATUS_OK && len < 5 + payload[4]) {
+        status = UCI_STATUS_SYNTAX_ERROR;
+    }
+    if (status != UCI_STATUS_OK) {
+        rsp[0] = status;
+        rsp[1] = 0;
+        send_msg(UCI_MT_RSP, UCI_GID_SESSION_CFG, UCI_OID_GET_APP_CONFIG, rsp, 2);
+        return;
+    }
+
+    const uint8_t n = payload[4] ? payload[4] : sizeof(all);
+    const uint8_t *ids = payload[4] ? &payload[5] : all;
+    uint16_t pos = 2;
+    uint8_t count = 0;
+
+    rsp[0] = UCI_STATUS_OK;
+    for (uint8_t i = 0; i < n; i++) {
+        const uint8_t w = cfg_get(ids[i], &rsp[pos], sizeof(rsp) - pos);
+
+        if (w == 0) {
+            rsp[0] = UCI_STATUS_INVALID_PARAM;
+            continue;
+        }
+        pos += w;
+        count++;
+    }
+    rsp[1] = count;
+    send_msg(UCI_MT_RSP, UCI_GID_SESSION_CFG, UCI_OID_GET_APP_CONFIG, rsp, (uint8_t)pos);
+}
+
+// ================= Session config group =================
+static void session_cfg_cmd(uint8_t oid, const uint8_t *payload, uint8_t len) {
+    uint8_t status;
+
+    switch (oid) {
+    case UCI_OID_SESSION_INIT:
+        if (len < 5) {
+            status = UCI_STATUS_SYNTAX_ERROR;
+        } else if (payload[4] != UCI_SESSION_TYPE_RANGING) {
+            status = UCI_STATUS_INVALID_PARAM;
+        } else if (session.exists) {
+            status = (uwb_get_u32(payload) == session.id) ? UCI_STATUS_SESSION_DUPLICATE
+                                                          : UCI_STATUS_MAX_SESSIONS;
+        } else {
+            status = UCI_STATUS_OK;
+        }
+        send_status_rsp(UCI_GID_SESSION_CFG, oid, status);
+        if (status == UCI_STATUS_OK) {
+            session = (struct uci_session){
+                .exists = true,
+                .id = uwb_get_u32(payload),
+                .interval_ms = 1000,
+            };
+            session_set_state(UCI_SESSION_STATE_INIT);
+        }
+        break;
+
+    case UCI_OID_SESSION_DEINIT:
+        status = session_lookup(payload, len, 4);
+        send_status_rsp(UCI_GID_SESSION_CFG, oid, status);
+        if (status == UCI_STATUS_OK) {
+            session_stop();
+            session_set_state(UCI_SESSION_STATE_DEINIT);
+            session.exists = false;
+        }
+        break;
+
+    case UCI_OID_SET_APP_CONFIG:
+        set_app_config(payload, len);
+        break;
+
+    case UCI_OID_GET_APP_CONFIG:
+        get_app_config(payload, len);
+        break;
+
+    case UCI_OID_SESSION_STATE: {
+        uint8_t rsp[2] = { session_lookup(payload, len, 4), 0 };
+
+        rsp[1] = session.state;
+        send_msg(UCI_MT_RSP, UCI_GID_SESSION_CFG, oid, rsp, rsp[0] == UCI_STATUS_OK ? 2 : 1);
+        break;
+    }
+
+    default:
+        send_status_rsp(UCI_GID_SESSION_CFG, oid, UCI_STATUS_UNKNOWN_OID);
+        break;
+    }
+}
+
+// ================= Session control group =================
+static void session_ctrl_cmd(uint8_t oid, const uint8_t *payload, uint8_t len) {
+    uint8_t status = session_lookup(payload, len, 4);
+
+    switch (oid) {
+    case UCI_OID_RANGE_START:
+        if (status == UCI_STATUS_OK && session.state == UCI_SESSION_STATE_ACTIVE) {
+            status = UCI_STATUS_SESSION_ACTIVE;
+        } else if (status == UCI_STATUS_OK && session.state != UCI_SESSION_STATE_IDLE) {
+            status = UCI_STATUS_REJECTED;   // not configured yet
+        } else if (status == UCI_STATUS_OK && dev_ops->ranging_start(session.interval_ms) != 0) {
+            status = UCI_STATUS_FAILED;
+        }
+        send_status_rsp(UCI_GID_SESSION_CTRL, oid, status);
+        if (status == UCI_STATUS_OK) {
+            session.ntf_seq = 0;
+            session_set_state(UCI_SESSION_STATE_ACTIVE);
+        }
+        break;
+
+    case UCI_OID_RANGE_STOP:
+        if (status == UCI_STATUS_OK && session.state != UCI_SESSION_STATE_ACTIVE) {
+            status = UCI_STATUS_REJECTED;
+        }
+        send_status_rsp(UCI_GID_SESSION_CTRL, oid, status);
+        if (status == UCI_STATUS_OK) {
+            session_stop();
+        }
+        break;
+
+    default:
+        send_status_rsp(UCI_GID_SESSION_CTRL, oid, UCI_STATUS_UNKNOWN_OID);
+        break;
+    }
+}
+
+// ================= Range log group =================
+static void log_cmd(uint8_t oid, const uint8_t *payload, uint8_t len) {
+    uint8_t p[UCI_MAX_PAYLOAD];
+
+    switch (oid) {
+    case UCI_OID_LOG_INFO: {
+        struct uci_log_info info;
+
+        if (dev_ops->log_info(&info) != 0) {
+            send_status_rsp(UCI_GID_LOG, oid, UCI_STATUS_FAILED);
+            break;
+        }
+        p[0] = UCI_STATUS_OK;
+        uwb_put_u32(&p[1], info.capacity);
+        uwb_put_u32(&p[5], info.used);
+        uwb_put_u32(&p[9], info.blocks);
+        uwb_put_u32(&p[13], info.records);
+        uwb_put_u32(&p[17], info.lost);
+        uwb_put_u32(&p[21], info.erases);
+        uwb_put_u16(&p[25], info.pending);
+        send_msg(UCI_MT_RSP, UCI_GID_LOG, oid, p, UCI_LOG_INFO_LEN);
+        break;
+    }
+
+    case UCI_OID_LOG_READ: {
+        uint16_t block_len = 0;
+        uint16_t offset = 0;
+
+        if (len < 1) {
+            send_status_rsp(UCI_GID_LOG, oid, UCI_STATUS_SYNTAX_ERROR);
+            break;
+        }
+        const int n = dev_ops->log_read(payload[0] != 0, &p[UCI_LOG_READ_HDR_LEN],
+                                        UCI_LOG_READ_MAX, &block_len, &offset);
+
+        if (n < 0) {
+            send_status_rsp(UCI_GID_LOG, oid, UCI_STATUS_FAILED);
+            break;
+        }
+        p[0] = UCI_STATUS_OK;
+        uwb_put_u16(&p[1], n ? block_len : 0);
+        uwb_put_u16(&p[3], n ? offset : 0);
+        send_msg(UCI_MT_RSP, UCI_GID_LOG, oid, p, (uint8_t)(UCI_LOG_READ_HDR_LEN + n));
+        break;
+    }
+
+    case UCI_OID_LOG_ERASE:
+        send_status_rsp(UCI_GID_LOG, oid,
+                        dev_ops->log_erase() == 0 ? UCI_STATUS_OK : UCI_STATUS_FAILED);
+        break;
+
+    default:
+        send_status_rsp(UCI_GID_LOG, oid, UCI_STATUS_UNKNOWN_OID);
+        break;
+    }
+}
+
+void uci_device_init(const struct uci_device_ops *ops) {
+    dev_ops = ops;
+    memset(&session, 0, sizeof(session));
+    send_device_status(UCI_DEVICE_STATE_READY);
+}
+
+void uci_device_handle(const uint8_t *pkt, uint16_t len) {
+    if (len < UCI_HDR_LEN || uci_hdr_mt(pkt) != UCI_MT_CMD) {
+        return;     // responses/notifications from the host are ignored
+    }
+    const uint8_t gid = uci_hdr_gid(pkt);
+    const uint8_t oid = uci_hdr_oid(pkt);
+    const uint8_t *payload = &pkt[UCI_HDR_LEN];
+    const uint8_t plen = pkt[3];
+
+    if (len != UCI_HDR_LEN + plen) {
+        send_status_rsp(gid, oid, UCI_STATUS_INVALID_MSG_SIZE);
+        return;
+    }
+
+    switch (gid) {
+    case UCI_GID_CORE:
+        core_cmd(oid, payload, plen);
+        break;
+    case UCI_GID_SESSION_CFG:
+        session_cfg_cmd(oid, payload, plen);
+        break;
+    case UCI_GID_SESSION_CTRL:
+        session_ctrl_cmd(oid, payload, plen);
+        break;
+    case UCI_GID_LOG:
+        if (dev_ops->log_read) {
+            log_cmd(oid, payload, plen);
+            break;
+        }
+        send_status_rsp(gid, oid, UCI_STATUS_UNKNOWN_GID);
+        break;
+    default:
+        send_status_rsp(gid, oid, UCI_STATUS_UNKNOWN_GID);
+        break;
+    }
+}
+
+bool uci_device_range_ntf(const struct uci_range_meas *m, uint8_t n) {
+    uint8_t p[UCI_MAX_PAYLOAD];
+
+    if (!session.exists || session.state != UCI_SESSION_STATE_ACTIVE) {
+        return false;
+    }
+    if (n > NTF_MAX_MEAS) {
+        n = NTF_MAX_MEAS;
+    }
+
+    uwb_put_u32(&p[0], session.ntf_seq++);
+    uwb_put_u32(&p[4], session.id);
+    uwb_put_u32(&p[8], session.interval_ms);
+    p[12] = UCI_MEAS_TYPE_TWR;
+    p[13] = n;
+
+    uint8_t *q = &p[UCI_RANGE_NTF_HDR_LEN];
+    for (uint8_t i = 0; i < n; i++, q += UCI_RANGE_MEAS_LEN) {
+        const uint32_t cm = (m[i].dist_mm + 5) / 10;
+
+        uwb_put_u16(&q[0], m[i].mac);
+        q[2] = m[i].status;
+        q[3] = m[i].nlos;
+        uwb_put_u16(&q[4], (uint16_t)(cm > UINT16_MAX ? UINT16_MAX : cm));
+        uwb_put_u32(&q[6], m[i].dist_mm);
+        uwb_put_u32(&q[10], m[i].report_mm);
+        uwb_put_u16(&q[14], (uint16_t)m[i].toa_diff_dtu);
+    }
+    send_msg(UCI_MT_NTF, UCI_GID_SESSION_CTRL, UCI_OID_RANGE_START, p,
+             (uint8_t)(UCI_RANGE_NTF_HDR_LEN + n * UCI_RANGE_MEAS_LEN));
+    return true;
+}
+
+bool uci_device_session_active(void) {
+    return session.exists && session.state == UCI_SESSION_STATE_ACTIVE;
+}
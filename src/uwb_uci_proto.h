@@ -0,0 +1,199 @@
+#ifndef UWB_UCI_PROTO_H
+#define UWB_UCI_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Binary host interface modelled on FiRa UCI. Plain C (no Zephyr): the same
+ * packet format, command handling and session state machine are linked into
+ * the firmware (uwb_uci.c) and into the host loopback stand-in (host/uci).
+ *
+ * Packet: 4-byte header + payload (max 255), multi-byte fields little endian.
+ *   [0] MT(3) << 5 | PBF(1) << 4 | GID(4)    MT: 1 = command, 2 = response, 3 = notification
+ *   [1] OID (6 bits)
+ *   [2] RFU (0)
+ *   [3] payload length
+ * Segmentation (PBF) is not used: every message fits one packet.
+ *
+ * Commands (every command gets exactly one response, status byte first):
+ *   CORE_DEVICE_RESET       00/00  reset_cfg(1)                       -> status
+ *   CORE_DEVICE_INFO        00/02  -                                  -> status, versions, vendor info
+ *   SESSION_INIT            01/00  session_id(4) type(1)              -> status
+ *   SESSION_DEINIT          01/01  session_id(4)                      -> status
+ *   SESSION_SET_APP_CONFIG  01/03  session_id(4) n(1) {id len value}  -> status n {id status}
+ *   SESSION_GET_APP_CONFIG  01/04  session_id(4) n(1) {id} (0 = all)  -> status n {id len value}
+ *   SESSION_GET_STATE       01/06  session_id(4)                      -> status state
+ *   RANGE_START             02/00  session_id(4)                      -> status
+ *   RANGE_STOP              02/01  session_id(4)                      -> status
+ * Range log (proprietary group, only if the device has one, see uwb_rangelog.h):
+ *   LOG_INFO                0A/00  -                                  -> status capacity(4) used(4)
+ *                                  blocks(4) records(4) lost(4) erases(4) pending(2)
+ *   LOG_READ                0A/01  restart(1)                         -> status block_len(2)
+ *                                  offset(2) data; no data = end of the log
+ *   LOG_ERASE               0A/02  -                                  -> status
+ *   LOG_READ returns the stored blocks in order, oldest first, in pieces of up
+ *   to UCI_LOG_READ_MAX bytes. restart = 1 writes out the partial RAM block and
+ *   starts from the oldest one. FAILED: the log wrapped over the read position.
+ * Notifications:
+ *   CORE_DEVICE_STATUS_NTF  00/01  state(1)
+ *   SESSION_STATUS_NTF      01/02  session_id(4) state(1) reason(1)
+ *   RANGE_DATA_NTF          02/00  seq(4) session_id(4) interval_ms(4) type(1) n(1)
+ *                                  n x { mac(2) status(1) nlos(1) distance_cm(2)
+ *                                        dist_mm(4) report_mm(4) toa_diff_dtu(2) }
+ * One session at a time; this tag is always the controller/initiator.
+ */
+
+#define UCI_HDR_LEN             4
+#define UCI_MAX_PAYLOAD         255
+#define UCI_MAX_PKT             (UCI_HDR_LEN + UCI_MAX_PAYLOAD)
+
+#define UCI_MT_CMD              1
+#define UCI_MT_RSP              2
+#define UCI_MT_NTF              3
+
+#define UCI_GID_CORE            0x0
+#define UCI_GID_SESSION_CFG     0x1
+#define UCI_GID_SESSION_CTRL    0x2
+#define UCI_GID_LOG             0xA     // proprietary
+
+#define UCI_OID_DEVICE_RESET    0x00
+#define UCI_OID_DEVICE_STATUS   0x01
+#define UCI_OID_DEVICE_INFO     0x02
+#define UCI_OID_SESSION_INIT    0x00
+#define UCI_OID_SESSION_DEINIT  0x01
+#define UCI_OID_SESSION_STATUS  0x02
+#define UCI_OID_SET_APP_CONFIG  0x03
+#define UCI_OID_GET_APP_CONFIG  0x04
+#define UCI_OID_SESSION_STATE   0x06
+#define UCI_OID_RANGE_START     0x00    // also RANGE_DATA_NTF
+#define UCI_OID_RANGE_STOP      0x01
+#define UCI_OID_LOG_INFO        0x00
+#define UCI_OID_LOG_READ        0x01
+#define UCI_OID_LOG_ERASE       0x02
+
+#define UCI_STATUS_OK                   0x00
+#define UCI_STATUS_REJECTED             0x01
+#define UCI_STATUS_FAILED               0x02
+#define UCI_STATUS_SYNTAX_ERROR         0x03
+#define UCI_STATUS_INVALID_PARAM        0x04
+#define UCI_STATUS_INVALID_RANGE        0x05
+#define UCI_STATUS_INVALID_MSG_SIZE     0x06
+#define UCI_STATUS_UNKNOWN_GID          0x07
+#define UCI_STATUS_UNKNOWN_OID          0x08
+#define UCI_STATUS_READ_ONLY            0x09
+#define UCI_STATUS_SESSION_NOT_EXIST    0x11
+#define UCI_STATUS_SESSION_DUPLICATE    0x12
+#define UCI_STATUS_SESSION_ACTIVE       0x13
+#define UCI_STATUS_MAX_SESSIONS         0x14
+
+// Per-measurement ranging status in RANGE_DATA_NTF
+#define UCI_STATUS_RANGING_TX_FAILED    0x20
+#define UCI_STATUS_RANGING_RX_TIMEOUT   0x21
+#define UCI_STATUS_RANGING_TOA_FAILED   0x23
+
+#define UCI_DEVICE_STATE_READY          0x01
+#define UCI_DEVICE_STATE_ACTIVE         0x02
+
+#define UCI_SESSION_STATE_INIT          0x00
+#define UCI_SESSION_STATE_DEINIT        0x01
+#define UCI_SESSION_STATE_ACTIVE        0x02
+#define UCI_SESSION_STATE_IDLE          0x03
+
+#define UCI_SESSION_TYPE_RANGING        0x00
+#define UCI_MEAS_TYPE_TWR               0x01
+
+// App config parameters (FiRa ids)
+#define UCI_CFG_CHANNEL_NUMBER          0x04    // u8, read-only
+#define UCI_CFG_DEVICE_MAC_ADDRESS      0x06    // u16, read-only
+#define UCI_CFG_RANGING_INTERVAL        0x09    // u32 ms
+
+#define UCI_RANGING_INTERVAL_MIN_MS     100
+#define UCI_RANGING_INTERVAL_MAX_MS     60000
+
+#define UCI_RANGE_MEAS_LEN              16
+#define UCI_RANGE_NTF_HDR_LEN           14
+
+#define UCI_LOG_INFO_LEN                27
+#define UCI_LOG_READ_HDR_LEN            5
+#define UCI_LOG_READ_MAX                (UCI_MAX_PAYLOAD - UCI_LOG_READ_HDR_LEN)
+
+static inline uint8_t uci_hdr_mt(const uint8_t *pkt) {
+    return pkt[0] >> 5;
+}
+
+static inline uint8_t uci_hdr_gid(const uint8_t *pkt) {
+    return pkt[0] & 0x0F;
+}
+
+static inline uint8_t uci_hdr_oid(const uint8_t *pkt) {
+    return pkt[1] & 0x3F;
+}
+
+/* Write header + payload to `out` (UCI_MAX_PKT bytes). Returns the packet length. */
+uint16_t uci_pkt_build(uint8_t *out, uint8_t mt, uint8_t gid, uint8_t oid,
+                       const uint8_t *payload, uint8_t len);
+
+/* Byte-stream reassembly (UART / CDC ACM have no packet boundaries). */
+struct uci_parser {
+    uint8_t buf[UCI_MAX_PKT];
+    uint16_t n;
+};
+
+/* Returns the packet length once `byte` completes a packet (in p->buf), else 0.
+ * The next call starts a new packet. */
+uint16_t uci_parser_feed(struct uci_parser *p, uint8_t byte);
+
+static inline void uci_parser_reset(struct uci_parser *p) {
+    p->n = 0;
+}
+
+/* One measurement of a RANGE_DATA_NTF */
+struct uci_range_meas {
+    uint16_t mac;
+    uint8_t status;         // UCI_STATUS_OK or UCI_STATUS_RANGING_*
+    uint8_t nlos;           // 1 = Ipatov/STS disagreement (see UWB_RANGE_FLAG_TOA)
+    uint32_t dist_mm;
+    uint32_t report_mm;
+    int16_t toa_diff_dtu;
+};
+
+/* Range log counters for LOG_INFO */
+struct uci_log_info {
+    uint32_t capacity;      // flash bytes
+    uint32_t used;          // bytes in stored blocks
+    uint32_t blocks;
+    uint32_t records;       // logged since boot
+    uint32_t lost;          // not logged since boot
+    uint32_t erases;        // sectors erased since boot
+    uint16_t pending;       // records not yet written
+};
+
+/* Device side. Callbacks run in the caller's context of uci_device_handle() /
+ * uci_device_range_ntf(); the caller serialises the two. */
+struct uci_device_ops {
+    int (*ranging_start)(uint32_t interval_ms);     // 0 or negative errno
+    void (*ranging_stop)(void);
+    void (*send)(const uint8_t *pkt, uint16_t len); // one complete packet
+    uint16_t mac;
+    uint8_t channel;
+    const char *vendor_info;                        // e.g. firmware version
+    // Range log, NULL without one (UCI_GID_LOG then answers UNKNOWN_GID).
+    // log_read returns the bytes copied, 0 at the end, or negative errno.
+    int (*log_info)(struct uci_log_info *out);
+    int (*log_read)(bool restart, uint8_t *buf, uint8_t max, uint16_t *block_len,
+                    uint16_t *offset);
+    int (*log_erase)(void);
+};
+
+void uci_device_init(const struct uci_device_ops *ops);
+
+/* Handle one complete command packet; the response (and any notification it
+ * triggers) is sent through ops->send before returning. */
+void uci_device_handle(const uint8_t *pkt, uint16_t len);
+
+/* Send a RANGE_DATA_NTF if a session is active. Returns false otherwise. */
+bool uci_device_range_ntf(const struct uci_range_meas *m, uint8_t n);
+
+bool uci_device_session_active(void);
+
+#endif /* UWB_UCI_PROTO_H */